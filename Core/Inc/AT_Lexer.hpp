@@ -0,0 +1,94 @@
+/**
+  ******************************************************************************
+  * @file    AT_Lexer.hpp
+  * @author  Ostap Kostyk
+  * @brief   Streaming lexer of ESP8266 AT responses: responses are recognized
+  *          byte by byte by trie built at compile time from the table of patterns,
+  *          numeric and string fields are extracted without line buffer
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* Patterns of responses are listed in AT_Lexer.cpp, e.g. "+CWLAP:(%u,\"%s\",%d,\"%s\",%u,%u,%u" or "OK". They are matched
+ * from the start of the line, longest pattern wins, the rest of the line is ignored. Token is returned at the end of line,
+ * "+IPD,...:" and "+CIPRECVDATA,...:" headers and "> " prompt are returned at once as data follow them in the same line.
+ * Fields: %u - unsigned, %d - signed, %x - hexadecimal number, %s - string until '"', %* - string which is not stored.
+ * Numbers are kept by lexer (GetNumber()), strings are written to buffers given to constructor (first and second string of
+ * the line, cut to buffer size). Cost per byte does not depend on line length, lines of any length can be parsed */
+
+#ifndef AT_LEXER_HPP_
+#define AT_LEXER_HPP_
+
+extern "C" {
+#include "common.h"
+}
+#include <stddef.h>
+
+namespace OKO_ESP8266
+{
+/* forward declaration of enums is not supported by compiler used in this project, see ESP8266.hpp */
+#include "ESP8266_def.hpp"
+
+#define AT_LEXER_NUMBERS_MAX    8   //  numeric fields of one line ("+IPD" with remote IP and port has 7), the rest are ignored
+
+class AT_Lexer
+{
+public:
+    /* Constructor */
+    AT_Lexer(char *pStr, size_t StrSize, char *pStr2, size_t Str2Size);
+
+    /* Takes next received byte. Returns token of recognized response or eAT::NO_COMMAND_RECEIVED */
+    eAT Feed(char Byte);
+
+    /* Drops partly received line, next byte is taken as the start of line */
+    void Reset();
+
+    uint8_t GetNumbersNum() const { return NumbersNum; }    //  numeric fields of the last token, valid until next byte is fed
+    unsigned int GetNumber(uint8_t Index) const { return (Index < NumbersNum) ? Number[Index] : 0; }
+    uint8_t GetStringsNum() const { return StrIndex; }      //  string fields of the last token, written to buffers (two at most)
+
+private:
+    bool StartField(uint16_t FieldNode, char Byte);
+    bool FieldByte(char Byte);
+    void EndField();
+
+    char * const pStr[2];
+    const size_t StrSize[2];
+
+    uint16_t Node;              //  current node of the trie, root if zero
+    eAT Matched;                //  token of the longest pattern matched in the current line
+    bool Unknown;               //  line does not match any pattern, bytes are ignored until end of line
+    bool LineDone;              //  token has been returned, next byte starts new line
+
+    bool InField;               //  current node is a field, bytes are taken while they fit it
+    char FieldType;
+    bool FieldNegative;
+    unsigned int FieldValue;
+    uint16_t FieldLen;          //  digits or string bytes taken
+    uint8_t StrIndex;           //  string being received (index of pStr), 2 and above are not stored
+
+    uint8_t NumbersNum;
+    unsigned int Number[AT_LEXER_NUMBERS_MAX];
+};
+
+}   //  END of namespace OKO_ESP8266
+
+#endif /* AT_LEXER_HPP_ */
@@ -16,9 +16,12 @@ typedef struct circular_buffer
 } circular_buffer;
 
 STATUS cb_init(circular_buffer *cb, size_t capacity, size_t sz);
+STATUS cb_init_static(circular_buffer *cb, void *buffer, size_t capacity, size_t sz);    //  buffer of capacity * sz bytes is provided by caller
 void cb_free(circular_buffer *cb);
 STATUS cb_push_back(circular_buffer *cb, const void *item);
 STATUS cb_pop_front(circular_buffer *cb, void *item);
+size_t cb_pop_front_n(circular_buffer *cb, void *items, size_t n);     //  pops up to n items (one or two memcpy), returns number of items popped
+size_t cb_drop_front(circular_buffer *cb, size_t n);                   //  removes up to n items without copying, returns number of items removed
 size_t cb_space_left(circular_buffer *cb);
 size_t cb_space_occupied(circular_buffer *cb);
 
@@ -0,0 +1,131 @@
+/**
+  ******************************************************************************
+  * @file    CoAP_Server.hpp
+  * @author  Ostap Kostyk
+  * @brief   CoAP (RFC 7252) server over ESP UDP socket: pages and files of HTTP
+  *          server and HTTP variables are accessed by single datagrams,
+  *          larger content is transferred block-wise (RFC 7959)
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* Server binds UDP socket to COAP_SERVER_PORT and answers requests one by one:
+ *   GET <page name or file path>   content of the page (rendered by HTTP_RenderPage()) or file from ROMFS, "GET /" is the home page
+ *   GET /.well-known/core          list of pages in CoRE Link Format (RFC 6690), for discovery
+ *   Uri-Query "name=value"         sets HTTP variable (see HTTPVariable) with GET as with query string of HTTP request
+ *   POST/PUT with payload "name=value&name2=value2" sets HTTP variables, response is 2.04 Changed
+ * Confirmable request is answered by piggybacked ACK, non-confirmable by NON message, token is echoed. Retransmitted request
+ * (same message ID from the same client) is answered by the stored response without processing. Content longer than
+ * COAP_BLOCK_SIZE is sent by blocks (Block2 option), client asks for next blocks, total size is given by Size2 option.
+ * Remote IP and port of requests are needed to answer them, so ESP8266_CIPDINFO_EN is required.
+ * Socket used by server must not be used by HTTP server, see ESP_DefaultConfig::ServerConnections */
+
+#ifndef COAP_SERVER_HPP_
+#define COAP_SERVER_HPP_
+
+#include "Timer.h"
+#include "ESP8266.hpp"
+
+extern "C" {
+#include "common.h"
+}
+
+//#define COAP_SERVER_EN    // CoAP server, see CoAP_Server class, requires ESP8266_CIPDINFO_EN. Should be enabled in the IDE as preprocessor symbol
+
+#if defined(COAP_SERVER_EN) && !defined(ESP8266_CIPDINFO_EN)
+#error "COAP_SERVER_EN requires ESP8266_CIPDINFO_EN (remote IP and port of request)"
+#endif
+
+#define COAP_SERVER_PORT            5683
+#define COAP_RX_BUFFER_SIZE         128         //  longer requests are answered by 4.13 Request Entity Too Large
+#define COAP_BLOCK_SZX              4           //  maximum payload of response is 16 << SZX (256 bytes), client may ask for smaller blocks
+#define COAP_BLOCK_SIZE             (16 << COAP_BLOCK_SZX)
+#define COAP_TX_BUFFER_SIZE         (COAP_BLOCK_SIZE + 32)  //  header, token (up to 8 bytes), options and payload
+#define COAP_PATH_SIZE              48          //  Uri-Path options joined by '/'
+#define COAP_VALUE_SIZE             48          //  "name=value" of one variable
+#define COAP_RENDER_TIMEOUT         _1sec_      //  application should render page within this time (see HTTP_RenderPage())
+#define COAP_RETRY_TIME             _5sec_      //  pause before binding socket again if it failed
+
+namespace OKO_COAP
+{
+using namespace mTimer;
+using namespace OKO_ESP8266;
+
+class CoAP_Server
+{
+public:
+    /* Constructor. Server uses socket SocketID of pESP */
+    CoAP_Server(ESP *pESP, uint8_t SocketID, uint16_t Port = COAP_SERVER_PORT);
+
+    /* Main Handler - must be called regularly (e.g. in main loop) */
+    void Handle();
+
+    bool isReady(void) const { return STEP >= 2; }  //  socket is bound, requests are served
+
+private:
+    enum class eType : uint8_t {Confirmable = 0, NonConfirmable, Acknowledgement, Reset};
+
+    struct request
+    {
+        uint32_t RemoteIP;
+        uint16_t RemotePort;
+        uint16_t MessageID;
+        eType Type;
+        uint8_t Code;               //  method
+        uint8_t TokenLen;
+        uint8_t Token[8];
+        uint32_t BlockNum;          //  Block2 option: number of requested block
+        uint8_t BlockSZX;           //  and its size exponent (block size is 16 << SZX)
+        bool Block2;                //  Block2 option received
+        bool WellKnownCore;         //  "/.well-known/core" requested
+        int PageIndex;              //  page from HTTPServerContent[], -1 if file or nothing
+        const void *pFile;          //  file from ROMFS (ROMFS_File), zero if page
+    };
+
+    uint8_t ParseRequest(uint16_t Len);         //  returns response code, zero if message is to be ignored
+    uint8_t ParseVariables(char *pStr);         //  "name=value&name2=value2", returns response code
+    uint8_t* PutOption(uint8_t *p, uint16_t &LastNumber, uint16_t Number, const uint8_t *pValue, uint16_t Len);
+    uint8_t* PutOptionUint(uint8_t *p, uint16_t &LastNumber, uint16_t Number, uint32_t Value);
+    void Respond(uint8_t Code);                 //  builds response to Request into TxBuffer and sends it
+    uint32_t GetContent(uint32_t Offset, uint8_t *pBuffer, uint32_t Len);  //  copies part of requested content, returns total length of content
+
+    ESP *pESP;
+    const uint8_t SocketID;
+    const uint16_t Port;
+
+    int STEP = 0;
+    Timer StateTimer{Timer::Down, COAP_RETRY_TIME, false};
+    bool Sending = false;               //  response is being sent by SocketSendTo()
+    bool *pSemaphore = 0;               //  application renders page (see HTTP_RenderPage())
+    uint16_t NextMessageID = 0;
+
+    request Request;
+    uint8_t RxBuffer[COAP_RX_BUFFER_SIZE + 1];     //  payload is terminated by zero
+    uint8_t TxBuffer[COAP_TX_BUFFER_SIZE];
+    uint16_t TxLen = 0;                 //  last response is kept for retransmitted request
+    uint32_t TxRemoteIP = 0;            //  destination and message ID of the last response to confirmable request
+    uint16_t TxRemotePort = 0;
+    uint16_t TxMessageID = 0;
+};
+
+}   //  END of namespace OKO_COAP
+
+#endif /* COAP_SERVER_HPP_ */
@@ -31,11 +31,16 @@
 #define ESP8266_HPP_
 
 #include "Timer.h"
+#include "Transport.hpp"
+#include "AT_Lexer.hpp"
 #include <string.h>
 
 extern "C" {
 #include "common.h"
 #include "ESP8266_Interface.h"
+#if defined(ESP8266_TIMESTAMPS_EN) || defined(ESP8266_PROCESS_BUDGET_US)
+#include "Timestamp.h"
+#endif
 }
 
 using namespace mTimer;
@@ -48,8 +53,9 @@ namespace OKO_ESP8266
 /* Configuration */
 #define ESP8266_UART_SPEED  ((uint32_t)230400)  //  this speed will be set after baudrate detection. Can be any desired speed supported by ESP8266: 0:9600; 1:115200; 2:19200; 3:38400; 4:74880; 5:230400; 6:460800; 7:921600
 
-#define ESP8266_SOCKETS_MAX  5      //  5: id 0-4, hardware-specific value, refer to ESP8266 documentation!
-#define ESP8266_RX_BUFF_LEN  100    //  Buffer size for responses on AT commands
+#define ESP8266_SOCKETS_MAX  5      //  5: id 0-4, hardware-specific value, refer to ESP8266 documentation! Instance can use less sockets, see ESP_DefaultConfig
+static_assert(ESP8266_SOCKETS_MAX <= 8, "TxPending has one bit per socket");
+#define ESP8266_TX_PACKET_MAX_SIZE  2048    //  maximum size of one TCP/UDP packet (modem limitation)
 #define ESP8266_AP_NAME_LEN  40     //  Access Point name maximum length
 #define ESP8266_AP_PWD_LEN   40     //  Access Point password max length
 
@@ -62,19 +68,57 @@ namespace OKO_ESP8266
 /* Enable/Disable debug output to stdout */
 #define ESPDEBUG    0
 //#define ESP_DEBUG_HTTP_REQ_ECHO	  // enables/disables echo of HTTP requests to the debug terminal. Should be used as preprocessor symbol
+//#define ESP8266_CIPDINFO_EN      // "+IPD" messages carry remote IP and port (AT+CIPDINFO=1), see GetSocketRemoteIP(). Should be used as preprocessor symbol
+//#define ESP8266_TIMESTAMPS_EN    // time stamps of socket events (connect, first received data, "SEND OK", close), see GetSocketTimestamps(). Should be used as preprocessor symbol
+//#define ESP8266_PROCESS_BUDGET_US 200   // Process() repeats state machine and Rx handling while they make progress, up to this time in microseconds (needs Timestamp_Init()). Should be used as preprocessor symbol
+#define ESP8266_PROCESS_PASSES_MAX  16      //  limit of repetitions by one Process() call with ESP8266_PROCESS_BUDGET_US (in case cycle counter is not running)
+//#define ESP8266_SOCKET_EVENTS_EN  // queue of socket events (connected, data received, data sent, closed), see GetSocketEvent(). Should be used as preprocessor symbol
+#define ESP8266_EVENT_QUEUE_LEN     16      //  number of socket events in the queue, power of 2 up to 128
+#define ESP8266_RESPONSE_QUEUE_LEN  8       //  responses of the module parsed ahead of state machine, power of 2 up to 128
+#define ESP8266_COMMAND_QUEUE_LEN   4       //  AT commands waiting to be sent, power of 2 up to 128
+#define ESP8266_COMMAND_LEN_MAX     72      //  longest queued AT command including "\r\n" (AT+CIPAP_CUR with three addresses)
+#define ESP8266_RX_PAUSE_MARGIN     16      //  rest of paused stream message (see ListenSocketStream()) is dropped when less than this is free in UART receive buffer
+#define ESP8266_SERVER_TIMEOUT      10      //  seconds, module closes server connections idle for this time (AT+CIPSTO, 0 - never, module default is 180)
+#define ESP8266_TX_QUANTUM_CONTROL  4096    //  bytes a socket may send per round of TX scheduler, by its class (see SetSocketTxClass())
+#define ESP8266_TX_QUANTUM_NORMAL   2048
+#define ESP8266_TX_QUANTUM_BULK     512
+//#define ESP8266_SENDBUF_EN        // TCP packets are sent by AT+CIPSENDBUF (if firmware supports it) without waiting for "SEND OK" of the previous one. Should be used as preprocessor symbol
+#define ESP8266_SENDBUF_SEGMENTS    4       //  packets of one socket written to the module with ESP8266_SENDBUF_EN and not yet confirmed by "<id>,<segment>,SEND OK"
+//#define ESP8266_PASSIVE_RX_EN     // passive receive mode (AT+CIPRECVMODE=1, if firmware supports it): TCP data wait in the module until socket buffer is free and are taken by AT+CIPRECVDATA. Should be used as preprocessor symbol
+#define ESP8266_RECVDATA_MAX        2048    //  limit of one AT+CIPRECVDATA (module limitation)
+#define ESP8266_RECVDATA_OVERHEAD   32      //  "+CIPRECVDATA,<len>:" and "OK" around requested data, the whole reply fits into UART receive buffer
+//#define ESP8266_RX_RING_EN        // ring receive mode of sockets: data are appended continuously and taken in any portions, see ListenSocketRing(). Should be used as preprocessor symbol
+//#define ESP8266_PASSTHROUGH_EN    // transparent transmission (AT+CIPMODE=1) to one remote side, see PassthroughStart(). Should be used as preprocessor symbol
 #define esp_debug_print(...) do { if (ESPDEBUG) fprintf(stdout, ##__VA_ARGS__); } while (0) //  debug print for this module. Compiler should not exclude all calls from the code if ESPDEBUG not defined
 
 /* END of Configuration */
 
+/* Compile-time configuration of ESP instance (see ESP_Instance at the end of file): static buffers are sized by it.
+ * Product-specific configuration derives from the default one and overrides needed values only, e.g.
+ *     struct MyESPConfig : ESP_DefaultConfig { static constexpr uint8_t Sockets = 2; static constexpr uint16_t UartRxSize = 128; };
+ *     ESP_Instance<MyESPConfig> ESP1{ESP1_HUART_NUM};
+ * Optional features are still enabled by preprocessor symbols (see above) */
+struct ESP_DefaultConfig
+{
+    static constexpr uint8_t  Sockets = ESP8266_SOCKETS_MAX;            //  sockets with id 0 to Sockets-1
+    static constexpr uint8_t  ServerConnections = ESP8266_SOCKETS_MAX;  //  incoming connections accepted by server (AT+CIPSERVERMAXCONN), not more than Sockets. Less leaves upper sockets for outgoing connections
+    static constexpr uint16_t UartRxSize = ESP8266_CB_RX_SIZE;          //  UART circular buffers, members of ESP_Instance
+    static constexpr uint16_t UartTxSize = ESP8266_CB_TX_SIZE;
+    static constexpr uint16_t TxPacketMaxSize = ESP8266_TX_PACKET_MAX_SIZE;     //  longer data are sent by several packets
+};
+
+template<class Config> class ESP_Instance;
+
 /*************************************************************
  *                      ESP Class
  *************************************************************/
 
-class ESP
+class ESP : public OKO_TRANSPORT::Transport
 {
 public:
-    /* Constructor */
-    ESP(uint8_t HuartNumber);
+    /* Instances are created as ESP_Instance<Config>, which allocates storage for them */
+    ESP(const ESP&) = delete;
+    ESP& operator=(const ESP&) = delete;
 
     /* Main Handler - must be called regularly (e.g. in main loop) */
     void Process();
@@ -103,17 +147,27 @@ enum class eAccessPointState{NotStarted = 0, Starting, Timeout, Failed, Started}
 /* Server States */
 enum class eServerState{Undefined = 0, GotIP = 2, Connected = 3, Disconnected = 4, Connecting = 200, ConnectTimeout = 254, Error = 255};
 
-/* Socket States */
-enum class eSocketState{Closed = 0, Open, ConnectRequested, Connecting, Connected, CloseRequested, Closing, Error};
-
 /* Socket Error Flags */
 enum class eSocketErrorFlag {NoError = 0, FailToConnect, Timeout, NoAccessPoint, InternalError};
 
 /* Socket Type: UDP or TCP */
 enum class eSocketType {UDP = 0, TCP};
 
-/* Data transmit states */
-enum class eSocketSendDataStatus{Idle = 0, SendRequested, InProgress, SendFail, SendSuccess};
+/* Socket states and data transmit states are declared by Transport */
+
+#ifdef ESP8266_PASSTHROUGH_EN
+/* Transparent transmission states: Entering (server and connections are being closed, connection to remote side is being established),
+ * Active (data go both ways by PassthroughSend()/PassthroughRecv()), Leaving (server mode is being restored), Failed (connection failed or module restarted) */
+enum class ePassthroughState {Idle = 0, Entering, Active, Leaving, Failed};
+#endif
+
+#ifdef ESP8266_RX_RING_EN
+/* What happens when data come for socket in ring receive mode and the ring is full: Pause - with ESP8266_PASSIVE_RX_EN data wait
+ * in the module until application reads the ring, otherwise message which does not fit into free space of the ring is dropped whole
+ * when "+IPD" comes (receiving of other sockets and AT responses never wait for the application), Drop - the rest of the message
+ * which does not fit is dropped, Close - the rest of the message is dropped and the socket is closed */
+enum class eRxFullPolicy {Pause = 0, Drop, Close};
+#endif
 
 /* Public Methods */
 /* Enables/Disables Module using "Enable" IO-pin. Module is disabled by default and whole engine will not work saving CPU resources */
@@ -152,33 +206,104 @@ ESP::eServerState GetServerState();
  * (1 to ESP8266_SOCKETS_MAX) and returns SUCCESS. If all sockets occupied then returns ERROR */
 STATUS OpenSocket(uint8_t &SocketID, eSocketType Type);
 
+/* Same as OpenSocket() but opens socket SocketID, e.g. one of sockets which are not used by server (see ESP_DefaultConfig::ServerConnections).
+ * Returns ERROR if the socket is not closed */
+STATUS OpenSocketWithID(uint8_t SocketID, eSocketType Type);
+
 /* Connects socket <SocketID> to provided Address and Port. Returns SUCCESS or ERROR.
- * Socket with SocketID must be opened by OpenSocket() before. */
+ * Socket with SocketID must be opened by OpenSocket() before. Address string is used until connection is established, it is not modified */
 STATUS ConnectSocket(uint8_t SocketID, char * Address, unsigned int Port);
 
+/* Opens TCP socket SocketID by OpenSocketWithID() and connects it by ConnectSocket() (Transport interface for clients, e.g. HTTP_Client) */
+STATUS OpenConnection(uint8_t SocketID, const char *pHost, uint16_t Port) override;
+
+/* Binds UDP socket opened by OpenSocket()/OpenSocketWithID() to LocalPort: datagrams from any remote side are received
+ * (AT+CIPSTART=<id>,"UDP","0.0.0.0",<LocalPort>,<LocalPort>,2). Socket becomes Connected, replies are sent by SocketSendTo() */
+STATUS BindSocket(uint8_t SocketID, unsigned int LocalPort);
+
 /* Listen to connected socket. Returns SUCCESS if SocketID is in range of existing sockets
  * and this socket is connected (see ESP::eSocketState) */
-STATUS ListenSocket(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize);
+STATUS ListenSocket(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize) override;
+
+/* Same as ListenSocket() but in stream mode: incoming message longer than the buffer is not cut. When the buffer is full
+ * receiving pauses (rest of the message stays in HUART buffer) until application provides next buffer by calling
+ * ListenSocketStream() again. While paused, nothing else is received from the module, so application must provide next buffer
+ * quickly or return to normal mode by calling ListenSocket() (rest of paused message is ignored then). If HUART buffer fills up
+ * meanwhile, rest of paused message is dropped and SocketRecv() returns -1 after the next ListenSocketStream(), so messages
+ * of other sockets are not lost by overflow. With ESP8266_PASSIVE_RX_EN stream never pauses: data wait in the module */
+STATUS ListenSocketStream(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize) override;
 
 /* check if there are data received, returns num of data in buffer OR -1 if message has been cut */
-uint16_t SocketRecv(uint8_t SocketID);
+uint16_t SocketRecv(uint8_t SocketID) override;
+
+/* Returns true if receiving of the message is paused because stream buffer is full (see ListenSocketStream()) */
+bool SocketRxPaused(uint8_t SocketID) override;
+
+/* Leaves stream mode without providing new buffer: rest of paused message and further incoming data are ignored until ListenSocket() */
+void SocketRxDiscard(uint8_t SocketID) override;
+
+#ifdef ESP8266_RX_RING_EN
+/* Ring receive mode: incoming data are appended to Ring of Size bytes while application takes them by SocketRead() in any portions,
+ * nothing is locked between messages. Policy defines what happens when the ring is full. Mode stays until ListenSocket(),
+ * ListenSocketStream() or SocketRxDiscard(). Returns ERROR if SocketID is out of range or Ring is zero.
+ * Ring mode is ESP class only, it is not part of Transport interface: applications written for Transport (HTTP_Server)
+ * use ListenSocket() and ListenSocketStream() */
+STATUS ListenSocketRing(uint8_t SocketID, uint8_t *Ring, uint16_t Size, eRxFullPolicy Policy);
+
+/* Returns number of bytes in the ring */
+uint16_t SocketRxAvailable(uint8_t SocketID);
+
+/* Copies up to Len bytes from the ring to pData and removes them from the ring (pData can be zero to skip data), returns number of bytes taken */
+uint16_t SocketRead(uint8_t SocketID, uint8_t *pData, uint16_t Len);
+
+/* Same as SocketRead() but data stay in the ring */
+uint16_t SocketPeek(uint8_t SocketID, uint8_t *pData, uint16_t Len);
+
+/* Returns number of bytes lost since ListenSocketRing() because the ring was full or HUART buffer overflowed */
+uint32_t GetSocketRxDropped(uint8_t SocketID);
+#endif
+
+/* Returns IP address (e.g. 0xC0A80002 is 192.168.0.2) and port of the remote side of the last message received by the socket.
+ * Zero if unknown (ESP8266_CIPDINFO_EN is not defined or module firmware doesn't support AT+CIPDINFO) */
+uint32_t GetSocketRemoteIP(uint8_t SocketID) override;
+uint16_t GetSocketRemotePort(uint8_t SocketID) override;
+
+#ifdef ESP8266_TIMESTAMPS_EN
+/* Time stamps (see Timestamp.h) of the current or last connection of the socket: "<id>,CONNECT", first "+IPD", first and last "SEND OK", "<id>,CLOSED" */
+const socket_timestamps* GetSocketTimestamps(uint8_t SocketID) override;
+#endif
+
+#ifdef ESP8266_SOCKET_EVENTS_EN
+/* Takes the oldest event (see Transport::eSocketEvent) from the queue into Event, returns false if there are no events. Events are generated
+ * by Process() from changes of socket states, so application can wait for them instead of polling every socket.
+ * Overflow (SocketID is ESP8266_SOCKETS_MAX) means that queue was full or module was re-initialized */
+bool GetSocketEvent(socket_event &Event) override;
+#endif
 
 /* Initialize Data Send process. Return SUCCESS if socket is connected and data prepared to be sent, otherwise ERROR */
-STATUS SocketSend(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen);
+STATUS SocketSend(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen) override;
 
 /* Same as SocketSend() but closes socket after sending completion */
-STATUS SocketSendClose(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen);
+STATUS SocketSendClose(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen) override;
+
+/* Same as SocketSend() for UDP socket, datagram is sent to RemoteIP (e.g. 0xC0A80002 is 192.168.0.2) and RemotePort,
+ * e.g. to the sender of received datagram (see GetSocketRemoteIP()). Data longer than ESP8266_TX_PACKET_MAX_SIZE are sent as several datagrams */
+STATUS SocketSendTo(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen, uint32_t RemoteIP, uint16_t RemotePort);
 
 /* Closes socket. Returns error if SocketID is out of range (doesn't exist), otherwise SUCCESS
  * If Socket is not "Open" or "Closed", means it is connected or in process of connection/disconnection
  * then this method only requests it to be closed and state machine tries to close it later */
-STATUS CloseSocket(uint8_t SocketID);
+STATUS CloseSocket(uint8_t SocketID) override;
 
 /* Returns current socket state */
-ESP::eSocketState GetSocketState(uint8_t SocketID);
+ESP::eSocketState GetSocketState(uint8_t SocketID) override;
 
 /* Returns data send status */
-ESP::eSocketSendDataStatus GetDataSendStatus(uint8_t SocketID);
+ESP::eSocketSendDataStatus GetDataSendStatus(uint8_t SocketID) override;
+
+/* Sets transmit class of the socket (Normal by default and for every accepted connection). Packets of sockets with data to send
+ * are interleaved by deficit round robin: each round socket may send ESP8266_TX_QUANTUM_<class> bytes */
+void SetSocketTxClass(uint8_t SocketID, eTxClass Class) override;
 
 /* Returns connection state to remote access point */
 ESP::eStationConnectionState StationConnectionState();
@@ -193,17 +318,82 @@ uint8_t AccessPointNameChanged();
 /* Sets IP address of the Access Point */
 bool SetAccessPointIP(uint32_t ip, uint32_t gw, uint32_t mask);
 
+/* Requests AT+CIPSTATUS: socket states are compared with connections of the module, sockets with lost "<id>,CLOSED" are closed
+ * and connections with lost "<id>,CONNECT" are taken. Done periodically (ConnectionsInfoPeriod) in multiple connection mode anyway */
+void SyncSocketStates();
+
+#ifdef ESP8266_PASSTHROUGH_EN
+/* Requests transparent transmission with RemoteIP (e.g. 0xC0A80002 is 192.168.0.2) and RemotePort for bulk transfers: all connections
+ * and server are closed, module is switched to single connection mode, connected by AT+CIPSTART and switched to AT+CIPMODE=1 and AT+CIPSEND.
+ * Then data go without "+IPD" and AT+CIPSEND framing at the speed of UART. Sockets cannot be used until PassthroughStop() is completed,
+ * server is started again then. Returns ERROR if transparent transmission is already requested */
+STATUS PassthroughStart(uint32_t RemoteIP, uint16_t RemotePort, eSocketType Type);
+
+/* Leaves transparent transmission: waits until written data are sent out, sends "+++" with guard time, closes connection
+ * and returns module to the connection type and server state it had before PassthroughStart() */
+void PassthroughStop();
+
+ESP::ePassthroughState GetPassthroughState();
+
+/* In Active state writes up to Len bytes to UART (as much as transmit buffer takes), returns number of bytes written */
+size_t PassthroughSend(const uint8_t *pData, size_t Len);
+
+/* In Active state takes up to Len bytes received from the remote side directly from UART buffer, returns number of bytes taken.
+ * Data must be taken faster than they come, there is no flow control in transparent transmission */
+size_t PassthroughRecv(uint8_t *pData, size_t Len);
+#endif
+
 /******************************************
  *      PRIVATE MEMBERS
  ******************************************/
 private:
+    template<class Config> friend class ESP_Instance;
+    template<class Config> friend struct ESP_Storage;
+
+    /* Runtime copy of ESP_Instance configuration */
+    struct config
+    {
+        uint8_t  Sockets;
+        uint8_t  ServerConnections;
+        uint16_t UartRxSize;
+        uint16_t UartTxSize;
+        uint16_t TxPacketMaxSize;
+    };
+
+    class socket;
+    ESP(uint8_t HuartNumber, const config &Config, socket *pSockets, uint8_t *pUartRx, uint8_t *pUartTx);
+
+    void SocketRxDiscardPaused(uint8_t SocketID);  //  ignores rest of the message if receiving to stream buffer is paused (or goes to the ring)
+    bool SocketRxReady(uint8_t SocketID);           //  message is received (or stream buffer is full) and can be taken by SocketRecv()
+    bool SocketTxReady(uint8_t SocketID);           //  data are waiting to be sent and the next packet can be sent now
+    int TxSchedule(void);                           //  socket to send the next packet, -1 if none can send now
+#ifdef ESP8266_SENDBUF_EN
+    void SendBufSegmentDone(uint8_t SocketID, uint16_t Segment, bool Sent);   //  "<id>,<segment>,SEND OK/FAIL", completes sending when the last packet is confirmed
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+    uint16_t SocketRxPullLen(uint8_t SocketID);     //  bytes to request by AT+CIPRECVDATA now, zero if socket cannot take data
+    void SocketRxPulled(uint8_t SocketID, uint16_t Len);    //  "+CIPRECVDATA,<len>:" data waiting in the module are updated
+#endif
     uint8_t HuartNumber;
+    const uint16_t UartRxSize;
+    const uint16_t UartTxSize;
+    uint8_t * const pUartRx;                                    //  UART circular buffers, allocated by ESP_Instance
+    uint8_t * const pUartTx;
+    const uint16_t TxPacketMaxSize;                             //  defines maximum size of one TCP/UDP packet
     bool HuartConfigured;                                       //  disables whole engine if false (UART is not configured). Changes to true if configured successfully by ESP_HuartInit()
     eModuleToggle ModuleToggleFlag = eModuleToggle::Disable;    //  Module disabled by default. Module must be enabled from the main program to start communication
 
     uint8_t STEP;   //  State machine step
     Timer StateTimer{Timer::Down, _1sec_, false};    //  down counting timer with dummy delay and disabled
+    const unsigned long ConnectionsInfoPeriod = _5sec_; //  AT+CIPSTATUS period, see SyncSocketStates()
+    Timer ConnectionsInfoTimer{Timer::Down, ConnectionsInfoPeriod, false};  //  started with the server
+    bool ConnectionsInfoRequest = false;
+    uint8_t ConnectionsInfoLinks;           //  bit per connection listed by "+CIPSTATUS:"
+    uint8_t ConnectionsInfoServerLinks;     //  connections accepted by the server
     const unsigned long DataSendTimeout = _3sec_;    //  defines timeout for sending data with socket
+    uint8_t TxPending = 0;      //  bit per socket with send requested, cleared by TxSchedule() when socket has nothing more to send
+    uint8_t TxTurn = 0;         //  socket which has its turn in TX round
+    int8_t TxNext = -1;         //  socket chosen by Standby for StateSendData
 
     const unsigned long FlushRxUARTTime = _500ms_;   // value for the timer below
     Timer RxOverflowTimer{Timer::Down, FlushRxUARTTime, false}; //  if Rx buffer overflows (usually happen when ESP module starts with the wrong speed) then this timer keeps engine off for time-out time to flush all trash coming from the module
@@ -212,16 +402,48 @@ private:
     /* Debug flags */
     bool DebugFlag_RxStreamToStdOut;
     bool DebugFlag2 = false;
-    /* New command semaphore - flag blocking from storing new command from Rx stream until engine make one round (in case when Rx stream received (using interrupts) more than one command and main handler has not been ran in between) */
-    bool NewCommandSemaphore;
     bool FirstTime;     //  flag for one-time at start initialization, using to initialize something (e.g. UART communication)
 
     /* PRIVATE METHODS */
+    bool ProcessStep();                 //  one pass of Process(), returns true if there was progress
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    void UpdateSocketEvents(uint8_t SocketID);  //  compares socket with its state seen last time and queues events
+    void PushSocketEvent(eSocketEvent Type, uint8_t SocketID, uint16_t Len);
+
+    socket_event EventQueue[ESP8266_EVENT_QUEUE_LEN];
+    uint8_t EventWrite = 0;             //  free-running indexes, number of events is EventWrite - EventRead
+    uint8_t EventRead = 0;
+    bool EventsLost = false;
+#endif
     void RxHandler();                   //  Handles Rx stream coming from ESP module. Parses commands and data from sockets
+    void SocketConnected(uint8_t SocketID);     //  "<id>,CONNECT"
+    void SocketClosed(uint8_t SocketID);        //  "<id>,CLOSED"
+#ifdef ESP8266_RX_RING_EN
+    void RxToRing();                    //  Rx stream of the message goes to the ring of socket IO.RxSocketId
+#endif
     void ModuleReInit();                //  Re-initialize ESP module in case of fault that cannot be handled by engine
-    bool isCommandReceived(eAT Cmd);    //  check if specific AT-command received from ESP module
-    void StoreCommand(eAT Cmd);         //  stores AT command received from ESP module
-    void ClearLastCommand();            //  clears last received AT-command
+    bool isCommandReceived(eAT Cmd);    //  check if the oldest queued response of ESP module is Cmd, takes it from the queue if so
+    void StoreCommand(eAT Cmd, bool Strings);   //  queues response received from ESP module, Strings: its string parameters are in IO.pReceivedParameterStr/Str2
+    void ClearLastCommand();            //  drops all queued responses
+    void HandleMessages();              //  handles restart of the module in any state (socket connected/closed are handled by RxHandler() at once)
+    eAT TakeResponse();                 //  takes the oldest queued response whatever it is, eAT::NO_COMMAND_RECEIVED if there is none
+
+    /* Queue of AT commands run by StateCommandQueue: module takes one command at a time, so the next one is sent as soon as
+     * the previous one is completed, without return to Standby. Callback is called for every response to the command with
+     * its parameters in IO.pReceivedParameter, Last is true for terminal response (Done or Done2) or for timeout, when Response
+     * is eAT::NO_COMMAND_RECEIVED. Tag is passed to callback (e.g. socket id) */
+    typedef void (*at_callback)(ESP *pESP, uint8_t Tag, eAT Response, bool Last);
+    STATUS QueueCommand(const char *pCmd, size_t Len, eAT Done, eAT Done2, unsigned long Timeout, at_callback Callback, uint8_t Tag);
+    static void CloseSocketCallback(ESP *pESP, uint8_t SocketId, eAT Response, bool Last);
+    static void GetApIPCallback(ESP *pESP, uint8_t Tag, eAT Response, bool Last);
+    static void ChangeAPIPCallback(ESP *pESP, uint8_t Tag, eAT Response, bool Last);
+#ifdef ESP8266_SENDBUF_EN
+    static void SendBufTestCallback(ESP *pESP, uint8_t Tag, eAT Response, bool Last);
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+    static void PassiveRxCallback(ESP *pESP, uint8_t Tag, eAT Response, bool Last);
+    static void RecvDataCallback(ESP *pESP, uint8_t SocketId, eAT Response, bool Last);
+#endif
 
     /* STATE MACHINE */
     class StateMachine
@@ -259,6 +481,13 @@ private:
         uint32_t BaudRate = ESP8266_UART_SPEED; //  ESP8266 baudrate is switched to this speed after baudrate detection. TODO: public method can be implemented to set this member from outside.
         bool EchoIsOnFlag = true;               //  echo is ON by default on ESP8266, flag is cleared by state machine after successful command ATE0
         uint8_t AP_NamePostfix;                 //  Access Point Name Postfix. Is added to Requested Name automatically if another AP with this name is broadcasting
+#ifdef ESP8266_SENDBUF_EN
+        bool SendBufSupported = false;          //  firmware answered "OK" to AT+CIPSENDBUF=?
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+        bool PassiveRx = false;                 //  firmware answered "OK" to AT+CIPRECVMODE=1
+        bool RxLenQuery = false;                //  "+IPD,<id>,<len>" notifications could be lost, AT+CIPRECVLEN? is queued by Standby
+#endif
 
     //private:
         /* Reload operator new to be able to call constructor and re-initialize members any time */
@@ -362,6 +591,22 @@ private:
     server Server{};            //  instance of server class (only create, never destroy)
     server *pServer = &Server;
 
+#ifdef ESP8266_PASSTHROUGH_EN
+    struct passthrough
+    {
+        ePassthroughState State = ePassthroughState::Idle;
+        bool StopRequest = false;
+        bool Error = false;             //  Failed state after server mode is restored
+        eSocketType Type = eSocketType::TCP;
+        uint32_t RemoteIP = 0;
+        uint16_t RemotePort = 0;
+        eModuleConnectionType ConnectionType = eModuleConnectionType::Undefined;  //  restored after leaving
+        bool ServerStarted = false;
+    };
+
+    passthrough Passthrough{};
+#endif
+
 /***********************************************************************************************
  *  This class (input-output) handles communication with ESP module over HUART
  ***********************************************************************************************/
@@ -377,18 +622,44 @@ private:
         void ClearReceivingErrors();
         void ClearRxStream();
 
-        const unsigned int TxPacketMaxSize = 2048;                //  defines maximum size of one TCP/UDP packet (modem limitation)
-
-        char* pRxBuffer, *pCommandString, *pReceivedParameterStr, *pReceivedParameterStr2;
-        const size_t  RxBufferSize = sizeof(RxBuffer);
+        char *pCommandString, *pReceivedParameterStr, *pReceivedParameterStr2;
         const size_t  CommandStringSize = sizeof(CommandString);
         const size_t  ReceivedParameterStrSize = sizeof(ReceivedParameterStr);
         const size_t  ReceivedParameterStr2Size = sizeof(ReceivedParameterStr2);
         unsigned int* pReceivedParameter;
-        eAT ReceivedCommand;
+
+        /* Responses parsed by RxHandler() and waiting for state machine. State machine sees the oldest one per pass and it is
+         * dropped after the pass if not taken, as if it was the only one received. Restart of the module is seen in any state
+         * by HandleMessages() */
+        struct response
+        {
+            eAT Token;
+            bool Strings;       //  string parameters are in ReceivedParameterStr/Str2, parsing waits until response is dropped
+            unsigned int Param[ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM];
+        };
+        response Response[ESP8266_RESPONSE_QUEUE_LEN];
+        uint8_t ResponseWrite;  //  free-running indexes, number of responses is ResponseWrite - ResponseRead
+        uint8_t ResponseRead;
+        bool ResponseTaken;     //  state machine has taken a response during current pass
+
+        response* GetResponse();    //  oldest response, zero if queue is empty
+        bool isResponseQueueBlocked();  //  queue is full or string parameters of queued response would be overwritten by parsing
+
+        /* AT commands queued by QueueCommand() */
+        struct at_command
+        {
+            char Cmd[ESP8266_COMMAND_LEN_MAX];
+            uint8_t Len;
+            eAT Done, Done2;        //  terminal responses
+            uint8_t Tag;
+            unsigned long Timeout;
+            at_callback Callback;
+        };
+        at_command Command[ESP8266_COMMAND_QUEUE_LEN];
+        uint8_t CommandWrite;   //  free-running indexes, number of commands is CommandWrite - CommandRead
+        uint8_t CommandRead;
 
         uint8_t  RxSocketId;
-        uint16_t RxBuffCounter;
         uint32_t RxIgnoreCounter;
         uint16_t CurrentSocketDataLeft;
         uint8_t  *pCurrentSocketData;
@@ -399,20 +670,22 @@ private:
         bool ReceiveError;
         bool ListenToTxData;
         bool ReceivingDataStream;
+        bool Passthrough;       //  received data are not parsed, they are taken by PassthroughRecv() or by StatePassthrough
 
     //private:
         /* Reload operator new to be able to call constructor and re-initialize members any time */
         inline void* operator new( size_t, void* where ) { return where; }
 
         /* memory allocated statically to see memory footprint at compile time, better debug possibilities etc.  */
-        char RxBuffer[ESP8266_RX_BUFF_LEN] = "";
         char CommandString[ESP8266_AP_NAME_LEN+ESP8266_AP_PWD_LEN+40] = "";
         unsigned int    ReceivedParameter[ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM];
         char            ReceivedParameterStr[ESP8266_RECEIVED_COMMAND_PARAM_STR_LEN];
         char            ReceivedParameterStr2[ESP8266_RECEIVED_COMMAND_PARAM_STR2_LEN];
+
+        AT_Lexer Lexer{ReceivedParameterStr, sizeof(ReceivedParameterStr), ReceivedParameterStr2, sizeof(ReceivedParameterStr2)};  //  responses are parsed byte by byte, no line buffer
     };
 
-    io IO{};
+    io IO;
     io* pIO = &IO;
 
 /***********************************************************************************************
@@ -440,6 +713,42 @@ private:
         eSocketSendDataStatus TxState;
         bool DataCutFlag;    //  indicates HUART buffer overflow during receiving income stream or that the length of Rx message is biger than provided buffer length for the message
         bool CloseAfterSending;
+        bool RxStream;       //  stream mode, see ListenSocketStream()
+        bool RxStreamCut;    //  rest of paused message was dropped, reported by SocketRecv() after next ListenSocketStream()
+        uint8_t LinkEvents;  //  counter of "<id>,CONNECT" and "<id>,CLOSED", AT+CIPSTATUS reply does not change socket which had them meanwhile
+        uint8_t LinkEventsSeen;
+        eTxClass TxClass;
+        uint16_t TxDeficit;  //  bytes socket may still send in its turn (deficit round robin, see TxSchedule())
+#ifdef ESP8266_RX_RING_EN
+        bool RxRing;         //  ring mode, see ListenSocketRing(): DataRx is the ring of RxBuffSize bytes, RxDataLen bytes are in it from RxRead
+        eRxFullPolicy RxPolicy;
+        uint16_t RxRead;
+        uint32_t RxDropped;
+#endif
+        uint32_t RemoteIP;   //  remote side of the last received message, see GetSocketRemoteIP()
+        uint16_t RemotePort;
+        uint16_t LocalPort;  //  UDP socket bound by BindSocket(), zero otherwise
+        uint32_t TxRemoteIP; //  destination of datagram sent by SocketSendTo()
+        uint16_t TxRemotePort;  //  zero: data are sent to the connected remote side
+#ifdef ESP8266_SENDBUF_EN
+        uint16_t TxSegment;             //  segment id given by the module to the last packet sent by AT+CIPSENDBUF
+        uint8_t TxSegmentsInFlight;     //  packets written to the module and not confirmed yet
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+        uint32_t RxPending;             //  received data waiting in the module (passive receive mode)
+        uint16_t RxRequested;           //  AT+CIPRECVDATA is queued for this number of bytes
+#endif
+#ifdef ESP8266_TIMESTAMPS_EN
+        socket_timestamps Timestamps;
+#endif
+#ifdef ESP8266_SOCKET_EVENTS_EN
+        eSocketState EventState;    //  state seen by UpdateSocketEvents() last time
+        eSocketSendDataStatus EventTxState;
+        bool EventRxReady;          //  SocketRecv() returned data
+#ifdef ESP8266_RX_RING_EN
+        uint16_t EventRxLen;        //  bytes in the ring seen last time
+#endif
+#endif
 
         //uint16_t CurrentTxSocketId;     //  needed for state machine, keeps the number of current socket (0 to ESP8266_SOCKETS_MAX)
 
@@ -448,9 +757,9 @@ private:
         inline void* operator new( size_t, void* where ) { return where; }
     };
 
-    socket Socket[ESP8266_SOCKETS_MAX];     //  create sockets, never destroyed, can be re-initialized by constructor
-    socket *pSocket[ESP8266_SOCKETS_MAX];
-    const uint8_t SocketsNum = ESP8266_SOCKETS_MAX;
+    socket * const Socket;      //  sockets are allocated by ESP_Instance, never destroyed, can be re-initialized by constructor
+    const uint8_t SocketsNum;
+    const uint8_t ServerConnections;
 
 /***********************************************************************************************
  *                           STATE MACHINE STATES
@@ -466,21 +775,26 @@ private:
     class StateJoinAP               : public StateMachine { public: void Process(ESP* pESP); ~StateJoinAP(){}               };
     class StateChangeConnectionType : public StateMachine { public: void Process(ESP* pESP); ~StateChangeConnectionType(){} };
     class StateStartServer          : public StateMachine { public: void Process(ESP* pESP); ~StateStartServer(){}          };
-    class StateGetApIP              : public StateMachine { public: void Process(ESP* pESP); ~StateGetApIP(){}              };
-    class StateChangeAPIP           : public StateMachine { public: void Process(ESP* pESP); ~StateChangeAPIP(){}           };
+    class StateCommandQueue         : public StateMachine { public: void Process(ESP* pESP); ~StateCommandQueue(){}         };
     class StateGetConnectionsInfo   : public StateMachine { public: void Process(ESP* pESP); ~StateGetConnectionsInfo(){}   };
-    class StateStandby              : public StateMachine
+#ifdef ESP8266_PASSTHROUGH_EN
+    class StatePassthrough          : public StateMachine
     {
-        public: void Process(ESP* pESP); ~StateStandby(){}
+        public: void Process(ESP* pESP); ~StatePassthrough(){}
         private:
-        uint8_t SocketId;
+        void SendCommand(ESP* pESP, const char *pCmd, size_t Len, unsigned long Timeout);  //  sends command and goes to the next step, module is reset if UART fails
     };
+#endif
+    class StateStandby              : public StateMachine { public: void Process(ESP* pESP); ~StateStandby(){}              };
     class StateSendData             : public StateMachine
     {
         public: void Process(ESP* pESP); ~StateSendData(){}
         private:
         uint8_t SocketId;     //  needed in StateSendData, keeps the number of current socket (0 to ESP8266_SOCKETS_MAX)
         uint8_t RetryCounter;
+#ifdef ESP8266_SENDBUF_EN
+        bool Buffered;        //  current packet is sent by AT+CIPSENDBUF
+#endif
     };
     class StateOpenSocket           : public StateMachine
     {
@@ -488,12 +802,6 @@ private:
         private:
         uint8_t SocketId;
     };
-    class StateCloseSocket          : public StateMachine
-    {
-        public: void Process(ESP* pESP); ~StateCloseSocket(){}
-        private:
-        uint8_t SocketId;
-    };
     //class  : public StateMachine { public: void Process(ESP* pESP); ~(){} };
 
     /* State Machine States */
@@ -510,14 +818,42 @@ private:
     StateChangeConnectionType   smChangeConnectionType;
     StateSendData               smSendData;
     StateOpenSocket             smOpenSocket;
-    StateCloseSocket            smCloseSocket;
     StateStartServer            smStartServer;
-    StateGetApIP                smGetApIP;
-    StateChangeAPIP             smChangeAPIP;
+    StateCommandQueue           smCommandQueue;
     StateGetConnectionsInfo     smGetConnectionsInfo;
+#ifdef ESP8266_PASSTHROUGH_EN
+    StatePassthrough            smPassthrough;
+#endif
 
 };
 
+/* Storage of ESP_Instance, base class to be constructed before ESP */
+template<class Config> struct ESP_Storage
+{
+    static_assert(Config::Sockets > 0 && Config::Sockets <= ESP8266_SOCKETS_MAX, "number of sockets is limited by module");
+    static_assert(Config::ServerConnections > 0, "server needs at least one connection");
+    static_assert(Config::UartRxSize > ESP8266_RX_PAUSE_MARGIN && Config::UartTxSize > 0, "UART buffers are too small");
+    static_assert(Config::TxPacketMaxSize > 0 && Config::TxPacketMaxSize <= ESP8266_TX_PACKET_MAX_SIZE, "packet size is limited by module");
+#ifdef ESP8266_PASSIVE_RX_EN
+    static_assert(Config::UartRxSize > ESP8266_RECVDATA_OVERHEAD, "UART receive buffer must hold reply to AT+CIPRECVDATA");
+#endif
+
+    ESP::socket Sockets[Config::Sockets];
+    uint8_t UartRx[Config::UartRxSize];
+    uint8_t UartTx[Config::UartTxSize];
+};
+
+/* ESP with static buffers sized by Config (see ESP_DefaultConfig) */
+template<class Config = ESP_DefaultConfig> class ESP_Instance : private ESP_Storage<Config>, public ESP
+{
+public:
+    typedef Config config_type;
+
+    /* Constructor */
+    ESP_Instance(uint8_t HuartNumber) : ESP(HuartNumber, {Config::Sockets, (Config::ServerConnections < Config::Sockets) ? Config::ServerConnections : Config::Sockets, Config::UartRxSize, Config::UartTxSize, Config::TxPacketMaxSize},
+                                            ESP_Storage<Config>::Sockets, ESP_Storage<Config>::UartRx, ESP_Storage<Config>::UartTx) {}
+};
+
 }   //  END of namespace OKO_ESP8266
 
 #endif /* ESP8266_HPP_ */
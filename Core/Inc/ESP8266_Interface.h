@@ -33,21 +33,22 @@
 #include "common.h"
 #include "CircularBuffer.h"
 #include "main.h"
+#include "My_hal_uart_stm32f1xx.h"
 
 /* ==== ESP 1 Configuration ==== */
 #define ESP1_HUART_NUM  1
 #define ESP1_HUART      huart2
-#define ESP8266_CB_RX_SIZE  200
+#define ESP8266_CB_RX_SIZE  200     //  default sizes of UART buffers, see ESP_DefaultConfig
 #define ESP8266_CB_TX_SIZE  200
 /*  END of ESP 1 Configuration      */
 
 extern UART_HandleTypeDef ESP1_HUART;
 extern int UART_RxDataOverflow(UART_HandleTypeDef *huart);
-extern STATUS Init_USART_CB(UART_HandleTypeDef *huart, circular_buffer *cb_Rx, circular_buffer *cb_Tx, size_t cb_size_rx, size_t cb_size_tx, size_t data_size);
+extern STATUS Init_USART_CB_Static(UART_HandleTypeDef *huart, circular_buffer *cb_Rx, circular_buffer *cb_Tx, void *buffer_rx, void *buffer_tx, size_t cb_size_rx, size_t cb_size_tx, size_t data_size);
 extern void Start_USART_Rx_IT(UART_HandleTypeDef *huart);
 
-/* Initialize streams to/from serial port. Any other required initialization can be implemented here */
-STATUS ESP_HuartInit(uint8_t HuartNumber);
+/* Initialize streams to/from serial port on buffers pRx of RxSize and pTx of TxSize bytes (storage of ESP instance). Any other required initialization can be implemented here */
+STATUS ESP_HuartInit(uint8_t HuartNumber, uint8_t *pRx, size_t RxSize, uint8_t *pTx, size_t TxSize);
 
 /* Enables ESP module by providing High level on "Enable" pin */
 void ESP_Enable(uint8_t HuartNumber);
@@ -61,6 +62,12 @@ STATUS ESP_HuartSend(uint8_t HuartNumber, char* pData, size_t Size);
 // Gets next char from input stream from UART defined by number HuartNumber, returns SUCCESS if symbol extracted or ERROR if there is no more symbols from the stream
 STATUS ESP_GetChar(uint8_t HuartNumber, uint8_t* sym);
 
+// Gets up to Size bytes from input stream from UART defined by number HuartNumber into pData, returns number of bytes extracted
+size_t ESP_GetData(uint8_t HuartNumber, uint8_t* pData, size_t Size);
+
+// Removes up to Size bytes from input stream from UART defined by number HuartNumber, returns number of bytes removed
+size_t ESP_SkipData(uint8_t HuartNumber, size_t Size);
+
 //  returns number of bytes received from Rx stream of HUART defined by HuartNumber
 size_t ESP_NumOfDataReceived(uint8_t HuartNumber);
 
@@ -76,6 +83,9 @@ void ESP_ReleaseResetPin(uint8_t HuartNumber);
 /* Check if Overflow occured for Rx HUART buffer */
 STATUS ESP_HuartRxOverflow(uint8_t HuartNumber);
 
+/* Returns receive error counters (frame, noise, overrun) of HUART, zero if HUART is unknown */
+const UART_ErrorCounters* ESP_HuartErrorCounters(uint8_t HuartNumber);
+
 /* Sets HUART baudrate */
 void ESP_SetBaudRate(uint8_t HuartNumber, uint32_t Baud);
 
@@ -61,7 +61,8 @@ IP,
 FAIL,
 ALREADY_CONNECT,
 SEND_OK,
-CIPSTATUS,
+CIPSTATUS,          //  "+CIPSTATUS:<id>,..." connection of the module
+STATUS,             //  "STATUS:<stat>" first line of AT+CIPSTATUS reply
 WRONG_SYNTAX,
 AT_ERROR,
 LINKED,
@@ -86,6 +87,15 @@ SOCKET_CLOSED,
 SOCKET_CONNECT_FAIL,
 REBOOT_DETECTED,
 WDT_RESET,
+IPD,                //  "+IPD,<id>,<len>:" header of received data, handled by RxHandler()
+SEND_PROMPT,        //  "> " module waits for data to send, handled by RxHandler()
+SENDBUF_SEGMENT,    //  "<segment>,<last segment sent>" response to AT+CIPSENDBUF
+SENDBUF_OK,         //  "<id>,<segment>,SEND OK" packet sent by AT+CIPSENDBUF, handled by RxHandler()
+SENDBUF_FAIL,       //  "<id>,<segment>,SEND FAIL", handled by RxHandler()
+RECV_BYTES,         //  "Recv <len> bytes" data to send are taken by the module
+IPD_NOTIFY,         //  "+IPD,<id>,<len>" in passive receive mode: data wait in the module, handled by RxHandler()
+RECV_DATA,          //  "+CIPRECVDATA,<len>:" header of data requested by AT+CIPRECVDATA, handled by RxHandler()
+RECV_LEN,           //  "+CIPRECVLEN:<len0>,...,<len4>" data waiting in the module, handled by RxHandler()
 
 BAD_STRUCTURE,
 UNKNOWN,
@@ -0,0 +1,56 @@
+/**
+  ******************************************************************************
+  * @file    Flash_Interface.h
+  * @author  Ostap Kostyk
+  * @brief   Flash_Interface implements hardware-depended access to the internal
+  *          flash memory (erase/program) in C language to be compatible with
+  *          Low-level implementation of the hardware or HAL.
+  *          If FLASH_EMULATOR is defined then flash is emulated in RAM, so
+  *          modules using flash (e.g. OTA_Update) can be built and run on the host
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#ifndef FLASH_INTERFACE_H_
+#define FLASH_INTERFACE_H_
+
+#include "common.h"
+
+#define FLASH_IF_PAGE_SIZE          0x400U      //  erase unit, 1K for STM32F103x8/xB
+
+#ifdef FLASH_EMULATOR
+#define FLASH_EMULATOR_BASE         0x08010000U //  address of the first emulated byte
+#define FLASH_EMULATOR_SIZE         0x10000U    //  size of emulated flash, must be multiple of FLASH_IF_PAGE_SIZE
+#endif
+
+/* Prepares flash for erase/program operations (unlocks flash controller) */
+STATUS Flash_Init(void);
+
+/* Erases flash page starting at Address (must be aligned to FLASH_IF_PAGE_SIZE). Blocks CPU for the page erase time (about 20ms) */
+STATUS Flash_ErasePage(uint32_t Address);
+
+/* Programs half-word Data at Address (must be aligned to 2). Half-word must be erased before, otherwise returns ERROR */
+STATUS Flash_ProgramHalfWord(uint32_t Address, uint16_t Data);
+
+/* Returns pointer to read flash content at Address (flash is memory-mapped on target) */
+const uint8_t* Flash_GetPointer(uint32_t Address);
+
+#endif /* FLASH_INTERFACE_H_ */
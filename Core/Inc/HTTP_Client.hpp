@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file    HTTP_Client.hpp
+  * @author  Ostap Kostyk
+  * @brief   HTTP/1.1 client over Transport socket: queue of requests sent through
+  *          kept-alive connection with pipelining, response parser with
+  *          Content-Length and chunked bodies
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* Requests are built at once into transmit buffer (request line, headers and body), so application data can be changed after Request().
+ * Client connects when there are requests to send and keeps connection alive while requests come. Requests enqueued within
+ * HTTP_CLIENT_BATCH_TIME are sent by one SocketSend() (one AT+CIPSEND of ESP), up to HTTP_CLIENT_PIPELINE_MAX requests are sent without
+ * waiting for responses. Request stays in the buffer until its response is received: requests without response are sent again
+ * if connection is lost, so they should be safe to repeat (e.g. events with own ID). Response is passed to callback by parts
+ * of body as they come, the last call has Last flag set. Negative status means that request failed (see HTTP_CLIENT_STATUS_...).
+ * Socket used by client must not be used by server, see ESP_DefaultConfig::ServerConnections. Client works with any Transport
+ * (ESP on the device, Linux_Transport on the host, see Tools/http_client_test.cpp) */
+
+#ifndef HTTP_CLIENT_HPP_
+#define HTTP_CLIENT_HPP_
+
+#include "Timer.h"
+#include "Transport.hpp"
+
+extern "C" {
+#include "common.h"
+}
+
+//#define HTTP_CLIENT_EN    // HTTP client, see HTTP_Client class. Should be enabled in the IDE as preprocessor symbol
+
+#define HTTP_CLIENT_TX_BUFFER_SIZE      512         //  queued requests waiting to be sent or answered
+#define HTTP_CLIENT_QUEUE_LEN           8           //  maximum number of queued requests
+#define HTTP_CLIENT_PIPELINE_MAX        4           //  requests sent without waiting for responses
+#define HTTP_CLIENT_RX_BUFFER_SIZE      256         //  response is received by parts of this size (stream mode of socket)
+#define HTTP_CLIENT_LINE_SIZE           80          //  status line, header lines and chunk sizes, longer lines are cut (only beginning is analyzed)
+#define HTTP_CLIENT_BATCH_TIME          _50ms_      //  requests enqueued within this time are sent together
+#define HTTP_CLIENT_CONNECT_TIMEOUT     _10sec_
+#define HTTP_CLIENT_RESPONSE_TIMEOUT    _10sec_     //  connection is closed (and requests sent again) if response doesn't come within this time
+#define HTTP_CLIENT_IDLE_TIMEOUT        _5sec_      //  idle connection is closed by client after this time (server may close it earlier)
+#define HTTP_CLIENT_RETRY_TIME          _2sec_      //  pause after failed connection
+#define HTTP_CLIENT_RETRIES_MAX         3           //  failed connections in a row after which all queued requests fail
+
+#define HTTP_CLIENT_STATUS_FAILED       (-1)        //  connection failed HTTP_CLIENT_RETRIES_MAX times or was lost while response was received
+#define HTTP_CLIENT_STATUS_BAD_RESPONSE (-2)        //  response could not be parsed, connection is closed
+
+namespace OKO_HTTP_CLIENT
+{
+using namespace mTimer;
+using namespace OKO_TRANSPORT;
+
+class HTTP_Client
+{
+public:
+    enum class eMethod : uint8_t {Get = 0, Post, Put, Delete};
+
+    /* Called for parts of response body (pData, Len) as they are received and once more with Last set when response is complete.
+     * Tag is the value given to Request(), Status is HTTP status code or HTTP_CLIENT_STATUS_... */
+    typedef void (*response_callback)(void *pContext, uint8_t Tag, int Status, const uint8_t *pData, uint16_t Len, bool Last);
+
+    /* Constructor. Client uses socket SocketID of pTransport to connect to Host (name or IP address as string, must exist all the time) and Port */
+    HTTP_Client(Transport *pTransport, uint8_t SocketID, const char *pHost, uint16_t Port);
+
+    void SetCallback(response_callback pCallback, void *pContext) { this->pCallback = pCallback; this->pContext = pContext; }
+
+    /* Builds request into transmit buffer. Path must start with '/'. ContentType and Body are optional (zero).
+     * Returns ERROR if queue or buffer is full */
+    STATUS Request(eMethod Method, const char *pPath, const char *pContentType = 0, const uint8_t *pBody = 0, uint16_t BodyLen = 0, uint8_t Tag = 0);
+
+    /* Main Handler - must be called regularly (e.g. in main loop) */
+    void Handle();
+
+    uint8_t GetQueued(void) const { return QueueCount; }    //  requests waiting to be sent or answered
+    bool isConnected(void) const { return STEP == 2; }
+
+private:
+    enum class eRxState : uint8_t {StatusLine = 0, Headers, Body, ChunkSize, ChunkEnd, Trailer, UntilClose};
+
+    struct request
+    {
+        uint16_t Len;               //  length of request in TxBuffer
+        uint8_t Tag;
+    };
+
+    void Send(void);
+    bool Receive(void);                                 //  returns false if response can't be parsed
+    bool Parse(const uint8_t *pData, uint16_t Len);
+    bool ParseLine(void);
+    void ResponseComplete(void);
+    void ConnectionFailed(void);                        //  connection could not be established or is lost
+    void FailAll(int Status);
+    void Close(void);
+    void Compact(void);
+    void RestartTimer(void);
+    uint16_t RequestsLen(uint8_t First, uint8_t Num);   //  total length of Num requests starting from First (relative to the oldest one)
+
+    Transport *pTransport;
+    const uint8_t SocketID;
+    const char *pHost;
+    const uint16_t Port;
+    response_callback pCallback = 0;
+    void *pContext = 0;
+
+    int STEP = 0;
+    uint8_t Retries = 0;
+    Timer StateTimer{Timer::Down, HTTP_CLIENT_CONNECT_TIMEOUT, false};
+    Timer BatchTimer{Timer::Down, HTTP_CLIENT_BATCH_TIME, false};
+    bool BatchPending = false;          //  requests are collected for sending together
+
+    char TxBuffer[HTTP_CLIENT_TX_BUFFER_SIZE];
+    uint16_t TxStart = 0;               //  offset of the oldest request in TxBuffer
+    uint16_t TxEnd = 0;                 //  end of the newest one
+    request Queue[HTTP_CLIENT_QUEUE_LEN];
+    uint8_t QueueFirst = 0;
+    uint8_t QueueCount = 0;
+    uint8_t SentCount = 0;              //  requests from the oldest one which are sent and wait for response
+    uint8_t SendingCount = 0;           //  requests after them which are being sent by SocketSend()
+
+    uint8_t RxBuffer[HTTP_CLIENT_RX_BUFFER_SIZE];
+    char Line[HTTP_CLIENT_LINE_SIZE];
+    uint8_t LineLen = 0;
+    eRxState RxState = eRxState::StatusLine;
+    int Status = 0;
+    uint32_t BodyLeft = 0;              //  bytes of body (or of chunk) to receive
+    bool HasLength = false;             //  "Content-Length" received
+    bool Chunked = false;               //  "Transfer-Encoding: chunked" received
+    bool CloseAfter = false;            //  "Connection: close" received, connection is closed after the response
+    bool ResponseStarted = false;       //  status line of response to the oldest request is received
+};
+
+}   //  END of namespace OKO_HTTP_CLIENT
+
+#endif /* HTTP_CLIENT_HPP_ */
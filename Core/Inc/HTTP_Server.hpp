@@ -34,10 +34,23 @@
 
 extern "C" {
 #include "common.h"
+#ifdef HTTP_SERV_HANDLE_BUDGET_US
+#include "Timestamp.h"
+#endif
 }
 #include "HTTP_content.h"
+#include "ROMFS.h"
+#include "OTA_Update.hpp"
+#include "Histogram.hpp"
+#include "Metrics.hpp"
 
 //#define HTTP_SERV_SUPPORT_FLOATING_POINT_VARS	// support floating-point variables parsing. Significantly increases app footprint! Should be enables in the IDE as preprocessor symbol
+//#define HTTP_SERV_ROMFS_EN    // serve static files (favicon, images, scripts) from ROMFS image in flash, see ROMFS.h. Should be enabled in the IDE as preprocessor symbol
+//#define HTTP_SERV_RATE_LIMIT_EN   // limit requests rate and number of connections per client (remote IP), requires ESP8266_CIPDINFO_EN. Should be enabled in the IDE as preprocessor symbol
+//#define HTTP_SERV_LATENCY_STATS_EN    // histograms of request processing phases and of total time per page, served at "/stats", requires ESP8266_TIMESTAMPS_EN. Should be enabled in the IDE as preprocessor symbol
+//#define HTTP_SERV_OTA_EN      // firmware upload by "POST /update" written to flash staging area, see OTA_Update.hpp. Should be enabled in the IDE as preprocessor symbol
+//#define HTTP_SERV_IDLE_RECLAIM_EN // idle connections (no request yet) wait shorter when free sockets run out, the least recently active one is closed when the last free socket is taken. Should be enabled in the IDE as preprocessor symbol
+//#define HTTP_SERV_HANDLE_BUDGET_US 200    // Handle() repeats processing of sockets while their steps change, up to this time in microseconds (needs Timestamp_Init()). Should be enabled in the IDE as preprocessor symbol
 
 /* Application should render dynamic fields of the page and return true if success, otherwise false
  * Arguments: PageIndex is index of page in HTTPServerContent[] array, pHostName pointer to host name (text string) if received, otherwise zero (e.g. HTPP 1.0 protocol)*/
@@ -47,32 +60,135 @@ namespace OKO_HTTP_SERVER
 {
 using namespace mTimer;
 using namespace OKO_ESP8266;
+using namespace OKO_TRANSPORT;
 
 #include "ESP8266.hpp"
 
-#define HTTP_CLIENT_REQUEST_STRING_SIZE     700     //  should be long enough to receive HTTP header with query string with method "put". If only "get" method is intented to be used then the size could be much smaller to receive only part of HTTP header with query string and host name, e.g. 200-300
+#define HTTP_CLIENT_REQUEST_STRING_SIZE     700     //  default size (see HTTP_ServerDefaultConfig), should be long enough to receive HTTP header with query string with method "put". If only "get" method is intented to be used then the size could be much smaller to receive only part of HTTP header with query string and host name, e.g. 200-300
 #define HTTP_CLIENT_HOST_NAME_SIZE          50
-#define HTTP_SERVER_SOCKETS_MAX             ESP8266_SOCKETS_MAX
+#define HTTP_SERV_RESPONSE_HEADER_MAX       280     //  longest response header written into RequestString (206 of gzip-compressed ROMFS file with Content-Type and ETag), checked in HTTP_Server.cpp
+#define HTTP_SERVER_SOCKETS_MAX             ESP8266_SOCKETS_MAX     //  default number of sockets served
+#define HTTP_SERV_HANDLE_PASSES_MAX         8           //  limit of repetitions by one Handle() call with HTTP_SERV_HANDLE_BUDGET_US (in case cycle counter is not running)
+#define HTTP_SERV_RATE_LIMIT_CLIENTS        8           //  number of clients (remote IPs) tracked by rate limiter, least recently seen client is replaced by a new one
+#define HTTP_SERV_RATE_LIMIT_BURST          8           //  token bucket size: number of requests client can send in a burst
+#define HTTP_SERV_RATE_LIMIT_REFILL         5           //  one token (request) is added to client's bucket every N ticks of BaseTimer (100ms), i.e. 2 requests per second sustained
+#define HTTP_SERV_RATE_LIMIT_CONNECTIONS    3           //  maximum number of sockets served for one client at a time, the rest are left for other clients
+#define HTTP_SERV_IDLE_TIMEOUT_MIN          10          //  timeout of idle connection (BaseTimer ticks) with HTTP_SERV_IDLE_RECLAIM_EN when no socket is free, grows linearly up to SocketConnectionTimeOut when all are free
+
+#if defined(HTTP_SERV_RATE_LIMIT_EN) && !defined(ESP8266_CIPDINFO_EN)
+#error "HTTP_SERV_RATE_LIMIT_EN requires ESP8266_CIPDINFO_EN (remote IP of the client)"
+#endif
+
+#define HTTP_SERV_LATENCY_PAGES             8           //  pages with own histogram of total request time (page index 0 to N-2), the last histogram counts other pages, files and errors
+#define HTTP_SERV_STATS_URI                 "stats"     //  "GET /stats" returns latency histograms as text
+#define HTTP_SERV_METRICS_URI               "metrics"   //  "GET /metrics" returns metrics registry in Prometheus text format (METRICS_EN, see Metrics.hpp)
+
+#if defined(HTTP_SERV_LATENCY_STATS_EN) && !defined(ESP8266_TIMESTAMPS_EN)
+#error "HTTP_SERV_LATENCY_STATS_EN requires ESP8266_TIMESTAMPS_EN (time stamps of socket events)"
+#endif
+
+#if defined(HTTP_SERV_LATENCY_STATS_EN) || defined(METRICS_EN)
+#define HTTP_SERV_GENERATED_RESPONSES       //  some responses are generated by the server line by line (see GenerateResponseLines())
+#endif
+
+#define HTTP_SERV_OTA_URI                   "update"    //  "POST /update" uploads firmware image (body), "GET /update" returns update status
+
+/* Compile-time configuration of HTTP_Server instance (see HTTP_ServerInstance at the end of file), same way as ESP_DefaultConfig:
+ *     struct MyServerConfig : HTTP_ServerDefaultConfig { static constexpr uint8_t Sockets = 2; static constexpr uint16_t RequestStringSize = 300; };
+ *     HTTP_ServerInstance<MyServerConfig> MyHTTPServer{&ESP1};
+ * Server can't use more sockets than ESP instance it is created with, this is checked at compile time (not for other transports) */
+struct HTTP_ServerDefaultConfig
+{
+    static constexpr uint8_t  Sockets = HTTP_SERVER_SOCKETS_MAX;                    //  sockets with id 0 to Sockets-1 are served
+    static constexpr uint16_t RequestStringSize = HTTP_CLIENT_REQUEST_STRING_SIZE;  //  buffer for request and response header, one per socket
+};
+
+template<class Config> class HTTP_ServerInstance;
 
 class HTTP_Server
 {
 public:
-    /* Constructor */
-    HTTP_Server(ESP* pESP);
+    /* Instances are created as HTTP_ServerInstance<Config>, which allocates storage for them */
+    HTTP_Server(const HTTP_Server&) = delete;
+    HTTP_Server& operator=(const HTTP_Server&) = delete;
 
-    enum class ResponseStatusCode : int {Continue=100, OK=200, NotModified=304, BadRequest=400, AuthenticationRequired=401, Forbidden=403, NotFound=404, MethodNotAllowed=405, RequestURItooLarge=414, InternalServerError=500, MethodNotImplemented=501, ServiceUnavailable=503};
+    enum class ResponseStatusCode : int {Continue=100, OK=200, NotModified=304, BadRequest=400, AuthenticationRequired=401, Forbidden=403, NotFound=404, MethodNotAllowed=405, NotAcceptable=406, PayloadTooLarge=413, RequestURItooLarge=414, TooManyRequests=429, InternalServerError=500, MethodNotImplemented=501, ServiceUnavailable=503};
 
     /* Main Handler - must be called regularly (e.g. in main loop) */
     void Handle();
 
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+    /* Print latency histograms to debug output (same as "GET /stats") */
+    void PrintLatencyStats(void);
+    void ClearLatencyStats(void);
+#endif
+
+#ifdef HTTP_SERV_OTA_EN
+    /* Attach firmware update writer, without it "/update" is not served. Server calls OTA_Update::Handle() */
+    void AttachOTA(OKO_OTA::OTA_Update *pOTA) { this->pOTA = pOTA; }
+#endif
+
 private:
+    template<class Config> friend class HTTP_ServerInstance;
+    template<class Config> friend struct HTTP_ServerStorage;
+
+    struct process;
+    HTTP_Server(Transport* pTransport, process *pProcess, uint8_t SocketsNum, char *pRequestStrings, uint16_t RequestStringSize);
+
+    enum class eService : uint8_t {None = 0, OTAUpload, OTAStatus, LatencyStats, Metrics};     //  request served by the server itself instead of page or file
+
+
     //TODO: change return type from int to ResponseStatusCode. Save page index into Process, return pure ResponseStatusCode
-    ResponseStatusCode ParseHTTPRequest(char *ReqStr, size_t Len, uint8_t SocketID); //  parse request and search for the requested page name and arguments in content
+    bool HandleSockets(void);   //  one step of every socket process, returns true if any of them changed its step
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    uint8_t SocketWaiting = 0;  //  bit per socket: process waits for socket event (see Transport::GetSocketEvent()) and is not executed until it comes
+#endif
+    ResponseStatusCode ParseHTTPRequest(char *ReqStr, size_t Len, uint8_t SocketID); //  parse request and search for the requested page name and arguments in content. Len includes terminating zero
     char* ParseQueryString(char *ReqStr, size_t len, HTTP_Server::ResponseStatusCode *response);
+    size_t PrepareResponseHeader(uint8_t SocketID);     //  resolves requested range, writes response header (if any) into RequestString, returns header length
+    size_t PrepareErrorHeader(uint8_t SocketID);        //  "500 Internal Server Error" instead of response header which doesn't fit RequestString
+    uint32_t GetContentLength(uint8_t SocketID);        //  total length of requested page or file
+    int GetContentParts(uint8_t SocketID);              //  number of parts of requested page (file is one part)
+    const char* GetContentPart(uint8_t SocketID, int Part, size_t *pLen);   //  pointer on part of the requested page or file, writes length of the part to pLen
+
+    Transport* pTransport;  //  sockets used for communication (ESP8266 modem on the target)
+#ifdef HTTP_SERV_GENERATED_RESPONSES
+    size_t GenerateResponseLines(uint8_t SocketID);     //  writes next lines of generated response into RequestString, returns length, zero when response is finished
+#endif
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+    enum class eLatencyPhase : uint8_t {ConnectToRx = 0, RxToParsed, Render, RenderedToSendOK, Send, SendOKToClosed, Total, Num};    //  phases between consecutive time stamps and total time
+    void RecordLatency(uint8_t SocketID);               //  adds time stamps of finished request to histograms
+    int RenderLatencyStatsLine(int Line, char *pBuf, size_t Size);  //  returns length of the line, -1 if there are no more lines
+
+    OKO_STATS::Log2Histogram LatencyPhase[(int)eLatencyPhase::Num];
+    OKO_STATS::Log2Histogram LatencyPage[HTTP_SERV_LATENCY_PAGES];
+#endif
+#ifdef HTTP_SERV_RATE_LIMIT_EN
+    ResponseStatusCode CheckRateLimit(uint8_t SocketID);    //  takes token from bucket of the client, returns OK if client is within its limits
+    void RefillRateLimitBuckets(void);                      //  called every BaseTimer tick
 
-    ESP* pESP;  //  pointer to ESP8266 modem used for communication
-    int NumOfPages;
-    const int MaxNumOfPages = 100;                  //  Maximum number of pages in server's content
+    struct client_bucket
+    {
+        uint32_t IP;            //  zero if bucket is free
+        uint32_t LastSeen;      //  value of RateLimitClock when client sent request last time, for replacement of the least recently seen client
+        uint8_t Tokens;         //  number of requests client can send now
+        uint8_t RefillCounter;  //  BaseTimer ticks since the last token was added
+    };
+
+    client_bucket RateLimitBucket[HTTP_SERV_RATE_LIMIT_CLIENTS] = {};
+    uint32_t RateLimitClock = 0;   //  incremented with every request
+#endif
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+    int GetFreeSockets(void);                       //  number of sockets waiting for connection
+    int GetIdleTimeout(void);                       //  timeout for idle connections by number of free sockets
+    void EvictIdleSocket(uint8_t NewSocketID);      //  closes the least recently active idle connection except the new one
+
+    uint32_t IdleClock = 0;    //  incremented every BaseTimer tick
+#endif
+#ifdef HTTP_SERV_OTA_EN
+    OKO_OTA::OTA_Update *pOTA = 0;
+    size_t PrepareOTAResponse(uint8_t SocketID);        //  writes update status response into RequestString, returns its length
+#endif
     Timer BaseTimer{Timer::Down, _100ms_, true};    //  down counting timer with dummy delay and enabled
     const int SocketConnectionTimeOut = 30;         //  Timeout for connected socket as number of BaseTimer ticks. If socket is connected and no data come within this timeout time then the socket will be closed
     const int MessageSendTimeout = 5;               //  Timeout for data send and close socket as number of BaseTimer ticks.
@@ -85,7 +201,7 @@ private:
        /* Constructor */
        process();
 
-       char RequestString[HTTP_CLIENT_REQUEST_STRING_SIZE];
+       char *RequestString;         //  RequestStringSize bytes provided by HTTP_ServerInstance
        char HostName[HTTP_CLIENT_HOST_NAME_SIZE+1];
        int RequestedPageIndex;
        bool HostNameFound;
@@ -94,10 +210,80 @@ private:
        int TimeCounter;
        bool TimeoutFlag;
        bool *pSemaphore;
-       int SendIndex;
+       int SendIndex;               //  index of page part being sent
+       uint32_t PartOffset;         //  offset of the part SendIndex from the beginning of content
+       uint32_t SendOffset;         //  offset of the next byte to send
+       uint32_t SendEnd;            //  offset of the end of content (or requested range) to send
+       size_t HeaderLen;            //  length of response header prepared in RequestString
+       bool HeaderOnly;             //  response consists of header only (e.g. "304 Not Modified", "416 Range Not Satisfiable")
+       bool RangeRequested;         //  "Range: bytes=..." header received
+       bool RangeSuffix;            //  "Range: bytes=-N" (last N bytes) received, N is in RangeLast
+       uint32_t RangeFirst;
+       uint32_t RangeLast;          //  0xFFFFFFFF if end of range is not specified ("Range: bytes=N-")
+       eService Service;
+#ifdef HTTP_SERV_GENERATED_RESPONSES
+       int GenLine;                 //  next line of generated response
+#endif
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+       uint32_t TsParsed;           //  time stamps of request processing by server (see Timestamp.h), socket events are time-stamped by ESP
+       uint32_t TsRendered;
+       uint8_t StatsSlot;           //  page histogram for this request
+       bool StatsPending;           //  request processed, time stamps to be recorded when connection is closed
+#endif
+#ifdef HTTP_SERV_OTA_EN
+       uint16_t RequestLen;         //  length of received data in RequestString
+       uint16_t BodyOffset;         //  offset of message body in RequestString (data after header), zero if end of header not received
+       uint32_t ContentLength;      //  "Content-Length" header
+       uint32_t BodyReceived;       //  number of body bytes passed to OTA writer
+       uint32_t ImageCRC;           //  "X-Image-CRC32" header
+       bool ImageCRCFound;
+       bool ExpectContinue;         //  "Expect: 100-continue" header, client waits for "100 Continue" before sending body
+#endif
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+       uint32_t ActiveTick;         //  value of IdleClock when connection was opened or data came last time
+#endif
+#ifdef HTTP_SERV_ROMFS_EN
+       const ROMFS_File *pFile;     //  requested file from ROMFS or zero if page from HTTPServerContent[] is requested
+       bool ETagMatch;              //  "If-None-Match" header matches ETag of requested file, "304 Not Modified" to be sent
+#endif
     };
 
-    process Process[HTTP_SERVER_SOCKETS_MAX];
+    process * const Process;        //  one per socket, allocated by HTTP_ServerInstance
+    const uint8_t SocketsNum;
+    const uint16_t RequestStringSize;
+};
+
+/* Storage of HTTP_ServerInstance, base class to be constructed before HTTP_Server */
+template<class Config> struct HTTP_ServerStorage
+{
+    static_assert(Config::Sockets > 0, "server needs at least one socket");
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    static_assert(Config::Sockets <= 8, "SocketWaiting has one bit per socket");
+#endif
+    static_assert(Config::RequestStringSize >= HTTP_SERV_RESPONSE_HEADER_MAX, "request string is too short for the longest response header");
+
+    HTTP_Server::process Process[Config::Sockets];
+    char RequestString[Config::Sockets][Config::RequestStringSize];
+};
+
+/* HTTP_Server with static buffers sized by Config (see HTTP_ServerDefaultConfig) */
+template<class Config = HTTP_ServerDefaultConfig> class HTTP_ServerInstance : private HTTP_ServerStorage<Config>, public HTTP_Server
+{
+public:
+    typedef Config config_type;
+
+    /* Constructor */
+    template<class ESPConfig> HTTP_ServerInstance(ESP_Instance<ESPConfig>* pESP) :
+        HTTP_Server(pESP, HTTP_ServerStorage<Config>::Process, Config::Sockets, &HTTP_ServerStorage<Config>::RequestString[0][0], Config::RequestStringSize)
+    {
+        static_assert(Config::Sockets <= ESPConfig::Sockets, "server uses more sockets than ESP instance has");
+    }
+
+    /* Constructor for other transports (e.g. Linux_Transport on the host), it must have at least Config::Sockets sockets */
+    HTTP_ServerInstance(Transport* pTransport) :
+        HTTP_Server(pTransport, HTTP_ServerStorage<Config>::Process, Config::Sockets, &HTTP_ServerStorage<Config>::RequestString[0][0], Config::RequestStringSize)
+    {
+    }
 };
 
 }
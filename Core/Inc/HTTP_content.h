@@ -37,7 +37,7 @@ extern "C" {
 #define HTML_RENDER_STR_SIZE2   50
 /* END OF USER DEFINES */
 
-enum class HTTP_PageType{Static = 0, Dynamic};  //  Static means that all fields of page are constant and do not change; Dynamic means that there is/are fields generated by application (rendered). This flag sets by application during initialization
+enum class HTTP_PageType{Static = 0, Dynamic};  //  Static means that all fields of page are constant and do not change; Dynamic means that there is/are fields generated by application (rendered). Calculated at compile time from sizes of page parts
 enum class HTTP_VariableType{Text = 0, Integer = 1, Float = 2};
 
 typedef struct
@@ -48,12 +48,52 @@ typedef struct
 
 typedef struct
 {
-    HTTP_Page *pPage;
+    const HTTP_Page *pPage;
     const int PageParts;
     const char *pPageName;
-    HTTP_PageType Type;
+    const HTTP_PageType Type;
+    const size_t StaticSize;    //  sum of sizes of static parts of page (whole content length if page is static)
 }HTTPServerContent_t;
 
+/* Compile time helpers for the content tables in HTTP_content.cpp (tables are constexpr and are placed in flash) */
+template<size_t N> constexpr int HTTP_GetPageParts(const HTTP_Page (&)[N]) { return (int)N; }
+
+template<size_t N> constexpr HTTP_PageType HTTP_GetPageType(const HTTP_Page (&Page)[N])
+{
+    for(size_t i=0; i<N; i++)
+    {
+        if(Page[i].Size == 0) { return HTTP_PageType::Dynamic; }    //  page contain at least one field that should be generated dynamically by application
+    }
+    return HTTP_PageType::Static;
+}
+
+template<size_t N> constexpr size_t HTTP_GetPageStaticSize(const HTTP_Page (&Page)[N])
+{
+size_t Size = 0;
+
+    for(size_t i=0; i<N; i++) { Size += Page[i].Size; }
+    return Size;
+}
+
+template<size_t N> constexpr bool HTTP_PagePartsAreValid(const HTTP_Page (&Page)[N])
+{
+    for(size_t i=0; i<N; i++)
+    {
+        if(Page[i].pContent == 0) { return false; }
+    }
+    return true;
+}
+
+/* true if all pages have content and name and the last element is the ending one (zeros) */
+template<size_t N> constexpr bool HTTP_ContentIsValid(const HTTPServerContent_t (&Content)[N])
+{
+    for(size_t i=0; i<N-1; i++)
+    {
+        if(Content[i].pPage == 0 || Content[i].PageParts <= 0 || Content[i].pPageName == 0 || Content[i].pPageName[0] == 0) { return false; }
+    }
+    return Content[N-1].pPage == 0 && Content[N-1].PageParts == 0 && Content[N-1].pPageName == 0;
+}
+
 typedef struct
 {
     const char *Name;       //  Variable name in HTTP protocol
@@ -65,7 +105,8 @@ typedef struct
     float ValueFloat;       //  Float value of variable if Type is Float
 }HTTPVariable_t;
 
-extern HTTPServerContent_t HTTPServerContent[]; //  !!! Last element must be initialized with zeros, indicating end of array. First page must be home page.
+extern const HTTPServerContent_t HTTPServerContent[];   //  !!! Last element must be initialized with zeros, indicating end of array. First page must be home page.
+extern const int HTTPServerContentPages;                //  number of pages in HTTPServerContent[] (without ending element), calculated by the compiler
 extern HTTPVariable_t   HTTPVariables[];        //  !!! Last element must be initialized with zeros, indicating end of array
 extern bool HTTPVariableReceivedFlag;           //  Flag to outside indicating that at least one of variables from the list above has been received
 
@@ -96,6 +137,10 @@ public:
 
     void SetValueFloat(float Value) { ValueFloat = Value; }
 
+    /* Sets value from string (e.g. received by MQTT client) according to the type of variable, as if it came with HTTP request.
+     * Returns false if value can't be converted or text doesn't fit */
+    bool SetValue(const char *pValue);
+
     static HTTPVariable* FindVariable(char* pName);
 
     char *pText;            //  text value of variable if Type is Text
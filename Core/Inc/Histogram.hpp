@@ -0,0 +1,65 @@
+/**
+  ******************************************************************************
+  * @file    Histogram.hpp
+  * @author  Ostap Kostyk
+  * @brief   Log2Histogram counts values (e.g. latencies) in power-of-two buckets,
+  *          fixed size, no dynamic memory
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#ifndef HISTOGRAM_HPP_
+#define HISTOGRAM_HPP_
+
+extern "C" {
+#include "common.h"
+}
+
+#define HISTOGRAM_BUCKETS   20      //  bucket k counts values from 2^k to 2^(k+1)-1 (bucket 0 also counts 0), last bucket counts all values from 2^19
+
+namespace OKO_STATS
+{
+
+class Log2Histogram
+{
+public:
+    /* Constructor */
+    Log2Histogram();
+
+    void Add(uint32_t Value);
+    void Clear();
+
+    uint32_t GetCount() const { return Count; }                 //  number of values added
+    uint32_t GetSum() const { return Sum; }                     //  sum of values added (wraps around)
+    uint16_t GetBucket(int Bucket) const;                       //  number of values in bucket (saturates at 0xFFFF)
+    uint32_t GetPercentile(uint8_t Percent) const;              //  upper bound of the bucket containing given percentile, zero if histogram is empty
+
+    static uint32_t GetBucketUpperBound(int Bucket);            //  values in the bucket are less than this (0xFFFFFFFF for the last bucket)
+
+private:
+    uint16_t Buckets[HISTOGRAM_BUCKETS];
+    uint32_t Count;
+    uint32_t Sum;
+};
+
+}   //  END of namespace OKO_STATS
+
+#endif /* HISTOGRAM_HPP_ */
@@ -0,0 +1,183 @@
+/**
+  ******************************************************************************
+  * @file    MQTT_Client.hpp
+  * @author  Ostap Kostyk
+  * @brief   MQTT 3.1.1 client over ESP socket: keep-alive, QoS0/QoS1 publishing
+  *          with batching of small messages, subscriptions and commands which
+  *          set HTTP variables
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* Client connects to the broker at first call of Handle() and keeps connection: PINGREQ is sent when nothing was sent for
+ * keep-alive time, connection is re-established after MQTT_RETRY_TIME if it is lost or broker doesn't answer.
+ * QoS0 messages are built into transmit buffer and sent together: messages published within MQTT_BATCH_TIME go out with
+ * one SocketSend() (one AT+CIPSEND). They are dropped while client is not connected (Publish() returns ERROR).
+ * QoS1 messages are stored until PUBACK comes, also while client is not connected, and are sent again (DUP flag) after reconnection.
+ * Subscriptions are sent after every connection. Messages are passed to callback; messages on topics "<prefix><name>"
+ * (see BindVariables()) set HTTP variable <name> (see HTTPVariable), so the same handling in main loop serves commands from
+ * web page and from MQTT. Incoming packets longer than MQTT_RX_PACKET_SIZE are skipped.
+ * Socket used by client must not be used by server, see ESP_DefaultConfig::ServerConnections */
+
+#ifndef MQTT_CLIENT_HPP_
+#define MQTT_CLIENT_HPP_
+
+#include "Timer.h"
+#include "ESP8266.hpp"
+
+extern "C" {
+#include "common.h"
+}
+
+//#define MQTT_CLIENT_EN    // MQTT client, see MQTT_Client class. Should be enabled in the IDE as preprocessor symbol
+
+#define MQTT_TX_BUFFER_SIZE         384         //  control packets and QoS0 messages waiting to be sent
+#define MQTT_INFLIGHT_BUFFER_SIZE   256         //  QoS1 messages waiting for PUBACK
+#define MQTT_INFLIGHT_MAX           4           //  maximum number of QoS1 messages waiting for PUBACK
+#define MQTT_RX_BUFFER_SIZE         128         //  data are received by parts of this size (stream mode of socket)
+#define MQTT_RX_PACKET_SIZE         128         //  incoming packet (PUBLISH with topic and payload) must fit
+#define MQTT_VALUE_SIZE             32          //  payload of message setting HTTP variable must be shorter
+#define MQTT_SUBSCRIPTIONS_MAX      4
+#define MQTT_TOPIC_SIZE             48          //  topic filter made by BindVariables()
+#define MQTT_KEEPALIVE_SEC          60
+#define MQTT_BATCH_TIME             _50ms_      //  QoS0 messages published within this time are sent together
+#define MQTT_CONNECT_TIMEOUT        _10sec_     //  TCP connection and CONNACK
+#define MQTT_RESPONSE_TIMEOUT       _10sec_     //  PINGRESP
+#define MQTT_RETRY_TIME             _5sec_      //  pause after failed or lost connection
+
+namespace OKO_MQTT
+{
+using namespace mTimer;
+using namespace OKO_ESP8266;
+
+class MQTT_Client
+{
+public:
+    /* Called for every received message. Topic is zero-terminated, payload is not */
+    typedef void (*message_callback)(void *pContext, const char *pTopic, const uint8_t *pPayload, uint16_t Len);
+
+    /* Constructor. Client uses socket SocketID of pESP to connect to broker Host (name or IP address as string) and Port.
+     * Strings must exist all the time */
+    MQTT_Client(ESP *pESP, uint8_t SocketID, const char *pHost, uint16_t Port, const char *pClientID);
+
+    /* User name and password for CONNECT, zero if not used. Must be set before connection */
+    void SetCredentials(const char *pUser, const char *pPassword) { this->pUser = pUser; this->pPassword = pPassword; }
+
+    /* Keep-alive time in seconds given to broker in CONNECT (MQTT_KEEPALIVE_SEC by default), zero disables PINGREQ */
+    void SetKeepAlive(uint16_t Seconds) { KeepAlive = Seconds; }
+
+    void SetCallback(message_callback pCallback, void *pContext) { this->pCallback = pCallback; this->pContext = pContext; }
+
+    /* Publishes message with QoS 0 or 1. Returns ERROR if client is not connected (QoS0) or there is no space for the message */
+    STATUS Publish(const char *pTopic, const uint8_t *pPayload, uint16_t Len, uint8_t QoS = 0, bool Retain = false);
+    STATUS Publish(const char *pTopic, const char *pText, uint8_t QoS = 0, bool Retain = false) { return Publish(pTopic, (const uint8_t*)pText, (uint16_t)strlen(pText), QoS, Retain); }
+
+    /* Adds topic filter (string must exist all the time) with maximum QoS 0 or 1, subscribed after every connection.
+     * Returns ERROR if there are MQTT_SUBSCRIPTIONS_MAX subscriptions already */
+    STATUS Subscribe(const char *pTopicFilter, uint8_t QoS = 0);
+
+    /* Subscribes to "<TopicPrefix>#". Message on topic "<TopicPrefix><name>" sets HTTP variable <name> to the payload
+     * (e.g. "device1/set/BlueLEDMode" with payload "Blink"), message callback is called as well */
+    STATUS BindVariables(const char *pTopicPrefix);
+
+    /* Main Handler - must be called regularly (e.g. in main loop) */
+    void Handle();
+
+    bool isConnected(void) const { return STEP == 3; }
+    uint8_t GetInFlight(void) const { return InFlightCount; }   //  QoS1 messages waiting for PUBACK
+
+private:
+    struct subscription
+    {
+        const char *pTopicFilter;
+        uint8_t QoS;
+    };
+
+    struct inflight
+    {
+        uint16_t Len;               //  length of PUBLISH packet in InFlightBuffer
+        uint16_t PacketID;
+        bool Sent;
+        bool Acked;                 //  PUBACK received, removed when buffer is not being sent
+    };
+
+    static uint16_t PutHeader(uint8_t *pBuffer, uint8_t Type, uint32_t RemainingLength);    //  returns length of fixed header
+    static uint16_t PutString(uint8_t *pBuffer, const char *pString);                       //  returns length with 2 bytes of string length
+    static uint16_t HeaderLen(uint32_t RemainingLength);
+    bool SendConnect(void);
+    void SendSubscribe(void);
+    void SendPing(void);
+    void Send(void);
+    void SendDone(void);
+    bool Receive(void);                 //  returns false if packet is not valid
+    bool ParsePacket(void);
+    void Message(uint8_t Flags);
+    void InFlightCompact(void);         //  removes acknowledged messages
+    uint16_t InFlightOffset(uint8_t Index);
+    void Close(void);
+
+    ESP *pESP;
+    const uint8_t SocketID;
+    const char *pHost;
+    const uint16_t Port;
+    const char *pClientID;
+    const char *pUser = 0;
+    const char *pPassword = 0;
+    uint16_t KeepAlive = MQTT_KEEPALIVE_SEC;
+    message_callback pCallback = 0;
+    void *pContext = 0;
+
+    int STEP = 0;
+    Timer StateTimer{Timer::Down, MQTT_CONNECT_TIMEOUT, false};
+    Timer KeepAliveTimer{Timer::Down, MQTT_KEEPALIVE_SEC * _1sec_, false};  //  restarted with every packet sent
+    Timer BatchTimer{Timer::Down, MQTT_BATCH_TIME, false};
+    bool BatchPending = false;          //  QoS0 messages are collected for sending together
+    bool PingPending = false;           //  PINGREQ sent, waiting for PINGRESP
+
+    subscription Subscriptions[MQTT_SUBSCRIPTIONS_MAX];
+    uint8_t SubscriptionsNum = 0;
+    char VariablesFilter[MQTT_TOPIC_SIZE];
+    uint8_t VariablesPrefixLen = 0;     //  BindVariables() prefix is the beginning of VariablesFilter
+
+    uint8_t TxBuffer[MQTT_TX_BUFFER_SIZE];
+    uint16_t TxLen = 0;
+    uint16_t TxSending = 0;             //  bytes from the beginning of TxBuffer being sent by SocketSend()
+    bool TxUrgent = false;              //  control packet in TxBuffer, send without waiting for batch
+
+    uint8_t InFlightBuffer[MQTT_INFLIGHT_BUFFER_SIZE];
+    inflight InFlight[MQTT_INFLIGHT_MAX];
+    uint8_t InFlightCount = 0;
+    uint8_t InFlightSending = 0;        //  messages being sent by SocketSend(), starting from InFlightSendFirst
+    uint8_t InFlightSendFirst = 0;
+    uint16_t NextPacketID = 1;
+
+    uint8_t RxBuffer[MQTT_RX_BUFFER_SIZE];
+    uint8_t Packet[MQTT_RX_PACKET_SIZE];
+    uint8_t RxHeader = 0;               //  first byte of packet being received, zero if waiting for new packet
+    uint8_t RxLenBytes = 0;             //  bytes of remaining length received
+    bool RxLenDone = false;
+    uint32_t RxRemaining = 0;           //  remaining length of packet
+    uint32_t RxPos = 0;                 //  bytes of packet body received
+};
+
+}   //  END of namespace OKO_MQTT
+
+#endif /* MQTT_CLIENT_HPP_ */
@@ -0,0 +1,102 @@
+/**
+  ******************************************************************************
+  * @file    Metrics.hpp
+  * @author  Ostap Kostyk
+  * @brief   Metrics registry: counters, gauges and histograms linked into a list
+  *          at construction (no dynamic memory) and rendered line by line in
+  *          Prometheus text format
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* Metric objects are created statically by the modules they describe, e.g.
+ *     static OKO_STATS::Metric MetricFrames{"esp_ipd_frames_total", "Received +IPD frames", OKO_STATS::Metric::eType::Counter};
+ *     METRIC_ADD(MetricFrames, 1);
+ * Metrics with the same name must be created one after another (same translation unit), they form one family
+ * distinguished by labels (e.g. "code=\"200\""), "# HELP" and "# TYPE" lines are rendered once per family.
+ * RenderLine() renders one line at a time, so whole registry is sent by parts without render buffer */
+
+#ifndef METRICS_HPP_
+#define METRICS_HPP_
+
+extern "C" {
+#include "common.h"
+}
+#include "Histogram.hpp"
+
+//#define METRICS_EN    // metrics registry, instrumentation of ESP and HTTP_Server, served by server at "/metrics". Should be enabled in the IDE as preprocessor symbol
+
+#ifdef METRICS_EN
+#define METRIC_ADD(Metric, Value)   (Metric).Add(Value)
+#define METRIC_SET(Metric, Value)   (Metric).Set(Value)
+#else
+#define METRIC_ADD(Metric, Value)
+#define METRIC_SET(Metric, Value)
+#endif
+
+namespace OKO_STATS
+{
+
+class Metric
+{
+public:
+    enum class eType : uint8_t {Counter = 0, Gauge, Histogram};
+
+    /* Counter or gauge, value is kept by the metric */
+    Metric(const char *pName, const char *pHelp, eType Type, const char *pLabels = 0);
+
+    /* Counter or gauge, value is kept by other module (e.g. C code or interrupt handler) and read when rendered */
+    Metric(const char *pName, const char *pHelp, eType Type, const volatile uint32_t *pSource, const char *pLabels = 0);
+
+    /* Histogram, Add() adds value to pHistogram */
+    Metric(const char *pName, const char *pHelp, Log2Histogram *pHistogram, const char *pLabels = 0);
+
+    void Add(uint32_t Value);       //  counter: increment by Value (wraps around), gauge: add Value, histogram: count Value
+    void Set(uint32_t Value);       //  gauge: set Value
+    uint32_t Get() const;           //  current value of counter or gauge, number of values of histogram
+
+    /* Renders line Line of the whole registry into pBuf (at most Size bytes including terminating zero, like snprintf()).
+     * Returns length of the line, -1 if there are no more lines */
+    static int RenderLine(int Line, char *pBuf, size_t Size);
+
+private:
+    int GetLines() const;           //  number of lines rendered for this metric
+    int Render(int Line, char *pBuf, size_t Size) const;
+    bool isFirstOfFamily() const;   //  "# HELP" and "# TYPE" lines are rendered before the first metric of family
+    void Link();
+
+    /* Linked list of Metric instances */
+    static Metric* pFirst;
+    Metric* Prev;
+    Metric* Next;
+
+    const char *pName;
+    const char *pHelp;
+    const char *pLabels;            //  zero if metric has no labels
+    eType Type;
+    const volatile uint32_t *pSource;   //  zero if value is kept by the metric
+    Log2Histogram *pHistogram;
+    uint32_t Value;
+};
+
+}   //  END of namespace OKO_STATS
+
+#endif /* METRICS_HPP_ */
@@ -33,7 +33,16 @@ uint16_t         TxBuffLeft;      /* How much space left in buffer */
 
 #define HAL_UART_STATE_RX_OVERFUL 0x01
 
+/* Receive errors counted by My_HAL_UART_IRQHandler() */
+typedef struct
+{
+volatile uint32_t FrameErrors;
+volatile uint32_t NoiseErrors;
+volatile uint32_t OverrunErrors;
+} UART_ErrorCounters;
+
 STATUS Init_USART_CB(UART_HandleTypeDef *huart, circular_buffer *cb_Rx, circular_buffer *cb_Tx, size_t cb_size_rx, size_t cb_size_tx, size_t data_size);
+STATUS Init_USART_CB_Static(UART_HandleTypeDef *huart, circular_buffer *cb_Rx, circular_buffer *cb_Tx, void *buffer_rx, void *buffer_tx, size_t cb_size_rx, size_t cb_size_tx, size_t data_size);  //  buffers are provided by caller
 void Start_USART_Rx_IT(UART_HandleTypeDef *huart);
 HAL_StatusTypeDef My_HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
 void My_HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
@@ -45,4 +54,11 @@ void My_HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
  */
 int UART_RxDataOverflow(UART_HandleTypeDef *huart);
 
+/**
+ * @brief Returns receive error counters of the UART
+ * @param huart: uart handle
+ * @retval pointer to counters, zero if UART is not served by this driver
+ */
+UART_ErrorCounters* UART_GetErrorCounters(UART_HandleTypeDef *huart);
+
 #endif
@@ -0,0 +1,124 @@
+/**
+  ******************************************************************************
+  * @file    OTA_Update.hpp
+  * @author  Ostap Kostyk
+  * @brief   Firmware update over the air: writes received image into staging
+  *          area of flash through double-buffered writer and verifies CRC32
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* Sequence: Begin() erases required pages of staging area (one page per Handle() call, pages which are already erased are skipped).
+ * Then data are written by Write() or directly by receiver into buffer returned by GetWriteBuffer() and confirmed by Commit().
+ * While one buffer is filled with received data the other one is programmed into flash by Handle(), few half-words per call,
+ * so programming overlaps with receiving. When whole image is programmed, CRC32 of the staging area is calculated and compared
+ * with expected one. Application decides what to do with verified image (e.g. restart into bootloader which copies it) */
+
+#ifndef OTA_UPDATE_HPP_
+#define OTA_UPDATE_HPP_
+
+extern "C" {
+#include "common.h"
+#include "Flash_Interface.h"
+}
+
+#define OTA_STAGING_ADDRESS             0x08010000U     //  STM32F103C8 devices usually have 128K of flash (same as STM32F103CB), upper 64K are used as staging area. Must not overlap application and EEPROM emulation pages
+#define OTA_STAGING_SIZE                0x0000F800U     //  maximum image size, equal to application flash size (see linker script), multiple of FLASH_IF_PAGE_SIZE
+#define OTA_BUFFER_SIZE                 512             //  size of each of two receive buffers, must be even
+#define OTA_PROGRAM_HALFWORDS_PER_CALL  16              //  half-words programmed by one Handle() call (about 50us each, CPU is stalled while programming)
+#define OTA_VERIFY_BYTES_PER_CALL       1024            //  bytes of CRC calculation by one Handle() call
+
+namespace OKO_OTA
+{
+
+class OTA_Update
+{
+public:
+    enum class eState {Idle = 0, Erasing, Receiving, Verifying, Done, Error};
+    enum class eError {NoError = 0, Busy, TooBig, Erase, Program, Aborted, CRCMismatch};
+
+    /* Constructor */
+    OTA_Update(uint32_t StagingAddress = OTA_STAGING_ADDRESS, uint32_t StagingSize = OTA_STAGING_SIZE);
+
+    /* Starts update of image with size ImageSize and expected CRC32 ImageCRC. Returns ERROR if update is in progress or image is too big */
+    STATUS Begin(uint32_t ImageSize, uint32_t ImageCRC);
+
+    /* Must be called regularly (e.g. in main loop): erases, programs and verifies flash step by step */
+    void Handle();
+
+    /* Stops update, image in staging area is not valid */
+    void Abort();
+
+    /* Returns true when staging area is erased and image data can be written */
+    bool isReadyForData() const { return State == eState::Receiving; }
+
+    /* Returns pointer to free space of the current receive buffer and writes its size to Space. Returns zero if both buffers are full (wait for programming) */
+    uint8_t* GetWriteBuffer(uint16_t &Space);
+
+    /* Confirms Len bytes written to the buffer returned by GetWriteBuffer() */
+    void Commit(uint16_t Len);
+
+    /* Copies data into receive buffers, returns number of bytes accepted */
+    uint16_t Write(const uint8_t *pData, uint16_t Len);
+
+    eState GetState() const { return State; }
+    eError GetError() const { return Error; }
+    bool isImageReady() const { return State == eState::Done; }     //  image is completely written and CRC is correct
+    uint32_t GetImageSize() const { return ImageSize; }
+    uint32_t GetMaxImageSize() const { return StagingSize; }
+    uint32_t GetImageCRC() const { return ImageCRC; }
+    uint32_t GetReceivedBytes() const { return ReceivedBytes; }
+    uint8_t GetProgress() const;    //  programmed part of image in percents
+
+    static const char* GetStateString(eState State);
+    static const char* GetErrorString(eError Error);
+
+    /* CRC32 (IEEE 802.3, same as zlib crc32()). For calculation by parts pass result of previous call as Crc, zero at start */
+    static uint32_t CRC32(uint32_t Crc, const uint8_t *pData, size_t Len);
+
+private:
+    void Fail(eError Error);
+
+    const uint32_t StagingAddress;
+    const uint32_t StagingSize;
+
+    eState State;
+    eError Error;
+    uint32_t ImageSize;
+    uint32_t ImageCRC;
+    uint32_t ReceivedBytes;     //  bytes committed to buffers
+    uint32_t ProgrammedBytes;   //  bytes programmed into flash
+    uint32_t EraseAddress;      //  next page to erase
+    uint32_t EraseEnd;
+    uint32_t VerifyCRC;
+    uint8_t LastProgress;       //  for progress reporting to debug output
+
+    uint8_t Buffer[2][OTA_BUFFER_SIZE];
+    uint16_t BufferLen[2];
+    bool BufferFull[2];         //  buffer is waiting for programming or being programmed
+    uint8_t FillIndex;          //  buffer being filled with received data
+    uint8_t ProgramIndex;       //  buffer being programmed
+    uint16_t ProgramPos;        //  position in buffer being programmed
+};
+
+}   //  END of namespace OKO_OTA
+
+#endif /* OTA_UPDATE_HPP_ */
@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file    ROMFS.h
+  * @author  Ostap Kostyk
+  * @brief   Read-only file system image located in flash (static assets for HTTP Server)
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* ROMFS image is generated from the directory HTML/romfs by Tools/mkromfs.py (pre-build step) into Core/Src/ROMFS_image.cpp
+ * and linked into flash as constant data. Files are served by the HTTP Server directly from flash (by pointer), no RAM copy.
+ * Path lookup is made through the hash index (open addressing, linear probing) so unknown paths are rejected in O(1).
+ * ROMFS is compiled in only if HTTP_SERV_ROMFS_EN is defined (see HTTP_Server.hpp) */
+
+#ifndef ROMFS_H_
+#define ROMFS_H_
+
+extern "C" {
+#include "common.h"
+}
+
+#define ROMFS_MAGIC                 0x53464D52      //  "RMFS"
+#define ROMFS_FLAG_GZIP             0x01            //  file content is gzip-compressed, must be sent with "Content-Encoding: gzip"
+#define ROMFS_ETAG_LEN              10              //  entity tag generated by Tools/mkromfs.py: 8 hex digits in quotes
+#define ROMFS_MIME_TYPE_LEN_MAX     25              //  longest string of ROMFS_GetMimeTypeString() ("text/plain; charset=utf-8")
+
+/* MIME types. Numbers must match the table in Tools/mkromfs.py */
+enum class ROMFS_MimeType : uint8_t {Binary = 0, Html, Css, Js, Json, Text, Png, Jpeg, Gif, Svg, Icon};
+
+typedef struct
+{
+    uint32_t PathHash;          //  FNV-1a hash of the path (without leading '/')
+    const char *pPath;          //  path of the file without leading '/', e.g. "favicon.ico" or "js/app.js"
+    const uint8_t *pData;       //  file content in flash
+    uint32_t Size;              //  size of the file content in bytes
+    const char *pETag;          //  entity tag including quotes, e.g. "\"1a2b3c4d\""
+    ROMFS_MimeType MimeType;
+    uint8_t Flags;              //  ROMFS_FLAG_...
+}ROMFS_File;
+
+typedef struct
+{
+    uint32_t Magic;             //  ROMFS_MAGIC
+    uint16_t NumOfFiles;
+    uint16_t IndexSize;         //  number of buckets in hash index, always power of 2
+    const ROMFS_File *pFiles;
+    const uint16_t *pIndex;     //  hash index: file number + 1 or zero if bucket is empty
+}ROMFS_Image;
+
+extern const ROMFS_Image ROMFS;     //  generated image (Core/Src/ROMFS_image.cpp)
+
+/* Calculates FNV-1a hash of the path with length Len */
+uint32_t ROMFS_Hash(const char *pPath, size_t Len);
+
+/* Searches for the file with path pPath of length Len (without leading '/'). Returns pointer on the file descriptor or zero if not found */
+const ROMFS_File* ROMFS_Find(const char *pPath, size_t Len);
+
+/* Same as ROMFS_Find() but returns uncompressed copy of the file (stored by mkromfs.py --plain), zero if there is none */
+const ROMFS_File* ROMFS_FindPlain(const char *pPath, size_t Len);
+
+/* Returns MIME type string for "Content-Type" header */
+const char* ROMFS_GetMimeTypeString(ROMFS_MimeType Type);
+
+#endif /* ROMFS_H_ */
@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file    Scan.h
+  * @author  Ostap Kostyk
+  * @brief   Scan implements word-at-a-time (SWAR) search of delimiters in
+  *          received data: one 32-bit word (4 bytes) is checked per step on
+  *          aligned data, byte by byte search is used for unaligned head and tail
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//#define SCAN_BYTEWISE     // portable byte by byte search only (e.g. for comparison or CPU without fast word access). Word search is also disabled automatically on big-endian CPU
+
+#define SCAN_SET_MAX    8   //  maximum number of bytes searched by Scan_FindAny()
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns pointer to the first byte c in p[0..Len-1], zero if not found (same as memchr()) */
+const char* Scan_FindByte(const char *p, size_t Len, char c);
+
+/* Returns pointer to the first byte in p[0..Len-1] equal to any of SetLen bytes of pSet (SetLen <= SCAN_SET_MAX, '\0' can be in the set), zero if not found */
+const char* Scan_FindAny(const char *p, size_t Len, const char *pSet, size_t SetLen);
+
+/* Returns pointer to "\r\n" in p[0..Len-1] (both bytes inside), zero if not found */
+const char* Scan_FindCRLF(const char *p, size_t Len);
+
+/* Returns pointer to "\r\n\r\n" (end of HTTP header) in p[0..Len-1], zero if not found */
+const char* Scan_FindCRLFCRLF(const char *p, size_t Len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCAN_H_ */
@@ -0,0 +1,44 @@
+/**
+  ******************************************************************************
+  * @file    Timestamp.h
+  * @author  Ostap Kostyk
+  * @brief   Timestamp implements high-resolution time stamps based on DWT cycle
+  *          counter of Cortex-M3 core for latency measurements
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#ifndef TIMESTAMP_H_
+#define TIMESTAMP_H_
+
+#include "common.h"
+
+/* Enables DWT cycle counter. Must be called once at start-up (e.g. in main()) before time stamps are used */
+void Timestamp_Init(void);
+
+/* Returns current time stamp in CPU cycles. Counter wraps around every 2^32 cycles (about 59s at 72MHz),
+ * so only intervals shorter than that can be measured */
+uint32_t Timestamp_Get(void);
+
+/* Returns time in microseconds between two time stamps (End taken after Start) */
+uint32_t Timestamp_ElapsedUs(uint32_t Start, uint32_t End);
+
+#endif /* TIMESTAMP_H_ */
@@ -0,0 +1,132 @@
+/**
+  ******************************************************************************
+  * @file    Transport.hpp
+  * @author  Ostap Kostyk
+  * @brief   Transport is the interface of sockets used by HTTP_Server: ESP class
+  *          implements it over AT commands of ESP8266 module, Linux_Transport
+  *          (Tools directory) over POSIX sockets to run the server on the host
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#ifndef TRANSPORT_HPP_
+#define TRANSPORT_HPP_
+
+extern "C" {
+#include "common.h"
+}
+
+namespace OKO_TRANSPORT
+{
+
+/* Sockets are identified by number from 0 to number of sockets of the implementation - 1. Incoming connections are accepted
+ * by the implementation itself into free sockets, application listens to connected sockets, sends data and closes them.
+ * All methods are non-blocking, the implementation makes progress in its own handler called from the main loop */
+class Transport
+{
+public:
+    /* Socket States */
+    enum class eSocketState{Closed = 0, Open, ConnectRequested, Connecting, Connected, CloseRequested, Closing, Error};
+
+    /* Data transmit states */
+    enum class eSocketSendDataStatus{Idle = 0, SendRequested, InProgress, SendFail, SendSuccess};
+
+    /* Transmit classes: sockets sending at the same time share the link in proportion to quantum of their class */
+    enum class eTxClass : uint8_t {Control = 0, Normal, Bulk};
+
+    /* Provides buffer for the next message received by connected socket. Message longer than the buffer is cut */
+    virtual STATUS ListenSocket(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize) = 0;
+
+    /* Same as ListenSocket() but message longer than the buffer is not cut: receiving pauses until the next buffer is provided */
+    virtual STATUS ListenSocketStream(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize) = 0;
+
+    /* Returns number of bytes received into the buffer, zero if nothing is received yet, (uint16_t)-1 if message has been cut */
+    virtual uint16_t SocketRecv(uint8_t SocketID) = 0;
+
+    /* Returns true if receiving is paused because stream buffer is full */
+    virtual bool SocketRxPaused(uint8_t SocketID) = 0;
+
+    /* Leaves stream mode without providing new buffer, incoming data are ignored until ListenSocket() */
+    virtual void SocketRxDiscard(uint8_t SocketID) = 0;
+
+    /* Remote side of the socket (e.g. 0xC0A80002 is 192.168.0.2), zero if unknown */
+    virtual uint32_t GetSocketRemoteIP(uint8_t SocketID) = 0;
+    virtual uint16_t GetSocketRemotePort(uint8_t SocketID) = 0;
+
+    /* Starts sending of DataLen bytes, Data must stay valid until GetDataSendStatus() returns SendSuccess or SendFail */
+    virtual STATUS SocketSend(uint8_t SocketID, uint8_t* Data, uint16_t DataLen) = 0;
+
+    /* Same as SocketSend() but closes socket after sending completion */
+    virtual STATUS SocketSendClose(uint8_t SocketID, uint8_t* Data, uint16_t DataLen) = 0;
+
+    /* Closes socket (or requests closing if it can't be done at once) */
+    virtual STATUS CloseSocket(uint8_t SocketID) = 0;
+
+    /* Starts outgoing TCP connection of closed socket SocketID (one which is not used for incoming connections) to Host (name or IP
+     * address as string, must stay valid until connection is established) and Port. Socket becomes Connected, or Closed if connection
+     * fails. Returns ERROR if connection can't be started */
+    virtual STATUS OpenConnection(uint8_t SocketID, const char *pHost, uint16_t Port) = 0;
+
+    virtual eSocketState GetSocketState(uint8_t SocketID) = 0;
+    virtual eSocketSendDataStatus GetDataSendStatus(uint8_t SocketID) = 0;
+
+    /* Transmit class of the socket, e.g. short API responses as Control are not queued behind big files sent as Bulk */
+    virtual void SetSocketTxClass(uint8_t SocketID, eTxClass Class) = 0;
+
+#ifdef ESP8266_TIMESTAMPS_EN
+    /* Time stamps (see Timestamp.h) of the current or last connection of the socket, zero if event has not happened yet */
+    struct socket_timestamps
+    {
+        uint32_t Connected;     //  connection accepted
+        uint32_t FirstRx;       //  first data received
+        uint32_t FirstSendOK;   //  first data sent
+        uint32_t LastSendOK;    //  last data sent
+        uint32_t Closed;        //  connection closed
+    };
+
+    virtual const socket_timestamps* GetSocketTimestamps(uint8_t SocketID) = 0;
+#endif
+
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    /* Socket events: Connected, Data (message or part of stream is in the buffer given by ListenSocket()/ListenSocketStream()),
+     * SendDone/SendFail (result of SocketSend(), socket can send again), Closed, Error (socket failed to close).
+     * Overflow means that events were lost: state of all sockets must be checked */
+    enum class eSocketEvent : uint8_t {Connected = 0, Data, SendDone, SendFail, Closed, Error, Overflow};
+
+    struct socket_event
+    {
+        eSocketEvent Type;
+        uint8_t SocketID;       //  not valid for Overflow
+        uint16_t Len;           //  Data: number of bytes in the buffer
+    };
+
+    /* Takes the oldest event from the queue into Event, returns false if there are no events */
+    virtual bool GetSocketEvent(socket_event &Event) = 0;
+#endif
+
+protected:
+    Transport() {}
+    ~Transport() {}     //  instances are not deleted through the interface
+};
+
+}   //  END of namespace OKO_TRANSPORT
+
+#endif /* TRANSPORT_HPP_ */
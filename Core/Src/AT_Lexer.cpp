@@ -0,0 +1,395 @@
+/**
+  ******************************************************************************
+  * @file    AT_Lexer.cpp
+  * @author  Ostap Kostyk
+  * @brief   Streaming lexer of ESP8266 AT responses: responses are recognized
+  *          byte by byte by trie built at compile time from the table of patterns,
+  *          numeric and string fields are extracted without line buffer
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "AT_Lexer.hpp"
+
+using namespace OKO_ESP8266;
+
+/* Fields are stored in the trie instead of received byte */
+#define AT_FIELD_UNSIGNED   '\x01'
+#define AT_FIELD_SIGNED     '\x02'
+#define AT_FIELD_HEX        '\x03'
+#define AT_FIELD_STRING     '\x04'
+#define AT_FIELD_SKIP       '\x05'
+
+struct at_pattern
+{
+    const char *Pattern;
+    eAT Token;
+};
+
+/* Responses of the module (see field types in AT_Lexer.hpp). Numbers are taken in the order of the pattern,
+ * e.g. "+CWLAP" gives ecn, rssi, channel, frequency offset and calibration as numbers 0..4, SSID and MAC as strings */
+static constexpr at_pattern Patterns[] = {
+    {"OK",                                      eAT::OK},
+    {"ready",                                   eAT::READY},
+    {"ERROR",                                   eAT::AT_ERROR},
+    {"FAIL",                                    eAT::FAIL},
+    {"SEND OK",                                 eAT::SEND_OK},
+    {"ALREAY CONNECT",                          eAT::ALREADY_CONNECT},      //  this is real message with grammatical error
+    {"ALREADY CONNECT",                         eAT::ALREADY_CONNECT},      //  this message can appear if manufacturer fix gramm. error
+    {"busy",                                    eAT::BUSY},
+    {"busy p...",                               eAT::BUSY_P},
+    {"busy s...",                               eAT::BUSY_S},
+    {"no change",                               eAT::NOCHANGE},
+    {"no ip",                                   eAT::NOIP},
+    {"no this fun",                             eAT::NO_THIS_FUNCTION},
+    {"wrong syntax",                            eAT::WRONG_SYNTAX},
+    {"wdt reset",                               eAT::WDT_RESET},
+    {"Linked",                                  eAT::LINKED},
+    {"link",                                    eAT::LINK},
+    {"link is not",                             eAT::LINKISNOT},
+    {"Link is builded",                         eAT::LINKISBUILDED},
+    {"Unlink",                                  eAT::UNLINK},
+    {"[Vendor:www.ai-thinker.com Version:",     eAT::REBOOT_DETECTED},
+    {"BAUD->%u",                                eAT::BAUDRATE_CONFIRMATION},
+    {"STATUS:%u",                               eAT::STATUS},
+    {"+CIPSTATUS:%u,\"%s\",\"%s\",%u,%u,%u",    eAT::CIPSTATUS},            //  link id, remote port, local port, tetype; type and remote IP as strings
+    {"+CIFSR:APIP,\"%u.%u.%u.%u",               eAT::CIFSR_APIP},
+    {"+CIFSR:APMAC,\"%x:%x:%x:%x:%x:%x",        eAT::CIFSR_APMAC},
+    {"+CIOBAUD:(%u-%u",                         eAT::CIOBAUD_RANGE},
+    {"+CIOBAUD:%u",                             eAT::CIOBAUD},
+    {"+CWJAP:%u",                               eAT::CWJAP_FAULT},
+    {"+CWJAP_CUR:\"%s\",\"%s\",%u,%d",          eAT::CWJAP},
+    {"+CWLAP:(%u,\"%s\",%d,\"%s\",%u,%d,%u",    eAT::CWLAP},
+    {"+CWMODE_CUR:%u",                          eAT::CWMODE},
+    {"+CWSAP_CUR:\"%s\",\"%*\",%u,%u,%u,%u",    eAT::CWSAP_CUR},            //  password is not stored
+    {"%u,CONNECT",                              eAT::SOCKET_CONNECT},
+    {"%u,CONNECT FAIL",                         eAT::SOCKET_CONNECT_FAIL},
+    {"%u,CLOSED",                               eAT::SOCKET_CLOSED},
+    {"+IPD,%u,%u:",                             eAT::IPD},
+#ifdef ESP8266_CIPDINFO_EN
+    {"+IPD,%u,%u,%u.%u.%u.%u,%u:",              eAT::IPD},
+#endif
+    {"> ",                                      eAT::SEND_PROMPT},
+#ifdef ESP8266_SENDBUF_EN
+    {"%u,%u",                                   eAT::SENDBUF_SEGMENT},
+    {"%u,%u,SEND OK",                           eAT::SENDBUF_OK},           //  link id, segment
+    {"%u,%u,SEND FAIL",                         eAT::SENDBUF_FAIL},
+    {"Recv %u bytes",                           eAT::RECV_BYTES},
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+    {"+IPD,%u,%u",                              eAT::IPD_NOTIFY},           //  no data follow in passive receive mode
+    {"+CIPRECVDATA,%u:",                        eAT::RECV_DATA},
+    {"+CIPRECVDATA:%u,",                        eAT::RECV_DATA},            //  format of later firmware
+    {"+CIPRECVLEN:%d,%d,%d,%d,%d",              eAT::RECV_LEN},             //  -1 for links which are not connected
+#endif
+    {"AT\r\r",                                  eAT::ECHO_AT},              //  echo ends with "\r\r\n"
+    {"ATE0\r\r",                                eAT::ECHO_ECHO_OFF},
+    {"ATE1\r\r",                                eAT::ECHO_ECHO_ON},
+};
+
+/* Trie node, children of a node are linked by Next */
+struct at_node
+{
+    char     Byte;      //  received byte or AT_FIELD_x
+    uint8_t  Token;     //  eAT of the pattern which ends here, zero if none
+    uint16_t Child;     //  first child, zero if none (root is never a child)
+    uint16_t Next;      //  next child of the same parent, zero if none
+};
+
+template<uint16_t N> struct at_trie
+{
+    at_node Node[N];
+    uint16_t Count;
+    bool Error;         //  pattern is empty, duplicated or has wrong field type
+};
+
+static constexpr bool isField(char Byte)
+{
+    return Byte >= AT_FIELD_UNSIGNED && Byte <= AT_FIELD_SKIP;
+}
+
+static constexpr int HexDigit(char Byte)
+{
+    return (Byte >= '0' && Byte <= '9') ? Byte - '0' :
+           (Byte >= 'a' && Byte <= 'f') ? Byte - 'a' + 10 :
+           (Byte >= 'A' && Byte <= 'F') ? Byte - 'A' + 10 : -1;
+}
+
+static constexpr char FieldType(char Spec)
+{
+    return (Spec == 'u') ? AT_FIELD_UNSIGNED :
+           (Spec == 'd') ? AT_FIELD_SIGNED :
+           (Spec == 'x') ? AT_FIELD_HEX :
+           (Spec == 's') ? AT_FIELD_STRING :
+           (Spec == '*') ? AT_FIELD_SKIP : 0;
+}
+
+/* Returns true if Byte can be the first byte of the field. String can be empty, so it can start with any byte */
+static constexpr bool FieldStarts(char Type, char Byte)
+{
+    return (Type == AT_FIELD_UNSIGNED) ? (Byte >= '0' && Byte <= '9') :
+           (Type == AT_FIELD_SIGNED)   ? ((Byte >= '0' && Byte <= '9') || Byte == '-') :
+           (Type == AT_FIELD_HEX)      ? (HexDigit(Byte) >= 0) : true;
+}
+
+static constexpr uint16_t PatternBytes()
+{
+uint16_t n = 1;     //  root
+
+    for(size_t p = 0; p < sizeof(Patterns) / sizeof(Patterns[0]); p++)
+    {
+        for(const char *s = Patterns[p].Pattern; *s; s++) { n++; }
+    }
+
+    return n;
+}
+
+template<uint16_t N> constexpr at_trie<N> BuildTrie()
+{
+at_trie<N> Trie{};
+uint16_t Parent = 0, Child = 0;
+char Byte = 0;
+
+    Trie.Count = 1;     //  root
+    for(size_t p = 0; p < sizeof(Patterns) / sizeof(Patterns[0]); p++)
+    {
+        Parent = 0;
+        for(const char *s = Patterns[p].Pattern; *s; s++)
+        {
+            Byte = *s;
+            if(Byte == '%')
+            {
+                s++;
+                Byte = FieldType(*s);
+                if(Byte == 0) { Trie.Error = true; return Trie; }
+            }
+
+            for(Child = Trie.Node[Parent].Child; Child; Child = Trie.Node[Child].Next)
+            {
+                if(Trie.Node[Child].Byte == Byte) { break; }
+            }
+
+            if(Child == 0)
+            {
+                if(Trie.Count >= N) { Trie.Error = true; return Trie; }
+                Child = Trie.Count++;
+                Trie.Node[Child].Byte = Byte;
+                Trie.Node[Child].Next = Trie.Node[Parent].Child;
+                Trie.Node[Parent].Child = Child;
+            }
+            Parent = Child;
+        }
+
+        if(Parent == 0 || Trie.Node[Parent].Token != 0) { Trie.Error = true; }
+        Trie.Node[Parent].Token = (uint8_t)Patterns[p].Token;
+    }
+
+    return Trie;
+}
+
+/* Each received byte must lead to one node: node has at most one field among children and no other child starts the same way */
+template<uint16_t N> constexpr bool isTrieDeterministic(const at_trie<N> &Trie)
+{
+uint16_t Field = 0, Child = 0;
+
+    for(uint16_t i = 0; i < Trie.Count; i++)
+    {
+        Field = 0;
+        for(Child = Trie.Node[i].Child; Child; Child = Trie.Node[Child].Next)
+        {
+            if(isField(Trie.Node[Child].Byte))
+            {
+                if(Field) { return false; }
+                Field = Child;
+            }
+        }
+        if(Field == 0) { continue; }
+
+        for(Child = Trie.Node[i].Child; Child; Child = Trie.Node[Child].Next)
+        {
+            if(Child != Field && FieldStarts(Trie.Node[Field].Byte, Trie.Node[Child].Byte)) { return false; }
+        }
+    }
+
+    return true;
+}
+
+static constexpr uint16_t TrieNodes = BuildTrie<PatternBytes()>().Count;
+static constexpr at_trie<TrieNodes> Trie = BuildTrie<TrieNodes>();
+
+static_assert((unsigned int)eAT::INTERNAL_ERROR < 256, "token must fit trie node");
+static_assert(!Trie.Error, "AT response patterns: empty or duplicated pattern or wrong field type");
+static_assert(isTrieDeterministic(Trie), "AT response patterns: received byte can match both field and other pattern");
+
+AT_Lexer::AT_Lexer(char *pStr, size_t StrSize, char *pStr2, size_t Str2Size) : pStr{pStr, pStr2}, StrSize{StrSize, Str2Size}
+{
+    Reset();
+}
+
+void AT_Lexer::Reset()
+{
+    Node = 0;
+    Matched = eAT::NO_COMMAND_RECEIVED;
+    Unknown = false;
+    LineDone = false;
+    InField = false;
+    FieldType = 0;
+    FieldNegative = false;
+    FieldValue = 0;
+    FieldLen = 0;
+    StrIndex = 0;
+    NumbersNum = 0;
+}
+
+eAT AT_Lexer::Feed(char Byte)
+{
+uint16_t Child, Field;
+eAT Token;
+
+    if(LineDone) { Reset(); }
+
+    if(Byte == '\n')    //  end of line, longest matched pattern is the token
+    {
+        if(InField) { EndField(); }
+        LineDone = true;
+        return Matched;
+    }
+
+    if(Unknown || isField(Byte))
+    {
+        Unknown = true;
+        return eAT::NO_COMMAND_RECEIVED;
+    }
+
+    if(InField)
+    {
+        if(FieldByte(Byte)) { return eAT::NO_COMMAND_RECEIVED; }
+        EndField();     //  byte after the field is matched below
+    }
+
+    while(1)
+    {
+        Field = 0;
+        for(Child = Trie.Node[Node].Child; Child; Child = Trie.Node[Child].Next)
+        {
+            if(Trie.Node[Child].Byte == Byte) { break; }
+            if(isField(Trie.Node[Child].Byte)) { Field = Child; }
+        }
+
+        if(Child)
+        {
+            Node = Child;
+            break;
+        }
+
+        if(Field == 0 || StartField(Field, Byte) == false)
+        {
+            Unknown = true;     //  rest of the line is ignored
+            return eAT::NO_COMMAND_RECEIVED;
+        }
+
+        Node = Field;
+        if(FieldByte(Byte)) { break; }
+        EndField();     //  empty string, byte is matched after it
+    }
+
+    Token = (eAT)Trie.Node[Node].Token;
+    if(Token == eAT::IPD || Token == eAT::RECV_DATA || Token == eAT::SEND_PROMPT)  //  data follow in the same line
+    {
+        LineDone = true;
+        return Token;
+    }
+    if(Token != eAT::NO_COMMAND_RECEIVED) { Matched = Token; }
+
+    return eAT::NO_COMMAND_RECEIVED;
+}
+
+bool AT_Lexer::StartField(uint16_t FieldNode, char Byte)
+{
+    FieldType = Trie.Node[FieldNode].Byte;
+    if(FieldStarts(FieldType, Byte) == false) { return false; }
+
+    InField = true;
+    FieldNegative = false;
+    FieldValue = 0;
+    FieldLen = 0;
+
+    if(FieldType == AT_FIELD_STRING && StrIndex < 2 && StrSize[StrIndex]) { pStr[StrIndex][0] = 0; }
+
+    return true;
+}
+
+bool AT_Lexer::FieldByte(char Byte)
+{
+int Digit;
+
+    switch(FieldType)
+    {
+    case AT_FIELD_STRING:
+    case AT_FIELD_SKIP:
+        if(Byte == '"' || Byte == '\r') { return false; }
+        if(FieldType == AT_FIELD_STRING && StrIndex < 2 && (size_t)FieldLen + 1 < StrSize[StrIndex])  //  cut to buffer size
+        {
+            pStr[StrIndex][FieldLen++] = Byte;
+            pStr[StrIndex][FieldLen] = 0;
+        }
+        return true;
+
+    case AT_FIELD_HEX:
+        Digit = HexDigit(Byte);
+        if(Digit < 0) { return false; }
+        FieldValue = (FieldValue << 4) | (unsigned int)Digit;
+        return true;
+
+    case AT_FIELD_SIGNED:
+        if(Byte == '-' && FieldLen == 0 && FieldNegative == false)
+        {
+            FieldNegative = true;
+            return true;
+        }
+        /* fall through */
+    case AT_FIELD_UNSIGNED:
+    default:
+        if(Byte < '0' || Byte > '9') { return false; }
+        FieldValue = FieldValue * 10 + (unsigned int)(Byte - '0');
+        FieldLen++;
+        return true;
+    }
+}
+
+void AT_Lexer::EndField()
+{
+    InField = false;
+
+    switch(FieldType)
+    {
+    case AT_FIELD_STRING:
+        StrIndex++;
+        break;
+
+    case AT_FIELD_SKIP:
+        break;
+
+    default:
+        if(NumbersNum < AT_LEXER_NUMBERS_MAX) { Number[NumbersNum++] = FieldNegative ? 0U - FieldValue : FieldValue; }
+        break;
+    }
+}
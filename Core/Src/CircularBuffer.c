@@ -2,7 +2,12 @@
 
 STATUS cb_init(circular_buffer *cb, size_t capacity, size_t sz)
 {
-    cb->buffer = memmgr_alloc(capacity * sz);
+    return cb_init_static(cb, memmgr_alloc(capacity * sz), capacity, sz);
+}
+
+STATUS cb_init_static(circular_buffer *cb, void *buffer, size_t capacity, size_t sz)
+{
+    cb->buffer = buffer;
     if(cb->buffer == NULL) { return ERROR; }
     cb->buffer_end = (char *)cb->buffer + capacity * sz;
     cb->capacity = capacity;
@@ -42,6 +47,48 @@ STATUS cb_pop_front(circular_buffer *cb, void *item)
     return SUCCESS;
 }
 
+size_t cb_pop_front_n(circular_buffer *cb, void *items, size_t n)
+{
+size_t first, bytes;
+
+    if(n > cb->count) { n = cb->count; }
+    if(n == 0) { return 0; }
+
+    bytes = n * cb->sz;
+    first = (size_t)((char*)cb->buffer_end - (char*)cb->tail);  //  contiguous data up to the end of buffer
+    if(first > bytes) { first = bytes; }
+
+    memcpy(items, cb->tail, first);
+    if(bytes > first)   //  data wrap around
+    {
+        memcpy((char*)items + first, cb->buffer, bytes - first);
+        cb->tail = (char*)cb->buffer + (bytes - first);
+    }
+    else
+    {
+        cb->tail = (char*)cb->tail + bytes;
+        if(cb->tail == cb->buffer_end)
+            cb->tail = cb->buffer;
+    }
+    cb->count -= n;
+    return n;
+}
+
+size_t cb_drop_front(circular_buffer *cb, size_t n)
+{
+size_t bytes, left;
+
+    if(n > cb->count) { n = cb->count; }
+    if(n == 0) { return 0; }
+
+    bytes = n * cb->sz;
+    left = (size_t)((char*)cb->buffer_end - (char*)cb->tail);
+    if(bytes >= left) { cb->tail = (char*)cb->buffer + (bytes - left); }
+    else              { cb->tail = (char*)cb->tail + bytes; }
+    cb->count -= n;
+    return n;
+}
+
 size_t cb_space_left(circular_buffer *cb)
 {
    return (cb->capacity - cb->count);
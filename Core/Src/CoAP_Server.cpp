@@ -0,0 +1,601 @@
+/**
+  ******************************************************************************
+  * @file    CoAP_Server.cpp
+  * @author  Ostap Kostyk
+  * @brief   CoAP (RFC 7252) server over ESP UDP socket: pages and files of HTTP
+  *          server and HTTP variables are accessed by single datagrams,
+  *          larger content is transferred block-wise (RFC 7959)
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "CoAP_Server.hpp"
+
+#ifdef COAP_SERVER_EN
+
+#include "HTTP_content.h"
+#include "ROMFS.h"
+
+using namespace OKO_COAP;
+
+extern bool HTTP_RenderPage(int PageIndex, char *pHostName, bool **pProcessSemaphore);
+
+/* Codes (class << 5 | detail) */
+#define COAP_EMPTY                      0x00    //  empty message (ping), answered by Reset
+#define COAP_GET                        0x01
+#define COAP_POST                       0x02
+#define COAP_PUT                        0x03
+#define COAP_CHANGED                    0x44    //  2.04
+#define COAP_CONTENT                    0x45    //  2.05
+#define COAP_BAD_REQUEST                0x80    //  4.00
+#define COAP_BAD_OPTION                 0x82    //  4.02
+#define COAP_NOT_FOUND                  0x84    //  4.04
+#define COAP_METHOD_NOT_ALLOWED         0x85    //  4.05
+#define COAP_NOT_ACCEPTABLE             0x86    //  4.06
+#define COAP_REQUEST_ENTITY_TOO_LARGE   0x8D    //  4.13
+#define COAP_INTERNAL_SERVER_ERROR      0xA0    //  5.00
+#define COAP_SERVICE_UNAVAILABLE        0xA3    //  5.03
+#define COAP_IGNORE                     0xFF    //  message is ignored (not a request or not valid)
+
+/* Option numbers */
+#define COAP_OPTION_URI_HOST            3
+#define COAP_OPTION_URI_PORT            7
+#define COAP_OPTION_URI_PATH            11
+#define COAP_OPTION_CONTENT_FORMAT      12
+#define COAP_OPTION_URI_QUERY           15
+#define COAP_OPTION_ACCEPT              17
+#define COAP_OPTION_BLOCK2              23
+#define COAP_OPTION_BLOCK1              27
+#define COAP_OPTION_SIZE2               28
+#define COAP_OPTION_SIZE1               60
+
+#define COAP_FORMAT_TEXT                0       //  text/plain;charset=utf-8
+#define COAP_FORMAT_LINK                40      //  application/link-format
+#define COAP_FORMAT_BINARY              42      //  application/octet-stream
+#define COAP_FORMAT_JSON                50
+#define COAP_FORMAT_NONE                -1      //  no registered format (e.g. HTML), option is not sent
+
+static const char CoAP_WellKnownCore[] = ".well-known/core";
+
+static_assert(COAP_BLOCK_SZX <= 6, "block size is 16 to 1024 bytes");
+static_assert(COAP_RX_BUFFER_SIZE >= 16, "buffer for requests is too short");
+
+/* Copies part of Data which falls into window [Offset, Offset + Len) of content into pBuffer, Pos is offset of Data in content */
+static void CopyContent(const void *pData, uint32_t Size, uint32_t &Pos, uint32_t Offset, uint8_t *pBuffer, uint32_t Len)
+{
+uint32_t First, Last;
+
+    if(pBuffer)
+    {
+        First = (Pos > Offset) ? Pos : Offset;
+        Last = (Pos + Size < Offset + Len) ? Pos + Size : Offset + Len;
+        if(First < Last) { memcpy(&pBuffer[First - Offset], (const uint8_t*)pData + (First - Pos), Last - First); }
+    }
+
+    Pos += Size;
+}
+
+CoAP_Server::CoAP_Server(ESP *pESP, uint8_t SocketID, uint16_t Port) : SocketID(SocketID), Port(Port)
+{
+    this->pESP = pESP;
+    memset(&Request, 0, sizeof(Request));
+}
+
+void CoAP_Server::Handle()
+{
+ESP::eSocketState State = pESP->GetSocketState(SocketID);
+ESP::eSocketSendDataStatus TxStatus;
+uint16_t Len;
+uint8_t Code;
+bool ret;
+
+    switch(STEP)
+    {
+    case 0:     //  bind socket
+        if(State != ESP::eSocketState::Closed) { break; }
+
+        if(SUCCESS == pESP->OpenSocketWithID(SocketID, ESP::eSocketType::UDP))
+        {
+            if(SUCCESS == pESP->BindSocket(SocketID, Port))
+            {
+                StateTimer.Set(_10sec_);
+                StateTimer.Reset();
+                STEP = 1;
+            }
+            else
+            {
+                pESP->CloseSocket(SocketID);
+            }
+        }
+        break;
+
+    case 1:     //  wait for socket
+        if(State == ESP::eSocketState::Connected && SUCCESS == pESP->ListenSocket(SocketID, RxBuffer, COAP_RX_BUFFER_SIZE))
+        {
+            StateTimer.Stop();
+            Sending = false;
+            STEP = 2;
+            debug_print("CoAP: server started, port %u\n", Port);
+            break;
+        }
+
+        if(State == ESP::eSocketState::Closed || State == ESP::eSocketState::Error || StateTimer.Elapsed())
+        {
+            pESP->CloseSocket(SocketID);
+            StateTimer.Set(COAP_RETRY_TIME);
+            StateTimer.Reset();
+            STEP = 4;
+        }
+        break;
+
+    case 2:     //  serve requests
+    case 3:     //  wait for application to render page
+        if(State != ESP::eSocketState::Connected)   //  e.g. module was restarted
+        {
+            pESP->CloseSocket(SocketID);
+            StateTimer.Set(COAP_RETRY_TIME);
+            StateTimer.Reset();
+            STEP = 4;
+            break;
+        }
+
+        if(Sending)
+        {
+            TxStatus = pESP->GetDataSendStatus(SocketID);
+            if(TxStatus != ESP::eSocketSendDataStatus::SendSuccess && TxStatus != ESP::eSocketSendDataStatus::SendFail) { break; }
+            Sending = false;    //  lost response is sent again when client retransmits request
+        }
+
+        if(STEP == 3)
+        {
+            if(*pSemaphore == true)
+            {
+                Respond(COAP_CONTENT);
+                STEP = 2;
+            }
+            else if(StateTimer.Elapsed())
+            {
+                Respond(COAP_SERVICE_UNAVAILABLE);
+                STEP = 2;
+            }
+            break;
+        }
+
+        Len = pESP->SocketRecv(SocketID);
+        if(Len == 0) { break; }
+
+        if(Len == (uint16_t)-1)     //  datagram is longer than buffer
+        {
+            Request.RemoteIP = pESP->GetSocketRemoteIP(SocketID);
+            Request.RemotePort = pESP->GetSocketRemotePort(SocketID);
+            Code = ((RxBuffer[0] >> 6) == 1 && (RxBuffer[0] & 0x0F) <= 8) ? COAP_REQUEST_ENTITY_TOO_LARGE : COAP_IGNORE;
+            Request.Type = (eType)((RxBuffer[0] >> 4) & 0x03);
+            Request.TokenLen = RxBuffer[0] & 0x0F;
+            Request.MessageID = ((uint16_t)RxBuffer[2] << 8) | RxBuffer[3];
+            if(Code != COAP_IGNORE && Request.TokenLen) { memcpy(Request.Token, &RxBuffer[4], Request.TokenLen); }
+            pESP->ListenSocket(SocketID, RxBuffer, COAP_RX_BUFFER_SIZE);
+            if(Code != COAP_IGNORE && (Request.Type == eType::Confirmable || Request.Type == eType::NonConfirmable)) { Respond(Code); }
+            break;
+        }
+
+        RxBuffer[Len] = 0;
+        Request.RemoteIP = pESP->GetSocketRemoteIP(SocketID);
+        Request.RemotePort = pESP->GetSocketRemotePort(SocketID);
+
+        /* retransmitted confirmable request: the last response was lost, send it again */
+        if(TxLen && Len >= 4 && ((RxBuffer[0] >> 4) & 0x03) == (uint8_t)eType::Confirmable && Request.RemoteIP == TxRemoteIP &&
+           Request.RemotePort == TxRemotePort && (((uint16_t)RxBuffer[2] << 8) | RxBuffer[3]) == TxMessageID)
+        {
+            pESP->ListenSocket(SocketID, RxBuffer, COAP_RX_BUFFER_SIZE);
+            if(SUCCESS == pESP->SocketSendTo(SocketID, TxBuffer, TxLen, TxRemoteIP, TxRemotePort)) { Sending = true; }
+            break;
+        }
+
+        Code = ParseRequest(Len);
+        pESP->ListenSocket(SocketID, RxBuffer, COAP_RX_BUFFER_SIZE);     //  everything needed is in Request now
+
+        if(Code == COAP_IGNORE) { break; }
+
+        if(Code == COAP_CONTENT && Request.PageIndex >= 0 && HTTPServerContent[Request.PageIndex].Type == HTTP_PageType::Dynamic)
+        {
+            pSemaphore = 0;
+            ret = HTTP_RenderPage(Request.PageIndex, 0, &pSemaphore);
+            if(ret == false)
+            {
+                Code = COAP_INTERNAL_SERVER_ERROR;
+            }
+            else if(pSemaphore)     //  wait for application
+            {
+                StateTimer.Set(COAP_RENDER_TIMEOUT);
+                StateTimer.Reset();
+                STEP = 3;
+                break;
+            }
+        }
+
+        Respond(Code);
+        break;
+
+    case 4:     //  pause before binding again
+        if(State == ESP::eSocketState::Closed && StateTimer.Elapsed())
+        {
+            StateTimer.Stop();
+            STEP = 0;
+        }
+        break;
+
+    default:
+        STEP = 0;
+        break;
+    }
+}
+
+uint8_t CoAP_Server::ParseRequest(uint16_t Len)
+{
+const uint8_t *p = RxBuffer;
+const uint8_t *pEnd = RxBuffer + Len;
+uint32_t Delta, OptLen, Value;
+uint16_t Number = 0;
+char Path[COAP_PATH_SIZE];
+size_t PathLen = 0;
+bool PathTooLong = false;
+char Str[COAP_VALUE_SIZE];
+char *pPayload = 0;
+
+    if(Len < 4 || (p[0] >> 6) != 1) { return COAP_IGNORE; }    //  version 1
+
+    Request.Type = (eType)((p[0] >> 4) & 0x03);
+    Request.TokenLen = p[0] & 0x0F;
+    Request.Code = p[1];
+    Request.MessageID = ((uint16_t)p[2] << 8) | p[3];
+    Request.BlockNum = 0;
+    Request.BlockSZX = COAP_BLOCK_SZX;
+    Request.Block2 = false;
+    Request.WellKnownCore = false;
+    Request.PageIndex = -1;
+    Request.pFile = 0;
+
+    if(Request.Type == eType::Acknowledgement || Request.Type == eType::Reset) { return COAP_IGNORE; }     //  server doesn't send confirmable messages
+    if(Request.TokenLen > 8 || 4 + Request.TokenLen > Len) { return COAP_IGNORE; }     //  message format error
+    memcpy(Request.Token, &p[4], Request.TokenLen);
+
+    if(Request.Code == COAP_EMPTY)
+    {
+        return (Request.Type == eType::Confirmable && Len == 4) ? COAP_EMPTY : COAP_IGNORE;     //  CoAP ping
+    }
+    if((Request.Code >> 5) != 0) { return COAP_IGNORE; }   //  response, not request
+
+    p += 4 + Request.TokenLen;
+
+    /* options, number of each option is delta to the previous one */
+    while(p < pEnd && *p != 0xFF)
+    {
+        Delta = *p >> 4;
+        OptLen = *p & 0x0F;
+        p++;
+
+        if(Delta == 13)      { if(p + 1 > pEnd) { return COAP_BAD_REQUEST; } Delta = 13 + p[0]; p += 1; }
+        else if(Delta == 14) { if(p + 2 > pEnd) { return COAP_BAD_REQUEST; } Delta = 269 + (((uint32_t)p[0] << 8) | p[1]); p += 2; }
+        else if(Delta == 15) { return COAP_BAD_REQUEST; }
+
+        if(OptLen == 13)      { if(p + 1 > pEnd) { return COAP_BAD_REQUEST; } OptLen = 13 + p[0]; p += 1; }
+        else if(OptLen == 14) { if(p + 2 > pEnd) { return COAP_BAD_REQUEST; } OptLen = 269 + (((uint32_t)p[0] << 8) | p[1]); p += 2; }
+        else if(OptLen == 15) { return COAP_BAD_REQUEST; }
+
+        if(p + OptLen > pEnd) { return COAP_BAD_REQUEST; }
+        Number += Delta;
+
+        Value = 0;
+        if(OptLen <= 4)
+        {
+            for(uint32_t i = 0; i < OptLen; i++) { Value = (Value << 8) | p[i]; }   //  uint option value, network byte order
+        }
+
+        switch(Number)
+        {
+        case COAP_OPTION_URI_PATH:  //  one option per path segment
+            if(PathLen + (PathLen ? 1 : 0) + OptLen >= sizeof(Path))
+            {
+                PathTooLong = true;
+                break;
+            }
+            if(PathLen) { Path[PathLen++] = '/'; }
+            memcpy(&Path[PathLen], p, OptLen);
+            PathLen += OptLen;
+            break;
+
+        case COAP_OPTION_URI_QUERY:     //  "name=value", variable is set as with query string of HTTP request
+            if(OptLen >= sizeof(Str)) { return COAP_BAD_REQUEST; }
+            memcpy(Str, p, OptLen);
+            Str[OptLen] = 0;
+            if(ParseVariables(Str) != COAP_CHANGED) { return COAP_BAD_REQUEST; }
+            break;
+
+        case COAP_OPTION_BLOCK2:
+            if(OptLen > 3 || (Value & 0x07) == 7) { return COAP_BAD_REQUEST; }
+            Request.BlockNum = Value >> 4;
+            Request.BlockSZX = ((Value & 0x07) < COAP_BLOCK_SZX) ? (Value & 0x07) : COAP_BLOCK_SZX;
+            if((Value & 0x07) > COAP_BLOCK_SZX) { Request.BlockNum <<= (Value & 0x07) - COAP_BLOCK_SZX; }   //  same offset with smaller blocks
+            Request.Block2 = true;
+            break;
+
+        case COAP_OPTION_BLOCK1:    //  payload of request must fit one datagram
+            if(OptLen > 3 || (Value >> 4) != 0 || (Value & 0x08)) { return COAP_REQUEST_ENTITY_TOO_LARGE; }
+            break;
+
+        case COAP_OPTION_URI_HOST:
+        case COAP_OPTION_URI_PORT:
+        case COAP_OPTION_ACCEPT:    //  there is one representation of every resource
+        case COAP_OPTION_SIZE1:
+            break;
+
+        default:
+            if(Number & 0x01) { return COAP_BAD_OPTION; }   //  unknown critical option
+            break;                                          //  unknown elective option is ignored
+        }
+
+        p += OptLen;
+    }
+
+    if(p < pEnd)    //  payload marker
+    {
+        p++;
+        if(p == pEnd) { return COAP_BAD_REQUEST; }  //  marker must be followed by payload
+        pPayload = (char*)p;    //  zero-terminated in receive buffer
+    }
+
+    if(PathTooLong) { return COAP_NOT_FOUND; }
+    Path[PathLen] = 0;
+
+    /* resource */
+    if(PathLen == 0)
+    {
+        Request.PageIndex = 0;  //  home page
+    }
+    else if(0 == strcmp(Path, CoAP_WellKnownCore))
+    {
+        Request.WellKnownCore = true;
+    }
+    else
+    {
+        for(int i = 0; i < HTTPServerContentPages; i++)
+        {
+            if(0 == strcmp(Path, HTTPServerContent[i].pPageName))
+            {
+                Request.PageIndex = i;
+                break;
+            }
+        }
+#ifdef HTTP_SERV_ROMFS_EN
+        if(Request.PageIndex < 0)
+        {
+            Request.pFile = ROMFS_Find(Path, PathLen);
+            if(Request.pFile && (((const ROMFS_File*)Request.pFile)->Flags & ROMFS_FLAG_GZIP))  //  CoAP has no content encoding, uncompressed copy is sent if there is one
+            {
+                Request.pFile = ROMFS_FindPlain(Path, PathLen);
+                if(Request.pFile == 0) { return COAP_NOT_ACCEPTABLE; }
+            }
+        }
+#endif
+        if(Request.PageIndex < 0 && Request.pFile == 0) { return COAP_NOT_FOUND; }
+    }
+
+    switch(Request.Code)
+    {
+    case COAP_GET:
+        return COAP_CONTENT;
+
+    case COAP_POST:
+    case COAP_PUT:
+        if(Request.PageIndex < 0) { return COAP_METHOD_NOT_ALLOWED; }
+        if(pPayload) { return ParseVariables(pPayload); }
+        return COAP_CHANGED;
+
+    default:
+        return COAP_METHOD_NOT_ALLOWED;
+    }
+}
+
+uint8_t CoAP_Server::ParseVariables(char *pStr)
+{
+char *pNext, *pValue;
+HTTPVariable *Variable;
+
+    while(pStr && *pStr)
+    {
+        pNext = strchr(pStr, '&');
+        if(pNext) { *pNext++ = 0; }
+
+        pValue = strchr(pStr, '=');
+        if(pValue == 0 || pValue == pStr) { return COAP_BAD_REQUEST; }
+        *pValue++ = 0;
+
+        Variable = HTTPVariable::FindVariable(pStr);
+        if(Variable && Variable->SetValue(pValue) == false) { return COAP_BAD_REQUEST; }    //  unknown variables are ignored
+
+        pStr = pNext;
+    }
+
+    return COAP_CHANGED;
+}
+
+uint8_t* CoAP_Server::PutOption(uint8_t *p, uint16_t &LastNumber, uint16_t Number, const uint8_t *pValue, uint16_t Len)
+{
+uint16_t Delta = Number - LastNumber;
+uint8_t *pHeader = p++;
+
+    LastNumber = Number;
+
+    if(Delta < 13)       { *pHeader = (uint8_t)(Delta << 4); }
+    else if(Delta < 269) { *pHeader = 13 << 4; *p++ = (uint8_t)(Delta - 13); }
+    else                 { *pHeader = 14 << 4; *p++ = (uint8_t)((Delta - 269) >> 8); *p++ = (uint8_t)(Delta - 269); }
+
+    if(Len < 13)       { *pHeader |= (uint8_t)Len; }
+    else if(Len < 269) { *pHeader |= 13; *p++ = (uint8_t)(Len - 13); }
+    else               { *pHeader |= 14; *p++ = (uint8_t)((Len - 269) >> 8); *p++ = (uint8_t)(Len - 269); }
+
+    memcpy(p, pValue, Len);
+    return p + Len;
+}
+
+uint8_t* CoAP_Server::PutOptionUint(uint8_t *p, uint16_t &LastNumber, uint16_t Number, uint32_t Value)
+{
+uint8_t Bytes[4];
+uint16_t Len = 0;
+
+    while(Value)    //  shortest form, zero is empty value
+    {
+        Len++;
+        Bytes[4 - Len] = (uint8_t)Value;
+        Value >>= 8;
+    }
+
+    return PutOption(p, LastNumber, Number, &Bytes[4 - Len], Len);
+}
+
+uint32_t CoAP_Server::GetContent(uint32_t Offset, uint8_t *pBuffer, uint32_t Len)
+{
+uint32_t Pos = 0;
+const HTTP_Page *pPage;
+
+    if(Request.WellKnownCore)   //  "</index.html>,</settings.html>"
+    {
+        for(int i = 0; i < HTTPServerContentPages; i++)
+        {
+            if(i) { CopyContent(",", 1, Pos, Offset, pBuffer, Len); }
+            CopyContent("</", 2, Pos, Offset, pBuffer, Len);
+            CopyContent(HTTPServerContent[i].pPageName, strlen(HTTPServerContent[i].pPageName), Pos, Offset, pBuffer, Len);
+            CopyContent(">", 1, Pos, Offset, pBuffer, Len);
+        }
+        return Pos;
+    }
+
+#ifdef HTTP_SERV_ROMFS_EN
+    if(Request.pFile)
+    {
+        CopyContent(((const ROMFS_File*)Request.pFile)->pData, ((const ROMFS_File*)Request.pFile)->Size, Pos, Offset, pBuffer, Len);
+        return Pos;
+    }
+#endif
+
+    if(Request.PageIndex < 0) { return 0; }
+
+    for(int i = 0; i < HTTPServerContent[Request.PageIndex].PageParts; i++)
+    {
+        pPage = &HTTPServerContent[Request.PageIndex].pPage[i];
+        CopyContent(pPage->pContent, pPage->Size ? pPage->Size : strlen(pPage->pContent), Pos, Offset, pBuffer, Len);  //  size of dynamic part is not known
+    }
+
+    return Pos;
+}
+
+void CoAP_Server::Respond(uint8_t Code)
+{
+uint8_t *p = TxBuffer;
+uint16_t LastOption = 0;
+uint16_t MessageID;
+eType Type;
+uint32_t Total, Offset, Size, n;
+bool More;
+int Format = COAP_FORMAT_NONE;
+
+    if(Code == COAP_EMPTY)  //  ping
+    {
+        Type = eType::Reset;
+        MessageID = Request.MessageID;
+        Request.TokenLen = 0;
+    }
+    else if(Request.Type == eType::Confirmable)     //  piggybacked response
+    {
+        Type = eType::Acknowledgement;
+        MessageID = Request.MessageID;
+    }
+    else
+    {
+        Type = eType::NonConfirmable;
+        MessageID = NextMessageID++;
+    }
+
+    *p++ = 0x40 | ((uint8_t)Type << 4) | Request.TokenLen;
+    *p++ = Code;
+    *p++ = (uint8_t)(MessageID >> 8);
+    *p++ = (uint8_t)MessageID;
+    memcpy(p, Request.Token, Request.TokenLen);
+    p += Request.TokenLen;
+
+    if(Code == COAP_CONTENT)
+    {
+        Total = GetContent(0, 0, 0);
+        Size = 16UL << Request.BlockSZX;
+        Offset = Request.BlockNum * Size;
+
+        if(Offset && Offset >= Total)   //  block out of content
+        {
+            TxBuffer[1] = COAP_BAD_OPTION;
+        }
+        else
+        {
+            n = (Total - Offset < Size) ? Total - Offset : Size;
+            More = (Offset + n < Total);
+
+            if(Request.WellKnownCore) { Format = COAP_FORMAT_LINK; }
+#ifdef HTTP_SERV_ROMFS_EN
+            if(Request.pFile)
+            {
+                switch(((const ROMFS_File*)Request.pFile)->MimeType)
+                {
+                case ROMFS_MimeType::Text:      Format = COAP_FORMAT_TEXT; break;
+                case ROMFS_MimeType::Json:      Format = COAP_FORMAT_JSON; break;
+                case ROMFS_MimeType::Binary:    Format = COAP_FORMAT_BINARY; break;
+                default: break;
+                }
+            }
+#endif
+            if(Format != COAP_FORMAT_NONE) { p = PutOptionUint(p, LastOption, COAP_OPTION_CONTENT_FORMAT, (uint32_t)Format); }
+            if(Request.Block2 || More) { p = PutOptionUint(p, LastOption, COAP_OPTION_BLOCK2, (Request.BlockNum << 4) | (More ? 0x08 : 0) | Request.BlockSZX); }
+            if(Request.BlockNum == 0 && More) { p = PutOptionUint(p, LastOption, COAP_OPTION_SIZE2, Total); }
+
+            if(n)
+            {
+                *p++ = 0xFF;    //  payload marker
+                GetContent(Offset, p, n);
+                p += n;
+            }
+        }
+    }
+
+    TxLen = (uint16_t)(p - TxBuffer);
+
+    if(Type == eType::Acknowledgement)  //  kept for retransmitted request
+    {
+        TxRemoteIP = Request.RemoteIP;
+        TxRemotePort = Request.RemotePort;
+        TxMessageID = MessageID;
+    }
+    else
+    {
+        TxRemotePort = 0;
+    }
+
+    if(SUCCESS == pESP->SocketSendTo(SocketID, TxBuffer, TxLen, Request.RemoteIP, Request.RemotePort)) { Sending = true; }
+}
+
+#endif  //  COAP_SERVER_EN
@@ -28,9 +28,16 @@
  */
 
 #include "ESP8266.hpp"
+#include "Metrics.hpp"
 
 using namespace OKO_ESP8266;
 
+#ifdef ESP8266_SOCKET_EVENTS_EN
+#define SOCKET_EVENTS_UPDATE(SocketID)  UpdateSocketEvents(SocketID)   //  public methods changing socket on request of application take changes into account at once
+#else
+#define SOCKET_EVENTS_UPDATE(SocketID)
+#endif
+
 static const U8 AT[] =                  "AT\r\n";
 static const U8 ATE0[] =                "ATE0\r\n";    //  Echo Off
 static const U8 AT_RST[] =              "AT+RST\r\n";
@@ -40,9 +47,46 @@ static const U8 AT_CWMODE_CUR_AP[] =    "AT+CWMODE_CUR=2\r\n";
 static const U8 AT_CWMODE_CUR_BOTH[] =  "AT+CWMODE_CUR=3\r\n";
 static const U8 AT_CIPMUX_SINGLE[] =    "AT+CIPMUX=0\r\n";
 static const U8 AT_CIPMUX_MULTIPLE[] =  "AT+CIPMUX=1\r\n";
+#ifdef ESP8266_CIPDINFO_EN
+static const U8 AT_CIPDINFO[] =         "AT+CIPDINFO=1\r\n";  //  show remote IP and port in "+IPD"
+#endif
+#ifdef ESP8266_SENDBUF_EN
+static const U8 AT_CIPSENDBUF_TEST[] =  "AT+CIPSENDBUF=?\r\n";
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+static const U8 AT_CIPRECVMODE_PASSIVE[] = "AT+CIPRECVMODE=1\r\n";
+static const U8 AT_CIPRECVLEN[] =       "AT+CIPRECVLEN?\r\n";
+#endif
+#ifdef ESP8266_PASSTHROUGH_EN
+static const U8 AT_CIPCLOSE_ALL[] =     "AT+CIPCLOSE=5\r\n";
+static const U8 AT_CIPCLOSE_SINGLE[] =  "AT+CIPCLOSE\r\n";
+static const U8 AT_CIPSERVER_STOP[] =   "AT+CIPSERVER=0\r\n";
+static const U8 AT_CIPMODE_TRANSPARENT[] = "AT+CIPMODE=1\r\n";
+static const U8 AT_CIPMODE_NORMAL[] =   "AT+CIPMODE=0\r\n";
+static const U8 AT_CIPSEND_TRANSPARENT[] = "AT+CIPSEND\r\n";
+static const U8 TRANSPARENT_EXIT[] =    "+++";     //  must come as separate packet: no data 20ms before and 1s after it
+#endif
 static const U8 AT_CWSAP_CUR_REQ[] =    "AT+CWSAP_CUR?\r\n";
 static const U8 AT_CWLAP_REQ[] =        "AT+CWLAP\r\n";
 static const U8 AT_CIFSR[] =            "AT+CIFSR\r\n";
+static const U8 AT_CIPSTATUS[] =        "AT+CIPSTATUS\r\n";
+
+#ifdef METRICS_EN
+using OKO_STATS::Metric;
+static OKO_STATS::Log2Histogram IPDFrameSize;
+static Metric MetricIPDFrames       {"esp_ipd_frames_total", "Received +IPD frames", Metric::eType::Counter};
+static Metric MetricIPDBytes        {"esp_ipd_bytes_total", "Data bytes announced by +IPD frames", Metric::eType::Counter};
+static Metric MetricIPDFrameSize    {"esp_ipd_frame_bytes", "Size of +IPD frames", &IPDFrameSize};
+static Metric MetricIPDCutFrames    {"esp_ipd_cut_frames_total", "+IPD frames cut because of short socket buffer or UART buffer overflow", Metric::eType::Counter};
+static Metric MetricRxDroppedBytes  {"esp_rx_dropped_bytes_total", "Received data bytes ignored (socket not ready, cut or discarded frames)", Metric::eType::Counter};
+static Metric MetricSendOK          {"esp_send_total", "Data send results reported by module", Metric::eType::Counter, "result=\"ok\""};
+static Metric MetricSendFail        {"esp_send_total", "", Metric::eType::Counter, "result=\"fail\""};
+static Metric MetricBusyRetries     {"esp_busy_retries_total", "Data sends retried because module was busy", Metric::eType::Counter};
+static Metric MetricModuleResets    {"esp_module_resets_total", "Resets of the module", Metric::eType::Counter};
+static Metric MetricUARTFrameErrors {"esp_uart_errors_total", "UART receive errors", Metric::eType::Counter, &ESP_HuartErrorCounters(ESP1_HUART_NUM)->FrameErrors, "type=\"frame\""};
+static Metric MetricUARTNoiseErrors {"esp_uart_errors_total", "", Metric::eType::Counter, &ESP_HuartErrorCounters(ESP1_HUART_NUM)->NoiseErrors, "type=\"noise\""};
+static Metric MetricUARTOverruns    {"esp_uart_errors_total", "", Metric::eType::Counter, &ESP_HuartErrorCounters(ESP1_HUART_NUM)->OverrunErrors, "type=\"overrun\""};
+#endif
 
 
 ESP::module::module()
@@ -106,16 +150,18 @@ ESP::server::server()
 
 ESP::io::io()
 {
-pRxBuffer              = RxBuffer;
 pCommandString         = CommandString;
 pReceivedParameterStr  = ReceivedParameterStr;
 pReceivedParameterStr2 = ReceivedParameterStr2;
 pReceivedParameter     = ReceivedParameter;
 
 pCurrentSocketData = 0;
-ReceivedCommand = eAT::NO_COMMAND_RECEIVED;
+ResponseWrite = 0;
+ResponseRead = 0;
+ResponseTaken = false;
+CommandWrite = 0;
+CommandRead = 0;
 
-RxBuffCounter = 0;
 RxIgnoreCounter = 0;
 CurrentSocketDataLeft = 0;
 RxSocketId = 0;
@@ -123,6 +169,7 @@ ReceiveError = false;
 DoEmptyRxStream = false;
 ListenToTxData = false;
 ReceivingDataStream = false;
+Passthrough = false;
 RxOverflowEvent = false;
 RxOverflowFlag = false;
 }
@@ -145,6 +192,42 @@ ESP::socket::socket()
     TxState = eSocketSendDataStatus::Idle;
     DataCutFlag = false;
     CloseAfterSending = false;
+    RxStream = false;
+    RxStreamCut = false;
+    LinkEvents = 0;
+    LinkEventsSeen = 0;
+    TxClass = eTxClass::Normal;
+    TxDeficit = 0;
+#ifdef ESP8266_RX_RING_EN
+    RxRing = false;
+    RxPolicy = eRxFullPolicy::Pause;
+    RxRead = 0;
+    RxDropped = 0;
+#endif
+    RemoteIP = 0;
+    RemotePort = 0;
+    LocalPort = 0;
+    TxRemoteIP = 0;
+    TxRemotePort = 0;
+#ifdef ESP8266_SENDBUF_EN
+    TxSegment = 0;
+    TxSegmentsInFlight = 0;
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+    RxPending = 0;
+    RxRequested = 0;
+#endif
+#ifdef ESP8266_TIMESTAMPS_EN
+    memset(&Timestamps, 0, sizeof(Timestamps));
+#endif
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    EventState = State;
+    EventTxState = TxState;
+    EventRxReady = false;
+#ifdef ESP8266_RX_RING_EN
+    EventRxLen = 0;
+#endif
+#endif
 }
 
 void ESP::io::ClearReceivingErrors(void)
@@ -152,12 +235,35 @@ void ESP::io::ClearReceivingErrors(void)
     if(ReceiveError) { DoEmptyRxStream = true; }
 }
 
+ESP::io::response* ESP::io::GetResponse(void)
+{
+    if(ResponseRead == ResponseWrite) { return 0; }
+
+    return &Response[ResponseRead % ESP8266_RESPONSE_QUEUE_LEN];
+}
+
+bool ESP::io::isResponseQueueBlocked(void)
+{
+uint8_t i;
+
+    if((uint8_t)(ResponseWrite - ResponseRead) >= ESP8266_RESPONSE_QUEUE_LEN) { return true; }
+
+    for(i = ResponseRead; i != ResponseWrite; i++)
+    {
+        if(Response[i % ESP8266_RESPONSE_QUEUE_LEN].Strings) { return true; }
+    }
+
+    return false;
+}
+
 void ESP::io::ClearRxStream(void)
 {
     DoEmptyRxStream = true;
 }
 
-ESP::ESP(uint8_t HuartNumber)
+ESP::ESP(uint8_t HuartNumber, const config &Config, socket *pSockets, uint8_t *pUartRx, uint8_t *pUartTx) :
+    UartRxSize(Config.UartRxSize), UartTxSize(Config.UartTxSize), pUartRx(pUartRx), pUartTx(pUartTx), TxPacketMaxSize(Config.TxPacketMaxSize),
+    IO(), Socket(pSockets), SocketsNum(Config.Sockets), ServerConnections(Config.ServerConnections)
 {
     this->HuartNumber = HuartNumber;
     CurrentState = &smStartModule;
@@ -168,20 +274,33 @@ ESP::ESP(uint8_t HuartNumber)
     HuartConfigured = false;
 
     DebugFlag_RxStreamToStdOut = false;
-    NewCommandSemaphore = false;
+}
 
-    for(int i = 0; i < ESP8266_SOCKETS_MAX; i++)
+void ESP::Process()
+{
+#ifdef ESP8266_PROCESS_BUDGET_US
+uint32_t Start = Timestamp_Get();
+uint8_t Passes = 0;
+
+    /* run to completion: repeat while something happens (e.g. response is parsed and next command is sent at once), but not longer than budget */
+    while(ProcessStep())
     {
-        pSocket[i] = &Socket[i];
+        if(++Passes >= ESP8266_PROCESS_PASSES_MAX) { break; }
+        if(Timestamp_ElapsedUs(Start, Timestamp_Get()) >= ESP8266_PROCESS_BUDGET_US) { break; }
     }
-
+#else
+    ProcessStep();
+#endif
 }
 
-void ESP::Process()
+bool ESP::ProcessStep()
 {
+StateMachine* State;
+size_t RxCount;
+
     if(FirstTime)
     {
-        if(SUCCESS == ESP_HuartInit(HuartNumber))
+        if(SUCCESS == ESP_HuartInit(HuartNumber, pUartRx, UartRxSize, pUartTx, UartTxSize))
         {
             HuartConfigured = true;
         }
@@ -190,11 +309,11 @@ void ESP::Process()
 
     /* do not run state machine if module is disabled by IO-pin, it will not respond anyway
      * TODO: take care that machine will stop when there is no data exchange/analysis by RxHandler() */
-    if(ModuleToggleFlag == eModuleToggle::Disable) { return; }
+    if(ModuleToggleFlag == eModuleToggle::Disable) { return false; }
 
-    if(HuartConfigured == false) { return; }    //  do not run if HUART cannot be configured (communication will not run)
+    if(HuartConfigured == false) { return false; }  //  do not run if HUART cannot be configured (communication will not run)
 
-    if(ESP_HuartRxOverflow(HuartNumber))
+    if(ESP_HuartRxOverflow(HuartNumber) && IO.Passthrough == false)    //  in transparent transmission data are taken by application, nothing to flush
     {
         if(IO.RxOverflowFlag == false)
         {
@@ -224,13 +343,31 @@ void ESP::Process()
         SMStateChanged = false;
     }
 
+    State = CurrentState;
+
     if(IO.RxOverflowFlag == false)
     {
+        HandleMessages();
+
+        IO.ResponseTaken = false;
         CurrentState->Process(this);    //  call actual State Machine function
-        NewCommandSemaphore = false;
+        if(IO.ResponseTaken == false && IO.GetResponse() != 0)  //  oldest response has been seen by state machine and is not needed
+        {
+            IO.ResponseRead++;
+        }
     }
 
+    RxCount = ESP_NumOfDataReceived(HuartNumber);
     RxHandler();
+
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    for(uint8_t i = 0; i < SocketsNum; i++) { UpdateSocketEvents(i); }
+#endif
+
+    if(IO.RxOverflowFlag || IO.ReceiveError) { return false; }   //  received data are flushed, nothing to hurry for
+
+    /* data received by interrupt meanwhile can hide taken ones, then there is just no next pass */
+    return (State != CurrentState || SMStateChanged || ESP_NumOfDataReceived(HuartNumber) < RxCount || IO.ResponseRead != IO.ResponseWrite);
 }
 
 /******************************************************
@@ -243,41 +380,113 @@ void ESP::ModuleReInit(void)
     SMStateChanged = true;
 
     DebugFlag_RxStreamToStdOut = false;
-    NewCommandSemaphore = false;
 
-    pIO = new (pIO) io;
+    pIO = new (pIO) io();
     pModule = new (pModule) module;
     pLocalAP = new (pLocalAP) AccessPoint;
     pRemoteAP = new (pRemoteAP) Station;
     pServer = new (pServer) server;
+#ifdef ESP8266_PASSTHROUGH_EN
+    if(Passthrough.State != ePassthroughState::Idle) { Passthrough.State = ePassthroughState::Failed; }    //  connection is lost, server is started by application again
+#endif
 
-    for(int i = 0; i < ESP8266_SOCKETS_MAX; i++)
+    for(int i = 0; i < SocketsNum; i++)
     {
-        pSocket[i] = new (pSocket[i]) socket;
+        new (&Socket[i]) socket;
     }
+
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    EventRead = EventWrite;     //  events of old connections are not valid anymore
+    EventsLost = true;
+#endif
 }
 
 bool ESP::isCommandReceived(eAT cmd)
 {
-    if(cmd == IO.ReceivedCommand)
+io::response* pResponse;
+
+    pResponse = IO.GetResponse();
+
+    if(pResponse != 0 && cmd == pResponse->Token)
     {
-        IO.ReceivedCommand = eAT::NO_COMMAND_RECEIVED;
+        TakeResponse();
         return true;
     }
 
     return false;
 }
 
-void ESP::StoreCommand(eAT cmd)
+eAT ESP::TakeResponse(void)
 {
-    IO.ReceivedCommand = cmd;
-    NewCommandSemaphore = true;
+io::response* pResponse;
+
+    pResponse = IO.GetResponse();
+    if(pResponse == 0) { return eAT::NO_COMMAND_RECEIVED; }
+
+    memcpy(IO.ReceivedParameter, pResponse->Param, sizeof(IO.ReceivedParameter));
+    IO.ResponseRead++;
+    IO.ResponseTaken = true;    //  next response is seen by the next pass, or by the next check in this pass
+
+    return pResponse->Token;
+}
+
+STATUS ESP::QueueCommand(const char *pCmd, size_t Len, eAT Done, eAT Done2, unsigned long Timeout, at_callback Callback, uint8_t Tag)
+{
+io::at_command* pCommand;
+
+    if(Len == 0 || Len > ESP8266_COMMAND_LEN_MAX) { return ERROR; }
+    if((uint8_t)(IO.CommandWrite - IO.CommandRead) >= ESP8266_COMMAND_QUEUE_LEN) { return ERROR; }
+
+    pCommand = &IO.Command[IO.CommandWrite % ESP8266_COMMAND_QUEUE_LEN];
+    memcpy(pCommand->Cmd, pCmd, Len);
+    pCommand->Len = (uint8_t)Len;
+    pCommand->Done = Done;
+    pCommand->Done2 = Done2;
+    pCommand->Timeout = Timeout;
+    pCommand->Callback = Callback;
+    pCommand->Tag = Tag;
+    IO.CommandWrite++;
+
+    return SUCCESS;
+}
+
+void ESP::StoreCommand(eAT cmd, bool Strings)
+{
+io::response* pResponse;
+
+    pResponse = &IO.Response[IO.ResponseWrite % ESP8266_RESPONSE_QUEUE_LEN];
+    pResponse->Token = cmd;
+    pResponse->Strings = Strings;
+    memcpy(pResponse->Param, IO.ReceivedParameter, sizeof(pResponse->Param));
+    IO.ResponseWrite++;
     esp_debug_print("AT Command:%d\n", (int)cmd);
 }
 
 void ESP::ClearLastCommand(void)
 {
-    IO.ReceivedCommand = eAT::NO_COMMAND_RECEIVED;
+    IO.ResponseRead = IO.ResponseWrite;
+}
+
+void ESP::HandleMessages(void)
+{
+io::response* pResponse;
+uint8_t i;
+
+    for(i = IO.ResponseRead; i != IO.ResponseWrite; i++)
+    {
+        pResponse = &IO.Response[i % ESP8266_RESPONSE_QUEUE_LEN];
+
+        if(pResponse->Token == eAT::REBOOT_DETECTED || pResponse->Token == eAT::WDT_RESET || pResponse->Token == eAT::READY)
+        {
+            if(Module.ModuleReady)  //  module has restarted by itself, its configuration and connections are lost (expected while module is being started)
+            {
+                esp_debug_print("ESP8266: Module restarted\n");
+                METRIC_ADD(MetricModuleResets, 1);
+                ModuleReInit();
+                return;
+            }
+        }
+    }
 }
 
 bool ESP::isModuleReady(void)
@@ -386,18 +595,40 @@ STATUS ESP::OpenSocket(uint8_t &SocketID, eSocketType Type)
             Socket[i].State = eSocketState::Open;
             Socket[i].Address = 0;
             Socket[i].Port = 0;
+            Socket[i].LocalPort = 0;
             Socket[i].Type = Type;
             Socket[i].DataRx = 0;
             Socket[i].DataTx = 0;
             Socket[i].RxBuffSize = 0;
             Socket[i].RxDataLen = 0;
             SocketID = i;
+            SOCKET_EVENTS_UPDATE(i);
             return SUCCESS;
         }
     }
     return ERROR;
 }
 
+STATUS ESP::OpenSocketWithID(uint8_t SocketID, eSocketType Type)
+{
+    if(SocketID >= SocketsNum || Socket[SocketID].State != eSocketState::Closed)
+    {
+        return ERROR;
+    }
+
+    Socket[SocketID].State = eSocketState::Open;
+    Socket[SocketID].Address = 0;
+    Socket[SocketID].Port = 0;
+    Socket[SocketID].LocalPort = 0;
+    Socket[SocketID].Type = Type;
+    Socket[SocketID].DataRx = 0;
+    Socket[SocketID].DataTx = 0;
+    Socket[SocketID].RxBuffSize = 0;
+    Socket[SocketID].RxDataLen = 0;
+    SOCKET_EVENTS_UPDATE(SocketID);
+    return SUCCESS;
+}
+
 STATUS ESP::ConnectSocket(uint8_t SocketID, char * Address, unsigned int Port)
 {
     if(SocketID >= SocketsNum || Address == 0 || Port == 0 )
@@ -414,6 +645,49 @@ STATUS ESP::ConnectSocket(uint8_t SocketID, char * Address, unsigned int Port)
         Socket[SocketID].DataTx = 0;
         Socket[SocketID].RxBuffSize = 0;
         Socket[SocketID].RxDataLen = 0;
+        SOCKET_EVENTS_UPDATE(SocketID);
+        return SUCCESS;
+    }
+
+    return ERROR;
+}
+
+STATUS ESP::OpenConnection(uint8_t SocketID, const char *pHost, uint16_t Port)
+{
+    if(SUCCESS != OpenSocketWithID(SocketID, eSocketType::TCP))
+    {
+        return ERROR;
+    }
+
+    if(SUCCESS != ConnectSocket(SocketID, (char*)pHost, Port))     //  address string is not modified
+    {
+        CloseSocket(SocketID);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+STATUS ESP::BindSocket(uint8_t SocketID, unsigned int LocalPort)
+{
+static char AnyAddress[] = "0.0.0.0";
+
+    if(SocketID >= SocketsNum || LocalPort == 0 || LocalPort > 0xFFFF)
+    {
+        return ERROR;
+    }
+
+    if(Socket[SocketID].State == eSocketState::Open && Socket[SocketID].Type == eSocketType::UDP)
+    {
+        Socket[SocketID].State = eSocketState::ConnectRequested;
+        Socket[SocketID].Address = AnyAddress;
+        Socket[SocketID].Port = LocalPort;          //  remote side changes with every received datagram (UDP mode 2)
+        Socket[SocketID].LocalPort = LocalPort;
+        Socket[SocketID].DataRx = 0;
+        Socket[SocketID].DataTx = 0;
+        Socket[SocketID].RxBuffSize = 0;
+        Socket[SocketID].RxDataLen = 0;
+        SOCKET_EVENTS_UPDATE(SocketID);
         return SUCCESS;
     }
 
@@ -427,6 +701,8 @@ STATUS ESP::CloseSocket(uint8_t SocketID)
         return ERROR;
     }
 
+    SocketRxDiscardPaused(SocketID);
+
     if(Socket[SocketID].State == eSocketState::Open)    //  Socket opened but not connected, so no input data is expected
     {
         Socket[SocketID].State = eSocketState::Closed;
@@ -437,6 +713,7 @@ STATUS ESP::CloseSocket(uint8_t SocketID)
         Socket[SocketID].RxBuffSize = 0;
         Socket[SocketID].RxDataLen = 0;
         Socket[SocketID].TxState = eSocketSendDataStatus::Idle;
+        SOCKET_EVENTS_UPDATE(SocketID);
         return SUCCESS;
     }
 
@@ -449,6 +726,7 @@ STATUS ESP::CloseSocket(uint8_t SocketID)
         Socket[SocketID].DataTx = 0;
         Socket[SocketID].RxBuffSize = 0;
         Socket[SocketID].RxDataLen = 0;
+        SOCKET_EVENTS_UPDATE(SocketID);
         return SUCCESS;
     }
 
@@ -493,128 +771,613 @@ STATUS ESP::ListenSocket(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSi
         return ERROR;
     }
 
+    SocketRxDiscardPaused(SocketID);
+
     Socket[SocketID].DataRx = RxBuffer;
     Socket[SocketID].RxBuffSize = BufferSize;
+    Socket[SocketID].RxStream = false;
+    Socket[SocketID].RxStreamCut = false;
+#ifdef ESP8266_RX_RING_EN
+    Socket[SocketID].RxRing = false;
+#endif
     Socket[SocketID].RxLock = false;
+    SOCKET_EVENTS_UPDATE(SocketID);
 
     return SUCCESS;
 }
 
-uint16_t ESP::SocketRecv(uint8_t SocketID)
+STATUS ESP::ListenSocketStream(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize)
 {
-    if(SocketID >= SocketsNum)  //  socket id is out of range
-        return 0;
-
-    if((Socket[SocketID].RxLock)   &&
-        IO.RxIgnoreCounter == 0    &&      //  too long message ended
-       (Socket[SocketID].ErrorFlag == eSocketErrorFlag::NoError))
+    if((SocketID >= SocketsNum) || (0 == RxBuffer) || (0 == BufferSize) )
     {
-        if(Socket[SocketID].DataCutFlag)
-        {
-            return -1;
-        }
-#ifdef ESP_DEBUG_HTTP_REQ_ECHO
-        esp_debug_print(">>>");
-        uint16_t tmp_cnt = Socket[SocketID].RxDataLen;
-        uint16_t ptr_offset = 0;
-        while(tmp_cnt--) esp_debug_print("%c", *(Socket[SocketID].DataRx + ptr_offset++));
+        return ERROR;
+    }
+
+    Socket[SocketID].DataRx = RxBuffer;
+    Socket[SocketID].RxBuffSize = BufferSize;
+    Socket[SocketID].RxDataLen = 0;
+    Socket[SocketID].DataCutFlag = false;
+    Socket[SocketID].RxStream = true;
+#ifdef ESP8266_RX_RING_EN
+    Socket[SocketID].RxRing = false;   //  message coming to the ring continues into the buffer
 #endif
-        return Socket[SocketID].RxDataLen;
+
+    if(IO.ReceivingDataStream && IO.RxSocketId == SocketID)     //  continue paused message into the new buffer
+    {
+        IO.pCurrentSocketData = RxBuffer;
     }
 
-    return 0;
+    Socket[SocketID].RxLock = false;
+    if(Socket[SocketID].RxStreamCut)    //  rest of paused message was dropped: stream is broken, SocketRecv() returns -1
+    {
+        Socket[SocketID].RxStreamCut = false;
+        Socket[SocketID].DataCutFlag = true;
+        Socket[SocketID].RxLock = true;
+    }
+    SOCKET_EVENTS_UPDATE(SocketID);
+
+    return SUCCESS;
 }
 
-STATUS ESP::SocketSend(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen)
+bool ESP::SocketRxPaused(uint8_t SocketID)
 {
-    if(SocketID >= SocketsNum)
+    if(SocketID >= SocketsNum) { return false; }
+
+#ifdef ESP8266_RX_RING_EN
+    if(Socket[SocketID].RxRing) { return false; }   //  ring never pauses receiving, see eRxFullPolicy
+#endif
+    return (IO.ReceivingDataStream && IO.RxSocketId == SocketID && Socket[SocketID].RxLock);
+}
+
+void ESP::SocketRxDiscard(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return; }
+
+    SocketRxDiscardPaused(SocketID);
+    Socket[SocketID].RxStream = false;
+    Socket[SocketID].RxStreamCut = false;
+#ifdef ESP8266_RX_RING_EN
+    Socket[SocketID].RxRing = false;
+#endif
+    Socket[SocketID].RxLock = true;
+    SOCKET_EVENTS_UPDATE(SocketID);
+}
+
+void ESP::SocketRxDiscardPaused(uint8_t SocketID)
+{
+#ifdef ESP8266_RX_RING_EN
+    if(SocketRxPaused(SocketID) || (Socket[SocketID].RxRing && IO.ReceivingDataStream && IO.RxSocketId == SocketID))
+#else
+    if(SocketRxPaused(SocketID))
+#endif
     {
-        return ERROR;
+        IO.RxIgnoreCounter = IO.CurrentSocketDataLeft;
+        METRIC_ADD(MetricRxDroppedBytes, IO.RxIgnoreCounter);
+        IO.CurrentSocketDataLeft = 0;
+        IO.ReceivingDataStream = false;
     }
+}
 
-    Socket[SocketID].CloseAfterSending = false;
-
-    if((Socket[SocketID].State == eSocketState::Connected) &&
-       (Socket[SocketID].TxLock == false))
+#ifdef ESP8266_RX_RING_EN
+STATUS ESP::ListenSocketRing(uint8_t SocketID, uint8_t *Ring, uint16_t Size, eRxFullPolicy Policy)
+{
+    if((SocketID >= SocketsNum) || (0 == Ring) || (0 == Size))
     {
-        Socket[SocketID].DataTx = Data;
-        Socket[SocketID].TxDataLen = DataLen;
-        Socket[SocketID].TxLock = true;       //  this must be cleared when data successfully transmitted
-        return SUCCESS;
+        return ERROR;
     }
 
-    return ERROR;
+    SocketRxDiscardPaused(SocketID);
+
+    Socket[SocketID].DataRx = Ring;
+    Socket[SocketID].RxBuffSize = Size;
+    Socket[SocketID].RxDataLen = 0;
+    Socket[SocketID].RxRead = 0;
+    Socket[SocketID].RxDropped = 0;
+    Socket[SocketID].RxPolicy = Policy;
+    Socket[SocketID].DataCutFlag = false;
+    Socket[SocketID].RxStream = false;
+    Socket[SocketID].RxStreamCut = false;
+    Socket[SocketID].RxRing = true;
+    Socket[SocketID].RxLock = false;
+    SOCKET_EVENTS_UPDATE(SocketID);
+
+    return SUCCESS;
 }
 
-STATUS ESP::SocketSendClose(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen)
+uint16_t ESP::SocketRxAvailable(uint8_t SocketID)
 {
-    if(SUCCESS == SocketSend(SocketID, Data, DataLen))
+    if(SocketID >= SocketsNum || Socket[SocketID].RxRing == false) { return 0; }
+
+    return Socket[SocketID].RxDataLen;
+}
+
+uint16_t ESP::SocketPeek(uint8_t SocketID, uint8_t *pData, uint16_t Len)
+{
+socket *pS;
+uint16_t n;
+
+    if(SocketID >= SocketsNum || Socket[SocketID].RxRing == false) { return 0; }
+
+    pS = &Socket[SocketID];
+    if(Len > pS->RxDataLen) { Len = pS->RxDataLen; }
+
+    if(pData)
     {
-        Socket[SocketID].CloseAfterSending = true;
-        return SUCCESS;
+        n = pS->RxBuffSize - pS->RxRead;     //  up to the end of the ring, the rest is at its start
+        if(n > Len) { n = Len; }
+        memcpy(pData, &pS->DataRx[pS->RxRead], n);
+        memcpy(pData + n, pS->DataRx, Len - n);
     }
 
-    return ERROR;
+    return Len;
 }
 
-void ESP::StartServer(unsigned int Port)
+uint16_t ESP::SocketRead(uint8_t SocketID, uint8_t *pData, uint16_t Len)
 {
-    Server.Port = Port;
-    Server.StartRequest = true;
+socket *pS;
+
+    Len = SocketPeek(SocketID, pData, Len);
+    if(Len == 0) { return 0; }
+
+    pS = &Socket[SocketID];
+    pS->RxRead = (uint16_t)(((uint32_t)pS->RxRead + Len) % pS->RxBuffSize);
+    pS->RxDataLen -= Len;
+    if(pS->RxDataLen == 0) { pS->RxRead = 0; }  //  next data are written from the start, contiguous as long as possible
+    SOCKET_EVENTS_UPDATE(SocketID);
+
+    return Len;
 }
 
-void ESP::StopServer()
+uint32_t ESP::GetSocketRxDropped(uint8_t SocketID)
 {
-    Server.StartRequest = false;
+    if(SocketID >= SocketsNum) { return 0; }
+
+    return Socket[SocketID].RxDropped;
 }
+#endif
 
-ESP::eServerState ESP::GetServerState()
+void ESP::SyncSocketStates(void)
 {
-  return Server.State;
+    ConnectionsInfoRequest = true;
 }
 
-bool ESP::SetAccessPointIP(uint32_t ip, uint32_t gw, uint32_t mask)
+uint32_t ESP::GetSocketRemoteIP(uint8_t SocketID)
 {
-    if(ip != LocalAP.IP         ||
-       gw != LocalAP.Gateway    ||
-       mask != LocalAP.NetMask   )
+    if(SocketID >= SocketsNum) { return 0; }
+
+    return Socket[SocketID].RemoteIP;
+}
+
+uint16_t ESP::GetSocketRemotePort(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return 0; }
+
+    return Socket[SocketID].RemotePort;
+}
+
+#ifdef ESP8266_TIMESTAMPS_EN
+const ESP::socket_timestamps* ESP::GetSocketTimestamps(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return 0; }
+
+    return &Socket[SocketID].Timestamps;
+}
+#endif
+
+#ifdef ESP8266_SOCKET_EVENTS_EN
+bool ESP::GetSocketEvent(socket_event &Event)
+{
+    if(EventsLost)
     {
-        LocalAP.NewIP = ip;
-        LocalAP.NewGateway = gw;
-        LocalAP.NewNetMask = mask;
-        LocalAP.ChangeIPRequest = true;
-        return 1;
+        EventsLost = false;
+        EventRead = EventWrite;     //  queued events are incomplete, application checks all sockets anyway
+        Event.Type = eSocketEvent::Overflow;
+        Event.SocketID = ESP8266_SOCKETS_MAX;
+        Event.Len = 0;
+        return true;
     }
-    return 0;
+
+    if(EventRead == EventWrite) { return false; }
+
+    Event = EventQueue[EventRead % ESP8266_EVENT_QUEUE_LEN];
+    EventRead++;
+
+    return true;
 }
 
+void ESP::PushSocketEvent(eSocketEvent Type, uint8_t SocketID, uint16_t Len)
+{
+socket_event *pEvent;
 
-/*********************************************************************************************************************************************************************
- *********************************************************************************************************************************************************************
- *                      Internal State Machine States
- *********************************************************************************************************************************************************************
- *********************************************************************************************************************************************************************/
+    if((uint8_t)(EventWrite - EventRead) >= ESP8266_EVENT_QUEUE_LEN)
+    {
+        EventsLost = true;
+        return;
+    }
 
-void ESP::StateModuleReset::Process(ESP* pESP)
+    pEvent = &EventQueue[EventWrite % ESP8266_EVENT_QUEUE_LEN];
+    pEvent->Type = Type;
+    pEvent->SocketID = SocketID;
+    pEvent->Len = Len;
+    EventWrite++;
+}
+
+void ESP::UpdateSocketEvents(uint8_t SocketID)
 {
-    if(pESP->StateMachineStateChanged())
+socket *pS = &Socket[SocketID];
+
+    /* socket states are changed in many places of state machine and Rx handler, comparing them here catches every path.
+     * States set by application (e.g. CloseRequested, SendRequested) do not generate events */
+    if(pS->State != pS->EventState)
     {
-        esp_debug_print("ESP: Module Reset\n");
-        pESP->Module.ModuleReady = false;
-        pESP->STEP = 0;
+        if(pS->State == eSocketState::Connected)                                            { PushSocketEvent(eSocketEvent::Connected, SocketID, 0); }
+        else if(pS->State == eSocketState::Closed && pS->EventState != eSocketState::Open)   { PushSocketEvent(eSocketEvent::Closed, SocketID, 0); }
+        else if(pS->State == eSocketState::Error)                                           { PushSocketEvent(eSocketEvent::Error, SocketID, 0); }
+        pS->EventState = pS->State;
     }
 
-    pESP->IO.ClearReceivingErrors();     //  if controller tries to communicate at wrong baud rate then trash is received continuously so need to clear all of it
+    if(pS->TxState != pS->EventTxState)
+    {
+        if(pS->TxState == eSocketSendDataStatus::SendSuccess)       { PushSocketEvent(eSocketEvent::SendDone, SocketID, 0); }
+        else if(pS->TxState == eSocketSendDataStatus::SendFail)     { PushSocketEvent(eSocketEvent::SendFail, SocketID, 0); }
+        pS->EventTxState = pS->TxState;
+    }
 
-    switch(pESP->STEP)
+#ifdef ESP8266_RX_RING_EN
+    if(pS->RxRing)
     {
-    case 0:
-        ESP_ActivateResetPin(pESP->HuartNumber);
-        if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)AT_RST, sizeof(AT_RST)-1))    //  Try to reset by communication (this is needed if HW reset by IO-pin is not implemented)
+        if(pS->RxDataLen > pS->EventRxLen) { PushSocketEvent(eSocketEvent::Data, SocketID, pS->RxDataLen); }     //  new data in the ring
+        pS->EventRxLen = pS->RxDataLen;
+        return;
+    }
+#endif
+
+    if(SocketRxReady(SocketID) != pS->EventRxReady)
+    {
+        pS->EventRxReady = !pS->EventRxReady;
+        if(pS->EventRxReady && pS->DataRx && (pS->RxDataLen || pS->DataCutFlag))
         {
-            pESP->StateTimer.Set(_200ms_);  //  time to send command over UART
-            pESP->StateTimer.Reset();
-            pESP->STEP = 1;
+            PushSocketEvent(eSocketEvent::Data, SocketID, pS->RxDataLen);
+        }
+    }
+}
+#endif
+
+bool ESP::SocketRxReady(uint8_t SocketID)
+{
+    return (Socket[SocketID].RxLock &&
+            IO.RxIgnoreCounter == 0 &&      //  too long message ended
+            Socket[SocketID].ErrorFlag == eSocketErrorFlag::NoError);
+}
+
+bool ESP::SocketTxReady(uint8_t SocketID)
+{
+    if(Socket[SocketID].State != eSocketState::Connected ||     //  for connected sockets
+       Socket[SocketID].TxLock == false ||                      //  new data send has been requested
+       Socket[SocketID].TxDataLen == 0)                         //  and not all of them are sent out yet
+    {
+        return false;
+    }
+#ifdef ESP8266_SENDBUF_EN
+    if(Socket[SocketID].TxSegmentsInFlight >= ESP8266_SENDBUF_SEGMENTS) { return false; }  //  wait for "SEND OK" of previous packets
+#endif
+    return true;
+}
+
+void ESP::SetSocketTxClass(uint8_t SocketID, eTxClass Class)
+{
+    if(SocketID >= SocketsNum) { return; }
+
+    Socket[SocketID].TxClass = Class;
+}
+
+/* Deficit round robin: socket having its turn sends packets while they fit into its deficit, then the turn goes to the next socket
+ * with data ready, which gets quantum of its class added. Packets of sockets are interleaved, so short response is not queued
+ * behind a big one, and Bulk socket takes a smaller share of the link than Control one */
+int ESP::TxSchedule(void)
+{
+static const uint16_t Quantum[] = {ESP8266_TX_QUANTUM_CONTROL, ESP8266_TX_QUANTUM_NORMAL, ESP8266_TX_QUANTUM_BULK};
+uint8_t Pending = TxPending;
+uint8_t Ready = 0;
+uint8_t Later;
+uint8_t i;
+uint16_t len;
+
+    while(Pending)
+    {
+        i = (uint8_t)__builtin_ctz(Pending);
+        Pending &= Pending - 1;
+
+        if(Socket[i].State != eSocketState::Connected || Socket[i].TxLock == false || Socket[i].TxDataLen == 0)   //  sent, failed or closed
+        {
+            TxPending &= ~(1U << i);
+            Socket[i].TxDeficit = 0;    //  credit is not kept while socket has nothing to send
+        }
+        else if(SocketTxReady(i))
+        {
+            Ready |= (1U << i);
+        }
+    }
+
+    if(Ready == 0) { return -1; }
+
+    for(;;)     //  ends within few rounds: quantum is added to a ready socket every iteration
+    {
+        i = TxTurn;
+        if(Ready & (1U << i))
+        {
+            len = (Socket[i].TxDataLen < TxPacketMaxSize) ? Socket[i].TxDataLen : TxPacketMaxSize;    //  next packet, see StateSendData
+            if(Socket[i].TxDeficit >= len)
+            {
+                Socket[i].TxDeficit -= len;
+                return i;
+            }
+        }
+
+        Later = Ready & ~((2U << i) - 1);
+        TxTurn = (uint8_t)__builtin_ctz(Later ? Later : Ready);
+        Socket[TxTurn].TxDeficit += Quantum[(uint8_t)Socket[TxTurn].TxClass];
+    }
+}
+
+#ifdef ESP8266_SENDBUF_EN
+void ESP::SendBufSegmentDone(uint8_t SocketID, uint16_t Segment, bool Sent)
+{
+socket *pS = &Socket[SocketID];
+
+    if(pS->TxSegmentsInFlight == 0) { return; }     //  socket was closed or module re-initialized meanwhile
+
+    if(Segment == pS->TxSegment) { pS->TxSegmentsInFlight = 0; }     //  the last written packet, packets before it are done too
+    else                         { pS->TxSegmentsInFlight--; }
+
+    if(Sent)
+    {
+        METRIC_ADD(MetricSendOK, 1);
+#ifdef ESP8266_TIMESTAMPS_EN
+        pS->Timestamps.LastSendOK = Timestamp_Get();
+        if(pS->Timestamps.FirstSendOK == 0) { pS->Timestamps.FirstSendOK = pS->Timestamps.LastSendOK; }
+#endif
+    }
+    else
+    {
+        esp_debug_print("ESP: Socket %u segment %u SEND FAIL\n", SocketID, Segment);
+        METRIC_ADD(MetricSendFail, 1);
+        pS->TxState = eSocketSendDataStatus::SendFail;
+        pS->TxDataLen = 0;      //  rest of the message is not sent
+    }
+
+    if(pS->TxSegmentsInFlight == 0 && pS->TxDataLen == 0 && pS->TxLock)    //  whole message is confirmed
+    {
+        pS->TxLock = false;
+        if(pS->TxState != eSocketSendDataStatus::SendFail) { pS->TxState = eSocketSendDataStatus::SendSuccess; }
+        if(pS->CloseAfterSending) { CloseSocket(SocketID); }
+    }
+}
+#endif
+
+#ifdef ESP8266_PASSIVE_RX_EN
+uint16_t ESP::SocketRxPullLen(uint8_t SocketID)
+{
+socket *pS = &Socket[SocketID];
+uint32_t len;
+
+    if(pS->RxPending == 0 || pS->RxRequested != 0 ||       //  nothing waits in the module or it is requested already
+       pS->State != eSocketState::Connected ||
+       pS->DataRx == 0 || pS->RxBuffSize == 0 || pS->RxLock || //  application does not listen or has not taken previous data
+       (IO.ReceivingDataStream && IO.RxSocketId == SocketID))
+    {
+        return 0;
+    }
+
+    //  not more than the socket buffer takes, so data are never cut, and not more than fits into UART buffer with the reply
+    len = pS->RxPending;
+#ifdef ESP8266_RX_RING_EN
+    if(pS->RxRing && len > (uint32_t)(pS->RxBuffSize - pS->RxDataLen)) { len = pS->RxBuffSize - pS->RxDataLen; }     //  free space of the ring
+#endif
+    if(len > pS->RxBuffSize) { len = pS->RxBuffSize; }
+    if(len > ESP8266_RECVDATA_MAX) { len = ESP8266_RECVDATA_MAX; }
+    if(len > (uint32_t)(UartRxSize - ESP8266_RECVDATA_OVERHEAD)) { len = UartRxSize - ESP8266_RECVDATA_OVERHEAD; }
+
+    return (uint16_t)len;
+}
+
+void ESP::SocketRxPulled(uint8_t SocketID, uint16_t Len)
+{
+socket *pS = &Socket[SocketID];
+
+    if(Len < pS->RxRequested || Len >= pS->RxPending) { pS->RxPending = 0; }    //  module had less than announced, nothing is left
+    else                                               { pS->RxPending -= Len; }
+}
+#endif
+
+uint16_t ESP::SocketRecv(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum)  //  socket id is out of range
+        return 0;
+
+    if(SocketRxReady(SocketID))
+    {
+        if(Socket[SocketID].DataCutFlag)
+        {
+            return -1;
+        }
+#ifdef ESP_DEBUG_HTTP_REQ_ECHO
+        esp_debug_print(">>>");
+        uint16_t tmp_cnt = Socket[SocketID].RxDataLen;
+        uint16_t ptr_offset = 0;
+        while(tmp_cnt--) esp_debug_print("%c", *(Socket[SocketID].DataRx + ptr_offset++));
+#endif
+        return Socket[SocketID].RxDataLen;
+    }
+
+    return 0;
+}
+
+STATUS ESP::SocketSend(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen)
+{
+    if(SocketID >= SocketsNum)
+    {
+        return ERROR;
+    }
+
+    Socket[SocketID].CloseAfterSending = false;
+
+    if((Socket[SocketID].State == eSocketState::Connected) &&
+       (Socket[SocketID].TxLock == false))
+    {
+        Socket[SocketID].DataTx = Data;
+        Socket[SocketID].TxDataLen = DataLen;
+        Socket[SocketID].TxRemotePort = 0;
+        Socket[SocketID].TxState = eSocketSendDataStatus::SendRequested;
+        Socket[SocketID].TxLock = true;       //  this must be cleared when data successfully transmitted
+        TxPending |= (1U << SocketID);
+        SOCKET_EVENTS_UPDATE(SocketID);
+        return SUCCESS;
+    }
+
+    return ERROR;
+}
+
+STATUS ESP::SocketSendClose(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen)
+{
+    if(SUCCESS == SocketSend(SocketID, Data, DataLen))
+    {
+        Socket[SocketID].CloseAfterSending = true;
+        return SUCCESS;
+    }
+
+    return ERROR;
+}
+
+STATUS ESP::SocketSendTo(uint8_t SocketID,  uint8_t* Data, uint16_t DataLen, uint32_t RemoteIP, uint16_t RemotePort)
+{
+    if(SocketID >= SocketsNum || Socket[SocketID].Type != eSocketType::UDP || RemotePort == 0)
+    {
+        return ERROR;
+    }
+
+    if(SUCCESS == SocketSend(SocketID, Data, DataLen))
+    {
+        Socket[SocketID].TxRemoteIP = RemoteIP;
+        Socket[SocketID].TxRemotePort = RemotePort;
+        return SUCCESS;
+    }
+
+    return ERROR;
+}
+
+void ESP::StartServer(unsigned int Port)
+{
+    Server.Port = Port;
+    Server.StartRequest = true;
+}
+
+void ESP::StopServer()
+{
+    Server.StartRequest = false;
+}
+
+ESP::eServerState ESP::GetServerState()
+{
+  return Server.State;
+}
+
+#ifdef ESP8266_PASSTHROUGH_EN
+STATUS ESP::PassthroughStart(uint32_t RemoteIP, uint16_t RemotePort, eSocketType Type)
+{
+    if(RemotePort == 0 ||
+       (Passthrough.State != ePassthroughState::Idle && Passthrough.State != ePassthroughState::Failed))
+    {
+        return ERROR;
+    }
+
+    Passthrough.RemoteIP = RemoteIP;
+    Passthrough.RemotePort = RemotePort;
+    Passthrough.Type = Type;
+    Passthrough.StopRequest = false;
+    Passthrough.Error = false;
+    Passthrough.State = ePassthroughState::Entering;    //  state machine takes it in Standby
+
+    return SUCCESS;
+}
+
+void ESP::PassthroughStop()
+{
+    if(Passthrough.State == ePassthroughState::Entering || Passthrough.State == ePassthroughState::Active)
+    {
+        Passthrough.StopRequest = true;
+    }
+}
+
+ESP::ePassthroughState ESP::GetPassthroughState()
+{
+    return Passthrough.State;
+}
+
+size_t ESP::PassthroughSend(const uint8_t *pData, size_t Len)
+{
+size_t len;
+
+    if(Passthrough.State != ePassthroughState::Active || Passthrough.StopRequest) { return 0; }
+
+    len = ESP_TransmitBufferSpaceLeft(HuartNumber);
+    if(len > Len) { len = Len; }
+    if(len == 0 || SUCCESS != ESP_HuartSend(HuartNumber, (char*)pData, len)) { return 0; }
+
+    return len;
+}
+
+size_t ESP::PassthroughRecv(uint8_t *pData, size_t Len)
+{
+    if(IO.Passthrough == false || (Passthrough.State != ePassthroughState::Active && Passthrough.State != ePassthroughState::Leaving)) { return 0; }
+
+    return ESP_GetData(HuartNumber, pData, Len);
+}
+#endif
+
+bool ESP::SetAccessPointIP(uint32_t ip, uint32_t gw, uint32_t mask)
+{
+    if(ip != LocalAP.IP         ||
+       gw != LocalAP.Gateway    ||
+       mask != LocalAP.NetMask   )
+    {
+        LocalAP.NewIP = ip;
+        LocalAP.NewGateway = gw;
+        LocalAP.NewNetMask = mask;
+        LocalAP.ChangeIPRequest = true;
+        return 1;
+    }
+    return 0;
+}
+
+
+/*********************************************************************************************************************************************************************
+ *********************************************************************************************************************************************************************
+ *                      Internal State Machine States
+ *********************************************************************************************************************************************************************
+ *********************************************************************************************************************************************************************/
+
+void ESP::StateModuleReset::Process(ESP* pESP)
+{
+    if(pESP->StateMachineStateChanged())
+    {
+        esp_debug_print("ESP: Module Reset\n");
+        METRIC_ADD(MetricModuleResets, 1);
+        pESP->Module.ModuleReady = false;
+        pESP->STEP = 0;
+    }
+
+    pESP->IO.ClearReceivingErrors();     //  if controller tries to communicate at wrong baud rate then trash is received continuously so need to clear all of it
+
+    switch(pESP->STEP)
+    {
+    case 0:
+        ESP_ActivateResetPin(pESP->HuartNumber);
+        if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)AT_RST, sizeof(AT_RST)-1))    //  Try to reset by communication (this is needed if HW reset by IO-pin is not implemented)
+        {
+            pESP->StateTimer.Set(_200ms_);  //  time to send command over UART
+            pESP->StateTimer.Reset();
+            pESP->STEP = 1;
         }
         else
         {
@@ -1357,6 +2120,10 @@ void ESP::StateJoinAP::Process(ESP* pESP)
 void ESP::StateStandby::Process(ESP* pESP)
 {
 U8 i;
+int len;
+#ifdef ESP8266_PASSIVE_RX_EN
+uint16_t RxLen;
+#endif
 
   if(pESP->StateMachineStateChanged())
   {
@@ -1365,36 +2132,13 @@ U8 i;
     esp_debug_print("ESP8266: Standby\n");
   }
 
-    if(pESP->isCommandReceived(eAT::SOCKET_CONNECT))  //  Socket opened in server mode
-    {
-        if(pESP->IO.pReceivedParameter[0] < pESP->SocketsNum)
-        {
-            SocketId = (uint8_t)pESP->IO.pReceivedParameter[0];
-            pESP->Socket[SocketId].State = ESP::eSocketState::Connected;
-            esp_debug_print("ESP: Socket %u Opened\n", SocketId);
-            //pESP->DebugFlag_RxStreamToStdOut = true;  //  this sends received content to std out stream (debug)
-            return;
-        }
-    }
-
-    if(pESP->isCommandReceived(eAT::SOCKET_CLOSED))  //  Socket closed in server mode
-    {
-        if(pESP->IO.pReceivedParameter[0] < pESP->SocketsNum)
-        {
-            SocketId = (uint8_t)pESP->IO.pReceivedParameter[0];
-            pESP->Socket[SocketId].State = ESP::eSocketState::Closed;
-            esp_debug_print("ESP8266: Socket %u Closed\n", SocketId);
-            //pESP->DebugFlag_RxStreamToStdOut = false;
-            return;
-        }
-    }
+    //  "<id>,CONNECT" and "<id>,CLOSED" are handled by RxHandler() in any state
 
     // Send data
-    for(i=0; i < pESP->SocketsNum; i++)
+    if(pESP->TxPending)
     {
-        if((pESP->Socket[i].State == eSocketState::Connected) &&    //  for connected sockets
-           (pESP->Socket[i].TxLock == true) &&                      //  Previous sending completed and new data send has been requested
-           (0 != pESP->Socket[i].TxDataLen))                        //  There is new data to send-out
+        pESP->TxNext = (int8_t)pESP->TxSchedule();
+        if(pESP->TxNext >= 0)
         {
             pESP->CurrentState = &pESP->smSendData;
             return;
@@ -1421,12 +2165,6 @@ U8 i;
         }
     }
 
-    if(pESP->LocalAP.ChangeIPRequest)
-    {
-        pESP->CurrentState = &pESP->smChangeAPIP;
-        return;
-    }
-
     // Open socket by request
     for(i=0; i < pESP->SocketsNum; i++)
     {
@@ -1437,32 +2175,93 @@ U8 i;
         }
     }
 
-    // Close socket by request
-    for(i=0; i < pESP->SocketsNum; i++)
-    {
-        if(pESP->Socket[i].State == eSocketState::CloseRequested)
-        {
-            pESP->CurrentState = &pESP->smCloseSocket;
-            return;
-        }
-    }
-
-    if(pESP->isCommandReceived(eAT::UNLINK))
+    //  commands below are queued and sent back to back, queue is run to the end before Standby is entered again
+    if(pESP->LocalAP.ChangeIPRequest)
     {
-        //  TODO: check sockets etc.
-    }
+        len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPAP_CUR=\"%u.%u.%u.%u\",\"%u.%u.%u.%u\",\"%u.%u.%u.%u\"\r\n",
+                                                                                (unsigned int)((pESP->LocalAP.NewIP >> 24) & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewIP >> 16) & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewIP >> 8)  & 0xFF),
+                                                                                (unsigned int)( pESP->LocalAP.NewIP        & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewGateway >> 24) & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewGateway >> 16) & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewGateway >> 8)  & 0xFF),
+                                                                                (unsigned int)( pESP->LocalAP.NewGateway        & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewNetMask >> 24) & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewNetMask >> 16) & 0xFF),
+                                                                                (unsigned int)((pESP->LocalAP.NewNetMask >> 8)  & 0xFF),
+                                                                                (unsigned int)( pESP->LocalAP.NewNetMask        & 0xFF) );
 
-    if(pESP->isCommandReceived(eAT::LINK))
+        pESP->QueueCommand(pESP->IO.pCommandString, len, eAT::OK, eAT::AT_ERROR, _5sec_, ChangeAPIPCallback, 0);
+    }
+
+    // Close sockets by request
+    for(i=0; i < pESP->SocketsNum; i++)
     {
-        //TODO: react on this, data will come
+        if(pESP->Socket[i].State == eSocketState::CloseRequested)
+        {
+            len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPCLOSE=%u\r\n", i);
+            if(SUCCESS != pESP->QueueCommand(pESP->IO.pCommandString, len, eAT::OK, eAT::AT_ERROR, _100ms_, CloseSocketCallback, i)) { break; }
+
+            esp_debug_print("ESP8266: Close Socket %d\n", i);
+            pESP->Socket[i].State = eSocketState::Closing;
+            pESP->Socket[i].TxState = eSocketSendDataStatus::Idle;
+        }
+    }
+
+#ifdef ESP8266_PASSIVE_RX_EN
+    //  data received in passive mode wait in the module until socket can take them
+    for(i=0; i < pESP->SocketsNum && pESP->Module.PassiveRx; i++)
+    {
+        RxLen = pESP->SocketRxPullLen(i);
+        if(RxLen == 0) { continue; }
+
+        len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPRECVDATA=%u,%u\r\n", i, RxLen);
+        if(SUCCESS != pESP->QueueCommand(pESP->IO.pCommandString, len, eAT::OK, eAT::AT_ERROR, _1sec_, RecvDataCallback, i)) { break; }
+        pESP->Socket[i].RxRequested = RxLen;
+    }
+
+    if(pESP->Module.RxLenQuery)     //  "+CIPRECVLEN:" is applied by RxHandler()
+    {
+        if(SUCCESS == pESP->QueueCommand((const char*)AT_CIPRECVLEN, sizeof(AT_CIPRECVLEN)-1, eAT::OK, eAT::AT_ERROR, _200ms_, 0, 0))
+        {
+            pESP->Module.RxLenQuery = false;
+        }
+    }
+#endif
+
+    if(pESP->IO.CommandRead != pESP->IO.CommandWrite)
+    {
+        pESP->CurrentState = &pESP->smCommandQueue;
+        return;
+    }
+
+#ifdef ESP8266_PASSTHROUGH_EN
+    if(pESP->Passthrough.State == ePassthroughState::Entering)     //  data and commands requested before are done
+    {
+        pESP->CurrentState = &pESP->smPassthrough;
+        return;
+    }
+#endif
+
+    if(pESP->ConnectionsInfoTimer.Elapsed()) { pESP->ConnectionsInfoRequest = true; }
+    if(pESP->ConnectionsInfoRequest && pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple)
+    {
+        pESP->CurrentState = &pESP->smGetConnectionsInfo;
+        return;
+    }
+
+    if(pESP->isCommandReceived(eAT::UNLINK))
+    {
+        //  TODO: check sockets etc.
     }
 
-    //TODO: maybe move this to main ESP handler to catch it properly also during other states?
-    if(pESP->isCommandReceived(eAT::REBOOT_DETECTED) || pESP->isCommandReceived(eAT::WDT_RESET))
+    if(pESP->isCommandReceived(eAT::LINK))
     {
-        //TODO: react on module reset during operation
+        //TODO: react on this, data will come
     }
 
+    //  restart of the module is handled by HandleMessages() in any state
 }
 
 void ESP::StateChangeConnectionType::Process(ESP* pESP)
@@ -1518,6 +2317,27 @@ void ESP::StateChangeConnectionType::Process(ESP* pESP)
         if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::LINKISBUILDED) || pESP->isCommandReceived(eAT::NOCHANGE))
         {
             pESP->Module.ConnectionTypeActual = pESP->Module.ConnectionTypeRequest;
+#ifdef ESP8266_SENDBUF_EN
+            if(pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple)    //  AT+CIPSENDBUF is available in multiple connection mode only
+            {
+                pESP->QueueCommand((const char*)AT_CIPSENDBUF_TEST, sizeof(AT_CIPSENDBUF_TEST)-1, eAT::OK, eAT::AT_ERROR, _200ms_, SendBufTestCallback, 0);
+            }
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+            pESP->Module.PassiveRx = false;
+            if(pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple)
+            {
+                pESP->QueueCommand((const char*)AT_CIPRECVMODE_PASSIVE, sizeof(AT_CIPRECVMODE_PASSIVE)-1, eAT::OK, eAT::AT_ERROR, _200ms_, PassiveRxCallback, 0);
+            }
+#endif
+#ifdef ESP8266_CIPDINFO_EN
+            if(pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple)
+            {
+                pESP->ClearLastCommand();
+                pESP->STEP = 2;
+                break;
+            }
+#endif
             pESP->CurrentState = &pESP->smStandby;
         }
 
@@ -1527,6 +2347,29 @@ void ESP::StateChangeConnectionType::Process(ESP* pESP)
         }
         break;
 
+#ifdef ESP8266_CIPDINFO_EN
+    case 2:     //  remote IP and port in "+IPD"
+        if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)AT_CIPDINFO, sizeof(AT_CIPDINFO)-1))
+        {
+            pESP->StateTimer.Set(_200ms_);
+            pESP->StateTimer.Reset();
+            pESP->STEP = 3;
+        }
+        else
+        {
+            pESP->CurrentState = &pESP->smModuleReset;
+        }
+        break;
+
+    case 3:
+        //  error is not critical (old firmware): "+IPD" comes without remote IP which is then unknown (zero)
+        if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            pESP->CurrentState = &pESP->smStandby;
+        }
+        break;
+#endif
+
     default:
       pESP->STEP = 0;
         break;
@@ -1543,7 +2386,7 @@ void ESP::StateChangeConnectionType::Process(ESP* pESP)
 void ESP::StateSendData::Process(ESP* pESP)
 {
 unsigned int len;
-U8 i;
+int Next;
 
     if(pESP->StateMachineStateChanged())
     {
@@ -1556,34 +2399,51 @@ U8 i;
 
     switch(pESP->STEP)
     {
-    case 0:
-        for(i=0; i<ESP8266_SOCKETS_MAX; i++)
+    case 0:     //  packet of the socket chosen by TX scheduler (by Standby for the first packet)
+        Next = pESP->TxNext;
+        pESP->TxNext = -1;
+        if(Next < 0 || pESP->SocketTxReady(Next) == false) { Next = pESP->TxSchedule(); }
+
+        if(Next >= 0)
         {
-            if((pESP->Socket[i].State == eSocketState::Connected) &&
-                   (pESP->Socket[i].TxLock == true))
-            {
-                SocketId = i;
-                pESP->Socket[i].TxState = eSocketSendDataStatus::InProgress;
-                pESP->STEP = 1;
-                return;
-            }
+            SocketId = (uint8_t)Next;
+            pESP->Socket[SocketId].TxState = eSocketSendDataStatus::InProgress;
+            pESP->STEP = 1;
+            return;
         }
+        pESP->CurrentState = &pESP->smStandby;
         break;
 
     case 1:
-        if(pESP->Socket[SocketId].TxDataLen <= pESP->IO.TxPacketMaxSize)
+        if(pESP->Socket[SocketId].TxDataLen <= pESP->TxPacketMaxSize)
         {
             pESP->Socket[SocketId].TxPacketLen = pESP->Socket[SocketId].TxDataLen;
         }
         else
         {
-            pESP->Socket[SocketId].TxPacketLen = pESP->IO.TxPacketMaxSize;
+            pESP->Socket[SocketId].TxPacketLen = pESP->TxPacketMaxSize;
         }
 
+#ifdef ESP8266_SENDBUF_EN
+        Buffered = pESP->Module.SendBufSupported &&
+                   pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple &&
+                   pESP->Socket[SocketId].Type == eSocketType::TCP;
+        if(Buffered)
+        {
+            len = snprintf(pESP->IO.pCommandString, 24, "AT+CIPSENDBUF=%u,%u\r\n", SocketId, pESP->Socket[SocketId].TxPacketLen);
+        }
+        else
+#endif
         if(pESP->Module.ConnectionTypeActual == eModuleConnectionType::Single)
         {
             len = snprintf(pESP->IO.pCommandString, 21, "AT+CIPSEND=%u\r\n", pESP->Socket[SocketId].TxPacketLen);
         }
+        else if (pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple && pESP->Socket[SocketId].TxRemotePort)   //  UDP datagram to given remote side
+        {
+            len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize - 1, "AT+CIPSEND=%u,%u,\"%u.%u.%u.%u\",%u\r\n", SocketId, pESP->Socket[SocketId].TxPacketLen,
+                           (unsigned int)(pESP->Socket[SocketId].TxRemoteIP >> 24), (unsigned int)(pESP->Socket[SocketId].TxRemoteIP >> 16) & 0xFF,
+                           (unsigned int)(pESP->Socket[SocketId].TxRemoteIP >> 8) & 0xFF, (unsigned int)pESP->Socket[SocketId].TxRemoteIP & 0xFF, pESP->Socket[SocketId].TxRemotePort);
+        }
         else if (pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple)
         {
             len = snprintf(pESP->IO.pCommandString, 21, "AT+CIPSEND=%u,%u\r\n", SocketId, pESP->Socket[SocketId].TxPacketLen);
@@ -1610,6 +2470,12 @@ U8 i;
         break;
 
     case 2:
+#ifdef ESP8266_SENDBUF_EN
+        if(pESP->isCommandReceived(eAT::SENDBUF_SEGMENT))   //  "<segment>,<last segment sent>" comes before "OK"
+        {
+            pESP->Socket[SocketId].TxSegment = pESP->IO.pReceivedParameter[0];
+        }
+#endif
         if(pESP->isCommandReceived(eAT::OK))
         {
             // Do nothing, wait for request for the data from ESP
@@ -1629,7 +2495,7 @@ U8 i;
         if(pESP->IO.ListenToTxData)    //  module switched to data mode and ready to receive data
         {
             len = (unsigned int)ESP_TransmitBufferSpaceLeft(pESP->HuartNumber);
-            if(len > pESP->IO.TxPacketMaxSize) { len = pESP->IO.TxPacketMaxSize; }  // packets longer than 2048 bytes must be separated on pieces with min 20ms delay between them
+            if(len > pESP->TxPacketMaxSize) { len = pESP->TxPacketMaxSize; }  // packets longer than 2048 bytes must be separated on pieces with min 20ms delay between them
             if(len != 0 && len < pESP->Socket[SocketId].TxPacketLen)
             {
                 if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)pESP->Socket[SocketId].DataTx, len))
@@ -1653,7 +2519,11 @@ U8 i;
                 pESP->StateTimer.Reset();
                 pESP->IO.ListenToTxData = false;
                 //esp_debug_print("ESP: sent packet (St2)\n");
+                pESP->Socket[SocketId].DataTx += pESP->Socket[SocketId].TxPacketLen;
                 pESP->Socket[SocketId].TxDataLen -= pESP->Socket[SocketId].TxPacketLen;
+#ifdef ESP8266_SENDBUF_EN
+                if(Buffered) { pESP->Socket[SocketId].TxSegmentsInFlight++; }
+#endif
                 pESP->STEP = 4;
             }
             else
@@ -1668,6 +2538,7 @@ U8 i;
         {
             pESP->Socket[SocketId].TxState = eSocketSendDataStatus::SendFail;
             esp_debug_print("ESP: SEND FAIL!\n");
+            METRIC_ADD(MetricSendFail, 1);
             pESP->Socket[SocketId].TxDataLen = 0;
             pESP->Socket[SocketId].TxLock = 0;
             pESP->CurrentState = &pESP->smStandby;
@@ -1678,6 +2549,7 @@ U8 i;
            pESP->isCommandReceived(eAT::BUSY_S))
         {
             esp_debug_print("ESP8266: Send Retry, %d\n", RetryCounter);
+            METRIC_ADD(MetricBusyRetries, 1);
             pESP->StateTimer.Set(_1sec_);
             pESP->StateTimer.Reset();
             RetryCounter--;
@@ -1694,7 +2566,7 @@ U8 i;
             if(pESP->IO.ListenToTxData)    //  module switched to data mode and ready to receive data
             {
                 len = (unsigned int)ESP_TransmitBufferSpaceLeft(pESP->HuartNumber);
-                if(len > pESP->IO.TxPacketMaxSize) { len = pESP->IO.TxPacketMaxSize; }  // packets longer than 2048 bytes must be separated on pieces with min 20ms delay between them
+                if(len > pESP->TxPacketMaxSize) { len = pESP->TxPacketMaxSize; }  // packets longer than 2048 bytes must be separated on pieces with min 20ms delay between them
                 if(len && len < pESP->Socket[SocketId].TxPacketLen)
                 {
                     if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)pESP->Socket[SocketId].DataTx, len))
@@ -1718,7 +2590,11 @@ U8 i;
                     pESP->StateTimer.Reset();
                     pESP->IO.ListenToTxData = 0;
                     //esp_debug_print("ESP: Rest of packet sent (St3), len=%u\n", pESP->Socket[SocketId].TxPacketLen);
+                    pESP->Socket[SocketId].DataTx += pESP->Socket[SocketId].TxPacketLen;
                     pESP->Socket[SocketId].TxDataLen -= pESP->Socket[SocketId].TxPacketLen;
+#ifdef ESP8266_SENDBUF_EN
+                    if(Buffered) { pESP->Socket[SocketId].TxSegmentsInFlight++; }
+#endif
                     //esp_debug_print("ESP: Rest of message: %u\n", pESP->Socket[SocketId].TxDataLen);
                     pESP->STEP = 4;
                     break;
@@ -1750,12 +2626,28 @@ U8 i;
            pESP->isCommandReceived(eAT::UNLINK))
         {
             esp_debug_print("ESP: Data Send Fail\n");
+            METRIC_ADD(MetricSendFail, 1);
             pESP->CloseSocket(SocketId);
             pESP->CurrentState = &pESP->smStandby;
         }
 
+#ifdef ESP8266_SENDBUF_EN
+        if(Buffered)
+        {
+            if(pESP->isCommandReceived(eAT::RECV_BYTES))    //  packet is taken by the module, "<id>,<segment>,SEND OK" is handled by RxHandler()
+            {
+                pESP->STEP = 0;     //  next packet of this or other socket without waiting for "SEND OK"
+            }
+            break;
+        }
+#endif
         if(pESP->isCommandReceived(eAT::SEND_OK))
         {
+            METRIC_ADD(MetricSendOK, 1);
+#ifdef ESP8266_TIMESTAMPS_EN
+            pESP->Socket[SocketId].Timestamps.LastSendOK = Timestamp_Get();
+            if(pESP->Socket[SocketId].Timestamps.FirstSendOK == 0) { pESP->Socket[SocketId].Timestamps.FirstSendOK = pESP->Socket[SocketId].Timestamps.LastSendOK; }
+#endif
             if(pESP->Socket[SocketId].TxDataLen)
             {
                 //esp_debug_print("ESP: (St4), data left: %u\n", pESP->Socket[SocketId].TxDataLen);
@@ -1801,7 +2693,7 @@ U8 i;
     case 6:
         if(pESP->StateTimer.Elapsed())
         {
-            pESP->STEP = 1; //  send next packet
+            pESP->STEP = 0; //  send next packet of this or other socket
         }
         break;
 
@@ -1814,6 +2706,7 @@ U8 i;
 void ESP::StateOpenSocket::Process(ESP* pESP)
 {
 char * str;
+char LinkId[5];
 U32 len;
 U8 i;
 
@@ -1827,7 +2720,7 @@ U8 i;
     switch(pESP->STEP)
     {
     case 0:
-        for(i=0; i<ESP8266_SOCKETS_MAX; i++)
+        for(i=0; i<pESP->SocketsNum; i++)
         {
             if(pESP->Socket[i].State == eSocketState::ConnectRequested)
             {
@@ -1853,23 +2746,34 @@ U8 i;
                     pESP->CurrentState = &pESP->smStandby;
                     return;
                 }
-                len += 40;
+                len += 48;     //  command with local port of UDP socket is the longest
                 str = (char*)malloc(len);
                 if(str)
                 {
-                    if(pESP->Socket[SocketId].Type == eSocketType::UDP)
+                    /* with multiple connections (AT+CIPMUX=1) link ID is the socket ID, single connection has no link ID */
+                    LinkId[0] = 0;
+                    if(pESP->Module.ConnectionTypeActual == eModuleConnectionType::Multiple)
+                    {
+                        snprintf(LinkId, sizeof(LinkId), "%u,", SocketId);
+                    }
+
+                    if(pESP->Socket[SocketId].Type == eSocketType::UDP && pESP->Socket[SocketId].LocalPort)     //  bound by BindSocket()
+                    {
+                        snprintf(str, len-1, "AT+CIPSTART=%s\"UDP\",\"%s\",%u,%u,2\r\n", LinkId, pESP->Socket[SocketId].Address, pESP->Socket[SocketId].Port, pESP->Socket[SocketId].LocalPort);
+                    }
+                    else if(pESP->Socket[SocketId].Type == eSocketType::UDP)
                     {
-                        snprintf(str, len-1, "AT+CIPSTART=\"UDP\",\"%s\",%u\r\n", pESP->Socket[SocketId].Address, pESP->Socket[SocketId].Port);
+                        snprintf(str, len-1, "AT+CIPSTART=%s\"UDP\",\"%s\",%u\r\n", LinkId, pESP->Socket[SocketId].Address, pESP->Socket[SocketId].Port);
                     }
                     else
                     {
-                        snprintf(str, len-1, "AT+CIPSTART=\"TCP\",\"%s\",%u\r\n", pESP->Socket[SocketId].Address, pESP->Socket[SocketId].Port);
+                        snprintf(str, len-1, "AT+CIPSTART=%s\"TCP\",\"%s\",%u\r\n", LinkId, pESP->Socket[SocketId].Address, pESP->Socket[SocketId].Port);
                     }
 
                     pESP->Socket[SocketId].ErrorFlag = eSocketErrorFlag::NoError;
                     if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)str, strlen(str)))
                     {
-                        pESP->StateTimer.Set(_200ms_);
+                        pESP->StateTimer.Set(_5sec_);   //  module replies when TCP connection is established (or failed)
                         pESP->StateTimer.Reset();
                         pESP->Socket[SocketId].State = eSocketState::Connecting;
                         pESP->STEP = 2;
@@ -1877,7 +2781,7 @@ U8 i;
                     else
                     {
                         pESP->Socket[SocketId].State = eSocketState::Closed;
-                        pESP->Socket[SocketId].Address[0] = 0;      //  empty name string
+                        pESP->Socket[SocketId].Address = 0;         //  address string belongs to application, it is not modified
                         pESP->Socket[SocketId].Port = 0;            //  empty port num
                         pESP->Socket[SocketId].ErrorFlag = eSocketErrorFlag::InternalError;
                         pESP->CurrentState = &pESP->smStandby;
@@ -1905,7 +2809,7 @@ U8 i;
         if(pESP->StateTimer.Elapsed())
         {
             pESP->Socket[SocketId].State = eSocketState::Closed;
-            pESP->Socket[SocketId].Address[0] = 0;      //  empty name string
+            pESP->Socket[SocketId].Address = 0;
             pESP->Socket[SocketId].Port = 0;            //  empty port
             pESP->Socket[SocketId].ErrorFlag = eSocketErrorFlag::Timeout;
             pESP->STEP = 0;
@@ -1918,7 +2822,7 @@ U8 i;
         }
         else if(pESP->isCommandReceived(eAT::NOIP))
         {
-            for(i=0; i<ESP8266_SOCKETS_MAX; i++)
+            for(i=0; i<pESP->SocketsNum; i++)
             {
                 pESP->Socket[SocketId].State = eSocketState::Closed;
                 pESP->Socket[SocketId].ErrorFlag = eSocketErrorFlag::NoAccessPoint;
@@ -1940,94 +2844,44 @@ U8 i;
     }
 }
 
-void ESP::StateCloseSocket::Process(ESP* pESP)
+void ESP::StateStartServer::Process(ESP* pESP)
 {
-uint8_t i;
+uint16_t len;
 
     if(pESP->StateMachineStateChanged())
     {
-      pESP->STEP = 0;
-      pESP->ClearLastCommand();
-      //esp_debug_print("ESP8266: Close Socket\n");
+        pESP->STEP = (pESP->ServerConnections < ESP8266_SOCKETS_MAX) ? 10 : 0;    //  limit incoming connections first
+        pESP->Server.State = eServerState::Connecting;
+        pESP->ClearLastCommand();
+        esp_debug_print("ESP8266: Start Server\n");
     }
 
     switch(pESP->STEP)
     {
-    case 0:
-        for(i=0; i<ESP8266_SOCKETS_MAX; i++)
-        {
-            if(pESP->Socket[i].State == eSocketState::CloseRequested)
-            {
-                SocketId = i;
-                esp_debug_print("ESP8266: Close Socket %d\n", i);
-                pESP->STEP = 1;
-                return;
-            }
-        }
-        pESP->CurrentState = &pESP->smStandby;
-        break;
-
-    case 1:
-        if(pESP->Socket[SocketId].State == eSocketState::CloseRequested)
-        {
-            sprintf(pESP->IO.pCommandString, "AT+CIPCLOSE=%u\r\n", SocketId);
-            if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, pESP->IO.pCommandString, strlen(pESP->IO.pCommandString)))
-            {
-                pESP->StateTimer.Set(_100ms_);
-                pESP->StateTimer.Reset();
-                pESP->Socket[SocketId].State = eSocketState::Closing;
-                pESP->STEP = 2;
-            }
-            else
-            {
-                pESP->CurrentState = &pESP->smModuleReset;
-            }
-        }
-        // TODO: else?
-        pESP->Socket[SocketId].TxState = eSocketSendDataStatus::Idle;
-        break;
+    case 10:
+        len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPSERVERMAXCONN=%u\r\n", pESP->ServerConnections);
 
-    case 2:
-        if(pESP->StateTimer.Elapsed())
+        if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, pESP->IO.pCommandString, len))
         {
-            pESP->Socket[SocketId].State = eSocketState::Error;
-            pESP->CurrentState = &pESP->smStandby;
+            pESP->StateTimer.Set(_1sec_);
+            pESP->StateTimer.Reset();
+            pESP->STEP = 11;
         }
-
-        if(pESP->isCommandReceived(eAT::OK))
+        else
         {
-            pESP->Socket[SocketId].State = eSocketState::Closed;
-            pESP->CurrentState = &pESP->smStandby;
+            pESP->CurrentState = &pESP->smModuleReset;
+            esp_debug_print("ESP: Cmd send Fail,%d\n", __LINE__);
         }
+        break;
 
-        if(pESP->isCommandReceived(eAT::AT_ERROR))  //  according to documentation, modem returns ERROR if there is no connection
+    case 11:    //  old firmware may not support the command, server is started anyway
+        if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
         {
-            pESP->Socket[SocketId].State = eSocketState::Closed;
-            pESP->CurrentState = &pESP->smStandby;
+            pESP->ClearLastCommand();
+            pESP->STEP = 0;
         }
-
-        break;
-
-    default:
-        pESP->STEP = 0;
         break;
-    }
-}
-
-void ESP::StateStartServer::Process(ESP* pESP)
-{
-uint16_t len;
 
-    if(pESP->StateMachineStateChanged())
-    {
-        pESP->STEP = 0;
-        pESP->Server.State = eServerState::Connecting;
-        pESP->ClearLastCommand();
-        esp_debug_print("ESP8266: Start Server\n");
-    }
-
-    switch(pESP->STEP)
-    {
     case 0:
         len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPSERVER=1,%u\r\n", pESP->Server.Port);
 
@@ -2055,16 +2909,18 @@ uint16_t len;
 
         if(pESP->isCommandReceived(eAT::OK))
         {
-            //pESP->WiFi_State = WiFi_GetConnectionsInfo;   // TODO now need to get status from the device
             pESP->Server.State = eServerState::Connected;
             pESP->Server.StartRequest = false;
             esp_debug_print("ESP8266: Server Started\n");
-            pESP->CurrentState = &pESP->smGetApIP;
+            pESP->QueueCommand((const char*)AT_CIFSR, sizeof(AT_CIFSR)-1, eAT::OK, eAT::AT_ERROR, _200ms_, GetApIPCallback, 0);
+            len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPSTO=%u\r\n", ESP8266_SERVER_TIMEOUT);
+            pESP->QueueCommand(pESP->IO.pCommandString, len, eAT::OK, eAT::AT_ERROR, _200ms_, 0, 0);     //  idle connections are closed by the module
+            pESP->ConnectionsInfoTimer.Reset();
+            pESP->CurrentState = &pESP->smStandby;
         }
 
         if(pESP->isCommandReceived(eAT::NOCHANGE))
         {
-            //pESP->WiFi_State = WiFi_GetConnectionsInfo;   // TODO now need to get status from the device
             pESP->Server.State = eServerState::Connected;
             esp_debug_print("ESP8266: Server Started\n");
             pESP->StateTimer.Set(_100ms_);
@@ -2085,7 +2941,11 @@ uint16_t len;
         if(pESP->isCommandReceived(eAT::OK) || pESP->StateTimer.Elapsed())
         {
             pESP->Server.StartRequest = false;
-            pESP->CurrentState = &pESP->smGetApIP;
+            pESP->QueueCommand((const char*)AT_CIFSR, sizeof(AT_CIFSR)-1, eAT::OK, eAT::AT_ERROR, _200ms_, GetApIPCallback, 0);
+            len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPSTO=%u\r\n", ESP8266_SERVER_TIMEOUT);
+            pESP->QueueCommand(pESP->IO.pCommandString, len, eAT::OK, eAT::AT_ERROR, _200ms_, 0, 0);
+            pESP->ConnectionsInfoTimer.Reset();
+            pESP->CurrentState = &pESP->smStandby;
         }
         break;
 
@@ -2095,146 +2955,403 @@ uint16_t len;
     }
 }
 
-void ESP::StateGetApIP::Process(ESP* pESP)
+/*************************************************************************************************
+ * COMMAND QUEUE
+ *
+ * Sends queued commands one by one: the next one is sent in the same pass in which the previous
+ * one is completed. STEP 0: command is to be sent, 1: waiting for responses
+ *************************************************************************************************/
+void ESP::StateCommandQueue::Process(ESP* pESP)
 {
+io::at_command* pCommand;
+at_callback Callback;
+uint8_t Tag;
+eAT Response;
+bool Last;
+
     if(pESP->StateMachineStateChanged())
     {
-      pESP->STEP = 0;
-      pESP->ClearLastCommand();
-      esp_debug_print("ESP8266: Get Ap IP\n");
+        pESP->STEP = 0;
+        pESP->ClearLastCommand();
+        esp_debug_print("ESP8266: Command Queue\n");
     }
 
-    switch(pESP->STEP)
+    while(pESP->IO.CommandRead != pESP->IO.CommandWrite)
     {
-    case 0:
-        if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)AT_CIFSR, sizeof(AT_CIFSR)-1))
+        pCommand = &pESP->IO.Command[pESP->IO.CommandRead % ESP8266_COMMAND_QUEUE_LEN];
+
+        if(pESP->STEP == 0)
         {
-            pESP->StateTimer.Set(_200ms_);
+            if(SUCCESS != ESP_HuartSend(pESP->HuartNumber, pCommand->Cmd, pCommand->Len))
+            {
+                pESP->CurrentState = &pESP->smModuleReset;
+                esp_debug_print("ESP: Cmd send Fail,%d\n", __LINE__);
+                return;
+            }
+            pESP->StateTimer.Set(pCommand->Timeout);
             pESP->StateTimer.Reset();
             pESP->STEP = 1;
+            return;     //  responses are parsed after this pass
         }
-        else
-        {
-            pESP->CurrentState = &pESP->smModuleReset;
-        }
-        break;
 
-    case 1:
-        if(pESP->isCommandReceived(eAT::CIFSR_APIP))
+        Response = pESP->TakeResponse();
+        if(Response == eAT::NO_COMMAND_RECEIVED)
         {
-            pESP->LocalAP.IP = (((uint32_t)pESP->IO.pReceivedParameter[3])                  |
-                                ((uint32_t)pESP->IO.pReceivedParameter[2] << 8  & 0xFF00)   |
-                                ((uint32_t)pESP->IO.pReceivedParameter[1] << 16 & 0xFF0000) |
-                                ((uint32_t)pESP->IO.pReceivedParameter[0] << 24 & 0xFF000000));
-
-            esp_debug_print("ESP8266: AP IP[hex]:%x\n", (unsigned int)pESP->LocalAP.IP);
+            if(pESP->StateTimer.Elapsed() == false) { return; }
+            esp_debug_print("ESP8266: Command Timeout: %.*s", (int)pCommand->Len, pCommand->Cmd);
+            Last = true;
         }
-
-        if(pESP->isCommandReceived(eAT::CIFSR_APMAC))
+        else
         {
-            pESP->LocalAP.MAC = ( (uint64_t)pESP->IO.pReceivedParameter[5] & 0xFF) |
-                                  (((uint64_t)pESP->IO.pReceivedParameter[4] << 8) & 0xFF00)   |
-                                  (((uint64_t)pESP->IO.pReceivedParameter[3] << 16) & 0xFF0000) |
-                                  (((uint64_t)pESP->IO.pReceivedParameter[2] << 24) & 0xFF000000) |
-                                  (((uint64_t)pESP->IO.pReceivedParameter[1] << 32) & 0xFF00000000) |
-                                  (((uint64_t)pESP->IO.pReceivedParameter[0] << 40) & 0xFF0000000000);
-
-            esp_debug_print("ESP8266: AP MAC:%x%x\n", (unsigned int)(pESP->LocalAP.MAC >> 32) , (unsigned int)pESP->LocalAP.MAC);
-
-            pESP->STEP = 2; //  wait for OK
+            Last = (Response == pCommand->Done || Response == pCommand->Done2);
         }
-        break;
 
-    case 2:
-        if(pESP->isCommandReceived(eAT::OK) || pESP->StateTimer.Elapsed())
+        Callback = pCommand->Callback;
+        Tag = pCommand->Tag;
+
+        if(Last)
         {
-            pESP->CurrentState = &pESP->smStandby;
+            pESP->IO.CommandRead++;     //  removed before callback, so callback can queue the next command
+            pESP->STEP = 0;
         }
-        break;
 
-    default:
-        pESP->STEP = 0;
-        break;
+        if(Callback) { Callback(pESP, Tag, Response, Last); }
+
+        if(pESP->CurrentState != this) { return; }  //  callback has started other state (e.g. module reset)
     }
 
+    pESP->CurrentState = &pESP->smStandby;
 }
 
-void ESP::StateChangeAPIP::Process(ESP* pESP)
+void ESP::CloseSocketCallback(ESP *pESP, uint8_t SocketId, eAT Response, bool Last)
 {
-int len;
+    if(Last == false) { return; }   //  "<id>,CLOSED" is handled by RxHandler()
 
-    if(pESP->StateMachineStateChanged())
+    if(Response == eAT::NO_COMMAND_RECEIVED)
     {
-      pESP->STEP = 0;
-      pESP->ClearLastCommand();
-      esp_debug_print("ESP8266: Set AP IP\n");
+        pESP->Socket[SocketId].State = eSocketState::Error;
+        pESP->ConnectionsInfoRequest = true;    //  closed if the module has no such connection
+    }
+    else    //  OK, or ERROR if there is no connection according to documentation
+    {
+        pESP->Socket[SocketId].State = eSocketState::Closed;
     }
+}
 
-    switch(pESP->STEP)
+void ESP::GetApIPCallback(ESP *pESP, uint8_t, eAT Response, bool)
+{
+    if(Response == eAT::CIFSR_APIP)
     {
-    case 0:
-        len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPAP_CUR=\"%u.%u.%u.%u\",\"%u.%u.%u.%u\",\"%u.%u.%u.%u\"\r\n",
-                                                                                (unsigned int)((pESP->LocalAP.NewIP >> 24) & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewIP >> 16) & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewIP >> 8)  & 0xFF),
-                                                                                (unsigned int)( pESP->LocalAP.NewIP        & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewGateway >> 24) & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewGateway >> 16) & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewGateway >> 8)  & 0xFF),
-                                                                                (unsigned int)( pESP->LocalAP.NewGateway        & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewNetMask >> 24) & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewNetMask >> 16) & 0xFF),
-                                                                                (unsigned int)((pESP->LocalAP.NewNetMask >> 8)  & 0xFF),
-                                                                                (unsigned int)( pESP->LocalAP.NewNetMask        & 0xFF) );
-        //esp_debug_print("ESP8266: CH.IP.Str:%s\n", pESP->IO.pCommandString);
-        //pESP->DebugFlag_RxStreamToStdOut = true;
+        pESP->LocalAP.IP = (((uint32_t)pESP->IO.pReceivedParameter[3])                  |
+                            ((uint32_t)pESP->IO.pReceivedParameter[2] << 8  & 0xFF00)   |
+                            ((uint32_t)pESP->IO.pReceivedParameter[1] << 16 & 0xFF0000) |
+                            ((uint32_t)pESP->IO.pReceivedParameter[0] << 24 & 0xFF000000));
 
-        if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, pESP->IO.pCommandString, len))
-        {
-            pESP->StateTimer.Set(_5sec_);
-            pESP->StateTimer.Reset();
-            pESP->STEP = 1;
-        }
-        else
+        esp_debug_print("ESP8266: AP IP[hex]:%x\n", (unsigned int)pESP->LocalAP.IP);
+    }
+
+    if(Response == eAT::CIFSR_APMAC)
+    {
+        pESP->LocalAP.MAC = ( (uint64_t)pESP->IO.pReceivedParameter[5] & 0xFF) |
+                              (((uint64_t)pESP->IO.pReceivedParameter[4] << 8) & 0xFF00)   |
+                              (((uint64_t)pESP->IO.pReceivedParameter[3] << 16) & 0xFF0000) |
+                              (((uint64_t)pESP->IO.pReceivedParameter[2] << 24) & 0xFF000000) |
+                              (((uint64_t)pESP->IO.pReceivedParameter[1] << 32) & 0xFF00000000) |
+                              (((uint64_t)pESP->IO.pReceivedParameter[0] << 40) & 0xFF0000000000);
+
+        esp_debug_print("ESP8266: AP MAC:%x%x\n", (unsigned int)(pESP->LocalAP.MAC >> 32) , (unsigned int)pESP->LocalAP.MAC);
+    }
+}
+
+void ESP::ChangeAPIPCallback(ESP *pESP, uint8_t, eAT Response, bool Last)
+{
+    if(Last == false) { return; }
+
+    if(Response == eAT::OK)
+    {
+        esp_debug_print("ESP8266: New IP set successfully\n");
+        pESP->LocalAP.IP      = pESP->LocalAP.NewIP;
+        pESP->LocalAP.Gateway = pESP->LocalAP.NewGateway;
+        pESP->LocalAP.NetMask = pESP->LocalAP.NewNetMask;
+    }
+    else
+    {
+        pESP->LocalAP.IP   = 0;
+        pESP->LocalAP.Gateway = 0;
+        pESP->LocalAP.NetMask = 0;
+        esp_debug_print("ESP8266: New IP set failed\n");
+        // TODO: report about error here
+    }
+    pESP->LocalAP.ChangeIPRequest = false;
+}
+
+#ifdef ESP8266_SENDBUF_EN
+void ESP::SendBufTestCallback(ESP *pESP, uint8_t, eAT Response, bool Last)
+{
+    if(Last == false) { return; }
+
+    pESP->Module.SendBufSupported = (Response == eAT::OK);     //  old firmware answers "ERROR", then AT+CIPSEND is used
+    esp_debug_print("ESP8266: AT+CIPSENDBUF %s\n", pESP->Module.SendBufSupported ? "supported" : "not supported");
+}
+#endif
+
+#ifdef ESP8266_PASSIVE_RX_EN
+void ESP::PassiveRxCallback(ESP *pESP, uint8_t, eAT Response, bool Last)
+{
+    if(Last == false) { return; }
+
+    pESP->Module.PassiveRx = (Response == eAT::OK);    //  old firmware answers "ERROR", then data come with "+IPD" at once
+    esp_debug_print("ESP8266: passive receive mode %s\n", pESP->Module.PassiveRx ? "on" : "not supported");
+}
+
+void ESP::RecvDataCallback(ESP *pESP, uint8_t SocketId, eAT Response, bool Last)
+{
+    if(Last == false) { return; }   //  data are received by RxHandler()
+
+    pESP->Socket[SocketId].RxRequested = 0;
+    if(Response != eAT::OK)         //  connection is closed meanwhile or reply is lost, amount of waiting data is queried again
+    {
+        pESP->Module.RxLenQuery = true;
+    }
+}
+#endif
+
+#ifdef ESP8266_PASSTHROUGH_EN
+/*************************************************************************************************
+ * TRANSPARENT TRANSMISSION
+ *
+ * Module allows AT+CIPMODE=1 in single connection mode only, so connections and server are closed
+ * and AT+CIPMUX=0 is set first. After "AT+CIPSEND" and ">" everything received from UART is data
+ * of the remote side until "+++" is sent as separate packet. Connection type and server are
+ * restored through Standby (StateChangeConnectionType, StateStartServer)
+ *
+ *************************************************************************************************/
+void ESP::StatePassthrough::SendCommand(ESP* pESP, const char *pCmd, size_t Len, unsigned long Timeout)
+{
+    if(SUCCESS == ESP_HuartSend(pESP->HuartNumber, (char*)pCmd, Len))
+    {
+        pESP->StateTimer.Set(Timeout);
+        pESP->StateTimer.Reset();
+        pESP->STEP++;
+    }
+    else
+    {
+        pESP->CurrentState = &pESP->smModuleReset;
+        esp_debug_print("ESP: Cmd send Fail,%d\n", __LINE__);
+    }
+}
+
+void ESP::StatePassthrough::Process(ESP* pESP)
+{
+uint16_t len;
+uint8_t ch;
+
+    if(pESP->StateMachineStateChanged())
+    {
+        pESP->STEP = 0;
+        pESP->ClearLastCommand();
+        esp_debug_print("ESP8266: Transparent transmission\n");
+    }
+
+    switch(pESP->STEP)
+    {
+    case 0:
+        pESP->Passthrough.ConnectionType = pESP->Module.ConnectionTypeActual;
+        pESP->Passthrough.ServerStarted = (pESP->Server.State == eServerState::Connected);
+        if(pESP->Module.ConnectionTypeActual != eModuleConnectionType::Multiple)
         {
-            pESP->CurrentState = &pESP->smModuleReset;
-            esp_debug_print("ESP: Cmd send Fail,%d\n", __LINE__);
+            pESP->STEP = 4;
+            break;
+        }
+        SendCommand(pESP, (const char*)AT_CIPCLOSE_ALL, sizeof(AT_CIPCLOSE_ALL)-1, _1sec_);    //  "<id>,CLOSED" are handled by RxHandler()
+        break;
+
+    case 1:     //  "ERROR" if there are no connections
+        if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            pESP->STEP = 2;
         }
+        break;
 
+    case 2:
+        SendCommand(pESP, (const char*)AT_CIPSERVER_STOP, sizeof(AT_CIPSERVER_STOP)-1, _1sec_);
         break;
 
-    case 1:
+    case 3:
+        if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            if(pESP->Server.State == eServerState::Connected) { pESP->Server.State = eServerState::Disconnected; }
+            pESP->STEP = 4;
+        }
+        break;
+
+    case 4:
+        if(pESP->Module.ConnectionTypeActual == eModuleConnectionType::Single)
+        {
+            pESP->STEP = 6;
+            break;
+        }
+        SendCommand(pESP, (const char*)AT_CIPMUX_SINGLE, sizeof(AT_CIPMUX_SINGLE)-1, _200ms_);
+        break;
+
+    case 5:
         if(pESP->isCommandReceived(eAT::OK))
         {
-            esp_debug_print("ESP8266: New IP set successfully\n");
-            pESP->LocalAP.IP      = pESP->LocalAP.NewIP;
-            pESP->LocalAP.Gateway = pESP->LocalAP.NewGateway;
-            pESP->LocalAP.NetMask = pESP->LocalAP.NewNetMask;
-            pESP->LocalAP.ChangeIPRequest = false;
-            pESP->CurrentState = &pESP->smStandby;
+            pESP->Module.ConnectionTypeActual = eModuleConnectionType::Single;
+            pESP->Module.ConnectionTypeRequest = eModuleConnectionType::Single;
+#ifdef ESP8266_PASSIVE_RX_EN
+            pESP->Module.PassiveRx = false;     //  set again when multiple connection mode is restored
+#endif
+            pESP->STEP = 6;
+        }
+        else if(pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            pESP->Passthrough.Error = true;
+            pESP->STEP = 19;
+        }
+        break;
+
+    case 6:
+        len = snprintf(pESP->IO.pCommandString, pESP->IO.CommandStringSize-1, "AT+CIPSTART=\"%s\",\"%u.%u.%u.%u\",%u\r\n",
+                       (pESP->Passthrough.Type == eSocketType::TCP) ? "TCP" : "UDP",
+                       (unsigned int)(pESP->Passthrough.RemoteIP >> 24), (unsigned int)(pESP->Passthrough.RemoteIP >> 16) & 0xFF,
+                       (unsigned int)(pESP->Passthrough.RemoteIP >> 8) & 0xFF, (unsigned int)pESP->Passthrough.RemoteIP & 0xFF, pESP->Passthrough.RemotePort);
+        SendCommand(pESP, pESP->IO.pCommandString, len, _5sec_);   //  module replies when TCP connection is established (or failed)
+        break;
+
+    case 7:
+        if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::ALREADY_CONNECT))
+        {
+            pESP->STEP = 8;
+        }
+        else if(pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            esp_debug_print("ESP8266: Transparent transmission, connection failed\n");
+            pESP->Passthrough.Error = true;
+            pESP->STEP = 19;
+        }
+        break;
+
+    case 8:
+        SendCommand(pESP, (const char*)AT_CIPMODE_TRANSPARENT, sizeof(AT_CIPMODE_TRANSPARENT)-1, _200ms_);
+        break;
+
+    case 9:
+        if(pESP->isCommandReceived(eAT::OK))
+        {
+            pESP->STEP = 10;
         }
+        else if(pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            pESP->Passthrough.Error = true;
+            pESP->STEP = 16;
+        }
+        break;
+
+    case 10:
+        pESP->IO.Passthrough = true;    //  reply is taken below, data of the remote side can follow ">" immediately
+        SendCommand(pESP, (const char*)AT_CIPSEND_TRANSPARENT, sizeof(AT_CIPSEND_TRANSPARENT)-1, _1sec_);
+        break;
 
+    case 11:    //  "OK" and ">" (without space in transparent mode)
+        while(SUCCESS == ESP_GetChar(pESP->HuartNumber, &ch))
+        {
+            if(ch == '>')
+            {
+                pESP->Passthrough.State = ePassthroughState::Active;
+                pESP->STEP = 12;
+                esp_debug_print("ESP8266: Transparent transmission started\n");
+                return;
+            }
+        }
         if(pESP->StateTimer.Elapsed())
         {
-            pESP->LocalAP.IP   = 0;
-            pESP->LocalAP.Gateway = 0;
-            pESP->LocalAP.NetMask = 0;
-            pESP->LocalAP.ChangeIPRequest = false;
-            esp_debug_print("ESP8266: New IP set Timeout!\n");
-            // TODO: report about error here
-            pESP->CurrentState = &pESP->smStandby;
+            pESP->Passthrough.Error = true;
+            pESP->STEP = 15;
         }
         break;
 
+    case 12:
+        if(pESP->Passthrough.StopRequest)
+        {
+            pESP->Passthrough.State = ePassthroughState::Leaving;
+            pESP->STEP = 13;
+        }
+        break;
+
+    case 13:    //  written data are sent out, then no data for guard time
+        if(ESP_TransmitBufferSpaceLeft(pESP->HuartNumber) >= pESP->UartTxSize)
+        {
+            pESP->StateTimer.Set(_50ms_);
+            pESP->StateTimer.Reset();
+            pESP->STEP = 14;
+        }
+        break;
+
+    case 14:
+        if(pESP->StateTimer.Elapsed())
+        {
+            SendCommand(pESP, (const char*)TRANSPARENT_EXIT, sizeof(TRANSPARENT_EXIT)-1, _1sec_);
+        }
+        break;
+
+    case 15:
+        if(pESP->StateTimer.Elapsed())  //  module takes next command not earlier than 1s after "+++"
+        {
+            pESP->IO.Passthrough = false;
+            pESP->IO.DoEmptyRxStream = true;    //  data not taken by application are dropped
+            pESP->STEP = 16;
+        }
+        break;
+
+    case 16:
+        SendCommand(pESP, (const char*)AT_CIPMODE_NORMAL, sizeof(AT_CIPMODE_NORMAL)-1, _500ms_);
+        break;
+
+    case 17:
+        if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            SendCommand(pESP, (const char*)AT_CIPCLOSE_SINGLE, sizeof(AT_CIPCLOSE_SINGLE)-1, _1sec_);
+        }
+        break;
+
+    case 18:    //  "ERROR" if connection is closed by remote side already
+        if(pESP->isCommandReceived(eAT::OK) || pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            pESP->STEP = 19;
+        }
+        break;
+
+    case 19:    //  connection type and server are restored by Standby
+        if(pESP->Passthrough.ConnectionType != eModuleConnectionType::Undefined) { pESP->Module.ConnectionTypeRequest = pESP->Passthrough.ConnectionType; }
+        if(pESP->Passthrough.ServerStarted) { pESP->Server.StartRequest = true; }
+        pESP->Passthrough.StopRequest = false;
+        pESP->Passthrough.State = pESP->Passthrough.Error ? ePassthroughState::Failed : ePassthroughState::Idle;
+        esp_debug_print("ESP8266: Transparent transmission finished\n");
+        pESP->CurrentState = &pESP->smStandby;
+        break;
+
     default:
         pESP->STEP = 0;
         break;
     }
-
 }
+#endif
 
+/*************************************************************************************************
+ * CONNECTIONS INFO
+ *
+ * "<id>,CONNECT" and "<id>,CLOSED" can be lost (e.g. flushed with UART overflow), then socket stays
+ * Connected for nothing or connection of the module is unknown. Connections listed by AT+CIPSTATUS
+ * are compared with sockets, sockets which had "<id>,CONNECT" or "<id>,CLOSED" since the command
+ * was sent are not changed, their state is newer than the list
+ *
+ *************************************************************************************************/
 void ESP::StateGetConnectionsInfo::Process(ESP* pESP)
 {
+uint8_t i, id;
+socket *pS;
+
     if(pESP->StateMachineStateChanged())
     {
       pESP->STEP = 0;
@@ -2245,7 +3362,72 @@ void ESP::StateGetConnectionsInfo::Process(ESP* pESP)
     switch(pESP->STEP)
     {
     case 0:
-        //TODO: AT+CIPSTATUS
+        if(SUCCESS != ESP_HuartSend(pESP->HuartNumber, (char*)AT_CIPSTATUS, sizeof(AT_CIPSTATUS)-1))
+        {
+            pESP->CurrentState = &pESP->smModuleReset;
+            esp_debug_print("ESP: Cmd send Fail,%d\n", __LINE__);
+            break;
+        }
+
+        for(i = 0; i < pESP->SocketsNum; i++) { pESP->Socket[i].LinkEventsSeen = pESP->Socket[i].LinkEvents; }
+        pESP->ConnectionsInfoLinks = 0;
+        pESP->ConnectionsInfoServerLinks = 0;
+        pESP->ConnectionsInfoRequest = false;
+        pESP->StateTimer.Set(_500ms_);
+        pESP->StateTimer.Reset();
+        pESP->STEP = 1;
+        break;
+
+    case 1:
+        pESP->isCommandReceived(eAT::STATUS);
+
+        while(pESP->isCommandReceived(eAT::CIPSTATUS))     //  "+CIPSTATUS:<id>,<type>,<remote IP>,<remote port>,<local port>,<tetype>"
+        {
+            id = pESP->IO.pReceivedParameter[0];
+            if(id >= pESP->SocketsNum) { continue; }
+            pESP->ConnectionsInfoLinks |= (1 << id);
+            if(pESP->IO.pReceivedParameter[4] == 1) { pESP->ConnectionsInfoServerLinks |= (1 << id); }
+        }
+
+        if(pESP->isCommandReceived(eAT::OK))
+        {
+            for(i = 0; i < pESP->SocketsNum; i++)
+            {
+                pS = &pESP->Socket[i];
+                if(pS->LinkEvents != pS->LinkEventsSeen) { continue; }
+
+                if(pESP->ConnectionsInfoLinks & (1 << i))
+                {
+                    if(pS->State != eSocketState::Closed) { continue; }
+
+                    if(pESP->ConnectionsInfoServerLinks & (1 << i))     //  accepted by the server, taken as if "<id>,CONNECT" came
+                    {
+                        esp_debug_print("ESP8266: Socket %u connection was not reported\n", i);
+                        pESP->SocketConnected(i);
+                    }
+                    else    //  connection of the client which is not used any more
+                    {
+                        pS->State = eSocketState::CloseRequested;
+                    }
+                }
+                else if(pS->State == eSocketState::Connected     ||
+                        pS->State == eSocketState::CloseRequested ||
+                        pS->State == eSocketState::Closing       ||
+                        pS->State == eSocketState::Error)
+                {
+                    esp_debug_print("ESP8266: Socket %u closing was not reported\n", i);
+                    pESP->SocketClosed(i);
+                }
+            }
+
+            pESP->ConnectionsInfoTimer.Reset();
+            pESP->CurrentState = &pESP->smStandby;
+        }
+        else if(pESP->isCommandReceived(eAT::AT_ERROR) || pESP->StateTimer.Elapsed())
+        {
+            pESP->ConnectionsInfoTimer.Reset();
+            pESP->CurrentState = &pESP->smStandby;
+        }
         break;
 
     default:
@@ -2294,12 +3476,104 @@ void ESP::StateGetConnectionsInfo::Process(ESP* pESP)
  *********************************************************************************************************************************************************************
  *********************************************************************************************************************************************************************/
 
+#ifdef ESP8266_RX_RING_EN
+void ESP::RxToRing(void)
+{
+socket *pS = &Socket[IO.RxSocketId];
+size_t len;
+uint16_t Write;
+
+    while(IO.CurrentSocketDataLeft)
+    {
+        if(pS->RxDataLen >= pS->RxBuffSize)     //  ring is full
+        {
+            IO.RxIgnoreCounter = IO.CurrentSocketDataLeft;
+            IO.CurrentSocketDataLeft = 0;
+            IO.ReceivingDataStream = false;
+            pS->RxDropped += IO.RxIgnoreCounter;
+            METRIC_ADD(MetricRxDroppedBytes, IO.RxIgnoreCounter);
+            esp_debug_print("ESP: Socket %u ring is full, %lu bytes dropped\n", IO.RxSocketId, (unsigned long)IO.RxIgnoreCounter);
+            if(pS->RxPolicy == eRxFullPolicy::Close && pS->State == eSocketState::Connected)
+            {
+                pS->State = eSocketState::CloseRequested;    //  closed by Standby, data in the ring can still be read
+            }
+            return;
+        }
+
+        //  contiguous free space from write position, up to the end of the ring or up to read position
+        Write = (uint16_t)(((uint32_t)pS->RxRead + pS->RxDataLen) % pS->RxBuffSize);
+        len = (Write >= pS->RxRead) ? pS->RxBuffSize - Write : pS->RxRead - Write;
+        if(len > IO.CurrentSocketDataLeft) { len = IO.CurrentSocketDataLeft; }
+
+        len = ESP_GetData(HuartNumber, &pS->DataRx[Write], len);
+        if(len == 0) { return; }
+
+        if(DebugFlag_RxStreamToStdOut)      //  copy all data from ESP to std out
+        {
+            for(size_t i=0; i < len; i++) { esp_debug_print("%c", pS->DataRx[Write + i]); }
+        }
+
+        IO.CurrentSocketDataLeft -= (uint16_t)len;
+        pS->RxDataLen += (uint16_t)len;
+    }
+
+    IO.ReceivingDataStream = false;
+}
+#endif
+
+void ESP::SocketConnected(uint8_t SocketID)
+{
+socket *pS = &Socket[SocketID];
+
+    if(pS->State == eSocketState::Closed)   //  accepted by the server
+    {
+        pS->Type = eSocketType::TCP;
+        pS->TxClass = eTxClass::Normal;
+    }
+    pS->State = eSocketState::Connected;
+    pS->LinkEvents++;
+#ifdef ESP8266_PASSIVE_RX_EN
+    pS->RxPending = 0;
+#endif
+    esp_debug_print("ESP: Socket %u Opened\n", SocketID);
+#ifdef ESP8266_TIMESTAMPS_EN
+    memset(&pS->Timestamps, 0, sizeof(socket_timestamps));    //  new connection, time stamps of the previous one are cleared
+    pS->Timestamps.Connected = Timestamp_Get();
+#endif
+}
+
+void ESP::SocketClosed(uint8_t SocketID)
+{
+socket *pS = &Socket[SocketID];
+
+    pS->State = eSocketState::Closed;
+    pS->LinkEvents++;
+#ifdef ESP8266_PASSIVE_RX_EN
+    pS->RxPending = 0;     //  data not taken are dropped by the module
+#endif
+    esp_debug_print("ESP8266: Socket %u Closed\n", SocketID);
+#ifdef ESP8266_SENDBUF_EN
+    if(pS->TxSegmentsInFlight)    //  packets in the buffer of the module are lost
+    {
+        pS->TxSegmentsInFlight = 0;
+        pS->TxDataLen = 0;
+        pS->TxLock = false;
+        pS->TxState = eSocketSendDataStatus::SendFail;
+    }
+#endif
+#ifdef ESP8266_TIMESTAMPS_EN
+    pS->Timestamps.Closed = Timestamp_Get();
+#endif
+}
+
 void ESP::RxHandler(void)
 {
-uint8_t tmpU8, res;
+uint8_t tmpU8, i, n;
 unsigned int data_len, id;
-char str[6];
-U8 NoMatchFound = 0;
+size_t len;
+eAT Token;
+
+  if(IO.Passthrough) { return; }    //  raw data of transparent transmission stay in HUART buffer for PassthroughRecv()
 
   //circular_buffer* cb_Rx;
 
@@ -2314,23 +3588,34 @@ U8 NoMatchFound = 0;
   {
       while(SUCCESS == ESP_GetChar(HuartNumber, &tmpU8)){}
       IO.DoEmptyRxStream = false;
-      IO.RxBuffCounter = 0;
+      IO.Lexer.Reset();
       IO.ReceiveError = false;
+      ConnectionsInfoRequest = true;     //  "<id>,CONNECT" or "<id>,CLOSED" could be flushed
+#ifdef ESP8266_PASSIVE_RX_EN
+      if(Module.PassiveRx) { Module.RxLenQuery = true; }    //  "+IPD,<id>,<len>" notifications could be flushed
+#endif
   }
 
   if(IO.RxIgnoreCounter)           // Ignore too long messages or data echo
   {
-    while(SUCCESS == ESP_GetChar(HuartNumber, &tmpU8))
+    while(IO.RxIgnoreCounter)
     {
-       if(DebugFlag_RxStreamToStdOut) { esp_debug_print("!%c", tmpU8); }     //  copy all data from ESP to std out
-
-       IO.RxIgnoreCounter--;
-       if(0 == IO.RxIgnoreCounter)
+       if(DebugFlag_RxStreamToStdOut)      //  copy all data from ESP to std out
+       {
+          if(SUCCESS != ESP_GetChar(HuartNumber, &tmpU8)) { break; }
+          esp_debug_print("!%c", tmpU8);
+          len = 1;
+       }
+       else
        {
-          if(IO.ListenToTxData) { IO.ListenToTxData = 0; }
-          return;
+          len = ESP_SkipData(HuartNumber, IO.RxIgnoreCounter);     //  whole received part at once
+          if(len == 0) { break; }
        }
+
+       IO.RxIgnoreCounter -= len;
     }
+
+    if(0 == IO.RxIgnoreCounter && IO.ListenToTxData) { IO.ListenToTxData = 0; }
     return;
   }
 
@@ -2341,18 +3626,55 @@ U8 NoMatchFound = 0;
          IO.RxOverflowEvent = 0;
          if(IO.CurrentSocketDataLeft > ESP_NumOfDataReceived(HuartNumber))     // grab only what is currently stored in buffer
          {
+#ifdef ESP8266_RX_RING_EN
+             Socket[IO.RxSocketId].RxDropped += IO.CurrentSocketDataLeft - ESP_NumOfDataReceived(HuartNumber);
+#endif
              IO.CurrentSocketDataLeft = ESP_NumOfDataReceived(HuartNumber);
              Socket[IO.RxSocketId].DataCutFlag = true;
+             METRIC_ADD(MetricIPDCutFrames, 1);
          }
      }
 
-     while(SUCCESS == ESP_GetChar(HuartNumber, IO.pCurrentSocketData))
+#ifdef ESP8266_RX_RING_EN
+     if(Socket[IO.RxSocketId].RxRing)
+     {
+         RxToRing();
+         return;
+     }
+#endif
+
+     if(Socket[IO.RxSocketId].RxLock)    //  stream mode: paused until application provides next buffer
+     {
+         if(ESP_NumOfDataReceived(HuartNumber) + ESP8266_RX_PAUSE_MARGIN < UartRxSize) { return; }
+
+         //  HUART buffer is about to overflow: rest of the message is dropped, so "SEND OK", "CLOSED" and data of other sockets behind it are parsed
+         IO.RxIgnoreCounter = IO.CurrentSocketDataLeft;
+         IO.CurrentSocketDataLeft = 0;
+         IO.ReceivingDataStream = false;
+         Socket[IO.RxSocketId].DataCutFlag = true;      //  application has not taken the buffer yet
+         Socket[IO.RxSocketId].RxStreamCut = true;      //  or it will know by the next one
+         METRIC_ADD(MetricIPDCutFrames, 1);
+         METRIC_ADD(MetricRxDroppedBytes, IO.RxIgnoreCounter);
+         esp_debug_print("ESP: Socket %u stream paused too long, %u bytes dropped\n", IO.RxSocketId, (unsigned int)IO.RxIgnoreCounter);
+         return;
+     }
+
+     while(1)
      {
-        if(DebugFlag_RxStreamToStdOut) { esp_debug_print("%c", *IO.pCurrentSocketData); }     //  copy all data from ESP to std out
+        //  copy as much as received, up to the end of message or socket buffer
+        len = IO.CurrentSocketDataLeft;
+        if(len > (size_t)(Socket[IO.RxSocketId].RxBuffSize - Socket[IO.RxSocketId].RxDataLen)) { len = Socket[IO.RxSocketId].RxBuffSize - Socket[IO.RxSocketId].RxDataLen; }
+        len = ESP_GetData(HuartNumber, IO.pCurrentSocketData, len);
+        if(len == 0) { return; }
 
-        IO.pCurrentSocketData++;
-        IO.CurrentSocketDataLeft--;
-        Socket[IO.RxSocketId].RxDataLen++;
+        if(DebugFlag_RxStreamToStdOut)      //  copy all data from ESP to std out
+        {
+            for(size_t i=0; i < len; i++) { esp_debug_print("%c", IO.pCurrentSocketData[i]); }
+        }
+
+        IO.pCurrentSocketData += len;
+        IO.CurrentSocketDataLeft -= (uint16_t)len;
+        Socket[IO.RxSocketId].RxDataLen += (uint16_t)len;
 /*
         if(*IO.pCurrentSocketData == '9' &&
                 *IO.pCurrentSocketData-1 == '.' &&
@@ -2371,675 +3693,196 @@ U8 NoMatchFound = 0;
         }
         if(Socket[IO.RxSocketId].RxDataLen >= Socket[IO.RxSocketId].RxBuffSize) //  Rx buffer is less than incoming data. Lock all data currently received and ignore rest
         {
+            if(Socket[IO.RxSocketId].RxStream)  //  stream mode: pause receiving, rest of the message goes to the next buffer
+            {
+                Socket[IO.RxSocketId].RxLock = true;
+                return;
+            }
             Socket[IO.RxSocketId].RxLock = true;  //  Lock data for application
             IO.RxIgnoreCounter = IO.CurrentSocketDataLeft;
             IO.ReceivingDataStream = false;
             //esp_debug_print("|RxIgnoreCounter-1=%u|", IO.RxIgnoreCounter);
             Socket[IO.RxSocketId].DataCutFlag = true;
+            METRIC_ADD(MetricIPDCutFrames, 1);
+            METRIC_ADD(MetricRxDroppedBytes, IO.RxIgnoreCounter);
             esp_debug_print("ESP: Rx Data has been cut out! RxDataLen=%u, RxBuffSize=%u\n", Socket[IO.RxSocketId].RxDataLen, Socket[IO.RxSocketId].RxBuffSize);
             return;
         }
      }
-     return;
   }
   else
   {
-    // return if previous command has not been processed
-    if(NewCommandSemaphore)
-    {
-        return;
-    }
-
-    // receive and parse incoming command
-    while(SUCCESS == ESP_GetChar(HuartNumber, (unsigned char*)(IO.pRxBuffer + IO.RxBuffCounter)))
+    // parse incoming responses byte by byte into the queue, the rest waits for the next call if the queue is full
+    while(IO.isResponseQueueBlocked() == false && SUCCESS == ESP_GetChar(HuartNumber, &tmpU8))
     {
        if(DebugFlag_RxStreamToStdOut)      //  copy all data from ESP to std out
        {
-           //if(*(IO.pRxBuffer + IO.RxBuffCounter) == '\r') esp_debug_print("\\r\r");
-           //else if(*(IO.pRxBuffer + IO.RxBuffCounter) == '\n') esp_debug_print("\\n\n");
-           //else
-               esp_debug_print("%c", *(IO.pRxBuffer + IO.RxBuffCounter));
+           esp_debug_print("%c", tmpU8);
        }
 
-       IO.RxBuffCounter++;
-       if(IO.RxBuffCounter > ESP8266_RX_BUFF_LEN - 1)
-       {
-         IO.RxBuffCounter = 0;
-         IO.ReceiveError = true;
-          esp_debug_print("ESP Rx Overflow\n");
-          continue;
-       }
+       Token = IO.Lexer.Feed((char)tmpU8);
+
+       if(Token == eAT::NO_COMMAND_RECEIVED) { continue; }     //  line is not complete yet or unknown one is skipped (nothing is buffered, so length does not matter)
 
-       *(IO.pRxBuffer + IO.RxBuffCounter) = 0;  // make a null-terminated string
        //============ Receive Socket Data in multi-mode =============
-       if((IO.pRxBuffer[0] == '+') &&
-          (IO.pRxBuffer[1] == 'I') )
+       if(Token == eAT::IPD || Token == eAT::RECV_DATA)
        {
-         res = sscanf(IO.pRxBuffer, "+IPD,%u,%u%1s", &id, &data_len, IO.pReceivedParameterStr);
-         if(3 == res)
-         {
-             esp_debug_print("ESP: IPD DATA, Socket=%d, Len:%d\n", id, data_len);
-            *IO.pRxBuffer = 0;   //  delete +IPD header
-            IO.RxBuffCounter = 0;    //  prepare buffer for the next command
+           if(Token == eAT::IPD)
+           {
+               id = IO.Lexer.GetNumber(0);
+               data_len = IO.Lexer.GetNumber(1);
+           }
+           else    //  "+CIPRECVDATA,<len>:<data>" reply to AT+CIPRECVDATA being run by the command queue, its tag is socket id
+           {
+               id = (IO.CommandRead != IO.CommandWrite) ? IO.Command[IO.CommandRead % ESP8266_COMMAND_QUEUE_LEN].Tag : SocketsNum;
+               data_len = IO.Lexer.GetNumber(0);
+#ifdef ESP8266_PASSIVE_RX_EN
+               if(id < SocketsNum) { SocketRxPulled(id, data_len); }
+#endif
+               if(data_len == 0) { continue; }     //  "OK" follows
+           }
+
+           esp_debug_print("ESP: IPD DATA, Socket=%d, Len:%d\n", id, data_len);
+           METRIC_ADD(MetricIPDFrames, 1);
+           METRIC_ADD(MetricIPDBytes, data_len);
+           METRIC_ADD(MetricIPDFrameSize, data_len);
+
+           if(id >= SocketsNum)  // wrong ID
+           {
+              IO.RxIgnoreCounter = data_len;
+              METRIC_ADD(MetricRxDroppedBytes, data_len);
+              return;
+           }
+
+#ifdef ESP8266_CIPDINFO_EN
+           if(Token == eAT::IPD)   //  "+IPD,<id>,<len>,<remote IP>,<remote port>:<data>", zeros if AT+CIPDINFO is not supported
+           {
+               Socket[id].RemoteIP = ((IO.Lexer.GetNumber(2) & 0xFF) << 24) | ((IO.Lexer.GetNumber(3) & 0xFF) << 16) | ((IO.Lexer.GetNumber(4) & 0xFF) << 8) | (IO.Lexer.GetNumber(5) & 0xFF);
+               Socket[id].RemotePort = (uint16_t)IO.Lexer.GetNumber(6);
+           }
+#endif
+#ifdef ESP8266_TIMESTAMPS_EN
+           if(Socket[id].Timestamps.FirstRx == 0) { Socket[id].Timestamps.FirstRx = Timestamp_Get(); }
+#endif
 
-            if(id>(ESP8266_SOCKETS_MAX-1))  // wrong ID
-            {
-               IO.RxIgnoreCounter = data_len;
+#ifdef ESP8266_RX_RING_EN
+           if(Socket[id].RxRing && Socket[id].State != eSocketState::Closed)     //  ring mode: appended to the ring by RxToRing()
+           {
+               if(Socket[id].RxPolicy == eRxFullPolicy::Pause && data_len > (unsigned int)(Socket[id].RxBuffSize - Socket[id].RxDataLen))
+               {
+                   //  message does not fit: dropped whole, waiting for the application would stop parsing of everything else
+                   IO.RxIgnoreCounter = data_len;
+                   Socket[id].RxDropped += data_len;
+                   METRIC_ADD(MetricRxDroppedBytes, data_len);
+                   esp_debug_print("ESP: Socket %u ring has no room for %u bytes, message dropped\n", id, data_len);
+                   return;
+               }
+               IO.CurrentSocketDataLeft = data_len;
+               IO.ReceivingDataStream = true;
+               IO.RxSocketId = id;
                return;
-            }
+           }
+#endif
 
-            if((Socket[id].State == eSocketState::Closed)   ||
-               (Socket[id].DataRx == 0)                     ||
-                Socket[id].RxLock                           ||
-                Socket[id].RxBuffSize == 0)
-            {
-                esp_debug_print("\nRxIgnoreCounter=%u\n", (unsigned int)IO.RxIgnoreCounter);
-               IO.RxIgnoreCounter = data_len;
+           if(Socket[id].RxStream && Socket[id].RxLock && Socket[id].DataRx && Socket[id].State != eSocketState::Closed)
+           {
+               //  stream mode, application still processes previous buffer: start receiving in paused state, buffer is assigned by ListenSocketStream()
+               IO.CurrentSocketDataLeft = data_len;
+               IO.ReceivingDataStream = true;
+               IO.RxSocketId = id;
                return;
-            }
-/*
-            if(Socket[id].RxBuffSize < data_len)
-            {
-                IO.CurrentSocketDataLeft = Socket[id].RxBuffSize;
-            }
-*/
-            IO.pCurrentSocketData = Socket[id].DataRx;
-            IO.CurrentSocketDataLeft = data_len;
-            Socket[id].RxDataLen = 0;
-            Socket[id].DataCutFlag = false;
-            IO.ReceivingDataStream = true;
-            IO.RxSocketId = id;
-            return;
-         }
-         //============ Receive Socket Data in single-mode =============
-//TODO work on following commented
-#if 0
-         res = sscanf(IO.pRxBuffer, "+IPD,%u:", &data_len);       //  First, look if new data coming (async process)
-         if(1 == res)
-         {
-            *IO.pRxBuffer = 0;   //  delete +IPD header
-            IO.RxBuffCounter = 0;
-
-            if((Socket[0].State != ESP8266_SOCKET_OPEN) ||
-               (Socket[0].DataRx == 0) ||
-                Socket[0].RxLock ||
-               (Socket[0].RxBuffSize < data_len) )
-            {
-               IO.RxIgnoreCounter = data_len;
-               continue;
-            }
-
-            IO.pCurrentSocketData = Socket[0].DataRx;
-            IO.CurrentSocketDataLeft = data_len;
-            Socket[0].RxDataLen = 0;
-            IO.ReceivingDataStream = 1;
-            IO.RxSocketId = 0;
-            continue;
-         }
-#endif
+           }
+
+           if((Socket[id].State == eSocketState::Closed)   ||
+              (Socket[id].DataRx == 0)                     ||
+               Socket[id].RxLock                           ||
+               Socket[id].RxBuffSize == 0)
+           {
+               esp_debug_print("\nRxIgnoreCounter=%u\n", (unsigned int)IO.RxIgnoreCounter);
+              IO.RxIgnoreCounter = data_len;
+              METRIC_ADD(MetricRxDroppedBytes, data_len);
+              return;
+           }
+
+           IO.pCurrentSocketData = Socket[id].DataRx;
+           IO.CurrentSocketDataLeft = data_len;
+           Socket[id].RxDataLen = 0;
+           Socket[id].DataCutFlag = false;
+           IO.ReceivingDataStream = true;
+           IO.RxSocketId = id;
+           return;
        }
-       if((IO.pRxBuffer[0] == '>') &&
-          (IO.pRxBuffer[1] == ' ') )
+
+       if(Token == eAT::SEND_PROMPT)
        {
            IO.ListenToTxData = true;
-           IO.RxBuffCounter = 0;    //  prepare buffer for the next command
            return;
        }
-       //=========== Parse command ==================
-       if(IO.RxBuffCounter >= 3)         //      at least 3 bytes received
+
+       //=========== Response or message of the module ==================
+       n = IO.Lexer.GetNumbersNum();
+       if(n > ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM) { n = ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM; }
+       for(i = 0; i < n; i++) { IO.pReceivedParameter[i] = IO.Lexer.GetNumber(i); }
+
+       switch(Token)
        {
-          if((*(IO.pRxBuffer + IO.RxBuffCounter - 1) == '\n') &&
-             (*(IO.pRxBuffer + IO.RxBuffCounter - 2) == '\r') &&
-             (*(IO.pRxBuffer + IO.RxBuffCounter - 3) == '\r'))     //  echo received
-          //============ Receive Echo =============
-          {
-            //esp_debug_print("ESP Rx1:Len=%d; Msg:%40s\n",IO.RxBuffCounter, IO.pRxBuffer);
-              if(IO.RxBuffCounter == 3)
-              {
-                IO.RxBuffCounter = 0;    //  prepare buffer for the next command
-                return;
-              }
-              switch(*IO.pRxBuffer)
-              {
-              case 'A':
-                  switch(*(IO.pRxBuffer + 1))
-                  {
-                  // AT
-                  case 'T':
-                      switch(*(IO.pRxBuffer + 2))
-                      {
-                      case '\r':
-                          if(strstr((const char *)IO.pRxBuffer, "AT\r\r\n")) { StoreCommand( eAT::ECHO_AT ); }
-                          else { NoMatchFound = 1; }
-                          break;
-                      // ATE
-                      case 'E':
-                          if     (strstr((const char *)IO.pRxBuffer, "ATE0\r\r\n"))   { StoreCommand( eAT::ECHO_ECHO_OFF ); }
-                          else if(strstr((const char *)IO.pRxBuffer, "ATE1\r\r\n"))   { StoreCommand( eAT::ECHO_ECHO_ON  ); }
-                          else { NoMatchFound = 1; }
-                          break;
-                      // END ATE
-
-                      default:
-                          NoMatchFound = 1;
-                          break;
-                      } // END AT
-                      break;
-
-                  default:
-                      NoMatchFound = 1;
-                      break;
-                  }// END A
-                  break;
-
-              default:
-                  NoMatchFound = 1;
-                  break;
-              }
-
-              if(NoMatchFound)
-              {
-                  esp_debug_print("ESP UNKNOWN MESSAGE.Len=%d; Msg:%40s",IO.RxBuffCounter, IO.pRxBuffer);
-
-                  IO.RxBuffCounter = 0;    //   prepare buffer for the next command
-              }
-              else
-              {
-                  IO.RxBuffCounter = 0;    //   prepare buffer for the next command
-              }
-          }
-/*******************************************************************************************************************************************************************************************/
-          if(NewCommandSemaphore) { return; }   //  previous command has not beeb parsed
-          //============ Receive Response =============
-          else if((*(IO.pRxBuffer + IO.RxBuffCounter - 1) == '\n') &&
-                  (*(IO.pRxBuffer + IO.RxBuffCounter - 2) == '\r'))     //  new line received
-          {
-            //esp_debug_print("ESP Rx2:Len=%d; Msg:%40s\n",IO.RxBuffCounter, IO.pRxBuffer);
-            if(IO.RxBuffCounter == 2)
-              {
-                IO.RxBuffCounter = 0;    //  prepare buffer for the next command
-                return;
-              }
-              //    First try to parse string with assumption that message starts from zero position in reseived message, otherwise NoMatchFound flag should be set and advanced parsing start
-              switch(*IO.pRxBuffer)
-              {
-              case '0':
-              case '1':
-              case '2':
-              case '3':
-              case '4':
-                  if(0 == strcmp((const char *)(IO.pRxBuffer + 1), ",CONNECT\r\n"))
-                  {
-                      StoreCommand(eAT::SOCKET_CONNECT);
-                      //esp_debug_print("#%d\n", *IO.pRxBuffer);
-                      switch(*IO.pRxBuffer)
-                      {
-                      case '0': IO.pReceivedParameter[0] = 0; break;
-                      case '1': IO.pReceivedParameter[0] = 1; break;
-                      case '2': IO.pReceivedParameter[0] = 2; break;
-                      case '3': IO.pReceivedParameter[0] = 3; break;
-                      case '4': IO.pReceivedParameter[0] = 4; break;
-                      default: IO.pReceivedParameter[0]  = 255; break;
-                      }
-                  }
-                  else if(0 == strcmp((const char *)(IO.pRxBuffer + 1), ",CLOSED\r\n"))
-                  {
-                      StoreCommand(eAT::SOCKET_CLOSED);
-                      //esp_debug_print("#%d\n", *IO.pRxBuffer);
-                      switch(*IO.pRxBuffer)
-                      {
-                      case '0': IO.pReceivedParameter[0] = 0; break;
-                      case '1': IO.pReceivedParameter[0] = 1; break;
-                      case '2': IO.pReceivedParameter[0] = 2; break;
-                      case '3': IO.pReceivedParameter[0] = 3; break;
-                      case '4': IO.pReceivedParameter[0] = 4; break;
-                      default: IO.pReceivedParameter[0]  = 255; break;
-                      }
-                  }
-                  else if(0 == strcmp((const char *)(IO.pRxBuffer + 1), ",CONNECT FAIL\r\n"))
-                  {
-                      StoreCommand(eAT::SOCKET_CONNECT_FAIL);
-                      switch(*IO.pRxBuffer)
-                      {
-                      case '0': IO.pReceivedParameter[0] = 0; break;
-                      case '1': IO.pReceivedParameter[0] = 1; break;
-                      case '2': IO.pReceivedParameter[0] = 2; break;
-                      case '3': IO.pReceivedParameter[0] = 3; break;
-                      case '4': IO.pReceivedParameter[0] = 4; break;
-                      default: IO.pReceivedParameter[0]  = 255; break;
-                      }
-                  }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'A':
-                  if     (strstr((const char *)IO.pRxBuffer, "ALREAY CONNECT\r\n"))  { StoreCommand(eAT::ALREADY_CONNECT ); }  // this is real message with grammatical error
-                  else if(strstr((const char *)IO.pRxBuffer, "ALREADY CONNECT\r\n")) { StoreCommand(eAT::ALREADY_CONNECT ); } // this message can appear if manufacturer fix gramm. error
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'b':
-                  if     (strstr((const char *)IO.pRxBuffer, "busy\r\n"))      { StoreCommand(eAT::BUSY   ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "busy p...\r\n")) { StoreCommand(eAT::BUSY_P ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "busy s...\r\n")) { StoreCommand(eAT::BUSY_S ); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'B':
-                  if(strstr((const char *)IO.pRxBuffer, "BAUD->"))
-                  {
-                      res = sscanf(IO.pRxBuffer, "BAUD->%u", &IO.pReceivedParameter[0]);
-                      if(1 == res) { StoreCommand( eAT::BAUDRATE_CONFIRMATION); }
-                  }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'E':
-                  if(strstr((const char *)IO.pRxBuffer, "ERROR\r\n")) { StoreCommand(eAT::AT_ERROR ); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'F':
-                  if(strstr((const char *)IO.pRxBuffer, "FAIL\r\n")) { StoreCommand(eAT::FAIL ); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'l':
-              case 'L':
-                  if(strstr((const char *)IO.pRxBuffer, "Linked\r\n"))               { StoreCommand(eAT::LINKED       ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "link is not\r\n"))     { StoreCommand(eAT::LINKISNOT    ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "link\r\n"))            { StoreCommand(eAT::LINK         ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "Link is builded\r\n")) { StoreCommand(eAT::LINKISBUILDED); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'n':
-                  if     (strstr((const char *)IO.pRxBuffer, "no change\r\n"))   { StoreCommand(eAT::NOCHANGE ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "no ip\r\n"))       { StoreCommand(eAT::NOIP     ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "no this fun\r\n")) { StoreCommand(eAT::NO_THIS_FUNCTION); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'O':
-                  if(strstr((const char *)IO.pRxBuffer, "OK\r\n")) { StoreCommand(eAT::OK); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'r':
-                  if(strstr((const char *)IO.pRxBuffer, "ready\r\n")) { StoreCommand(eAT::READY); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'S':
-                  if(strstr((const char *)IO.pRxBuffer, "SEND OK\r\n")) { StoreCommand(eAT::SEND_OK ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "STATUS:"))
-                  {
-                      res = sscanf(IO.pRxBuffer, "STATUS:%u", &IO.pReceivedParameter[0]);
-                      if(1 == res) { StoreCommand(eAT::CIPSTATUS); }
-                      else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                  }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'w':
-                  if     (strstr((const char *)IO.pRxBuffer, "wrong syntax\r\n")) { StoreCommand(eAT::WRONG_SYNTAX ); }
-                  else if(strstr((const char *)IO.pRxBuffer, "wdt reset\r\n"))    { StoreCommand(eAT::WDT_RESET    ); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case 'u':
-                  if(strstr((const char *)IO.pRxBuffer, "Unlink\r\n")) { StoreCommand(eAT::UNLINK ); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case '[':
-                  if(strstr((const char *)IO.pRxBuffer, "[Vendor:www.ai-thinker.com Version:")) { StoreCommand(eAT::REBOOT_DETECTED ); }
-                  else { NoMatchFound = 1; }
-                  break;
-
-              case '+':
-                  switch(*(IO.pRxBuffer + 1))
-                  {
-                  // +C
-                  case 'C':
-                      switch(*(IO.pRxBuffer + 2))
-                      {
-                      // +CI
-                      case 'I':
-                          switch(*(IO.pRxBuffer + 3))
-                          {
-                          case 'F':
-                              if(strstr((const char *)IO.pRxBuffer, "+CIFSR:APIP"))
-                              {
-                                  res = sscanf(IO.pRxBuffer, "+CIFSR:APIP,\"%u.%u.%u.%u", &IO.pReceivedParameter[0], &IO.pReceivedParameter[1],
-                                                                                                   &IO.pReceivedParameter[2], &IO.pReceivedParameter[3]);
-                                  if(4 == res) { StoreCommand(eAT::CIFSR_APIP); }
-                                  else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                              }
-                              else if(strstr((const char *)IO.pRxBuffer, "+CIFSR:APMAC"))
-                              {
-                                  res = sscanf(IO.pRxBuffer, "+CIFSR:APMAC,\"%x:%x:%x:%x:%x:%x", &IO.pReceivedParameter[0], &IO.pReceivedParameter[1],
-                                                                                                   &IO.pReceivedParameter[2], &IO.pReceivedParameter[3],
-                                                                                                   &IO.pReceivedParameter[4], &IO.pReceivedParameter[5]);
-                                  if(6 == res) { StoreCommand(eAT::CIFSR_APMAC); }
-                                  else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                              }
-                              else
-                              {
-                                  NoMatchFound = 1;
-                              }
-                              break;  // END of +CIF
-
-                          case 'O':
-                              // +CIOBAUD:(X-X)
-                              if(strstr((const char *)IO.pRxBuffer, "+CIOBAUD:("))
-                              {
-                                 if(ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM >= 2)
-                                 {
-                                    res = sscanf(IO.pRxBuffer, "+CIOBAUD:(%u-%u)", &IO.pReceivedParameter[0], &IO.pReceivedParameter[1]);
-                                    if(2 == res) { StoreCommand(eAT::CIOBAUD_RANGE); }
-                                    else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                                 }
-                                 else
-                                 {
-                                     StoreCommand(eAT::INTERNAL_ERROR);
-                                 }
-                              }
-                              //         +CIOBAUD:X
-                              else if(strstr((const char *)IO.pRxBuffer, "+CIOBAUD:"))
-                              {
-                                 if(ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM >= 1)
-                                 {
-                                    res = sscanf(IO.pRxBuffer, "+CIOBAUD:%u", &IO.pReceivedParameter[0]);
-                                    if(1 == res) { StoreCommand(eAT::CIOBAUD); }
-                                    else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                                 }
-                                 else
-                                 {
-                                     StoreCommand(eAT::INTERNAL_ERROR);
-                                 }
-                              }
-                              else
-                              {
-                                  NoMatchFound = 1;
-                              }
-                          break;    //  END of +CIO
-
-                          // +CIP
-                          case 'P':
-                              switch(*(IO.pRxBuffer + 4))
-                              {
-                              // +CIPS
-                              case 'S':
-                                  // +CIPSTATUS
-                                  if(strstr((const char *)IO.pRxBuffer, "+CIPSTATUS:"))
-                                  {
-                                      if(ESP8266_RECEIVED_COMMAND_PARAM_STR_LEN > 80 && ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM >= 5)
-                                      {
-                                          res = sscanf(IO.pRxBuffer, "+CIPSTATUS:%u,\"%5[^\"]\",\"%80[^\"]\",%u,%u,%u",
-                                                                                            &IO.pReceivedParameter[0], str, IO.pReceivedParameterStr, &IO.pReceivedParameter[2], &IO.pReceivedParameter[3], &IO.pReceivedParameter[4]);
-                                          if(res == 6)
-                                          {
-                                              str[5] = 0;
-                                              if(strstr(str, "TCP"))
-                                              {
-                                                  IO.pReceivedParameter[1] = (uint8_t)eSocketType::TCP;
-                                              }
-                                              else if(strstr(str, "UDP"))
-                                              {
-                                                  IO.pReceivedParameter[1] = (uint8_t)eSocketType::UDP;
-                                              }
-                                              else
-                                              {
-                                                  StoreCommand(eAT::BAD_STRUCTURE);
-                                              }
-                                          }
-                                          else
-                                          {
-                                              StoreCommand(eAT::BAD_STRUCTURE);
-                                          }
-                                      }
-                                      else
-                                      {
-                                          StoreCommand(eAT::INTERNAL_ERROR);
-                                      }
-                                  }
-                                  else
-                                  {
-                                      NoMatchFound = 1;
-                                  }
-                                  break;
-
-                              default:
-                                  NoMatchFound = 1;
-                              break;
-                              } //  END of +CIP
-                          break;
-
-                          default:
-                              NoMatchFound = 1;
-                          break;
-                          }
-                      break; //  END of +CI
-
-                      // +CW
-                      case 'W':
-                        switch(*(IO.pRxBuffer + 3))
-                        {
-                          // +CWJ
-                          case 'J':
-                              if(strstr((const char *)IO.pRxBuffer, "+CWJAP:"))  //  TODO: new data-set
-                              {
-                                  res = sscanf(IO.pRxBuffer, "+CWJAP:%u", &IO.pReceivedParameter[0]);
-                                  if(1 == res) { StoreCommand(eAT::CWJAP_FAULT); }
-                                  else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                              }
-                              else if(strstr((const char *)IO.pRxBuffer, "+CWJAP_CUR:"))  //  TODO: new data-set
-                              {
-                                  if(ESP8266_RECEIVED_COMMAND_PARAM_STR_LEN > 40)
-                                  {
-                                      res = sscanf(IO.pRxBuffer, "+CWJAP_CUR:(\"%40[^\"]\",\"%19[^\"]\",%u,%u", IO.pReceivedParameterStr,
-                                                                                                                         IO.pReceivedParameterStr2,
-                                                                                                                         &IO.pReceivedParameter[0],
-                                                                                                                         &IO.pReceivedParameter[1]);
-                                      if(4 == res) { StoreCommand(eAT::CWJAP); }
-                                      else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                                  }
-                                  else
-                                  {
-                                      StoreCommand(eAT::INTERNAL_ERROR );
-                                  }
-                              }
-                              else
-                              {
-                                  NoMatchFound = 1;
-                              }
-                          break;  // END +CWJ
-
-                          case 'L':
-                            if(strstr((const char *)IO.pRxBuffer, "+CWLAP:("))  //
-                            {
-                                if(ESP8266_RECEIVED_COMMAND_PARAM_STR_LEN > 80 && ESP8266_RECEIVED_COMMAND_PARAM_STR2_LEN >=20)
-                                {
-                                    res = sscanf(IO.pRxBuffer, "+CWLAP:(%u,\"%80[^\"]\",%d,\"%19[^\"]\",%u,%u,%u",
-                                            &IO.pReceivedParameter[0], IO.pReceivedParameterStr, &IO.pReceivedParameter[1], IO.pReceivedParameterStr2,
-                                            &IO.pReceivedParameter[2], &IO.pReceivedParameter[3], &IO.pReceivedParameter[4]);
-                                    if(7 == res) { StoreCommand(eAT::CWLAP); }
-                                    else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                                }
-                                else
-                                {
-                                    StoreCommand(eAT::INTERNAL_ERROR );
-                                }
-                            }
-                            else
-                            {
-                                NoMatchFound = 1;
-                            }
-                            break;
-
-                          // +CWM
-                          case 'M':
-                              if(strstr((const char *)IO.pRxBuffer, "+CWMODE_CUR:"))
-                              {
-                                  res = sscanf(IO.pRxBuffer, "+CWJAP:%u", &IO.pReceivedParameter[0]);
-                                  if(1 == res) { StoreCommand(eAT::CWMODE); }
-                                  else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                              }
-                              else
-                              {
-                                  NoMatchFound = 1;
-                              }
-                          break; // END +CWM
-
-                          // +CWS
-                          case 'S':
-                              if(strstr((const char *)IO.pRxBuffer, "+CWSAP_CUR:"))
-                              {
-                                  if(ESP8266_RECEIVED_COMMAND_PARAM_STR_LEN > 80)
-                                  {
-                                      // name and password are non-empty strings
-                                      res = sscanf(IO.pRxBuffer, "+CWSAP_CUR:\"%80[^\"]\",\"%*[^\"]\",%u,%u,%u,%u",
-                                              IO.pReceivedParameterStr, &IO.pReceivedParameter[0], &IO.pReceivedParameter[1], &IO.pReceivedParameter[2], &IO.pReceivedParameter[3]);
-                                      if(5 == res) { StoreCommand(eAT::CWSAP_CUR); }
-                                      else  //  name is non-empty string, password is empty string
-                                      {
-                                          res = sscanf(IO.pRxBuffer, "+CWSAP_CUR:\"%80[^\"]\",\"\",%u,%u,%u,%u",
-                                                           IO.pReceivedParameterStr, &IO.pReceivedParameter[0], &IO.pReceivedParameter[1], &IO.pReceivedParameter[2], &IO.pReceivedParameter[3]);
-                                          if(5 == res) { StoreCommand(eAT::CWSAP_CUR); }
-                                          else         { StoreCommand(eAT::BAD_STRUCTURE); }
-                                      }
-                                  }
-                                  else
-                                  {
-                                      StoreCommand(eAT::INTERNAL_ERROR);
-                                  }
-                              }
-                              else
-                              {
-                                  NoMatchFound = 1;
-                              }
-                          break; // END +CWS
-
-                          default:
-                          NoMatchFound = 1;
-                          break;
-                        } //  END +CW
-                        break;
+       //  socket messages can come in any state and are applied at once, so "+IPD" following them finds socket in the right state
+       case eAT::SOCKET_CONNECT:   //  socket opened in server mode
+           if(IO.pReceivedParameter[0] < SocketsNum) { SocketConnected(IO.pReceivedParameter[0]); }
+           continue;
+
+       case eAT::SOCKET_CLOSED:
+           if(IO.pReceivedParameter[0] < SocketsNum) { SocketClosed(IO.pReceivedParameter[0]); }
+           continue;
+
+#ifdef ESP8266_SENDBUF_EN
+       case eAT::SENDBUF_OK:       //  packets sent by AT+CIPSENDBUF are confirmed in any state
+       case eAT::SENDBUF_FAIL:
+           if(IO.pReceivedParameter[0] < SocketsNum) { SendBufSegmentDone(IO.pReceivedParameter[0], IO.pReceivedParameter[1], Token == eAT::SENDBUF_OK); }
+           continue;
+#endif
 
-                      default:
-                          NoMatchFound = 1;
-                          break;
-                      } // END +C
-                      break;
-
-                  default:
-                      NoMatchFound = 1;
-                      break;
-                  }  // END +
-                  break;
-
-              default:
-                 /* if(5 == sscanf(IO.pRxBuffer, "%u.%u.%u.%u%c", &IO.pReceivedParameter[0], &IO.pReceivedParameter[1], &IO.pReceivedParameter[2], &IO.pReceivedParameter[3], &c))
-                  {
-                      if(c == '\r') { StoreCommand(eAT::IP ); }
-                  }
-                  else*/
-                  {
-                      NoMatchFound = 1;
-                  }
-                  break;
-              }
-              if(NoMatchFound)
-              {
-#if 0
-               if(strstr((const char *)IO.pRxBuffer, "ready\r\n"))     { ESP8266_StoreCommand(pESP, ESP8266_RX_READY); }
-               else if(strstr((const char *)IO.pRxBuffer, "OK\r\n"))   { ESP8266_StoreCommand(pESP, ESP8266_RX_OK); }
-               //         +CIOBAUD:(X-X)
-               else if(strstr((const char *)IO.pRxBuffer, "+CIOBAUD:("))
+#ifdef ESP8266_PASSIVE_RX_EN
+       case eAT::IPD_NOTIFY:       //  data wait in the module, AT+CIPRECVDATA is queued by Standby when socket can take them
+           if(IO.pReceivedParameter[0] < SocketsNum)
+           {
+               id = IO.pReceivedParameter[0];
+               Socket[id].RxPending += IO.pReceivedParameter[1];
+               esp_debug_print("ESP: IPD notification, Socket=%u, Len:%u, pending:%lu\n", id, IO.pReceivedParameter[1], (unsigned long)Socket[id].RxPending);
+#ifdef ESP8266_CIPDINFO_EN
+               if(IO.Lexer.GetNumbersNum() >= 7)   //  "+IPD,<id>,<len>,<remote IP>,<remote port>"
                {
-                if(ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM >= 2)
-                {
-                   res = sscanf(IO.pRxBuffer, "+CIOBAUD:(%u-%u)", &IO.pReceivedParameter[0], &IO.pReceivedParameter[1]);
-                   if(2 == res) { ESP8266_StoreCommand(pESP, ESP8266_RX_CIOBAUD_RANGE); }
-                   else         { ESP8266_StoreCommand(pESP, ESP8266_RX_BAD_STRUCTURE); }
-                }
-                else
-                {
-                    ESP8266_StoreCommand(pESP, ESP8266_RX_INTERNAL_ERROR);
-                }
+                   Socket[id].RemoteIP = ((IO.Lexer.GetNumber(2) & 0xFF) << 24) | ((IO.Lexer.GetNumber(3) & 0xFF) << 16) | ((IO.Lexer.GetNumber(4) & 0xFF) << 8) | (IO.Lexer.GetNumber(5) & 0xFF);
+                   Socket[id].RemotePort = (uint16_t)IO.Lexer.GetNumber(6);
                }
-               //         +CIOBAUD:X
-               else if(strstr((const char *)IO.pRxBuffer, "+CIOBAUD:"))
-               {
-                if(ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM >= 1)
-                {
-                   res = sscanf(IO.pRxBuffer, "+CIOBAUD:%u", &IO.pReceivedParameter[0]);
-                   if(1 == res) { ESP8266_StoreCommand(pESP, ESP8266_RX_CIOBAUD); }
-                   else         { ESP8266_StoreCommand(pESP, ESP8266_RX_BAD_STRUCTURE); }
-                }
-                else
-                {
-                    ESP8266_StoreCommand(pESP, ESP8266_RX_INTERNAL_ERROR);
-                }
-               }
-               //         +CWJAP:str
-               else if(strstr((const char *)IO.pRxBuffer, "+CWJAP:"))
-               {
-                 res = sscanf(IO.pRxBuffer, "+CWJAP:\"%40s\"", IO.pReceivedParameterStr);    //  40 name length hardcoded, can make problems
-                 if(1 == res) { ESP8266_StoreCommand(pESP, ESP8266_RX_CWJAP); }
-                 else         { ESP8266_StoreCommand(pESP, ESP8266_RX_BAD_STRUCTURE); }
-               }
-               //         BAUD->X
-               else if(strstr((const char *)IO.pRxBuffer, "BAUD->"))
-               {
-                   res = sscanf(IO.pRxBuffer, "BAUD->%u", &IO.pReceivedParameter[0]);
-                   if(1 == res) { ESP8266_StoreCommand(pESP, ESP8266_BAUDRATE_CONFIRMATION); }
-               }
-               else if(strstr((const char *)IO.pRxBuffer, "no change\r\n"))        { StoreCommand(eAT::NOCHANGE        ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "FAIL\r\n"))             { StoreCommand(eAT::FAIL            ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "ALREAY CONNECT\r\n"))   { StoreCommand(eAT::ALREADY_CONNECT ); }//+  // this is real message with grammatical error
-               else if(strstr((const char *)IO.pRxBuffer, "ALREADY CONNECT\r\n"))  { StoreCommand(eAT::ALREADY_CONNECT ); }//+  // this message can appear if manufacturer fix gramm. error
-               else if(strstr((const char *)IO.pRxBuffer, "SEND OK\r\n"))          { StoreCommand(eAT::SEND_OK         ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "wrong syntax\r\n"))     { StoreCommand(eAT::WRONG_SYNTAX    ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "ERROR\r\n"))            { StoreCommand(eAT::ERROR           ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "Linked\r\n"))           { StoreCommand(eAT::LINKED          ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "Link\r\n"))             { StoreCommand(eAT::LINK            ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "Unlink\r\n"))           { StoreCommand(eAT::UNLINK          ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "busy\r\n"))             { StoreCommand(eAT::BUSY            ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "busy p...\r\n"))        { StoreCommand(eAT::BUSY_P          ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "busy s...\r\n"))        { StoreCommand(eAT::BUSY_S          ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "link is not\r\n"))      { StoreCommand(eAT::LINKISNOT       ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "no ip\r\n"))            { StoreCommand(eAT::NOIP            ); }//+
-               else if(strstr((const char *)IO.pRxBuffer, "no this fun\r\n"))      { StoreCommand(eAT::NO_THIS_FUNCTION); }//+
-               else if(5 == sscanf(IO.pRxBuffer, "%u.%u.%u.%u%c", &IO.pReceivedParameter[0], &IO.pReceivedParameter[1], &IO.pReceivedParameter[2], &IO.pReceivedParameter[3], &c))
-                {
-                  if(c == '\r') { StoreCommand(eAT::IP ); }
-                }
 #endif
-                  IO.RxBuffCounter = 0;    //  prepare buffer for next command
+           }
+           continue;
+
+       case eAT::RECV_LEN:         //  reply to AT+CIPRECVLEN? is applied at once, before notifications following it
+           for(i = 0; i < SocketsNum && i < n; i++)
+           {
+               Socket[i].RxPending = ((int)IO.pReceivedParameter[i] > 0) ? IO.pReceivedParameter[i] : 0;
+           }
+           continue;
+#endif
 
-              }
-              else
-              {
-                  IO.RxBuffCounter = 0;    //  prepare buffer for next command
-              }
-            }
+       case eAT::CIPSTATUS:
+           if(n == 4 && ESP8266_RECEIVED_COMMAND_NUM_OF_PARAM >= 5)    //  "+CIPSTATUS:<id>,<type>,<remote IP>,<remote port>,<local port>,<tetype>", type is set as parameter 1
+           {
+               for(i = 4; i > 1; i--) { IO.pReceivedParameter[i] = IO.pReceivedParameter[i - 1]; }
+               if(strcmp(IO.pReceivedParameterStr, "TCP") == 0)      { IO.pReceivedParameter[1] = (unsigned int)eSocketType::TCP; }
+               else if(strcmp(IO.pReceivedParameterStr, "UDP") == 0) { IO.pReceivedParameter[1] = (unsigned int)eSocketType::UDP; }
+               else { Token = eAT::BAD_STRUCTURE; }
+           }
+           StoreCommand(Token, false);     //  string is converted, next lines can be parsed
+           continue;
+
+       default:
+           break;
        }
-       else if(IO.RxBuffCounter >= 2)         //      at least 2 bytes received
-       {
-          if((*(IO.pRxBuffer + IO.RxBuffCounter - 1) == '\n') &&
-             (*(IO.pRxBuffer + IO.RxBuffCounter - 2) == '\r'))     //  empty line received
-             {
-                  IO.RxBuffCounter = 0;    //  prepare buffer for the next command
-             }
-       }
-
-       //============= Receive Tx Echo (multi-mode) ===============
-       //res = sscanf(IO.pRxBuffer, "AT+CIPSEND=%u,%u%c", &id, &data_len, &c);
-       {
 
-       }
+       StoreCommand(Token, IO.Lexer.GetStringsNum() != 0);
     }
   }
 }
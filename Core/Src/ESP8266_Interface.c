@@ -60,13 +60,13 @@ void ESP_Disable(uint8_t HuartNumber)
     }
 }
 
-STATUS ESP_HuartInit(uint8_t HuartNumber)
+STATUS ESP_HuartInit(uint8_t HuartNumber, uint8_t *pRx, size_t RxSize, uint8_t *pTx, size_t TxSize)
 {
     switch(HuartNumber)
     {
     case ESP1_HUART_NUM:
         // Configure UART for ESP8266 module
-        if(SUCCESS != Init_USART_CB(&ESP1_HUART, &ESP1_cb_Rx, &ESP1_cb_Tx, ESP8266_CB_RX_SIZE, ESP8266_CB_TX_SIZE, sizeof(U8))) //  TODO
+        if(SUCCESS != Init_USART_CB_Static(&ESP1_HUART, &ESP1_cb_Rx, &ESP1_cb_Tx, pRx, pTx, RxSize, TxSize, sizeof(U8))) //  TODO
         {
             //BlockingFaultHandler();
             return ERROR;
@@ -141,6 +141,44 @@ circular_buffer* cb_Rx;
     }
 }
 
+size_t ESP_GetData(uint8_t HuartNumber, uint8_t* pData, size_t Size)
+{
+circular_buffer* cb_Rx;
+size_t n;
+
+    switch(HuartNumber)
+    {
+    case ESP1_HUART_NUM:
+        cb_Rx = (circular_buffer*)(ESP1_HUART.pRxBuffPtr);
+        __HAL_UART_DISABLE_IT(&ESP1_HUART, UART_IT_RXNE);   //  several bytes are taken at once, receive interrupt must not change buffer meanwhile
+        n = cb_pop_front_n(cb_Rx, pData, Size);
+        __HAL_UART_ENABLE_IT(&ESP1_HUART, UART_IT_RXNE);
+        return n;
+
+    default:
+        return 0;
+    }
+}
+
+size_t ESP_SkipData(uint8_t HuartNumber, size_t Size)
+{
+circular_buffer* cb_Rx;
+size_t n;
+
+    switch(HuartNumber)
+    {
+    case ESP1_HUART_NUM:
+        cb_Rx = (circular_buffer*)(ESP1_HUART.pRxBuffPtr);
+        __HAL_UART_DISABLE_IT(&ESP1_HUART, UART_IT_RXNE);
+        n = cb_drop_front(cb_Rx, Size);
+        __HAL_UART_ENABLE_IT(&ESP1_HUART, UART_IT_RXNE);
+        return n;
+
+    default:
+        return 0;
+    }
+}
+
 //  returns number of bytes received from Rx stream of HUART defined by HuartNumber
 size_t ESP_NumOfDataReceived(uint8_t HuartNumber)
 {
@@ -224,6 +262,18 @@ STATUS ESP_HuartRxOverflow(uint8_t HuartNumber)
     return 0;
 }
 
+const UART_ErrorCounters* ESP_HuartErrorCounters(uint8_t HuartNumber)
+{
+    switch(HuartNumber)
+        {
+        case ESP1_HUART_NUM:
+            return UART_GetErrorCounters(&ESP1_HUART);
+
+        default:
+            return 0;
+        }
+}
+
 /* Sets HUART baudrate */
 void ESP_SetBaudRate(uint8_t HuartNumber, uint32_t Baud)
 {
@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file    Flash_Interface.c
+  * @author  Ostap Kostyk
+  * @brief   Flash_Interface implements hardware-depended access to the internal
+  *          flash memory (erase/program) in C language to be compatible with
+  *          Low-level implementation of the hardware or HAL.
+  *          If FLASH_EMULATOR is defined then flash is emulated in RAM, so
+  *          modules using flash (e.g. OTA_Update) can be built and run on the host
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "Flash_Interface.h"
+#include <string.h>
+
+#ifndef FLASH_EMULATOR
+
+STATUS Flash_Init(void)
+{
+    /* Flash stays unlocked because EEPROM emulation writes to flash at any time (see main()) */
+    if(HAL_OK != HAL_FLASH_Unlock()) { return ERROR; }
+
+    return SUCCESS;
+}
+
+STATUS Flash_ErasePage(uint32_t Address)
+{
+FLASH_EraseInitTypeDef EraseInit;
+uint32_t PageError = 0;
+
+    if(Address % FLASH_IF_PAGE_SIZE) { return ERROR; }
+
+    EraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+    EraseInit.Banks = FLASH_BANK_1;
+    EraseInit.PageAddress = Address;
+    EraseInit.NbPages = 1;
+
+    if(HAL_OK != HAL_FLASHEx_Erase(&EraseInit, &PageError)) { return ERROR; }
+
+    return SUCCESS;
+}
+
+STATUS Flash_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+    if(Address & 1) { return ERROR; }
+
+    if(Data == 0xFFFF && *(volatile uint16_t*)(uintptr_t)Address == 0xFFFF) { return SUCCESS; }   //  nothing to program, half-word is erased
+
+    if(HAL_OK != HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, Address, Data)) { return ERROR; }
+
+    if(*(volatile uint16_t*)(uintptr_t)Address != Data) { return ERROR; }  //  verify
+
+    return SUCCESS;
+}
+
+const uint8_t* Flash_GetPointer(uint32_t Address)
+{
+    return (const uint8_t*)(uintptr_t)Address;
+}
+
+#else   //  FLASH_EMULATOR
+
+static uint8_t FlashEmulatorMemory[FLASH_EMULATOR_SIZE];
+
+STATUS Flash_Init(void)
+{
+    return SUCCESS;
+}
+
+STATUS Flash_ErasePage(uint32_t Address)
+{
+    if(Address % FLASH_IF_PAGE_SIZE) { return ERROR; }
+    if(Address < FLASH_EMULATOR_BASE || Address - FLASH_EMULATOR_BASE >= FLASH_EMULATOR_SIZE) { return ERROR; }
+
+    memset(&FlashEmulatorMemory[Address - FLASH_EMULATOR_BASE], 0xFF, FLASH_IF_PAGE_SIZE);
+
+    return SUCCESS;
+}
+
+STATUS Flash_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+uint8_t *p;
+
+    if(Address & 1) { return ERROR; }
+    if(Address < FLASH_EMULATOR_BASE || Address - FLASH_EMULATOR_BASE >= FLASH_EMULATOR_SIZE) { return ERROR; }
+
+    p = &FlashEmulatorMemory[Address - FLASH_EMULATOR_BASE];
+
+    if(Data == 0xFFFF) { return (p[0] == 0xFF && p[1] == 0xFF) ? SUCCESS : ERROR; }
+
+    /* same as hardware: only erased half-word can be programmed (zero can be written always) */
+    if((p[0] != 0xFF || p[1] != 0xFF) && Data != 0) { return ERROR; }
+
+    p[0] = (uint8_t)Data;           //  little-endian like target
+    p[1] = (uint8_t)(Data >> 8);
+
+    return SUCCESS;
+}
+
+const uint8_t* Flash_GetPointer(uint32_t Address)
+{
+    if(Address < FLASH_EMULATOR_BASE || Address - FLASH_EMULATOR_BASE >= FLASH_EMULATOR_SIZE) { return 0; }
+
+    return &FlashEmulatorMemory[Address - FLASH_EMULATOR_BASE];
+}
+
+#endif  //  FLASH_EMULATOR
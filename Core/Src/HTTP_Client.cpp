@@ -0,0 +1,551 @@
+/**
+  ******************************************************************************
+  * @file    HTTP_Client.cpp
+  * @author  Ostap Kostyk
+  * @brief   HTTP/1.1 client over Transport socket: queue of requests sent through
+  *          kept-alive connection with pipelining, response parser with
+  *          Content-Length and chunked bodies
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "HTTP_Client.hpp"
+
+#ifdef HTTP_CLIENT_EN
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+extern "C" {
+#include "Scan.h"
+}
+
+using namespace OKO_HTTP_CLIENT;
+
+static const char* const HTTP_ClientMethod[] = {"GET", "POST", "PUT", "DELETE"};
+
+/* Returns pointer on header value (spaces skipped) if Line starts with header Name (case-insensitive), otherwise zero */
+static const char* HeaderValue(const char *pLine, const char *pName)
+{
+    while(*pName)
+    {
+        if(tolower((unsigned char)*pLine) != tolower((unsigned char)*pName)) { return 0; }
+        pLine++;
+        pName++;
+    }
+
+    while(*pLine == ' ' || *pLine == '\t') { pLine++; }
+    return pLine;
+}
+
+HTTP_Client::HTTP_Client(Transport *pTransport, uint8_t SocketID, const char *pHost, uint16_t Port) : SocketID(SocketID), Port(Port)
+{
+    this->pTransport = pTransport;
+    this->pHost = pHost;
+}
+
+STATUS HTTP_Client::Request(eMethod Method, const char *pPath, const char *pContentType, const uint8_t *pBody, uint16_t BodyLen, uint8_t Tag)
+{
+request *pRequest;
+size_t Space;
+int len;
+
+    if(QueueCount >= HTTP_CLIENT_QUEUE_LEN || pPath == 0 || (int)Method >= (int)(sizeof(HTTP_ClientMethod) / sizeof(HTTP_ClientMethod[0]))) { return ERROR; }
+
+    for(int i = 0; i < 2; i++)  //  second attempt after buffer compaction
+    {
+        Space = HTTP_CLIENT_TX_BUFFER_SIZE - TxEnd;
+
+        if(Port == 80) { len = snprintf(&TxBuffer[TxEnd], Space, "%s %s HTTP/1.1\r\nHost: %s\r\n", HTTP_ClientMethod[(int)Method], pPath, pHost); }
+        else           { len = snprintf(&TxBuffer[TxEnd], Space, "%s %s HTTP/1.1\r\nHost: %s:%u\r\n", HTTP_ClientMethod[(int)Method], pPath, pHost, Port); }
+
+        if(len > 0 && (size_t)len < Space && pContentType)
+        {
+            len += snprintf(&TxBuffer[TxEnd + len], Space - len, "Content-Type: %s\r\n", pContentType);
+        }
+
+        if(len > 0 && (size_t)len < Space && (BodyLen || Method == eMethod::Post || Method == eMethod::Put))
+        {
+            len += snprintf(&TxBuffer[TxEnd + len], Space - len, "Content-Length: %u\r\n", BodyLen);
+        }
+
+        if(len > 0 && (size_t)len < Space)
+        {
+            len += snprintf(&TxBuffer[TxEnd + len], Space - len, "\r\n");
+        }
+
+        if(len > 0 && (size_t)len + BodyLen < Space) { break; }    //  request fits
+
+        len = -1;
+        if(SendingCount || TxStart == 0) { break; }     //  buffer can't be compacted now or it doesn't help
+        Compact();
+    }
+
+    if(len < 0) { return ERROR; }
+
+    if(BodyLen) { memcpy(&TxBuffer[TxEnd + len], pBody, BodyLen); }
+
+    pRequest = &Queue[(QueueFirst + QueueCount) % HTTP_CLIENT_QUEUE_LEN];
+    pRequest->Len = (uint16_t)(len + BodyLen);
+    pRequest->Tag = Tag;
+    QueueCount++;
+    TxEnd += pRequest->Len;
+
+    if(BatchPending == false)   //  first request of the batch
+    {
+        BatchPending = true;
+        BatchTimer.Reset();
+    }
+
+    return SUCCESS;
+}
+
+void HTTP_Client::Handle()
+{
+Transport::eSocketState State = pTransport->GetSocketState(SocketID);
+
+    switch(STEP)
+    {
+    case 0:     //  not connected, connect when there are requests
+        if(QueueCount == 0 || State != Transport::eSocketState::Closed) { break; }  //  previous connection may still be closing
+
+        if(SUCCESS == pTransport->OpenConnection(SocketID, pHost, Port))
+        {
+            StateTimer.Set(HTTP_CLIENT_CONNECT_TIMEOUT);
+            StateTimer.Reset();
+            STEP = 1;
+        }
+        else
+        {
+            ConnectionFailed();     //  e.g. host name can't be resolved
+        }
+        break;
+
+    case 1:     //  wait for connection
+        if(State == Transport::eSocketState::Connected)
+        {
+            if(SUCCESS != pTransport->ListenSocketStream(SocketID, RxBuffer, sizeof(RxBuffer)))
+            {
+                Close();
+                break;
+            }
+
+            RxState = eRxState::StatusLine;
+            LineLen = 0;
+            ResponseStarted = false;
+            CloseAfter = false;
+            SentCount = 0;
+            SendingCount = 0;
+            RestartTimer();
+            STEP = 2;
+            Send();
+            break;
+        }
+
+        if(State == Transport::eSocketState::Closed || State == Transport::eSocketState::Error || StateTimer.Elapsed())
+        {
+            if(State != Transport::eSocketState::Closed) { pTransport->CloseSocket(SocketID); }
+            ConnectionFailed();
+        }
+        break;
+
+    case 2:     //  connected: receive responses, send queued requests
+        if(Receive() == false)
+        {
+            FailAll(HTTP_CLIENT_STATUS_BAD_RESPONSE);
+            Close();
+            break;
+        }
+
+        if(STEP != 2) { break; }    //  closed after response
+
+        if(State != Transport::eSocketState::Connected)
+        {
+            if(RxState == eRxState::UntilClose) { ResponseComplete(); }     //  end of body is indicated by closing
+
+            if(SentCount || SendingCount)
+            {
+                ConnectionFailed();     //  requests without response are sent again
+            }
+            else
+            {
+                STEP = 0;   //  closed while idle (e.g. keep-alive timeout of server): not a failure, queued requests connect again at once
+            }
+
+            if(State != Transport::eSocketState::Closed) { pTransport->CloseSocket(SocketID); }
+            break;
+        }
+
+        Send();
+
+        if(StateTimer.Elapsed())
+        {
+            if(SentCount || SendingCount)   //  no response
+            {
+                pTransport->CloseSocket(SocketID);
+                ConnectionFailed();
+            }
+            else if(QueueCount == 0)        //  idle
+            {
+                Close();
+            }
+        }
+        break;
+
+    case 3:     //  pause after failed connection
+        if(StateTimer.Elapsed())
+        {
+            StateTimer.Stop();
+            STEP = 0;
+        }
+        break;
+
+    case 4:     //  wait for socket to close
+        if(State == Transport::eSocketState::Closed) { STEP = 0; }
+        break;
+
+    default:
+        STEP = 0;
+        break;
+    }
+}
+
+void HTTP_Client::Send(void)
+{
+Transport::eSocketSendDataStatus TxStatus;
+uint8_t Unsent, Num;
+uint16_t Offset;
+
+    if(SendingCount)
+    {
+        TxStatus = pTransport->GetDataSendStatus(SocketID);
+        if(TxStatus == Transport::eSocketSendDataStatus::SendSuccess)
+        {
+            SentCount += SendingCount;
+            SendingCount = 0;
+            RestartTimer();
+        }
+        else if(TxStatus == Transport::eSocketSendDataStatus::SendFail)
+        {
+            pTransport->CloseSocket(SocketID);
+            ConnectionFailed();
+            return;
+        }
+        else
+        {
+            return;     //  sending in progress
+        }
+    }
+
+    if(CloseAfter) { return; }  //  server closes connection after the current response, rest is sent with next connection
+
+    Unsent = QueueCount - SentCount;
+    if(Unsent == 0) { return; }
+
+    if(BatchPending && BatchTimer.Elapsed())
+    {
+        BatchPending = false;
+        BatchTimer.Stop();
+    }
+
+    if(BatchPending && SentCount + Unsent < HTTP_CLIENT_PIPELINE_MAX && QueueCount < HTTP_CLIENT_QUEUE_LEN) { return; }    //  wait for more requests
+
+    Num = HTTP_CLIENT_PIPELINE_MAX - SentCount;
+    if(SentCount >= HTTP_CLIENT_PIPELINE_MAX) { return; }   //  wait for responses
+    if(Num > Unsent) { Num = Unsent; }
+
+    if(SendingCount == 0 && SentCount == 0) { Compact(); }  //  nothing is referenced by transport
+
+    Offset = TxStart + RequestsLen(0, SentCount);
+    if(SUCCESS == pTransport->SocketSend(SocketID, (uint8_t*)&TxBuffer[Offset], RequestsLen(SentCount, Num)))
+    {
+        SendingCount = Num;
+        BatchPending = false;
+        BatchTimer.Stop();
+        RestartTimer();
+    }
+}
+
+bool HTTP_Client::Receive(void)
+{
+uint16_t Len;
+
+    Len = pTransport->SocketRecv(SocketID);
+    if(Len == 0) { return true; }
+
+    if(Len == (uint16_t)-1) { return false; }   //  data lost (HUART buffer overflow)
+
+    if(Parse(RxBuffer, Len) == false) { return false; }
+
+    if(STEP == 2) { pTransport->ListenSocketStream(SocketID, RxBuffer, sizeof(RxBuffer)); }     //  next part
+    RestartTimer();
+    return true;
+}
+
+bool HTTP_Client::Parse(const uint8_t *pData, uint16_t Len)
+{
+const char *pLF;
+uint16_t n;
+uint8_t Tag;
+
+    while(Len && STEP == 2)
+    {
+        Tag = Queue[QueueFirst].Tag;
+
+        switch(RxState)
+        {
+        case eRxState::Body:
+            n = (BodyLeft < Len) ? (uint16_t)BodyLeft : Len;
+            if(pCallback) { pCallback(pContext, Tag, Status, pData, n, false); }
+            pData += n;
+            Len -= n;
+            BodyLeft -= n;
+            if(BodyLeft == 0)
+            {
+                if(Chunked) { RxState = eRxState::ChunkEnd; }
+                else        { ResponseComplete(); }
+            }
+            break;
+
+        case eRxState::UntilClose:
+            if(pCallback) { pCallback(pContext, Tag, Status, pData, Len, false); }
+            Len = 0;
+            break;
+
+        default:    //  line by line
+            pLF = Scan_FindByte((const char*)pData, Len, '\n');
+            n = pLF ? (uint16_t)(pLF - (const char*)pData) : Len;
+
+            if(LineLen + n > HTTP_CLIENT_LINE_SIZE - 1)     //  only beginning of long line is kept
+            {
+                if(LineLen < HTTP_CLIENT_LINE_SIZE - 1) { memcpy(&Line[LineLen], pData, HTTP_CLIENT_LINE_SIZE - 1 - LineLen); }
+                LineLen = HTTP_CLIENT_LINE_SIZE - 1;
+            }
+            else
+            {
+                memcpy(&Line[LineLen], pData, n);
+                LineLen += n;
+            }
+
+            if(pLF == 0)
+            {
+                Len = 0;
+                break;
+            }
+
+            pData += n + 1;
+            Len -= n + 1;
+
+            if(LineLen && Line[LineLen - 1] == '\r') { LineLen--; }
+            Line[LineLen] = 0;
+            LineLen = 0;
+
+            if(ParseLine() == false) { return false; }
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool HTTP_Client::ParseLine(void)
+{
+const char *pValue;
+unsigned long Value;
+
+    switch(RxState)
+    {
+    case eRxState::StatusLine:
+        if(Line[0] == 0) { break; }     //  empty lines before response are ignored
+
+        if(SentCount + SendingCount == 0) { return false; }     //  response without request
+        if(1 != sscanf(Line, "HTTP/%*u.%*u %d", &Status) || Status < 100) { return false; }
+
+        HasLength = false;
+        Chunked = false;
+        BodyLeft = 0;
+        ResponseStarted = true;
+        RxState = eRxState::Headers;
+        break;
+
+    case eRxState::Headers:
+        if(Line[0] != 0)
+        {
+            if((pValue = HeaderValue(Line, "Content-Length:")) != 0)
+            {
+                if(1 != sscanf(pValue, "%lu", &Value)) { return false; }
+                BodyLeft = Value;
+                HasLength = true;
+            }
+            else if((pValue = HeaderValue(Line, "Transfer-Encoding:")) != 0)
+            {
+                Chunked = (strstr(pValue, "chunked") != 0);
+            }
+            else if((pValue = HeaderValue(Line, "Connection:")) != 0)
+            {
+                if(HeaderValue(pValue, "close")) { CloseAfter = true; }
+            }
+            break;
+        }
+
+        /* end of header */
+        if(Status < 200)                        { RxState = eRxState::StatusLine; }     //  interim response (e.g. "100 Continue"), final one follows
+        else if(Status == 204 || Status == 304) { ResponseComplete(); }
+        else if(Chunked)                        { RxState = eRxState::ChunkSize; }
+        else if(HasLength)
+        {
+            if(BodyLeft) { RxState = eRxState::Body; }
+            else         { ResponseComplete(); }
+        }
+        else
+        {
+            RxState = eRxState::UntilClose;     //  body ends with connection
+            CloseAfter = true;
+        }
+        break;
+
+    case eRxState::ChunkSize:
+        if(1 != sscanf(Line, "%lx", &Value)) { return false; }  //  chunk extensions after ';' are ignored
+        BodyLeft = Value;
+        RxState = BodyLeft ? eRxState::Body : eRxState::Trailer;
+        break;
+
+    case eRxState::ChunkEnd:
+        if(Line[0] != 0) { return false; }  //  CRLF after chunk data expected
+        RxState = eRxState::ChunkSize;
+        break;
+
+    case eRxState::Trailer:
+        if(Line[0] == 0) { ResponseComplete(); }    //  trailer headers are ignored
+        break;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+void HTTP_Client::ResponseComplete(void)
+{
+request *pRequest = &Queue[QueueFirst];
+
+    if(pCallback) { pCallback(pContext, pRequest->Tag, Status, 0, 0, true); }
+
+    TxStart += pRequest->Len;
+    QueueFirst = (QueueFirst + 1) % HTTP_CLIENT_QUEUE_LEN;
+    QueueCount--;
+    if(SentCount) { SentCount--; }
+    else          { SendingCount--; }   //  response came before "SEND OK" was processed
+
+    if(QueueCount == 0 && SendingCount == 0) { TxStart = TxEnd = 0; }
+
+    Retries = 0;
+    ResponseStarted = false;
+    RxState = eRxState::StatusLine;
+    RestartTimer();
+
+    if(CloseAfter) { Close(); }
+}
+
+void HTTP_Client::ConnectionFailed(void)
+{
+request *pRequest;
+
+    if(ResponseStarted)     //  part of response is passed to application already, request is not repeated
+    {
+        pRequest = &Queue[QueueFirst];
+        if(pCallback) { pCallback(pContext, pRequest->Tag, HTTP_CLIENT_STATUS_FAILED, 0, 0, true); }
+        TxStart += pRequest->Len;
+        QueueFirst = (QueueFirst + 1) % HTTP_CLIENT_QUEUE_LEN;
+        QueueCount--;
+        ResponseStarted = false;
+    }
+
+    SentCount = 0;
+    SendingCount = 0;
+    RxState = eRxState::StatusLine;
+
+    if(++Retries >= HTTP_CLIENT_RETRIES_MAX)
+    {
+        Retries = 0;
+        FailAll(HTTP_CLIENT_STATUS_FAILED);
+    }
+
+    StateTimer.Set(HTTP_CLIENT_RETRY_TIME);
+    StateTimer.Reset();
+    STEP = 3;
+}
+
+void HTTP_Client::FailAll(int Status)
+{
+    while(QueueCount)
+    {
+        if(pCallback) { pCallback(pContext, Queue[QueueFirst].Tag, Status, 0, 0, true); }
+        QueueFirst = (QueueFirst + 1) % HTTP_CLIENT_QUEUE_LEN;
+        QueueCount--;
+    }
+
+    SentCount = 0;
+    SendingCount = 0;
+    ResponseStarted = false;
+    TxStart = TxEnd = 0;
+}
+
+void HTTP_Client::Close(void)
+{
+    pTransport->CloseSocket(SocketID);
+    SentCount = 0;          //  requests without response are sent with next connection
+    SendingCount = 0;
+    ResponseStarted = false;
+    RxState = eRxState::StatusLine;
+    StateTimer.Stop();
+    STEP = 4;
+}
+
+void HTTP_Client::Compact(void)
+{
+    if(TxStart == 0) { return; }
+
+    memmove(TxBuffer, &TxBuffer[TxStart], TxEnd - TxStart);
+    TxEnd -= TxStart;
+    TxStart = 0;
+}
+
+void HTTP_Client::RestartTimer(void)
+{
+    StateTimer.Set((SentCount || SendingCount) ? HTTP_CLIENT_RESPONSE_TIMEOUT : HTTP_CLIENT_IDLE_TIMEOUT);
+    StateTimer.Reset();
+}
+
+uint16_t HTTP_Client::RequestsLen(uint8_t First, uint8_t Num)
+{
+uint16_t Len = 0;
+
+    for(uint8_t i = First; i < First + Num; i++)
+    {
+        Len += Queue[(QueueFirst + i) % HTTP_CLIENT_QUEUE_LEN].Len;
+    }
+
+    return Len;
+}
+
+#endif  //  HTTP_CLIENT_EN
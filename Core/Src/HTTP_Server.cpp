@@ -26,6 +26,8 @@
  */
 
 #include "HTTP_Server.hpp"
+#include "Scan.h"
+#include <ctype.h>
 
 /*  This version of server handles one connection at a time to save RAM   */
 
@@ -37,33 +39,133 @@ const char HTTP_ServerResponseInternalServerError[] = "HTTP/1.1 500 Internal Ser
 const char HTTP_ServerResponseBadRequest[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
 const char HTTP_ServerResponseNotFound[] = "HTTP/1.1 404 Not Found\r\n\r\n";
 const char HTTP_ServerResponseURITooLarge[] = "HTTP/1.1 414 Request URI too large\r\n\r\n";
+const char HTTP_ServerResponseMethodNotAllowed[] = "HTTP/1.1 405 Method Not Allowed\r\n\r\n";
+const char HTTP_ServerResponseServiceUnavailable[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 10\r\n\r\n";
+#ifdef HTTP_SERV_GENERATED_RESPONSES
+const char HTTP_ServerResponseOKText[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; charset=utf-8\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n";
+#endif
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+static const char* const HTTP_LatencyPhaseName[] = {"connect_to_rx", "rx_to_parsed", "render", "rendered_to_send_ok", "send", "send_ok_to_closed", "total"};
+#endif
+#ifdef METRICS_EN
+using OKO_STATS::Metric;
+static const unsigned int HTTP_MetricStatusCode[] = {200, 206, 304, 400, 404, 405, 413, 414, 416, 429, 500, 503};     //  other codes are counted by the last metric
+static Metric HTTP_MetricResponses[] = {
+        {"http_responses_total", "Responses sent by status code", Metric::eType::Counter, "code=\"200\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"206\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"304\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"400\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"404\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"405\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"413\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"414\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"416\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"429\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"500\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"503\""},
+        {"http_responses_total", "", Metric::eType::Counter, "code=\"other\""}
+};
+static_assert(sizeof(HTTP_MetricResponses) / sizeof(HTTP_MetricResponses[0]) == sizeof(HTTP_MetricStatusCode) / sizeof(HTTP_MetricStatusCode[0]) + 1, "one metric per status code and one for other codes");
+
+static void CountResponse(const char *pResponse)
+{
+unsigned int Code = 0;
+size_t i;
+
+    sscanf(pResponse, "HTTP/%*u.%*u %u", &Code);
+
+    for(i=0; i < sizeof(HTTP_MetricStatusCode) / sizeof(HTTP_MetricStatusCode[0]); i++)
+    {
+        if(HTTP_MetricStatusCode[i] == Code) { break; }
+    }
+
+    HTTP_MetricResponses[i].Add(1);     //  last one if code is not in the table
+}
+#endif
+#ifdef HTTP_SERV_ROMFS_EN
+/* true if value of "Accept-Encoding" header allows gzip: "gzip" (or "*") is listed without "q=0" */
+static bool HTTP_GzipAccepted(const char *pValue)
+{
+const char *p, *pEnd;
+
+    p = strstr(pValue, "gzip");
+    if(p == 0) { p = strchr(pValue, '*'); }
+    if(p == 0) { return false; }
+
+    pEnd = strchr(p, ',');      //  parameters of this coding only
+    p = strstr(p, "q=");
+    if(p && (pEnd == 0 || p < pEnd) && p[2] == '0')     //  "q=0", "q=0.0" refuse the coding, "q=0.5" does not
+    {
+        p += 3;
+        if(*p == '.') { p++; }
+        while(*p == '0') { p++; }
+        if(*p < '1' || *p > '9') { return false; }
+    }
+
+    return true;
+}
+#endif
+#ifdef ESP8266_SOCKET_EVENTS_EN
+/* Steps which only wait for something to happen to the socket (connection, data, end of sending, closing). Other steps
+ * wait for application or firmware writer and are executed every time */
+static bool StepWaitsForSocketEvent(int Step)
+{
+    switch(Step)
+    {
+    case 1: case 2: case 3: case 7: case 13: case 20: case 21: case 100: case 200: case 201:
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+#ifdef HTTP_SERV_RATE_LIMIT_EN
+const char HTTP_ServerResponseTooManyRequests[] = "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\nConnection: close\r\n\r\n";
+#endif
+#ifdef HTTP_SERV_OTA_EN
+const char HTTP_ServerResponsePayloadTooLarge[] = "HTTP/1.1 413 Payload Too Large\r\n\r\n";
+const char HTTP_ServerResponseContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+const char HTTP_ServerResponseOTAStatus[] = "HTTP/1.1 %s\r\nContent-Type: application/json\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n"
+                                            "{\"state\":\"%s\",\"progress\":%u,\"received\":%lu,\"size\":%lu,\"error\":\"%s\"}";
+#endif
+
+
+/* Parts of response header prepared in RequestString (see PrepareResponseHeader()) */
+const char HTTP_ServerResponseOKContentLength[] = "HTTP/1.1 200 OK\r\nContent-Length: %lu\r\n";
+const char HTTP_ServerResponsePartialContent[] = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %lu-%lu/%lu\r\nContent-Length: %lu\r\n";
+const char HTTP_ServerResponseRangeNotSatisfiable[] = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lu\r\n";
+const char HTTP_ServerResponseContentTypeHTML[] = "Content-Type: text/html; charset=utf-8\r\n";
+const char HTTP_ServerResponseConnectionClose[] = "Connection: close\r\n\r\n";
+#ifdef HTTP_SERV_ROMFS_EN
+const char HTTP_ServerResponseFileInfo[] = "Content-Type: %s\r\nETag: %s\r\nAccept-Ranges: bytes\r\n%s";
+const char HTTP_ServerResponseFileNotModified[] = "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n";
+const char HTTP_ServerResponseGzipEncoding[] = "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n";
+const char HTTP_ServerResponseNotAcceptable[] = "HTTP/1.1 406 Not Acceptable\r\n\r\n";
+#endif
+
+/* Longest header of PrepareResponseHeader(): 206 with 10-digit numbers instead of four %lu, Content-Type, ETag and Content-Encoding of file */
+static_assert(sizeof(HTTP_ServerResponsePartialContent) - 1 + 4 * (10 - 3)
+#ifdef HTTP_SERV_ROMFS_EN
+              + sizeof(HTTP_ServerResponseFileInfo) - 1 - 3 * 2 + ROMFS_MIME_TYPE_LEN_MAX + ROMFS_ETAG_LEN + sizeof(HTTP_ServerResponseGzipEncoding) - 1
+#else
+              + sizeof(HTTP_ServerResponseContentTypeHTML) - 1
+#endif
+              + sizeof(HTTP_ServerResponseConnectionClose) - 1 + 1 <= HTTP_SERV_RESPONSE_HEADER_MAX, "HTTP_SERV_RESPONSE_HEADER_MAX is too small for the longest response header");
 
 using namespace OKO_ESP8266;
 using namespace OKO_HTTP_SERVER;
+#ifdef HTTP_SERV_OTA_EN
+using namespace OKO_OTA;
+#endif
 
-HTTP_Server::HTTP_Server(ESP* pESP)
+HTTP_Server::HTTP_Server(Transport* pTransport, process *pProcess, uint8_t SocketsNum, char *pRequestStrings, uint16_t RequestStringSize) :
+    Process(pProcess), SocketsNum(SocketsNum), RequestStringSize(RequestStringSize)
 {
-    this->pESP = pESP;
+    this->pTransport = pTransport;      //  number of pages and their types are known at compile time (see HTTP_content.cpp)
 
-    for(int i=0; i<MaxNumOfPages; i++)
+    for(uint8_t i=0; i < SocketsNum; i++)
     {
-        if(HTTPServerContent[i].pPage == 0)
-        {
-            NumOfPages = i;
-            break;
-        }
-        else
-        {
-            HTTPServerContent[i].Type = HTTP_PageType::Static;
-            for(int j=0; j<HTTPServerContent[i].PageParts; j++)
-            {
-                if(HTTPServerContent[i].pPage[j].Size == 0)     //  page contain at least one field that should be generated dynamically by application
-                {
-                    HTTPServerContent[i].Type = HTTP_PageType::Dynamic;
-                    break;
-                }
-            }
-        }
+        Process[i].RequestString = &pRequestStrings[i * RequestStringSize];
     }
 }
 
@@ -77,24 +179,68 @@ HTTP_Server::process::process()
     HostNameTooLong = false;
     pSemaphore = 0;
     SendIndex = 0;
+    PartOffset = 0;
+    SendOffset = 0;
+    SendEnd = 0;
+    HeaderLen = 0;
+    HeaderOnly = false;
+    RangeRequested = false;
+    RangeSuffix = false;
+    RangeFirst = 0;
+    RangeLast = 0;
+    Service = eService::None;
+#ifdef HTTP_SERV_GENERATED_RESPONSES
+    GenLine = 0;
+#endif
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+    TsParsed = 0;
+    TsRendered = 0;
+    StatsSlot = 0;
+    StatsPending = false;
+#endif
+#ifdef HTTP_SERV_OTA_EN
+    RequestLen = 0;
+    BodyOffset = 0;
+    ContentLength = 0;
+    BodyReceived = 0;
+    ImageCRC = 0;
+    ImageCRCFound = false;
+    ExpectContinue = false;
+#endif
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+    ActiveTick = 0;
+#endif
+#ifdef HTTP_SERV_ROMFS_EN
+    pFile = 0;
+    ETagMatch = false;
+#endif
 }
 
 void HTTP_Server::Handle()
 {
-uint16_t DataLen;
-ResponseStatusCode Response;
-bool ret;
-bool CloseSocketAfterSending;
-uint8_t *pSendData = 0;
-size_t len;
-STATUS Status;
-int PageIndex;
+#ifdef HTTP_SERV_HANDLE_BUDGET_US
+uint32_t Start = Timestamp_Get();
+uint8_t Passes = 0;
+#endif
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+int IdleTimeout;
+#endif
 
     if(BaseTimer.Elapsed())
     {
         BaseTimer.Reset();    //  TODO: Timer should be changed to restart automatically then this line to be removed and timer initialization to be changed in constructor
-        for(uint8_t i=0; i < HTTP_SERVER_SOCKETS_MAX; i++)
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+        IdleClock++;
+        IdleTimeout = GetIdleTimeout();
+#endif
+        for(uint8_t i=0; i < SocketsNum; i++)
         {
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+            if(Process[i].STEP == 2 && Process[i].TimeCounter > IdleTimeout)    //  connected, request not received yet
+            {
+                Process[i].TimeCounter = IdleTimeout;
+            }
+#endif
             if(Process[i].TimeCounter)
             {
                 Process[i].TimeCounter--;
@@ -104,15 +250,64 @@ int PageIndex;
                 }
             }
         }
+#ifdef HTTP_SERV_RATE_LIMIT_EN
+        RefillRateLimitBuckets();
+#endif
+    }
+
+#ifdef HTTP_SERV_OTA_EN
+    if(pOTA) { pOTA->Handle(); }    //  erase/program/verify flash step by step
+#endif
+
+#ifdef HTTP_SERV_HANDLE_BUDGET_US
+    /* run to completion: e.g. parsed request is rendered and its header is sent in the same call, but not longer than budget */
+    while(HandleSockets())
+    {
+        if(++Passes >= HTTP_SERV_HANDLE_PASSES_MAX) { break; }
+        if(Timestamp_ElapsedUs(Start, Timestamp_Get()) >= HTTP_SERV_HANDLE_BUDGET_US) { break; }
+    }
+#else
+    HandleSockets();
+#endif
+}
+
+bool HTTP_Server::HandleSockets(void)
+{
+uint16_t DataLen;
+ResponseStatusCode Response;
+bool ret;
+uint8_t *pSendData = 0;
+size_t len;
+STATUS Status;
+int Step;
+bool Progress = false;
+#ifdef ESP8266_SOCKET_EVENTS_EN
+Transport::socket_event Event;
+
+    while(pTransport->GetSocketEvent(Event))  //  wake up processes of sockets with news
+    {
+        if(Event.Type == Transport::eSocketEvent::Overflow)           { SocketWaiting = 0; }
+        else if(Event.SocketID < SocketsNum)       { SocketWaiting &= ~(1U << Event.SocketID); }
     }
+#endif
 
-    for(uint8_t i=0; i < HTTP_SERVER_SOCKETS_MAX; i++)
+    for(uint8_t i=0; i < SocketsNum; i++)
     {
+        Step = Process[i].STEP;
+
+#ifdef ESP8266_SOCKET_EVENTS_EN
+        if(Process[i].TimeoutFlag) { SocketWaiting &= ~(1U << i); }
+        if(SocketWaiting & (1U << i)) { continue; }     //  nothing happened to the socket since the last check
+#endif
+
         if(Process[i].TimeoutFlag)
         {
-            if(pESP->GetSocketState(i) != ESP::eSocketState::Closed)
+#ifdef HTTP_SERV_OTA_EN
+            if(Process[i].STEP >= 10 && Process[i].STEP <= 13) { pOTA->Abort(); }  //  upload interrupted
+#endif
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Closed)
             {
-                pESP->CloseSocket(i);
+                pTransport->CloseSocket(i);
                 Process[i].STEP = 200;  //  Close connected but inactive socket
             }
             Process[i].TimeoutFlag = false;
@@ -121,7 +316,20 @@ int PageIndex;
         switch(Process[i].STEP)
         {
         case 0:     // assign buffer for incoming stream and unlock receiving
-            if(SUCCESS == pESP->ListenSocket(i, (unsigned char*)Process[i].RequestString, sizeof(Process[i].RequestString)))
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+            if(Process[i].StatsPending)     //  previous connection is closed
+            {
+                RecordLatency(i);
+                Process[i].StatsPending = false;
+            }
+#endif
+#ifdef HTTP_SERV_OTA_EN
+            //  stream mode: body of upload longer than the buffer is not cut. Last byte is reserved for string termination
+            Status = pTransport->ListenSocketStream(i, (unsigned char*)Process[i].RequestString, RequestStringSize - 1);
+#else
+            Status = pTransport->ListenSocket(i, (unsigned char*)Process[i].RequestString, RequestStringSize - 1);    //  last byte is reserved for string termination
+#endif
+            if(SUCCESS == Status)
             {
                 Process[i].TimeCounter = SocketConnectionTimeOut;
                 Process[i].TimeoutFlag = false;
@@ -130,9 +338,13 @@ int PageIndex;
             break;
 
         case 1:     //  check socket state, set timeouts
-            if(pESP->GetSocketState(i) == ESP::eSocketState::Connected)
+            if(pTransport->GetSocketState(i) == Transport::eSocketState::Connected)
             {
                 Process[i].STEP = 2;
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+                Process[i].ActiveTick = IdleClock;
+                if(GetFreeSockets() == 0) { EvictIdleSocket(i); }   //  the last free socket is taken, make room for the next client
+#endif
             }
 
             Process[i].TimeCounter = SocketConnectionTimeOut;
@@ -141,41 +353,115 @@ int PageIndex;
 
         case 2:     // wait for new data
             // check socket state, set timeouts
-            if(pESP->GetSocketState(i) != ESP::eSocketState::Connected)
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected)
             {
-                if(pESP->GetSocketState(i) == ESP::eSocketState::Closed)
+                if(pTransport->GetSocketState(i) == Transport::eSocketState::Closed)
                 {
                     Process[i].STEP = 0;
                     break;
                 }
 
-                pESP->CloseSocket(i);
+                pTransport->CloseSocket(i);
                 Process[i].STEP = 200;
                 break;
             }
 
             // receive data
-            DataLen = pESP->SocketRecv(i);
+            DataLen = pTransport->SocketRecv(i);
             if(DataLen == (uint16_t)-1)    //  Incoming Message is longer than available buffer and therefore has been cut
             {
-                DataLen = sizeof(Process[i].RequestString);
-                Process[i].RequestString[HTTP_CLIENT_REQUEST_STRING_SIZE-1] = 0;    //  terminate string to use sscanf() safe later on
+                DataLen = RequestStringSize - 1;
+                Process[i].RequestString[DataLen] = 0;    //  terminate string to use sscanf() safe later on
+#ifdef HTTP_SERV_OTA_EN
+                Process[i].RequestLen = 0;  //  body is not valid
+#endif
             }
             else if(DataLen)
             {
                 Process[i].RequestString[DataLen] = 0;    //  terminate string to use sscanf() safe later on
+#ifdef HTTP_SERV_OTA_EN
+                Process[i].RequestLen = DataLen;
+#endif
             }
 
             if(DataLen)     //  parse message
             {
                 Process[i].TimeCounter = SocketConnectionTimeOut;   //  prolong timeout time
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+                Process[i].ActiveTick = IdleClock;
+#endif
+
+#ifdef HTTP_SERV_RATE_LIMIT_EN
+                Response = CheckRateLimit(i);   //  client over its budget gets precomputed response without parsing and rendering
+                if(Response == ResponseStatusCode::OK)
+                {
+                    Response = ParseHTTPRequest(Process[i].RequestString, DataLen + 1, i);
+                }
+#else
+                Response = ParseHTTPRequest(Process[i].RequestString, DataLen + 1, i);
+#endif
+
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+                Process[i].TsParsed = Timestamp_Get();
+                Process[i].TsRendered = 0;
+                Process[i].StatsPending = true;
+                Process[i].StatsSlot = HTTP_SERV_LATENCY_PAGES - 1;     //  other pages, files and errors
+                if(Response == ResponseStatusCode::OK && Process[i].Service == eService::None &&
+#ifdef HTTP_SERV_ROMFS_EN
+                   Process[i].pFile == 0 &&
+#endif
+                   Process[i].RequestedPageIndex < HTTP_SERV_LATENCY_PAGES - 1)
+                {
+                    Process[i].StatsSlot = (uint8_t)Process[i].RequestedPageIndex;
+                }
+#endif
+
+                /* error responses, status and API are not queued behind files and pages sent to other clients */
+                if(Response != ResponseStatusCode::OK || Process[i].Service != eService::None) { pTransport->SetSocketTxClass(i, Transport::eTxClass::Control); }
+#ifdef HTTP_SERV_ROMFS_EN
+                else if(Process[i].pFile)                                                      { pTransport->SetSocketTxClass(i, Transport::eTxClass::Bulk); }
+#endif
+                else                                                                           { pTransport->SetSocketTxClass(i, Transport::eTxClass::Normal); }
 
-                Response = ParseHTTPRequest(Process[i].RequestString, HTTP_CLIENT_REQUEST_STRING_SIZE, i);
+#ifdef HTTP_SERV_OTA_EN
+                if(Process[i].Service != eService::OTAUpload || Response != ResponseStatusCode::OK)
+                {
+                    pTransport->SocketRxDiscard(i);   //  rest of long message is not needed, resume receiving from module
+                }
+#endif
 
                 pSendData = 0;
                 switch(Response)
                 {
                 case ResponseStatusCode::OK:
+#ifdef HTTP_SERV_OTA_EN
+                    if(Process[i].Service == eService::OTAUpload)
+                    {
+                        Process[i].STEP = 10;   //  Next step - start firmware update
+                        break;
+                    }
+                    if(Process[i].Service == eService::OTAStatus)
+                    {
+                        Process[i].HeaderLen = PrepareOTAResponse(i);
+                        Process[i].HeaderOnly = true;
+                        Process[i].STEP = 7;    //  Next step - send status
+                        break;
+                    }
+#endif
+#ifdef HTTP_SERV_GENERATED_RESPONSES
+                    if(Process[i].Service != eService::None)
+                    {
+                        Process[i].STEP = 20;   //  Next step - send generated response
+                        break;
+                    }
+#endif
+#ifdef HTTP_SERV_ROMFS_EN
+                    if(Process[i].pFile)    //  file from ROMFS requested
+                    {
+                        Process[i].STEP = 6;    //  Next step - prepare response and send file
+                        break;
+                    }
+#endif
                     if(HTTPServerContent[Process[i].RequestedPageIndex].Type == HTTP_PageType::Dynamic)
                     {
                         // Generate dynamic parts of the page by application
@@ -193,14 +479,13 @@ int PageIndex;
                         {
                             if(Process[i].pSemaphore == 0)  //  no need to wait for application
                             {
-                                Process[i].STEP = 3;    //  Next step - send page
+                                Process[i].STEP = 6;    //  Next step - prepare response and send page
                             }
                             else                            //  wait for application to render the page
                             {
                                 Process[i].TimeCounter = ApplicationResponseTimeout;    // set timeout for rendering
                                 Process[i].STEP = 4;    //  Next step - send page
                             }
-                            Process[i].SendIndex = 0;
                             break;
                         }
                         else    //  application was not able to render page, return error code
@@ -212,8 +497,7 @@ int PageIndex;
                     }
                     else    //  static page
                     {
-                        Process[i].SendIndex = 0;
-                        Process[i].STEP = 3;    //  Next step - send page
+                        Process[i].STEP = 6;    //  Next step - prepare response and send page
                     }
                     break;
 
@@ -225,13 +509,27 @@ int PageIndex;
                 /* Following responses can be implemented separately. Here is not implemented to save resources */
                 case ResponseStatusCode::Continue:
                 case ResponseStatusCode::Forbidden:
-                case ResponseStatusCode::MethodNotAllowed:
                 case ResponseStatusCode::NotModified:
-                case ResponseStatusCode::ServiceUnavailable:
                 case ResponseStatusCode::AuthenticationRequired:
                     pSendData = (uint8_t*)HTTP_ServerResponseInternalServerError;
                     break;
 
+                case ResponseStatusCode::ServiceUnavailable:
+                    pSendData = (uint8_t*)HTTP_ServerResponseServiceUnavailable;
+                    break;
+
+#ifdef HTTP_SERV_RATE_LIMIT_EN
+                case ResponseStatusCode::TooManyRequests:
+                    pSendData = (uint8_t*)HTTP_ServerResponseTooManyRequests;
+                    break;
+#endif
+
+#ifdef HTTP_SERV_OTA_EN
+                case ResponseStatusCode::PayloadTooLarge:
+                    pSendData = (uint8_t*)HTTP_ServerResponsePayloadTooLarge;
+                    break;
+#endif
+
                 case ResponseStatusCode::RequestURItooLarge:
                     pSendData = (uint8_t*)HTTP_ServerResponseURITooLarge;
                     break;
@@ -240,14 +538,30 @@ int PageIndex;
                     pSendData = (uint8_t*)HTTP_ServerResponseNotFound;
                     break;
 
+                case ResponseStatusCode::MethodNotAllowed:
+                    pSendData = (uint8_t*)HTTP_ServerResponseMethodNotAllowed;
+                    break;
+
+#ifdef HTTP_SERV_ROMFS_EN
+                case ResponseStatusCode::NotAcceptable:
+                    pSendData = (uint8_t*)HTTP_ServerResponseNotAcceptable;
+                    break;
+#endif
+
                 default:
                     pSendData = (uint8_t*)HTTP_ServerResponseInternalServerError;
                 }
 
                 if(pSendData)
                 {
-                    if(SUCCESS == pESP->SocketSendClose(i, pSendData, (uint16_t)strlen((const char*)pSendData)))
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+                    Process[i].TsRendered = Timestamp_Get();    //  nothing to render
+#endif
+                    if(SUCCESS == pTransport->SocketSendClose(i, pSendData, (uint16_t)strlen((const char*)pSendData)))
                     {
+#ifdef METRICS_EN
+                        CountResponse((const char*)pSendData);
+#endif
                         //  wait for socket close
                         Process[i].TimeCounter = MessageSendTimeout;    // set socket close timeout
                         Process[i].STEP = 100;
@@ -255,7 +569,7 @@ int PageIndex;
                     }
                     else
                     {
-                        pESP->CloseSocket(i);
+                        pTransport->CloseSocket(i);
                         Process[i].STEP = 200;
                         break;
                     }
@@ -265,171 +579,433 @@ int PageIndex;
 
             break;
 
-        case 3: //  SEND PAGE
-            if(pESP->GetSocketState(i) != ESP::eSocketState::Connected ||
-                   pESP->GetDataSendStatus(i) == ESP::eSocketSendDataStatus::SendFail)
+        case 3: //  SEND PAGE OR FILE: content from SendOffset up to SendEnd (whole content or requested range), part by part
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected ||
+                   pTransport->GetDataSendStatus(i) == Transport::eSocketSendDataStatus::SendFail)
             {
                 Process[i].STEP = 200;
                 break;
             }
 
-            PageIndex = Process[i].RequestedPageIndex;
+            if(Process[i].SendOffset >= Process[i].SendEnd) { break; }     //  everything is sent, socket is closed by ESP after sending
 
-            if(Process[i].SendIndex < HTTPServerContent[PageIndex].PageParts)
+            /* seek to the part containing SendOffset, skipping parts that are already sent, out of requested range or empty */
+            pSendData = 0;
+            while(Process[i].SendIndex < GetContentParts(i))
             {
-                if(Process[i].SendIndex+1 == HTTPServerContent[PageIndex].PageParts) { CloseSocketAfterSending = true; }    // last part of page
-                else                                                         { CloseSocketAfterSending = false; }
+                pSendData = (uint8_t*)GetContentPart(i, Process[i].SendIndex, &len);
+                if(Process[i].PartOffset + len > Process[i].SendOffset) { break; }
+                Process[i].PartOffset += len;
+                Process[i].SendIndex++;
+                pSendData = 0;
+            }
 
-                if(HTTPServerContent[PageIndex].pPage[Process[i].SendIndex].Size == 0)  //  dynamic part of page, size is not known, need to calculate
-                {
-                    len = strlen(HTTPServerContent[PageIndex].pPage[Process[i].SendIndex].pContent);
-                    if(len)
-                    {
-                        pSendData = (uint8_t*)HTTPServerContent[PageIndex].pPage[Process[i].SendIndex].pContent;
-                    }
-                    else    //  empty block, send next block
-                    {
-                        // do nothing
-                    }
-                }
-                else
-                {
-                    pSendData = (uint8_t*)HTTPServerContent[PageIndex].pPage[Process[i].SendIndex].pContent;
-                    len = HTTPServerContent[PageIndex].pPage[Process[i].SendIndex].Size;
-                }
+            if(pSendData == 0)  //  content is shorter than expected (dynamic part changed while sending), nothing more to send
+            {
+                pTransport->CloseSocket(i);
+                Process[i].STEP = 200;
+                break;
+            }
 
-                if(len)     //  there are data to send
-                {
-                    if(CloseSocketAfterSending)
-                    {
-                        Status = pESP->SocketSendClose(i, pSendData, (uint16_t)len);    //  this will also change STEP after data are sent out
-                        if(Status == SUCCESS) debug_print("SRV: SendAndClose, len=%u\n", len);
-                    }
-                    else
-                    {
-                        Status = pESP->SocketSend(i, pSendData, (uint16_t)len);
-                        if(Status == SUCCESS) debug_print("SRV: Send, len=%u\n", len);
-                    }
+            pSendData += Process[i].SendOffset - Process[i].PartOffset;
+            len -= Process[i].SendOffset - Process[i].PartOffset;
+            if(len > Process[i].SendEnd - Process[i].SendOffset) { len = Process[i].SendEnd - Process[i].SendOffset; }
+            if(len > 0xFFFF) { len = 0xFFFF; }     //  SocketSend() limit, rest of the part is sent in the next cycle
 
-                    if(Status == SUCCESS)   //  Next part of page
-                    {
-                        Process[i].SendIndex++;
-                        Process[i].TimeCounter = SocketConnectionTimeOut;   //  prolong timeout time
-                        break;
-                    }
-                    else
-                    {
-                        //  previous block is sending, wait for next cycle
-                        break;
-                    }
-                }
+            if(Process[i].SendOffset + len >= Process[i].SendEnd)   //  last piece of content
+            {
+                Status = pTransport->SocketSendClose(i, pSendData, (uint16_t)len);    //  this will also change STEP after data are sent out
+                if(Status == SUCCESS) debug_print("SRV: SendAndClose, len=%u\n", (unsigned int)len);
+            }
+            else
+            {
+                Status = pTransport->SocketSend(i, pSendData, (uint16_t)len);
+                if(Status == SUCCESS) debug_print("SRV: Send, len=%u\n", (unsigned int)len);
             }
 
+            if(Status == SUCCESS)   //  Next piece of content
+            {
+                Process[i].SendOffset += len;
+                Process[i].TimeCounter = SocketConnectionTimeOut;   //  prolong timeout time
+            }
+            //  else previous block is sending, wait for next cycle
             break;
 
         case 4:     //  check if application is ready with page rendering
             if(*(Process[i].pSemaphore) == true)  //  application is ready with page rendering
             {
-                Process[i].STEP = 3;    //  send out rendered page
+                Process[i].STEP = 6;    //  send out rendered page
             }
             break;
 
-        case 100:   //  wait timeout and then close socket if not already closed
-            if(pESP->GetSocketState(i) == ESP::eSocketState::Closed )
+        case 6:     //  PREPARE RESPONSE: calculate content length, resolve requested range, write header into RequestString (request is not needed anymore)
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+            Process[i].TsRendered = Timestamp_Get();
+#endif
+            Process[i].HeaderLen = PrepareResponseHeader(i);
+            if(Process[i].HeaderLen)
             {
-                Process[i].TimeCounter = 0;
-                Process[i].STEP = 0;
+                Process[i].STEP = 7;
             }
-
-            if(Process[i].TimeoutFlag)
+            else if(Process[i].SendOffset < Process[i].SendEnd)
             {
-                if(SUCCESS == pESP->CloseSocket(i))
-                {
-                    Process[i].STEP = 200;
-                }
+#ifdef METRICS_EN
+                CountResponse(HTTP_ServerResponseOKShort);  //  page is sent without header
+#endif
+                Process[i].STEP = 3;
+            }
+            else    //  nothing to send
+            {
+                pTransport->CloseSocket(i);
+                Process[i].STEP = 200;
             }
-
             break;
 
-        case 200:
-            if(pESP->GetSocketState(i) == ESP::eSocketState::Closed )
+        case 7:     //  SEND RESPONSE HEADER, then content
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+            if(Process[i].TsRendered == 0) { Process[i].TsRendered = Timestamp_Get(); }   //  response prepared without step 6
+#endif
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected)
             {
-                Process[i].STEP = 0;
+                Process[i].STEP = 200;
+                break;
             }
-            else if(pESP->GetSocketState(i) == ESP::eSocketState::Connected ||     //  Socket has been connected again after closing, between steps
-                    pESP->GetSocketState(i) == ESP::eSocketState::Error)
+
+            if(Process[i].HeaderOnly)
             {
-                Process[i].STEP = 201;  //  Close socket because HTTP Server was not ready when it opened (should be very exceptional case)
+                Status = pTransport->SocketSendClose(i, (uint8_t*)Process[i].RequestString, (uint16_t)Process[i].HeaderLen);
+            }
+            else
+            {
+                Status = pTransport->SocketSend(i, (uint8_t*)Process[i].RequestString, (uint16_t)Process[i].HeaderLen);
             }
-            break;
 
-        case 201:   //  Socket timeout, close socket
-            if(pESP->GetSocketState(i) != ESP::eSocketState::Closing )
+            if(Status == SUCCESS)
             {
-                if(SUCCESS == pESP->CloseSocket(i))
+#ifdef METRICS_EN
+                CountResponse(Process[i].RequestString);
+#endif
+                if(Process[i].HeaderOnly)
                 {
-                    Process[i].STEP = 200;
+                    Process[i].TimeCounter = MessageSendTimeout;    // set socket close timeout
+                    Process[i].STEP = 100;
                 }
                 else
                 {
-                    Process[i].STEP = 0;
+                    Process[i].TimeCounter = SocketConnectionTimeOut;   //  prolong timeout time
+                    Process[i].STEP = 3;
                 }
             }
             break;
 
-        default:
-            Process[i].STEP = 0;
-            break;
-        }
-    }
-}
-
-
-HTTP_Server::ResponseStatusCode HTTP_Server::ParseHTTPRequest(char *ReqStr, size_t len, uint8_t SocketID)
-{
-int pos = 0;
-char c;
-bool PageFound = false;
-int num;
-bool exit = false;
-int HTTPVersion[2] = {0,0};
-char *p;
-enum class cMethod {NotImplemented = 0, Get, Post};
-cMethod Method = cMethod::NotImplemented;
-char *ReqStrStart = ReqStr;
-char *ReqStrEnd = &ReqStr[len-1];
-ResponseStatusCode response;
+#ifdef HTTP_SERV_OTA_EN
+        case 10:    //  FIRMWARE UPDATE: start writer, staging area of flash is erased in background
+            if(SUCCESS == pOTA->Begin(Process[i].ContentLength, Process[i].ImageCRC))
+            {
+                Process[i].BodyReceived = 0;
+                Process[i].STEP = 11;
+                break;
+            }
 
-    switch(ReqStr[0])
-    {
-    case 'G':   // GET method
-        if(0 == strncmp(ReqStr, "GET /", 5))
-        {
-            if(0 == strncmp(ReqStr, "GET /", 5))
+            pTransport->SocketRxDiscard(i);   //  other update is in progress
+            if(SUCCESS == pTransport->SocketSendClose(i, (uint8_t*)HTTP_ServerResponseServiceUnavailable, (uint16_t)strlen(HTTP_ServerResponseServiceUnavailable)))
             {
-                Method = cMethod::Get;
-                ReqStr += 5;
+#ifdef METRICS_EN
+                CountResponse(HTTP_ServerResponseServiceUnavailable);
+#endif
+                Process[i].TimeCounter = MessageSendTimeout;    // set socket close timeout
+                Process[i].STEP = 100;
             }
-            /* Here other methods can be implemented */
             else
             {
-                return ResponseStatusCode::MethodNotImplemented;
+                pTransport->CloseSocket(i);
+                Process[i].STEP = 200;
             }
             break;
-        }
-        /* Here other methods can be implemented */
-        else
-        {
-            return ResponseStatusCode::MethodNotImplemented;
-        }
-        break;
 
-    case 'P':      //  "POST" or "PUT" methods
-        if(0 == strncmp(ReqStr, "POST /", 6))
-        {
-            Method = cMethod::Post;
-            ReqStr += 6;
-        }
+        case 11:    //  FIRMWARE UPDATE: wait for erasing, then let client send the body
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected)
+            {
+                pOTA->Abort();
+                Process[i].STEP = 200;
+                break;
+            }
+
+            Process[i].TimeCounter = SocketConnectionTimeOut;   //  erasing of whole staging area may take longer than connection timeout
+
+            if(pOTA->isReadyForData())
+            {
+                if(Process[i].ExpectContinue && pTransport->SocketRxPaused(i) == false)  //  client waits for "100 Continue" (unless it has started sending anyway)
+                {
+                    if(SUCCESS == pTransport->SocketSend(i, (uint8_t*)HTTP_ServerResponseContinue, (uint16_t)strlen(HTTP_ServerResponseContinue)))
+                    {
+                        Process[i].STEP = 12;
+                    }
+                }
+                else
+                {
+                    Process[i].STEP = 12;
+                }
+            }
+            else if(pOTA->GetState() != OTA_Update::eState::Erasing)   //  erase failed
+            {
+                Process[i].STEP = 14;
+            }
+            break;
+
+        case 12:    //  FIRMWARE UPDATE: pass body to writer. Rest of the first message first, then socket receives directly into writer buffers
+            if(Process[i].BodyReceived >= Process[i].ContentLength)
+            {
+                Process[i].STEP = 14;   //  whole image received
+                break;
+            }
+
+            if(pOTA->GetState() != OTA_Update::eState::Receiving)
+            {
+                Process[i].STEP = 14;   //  programming failed
+                break;
+            }
+
+            if(Process[i].BodyOffset < Process[i].RequestLen)
+            {
+                len = Process[i].RequestLen - Process[i].BodyOffset;
+                if(len > Process[i].ContentLength - Process[i].BodyReceived) { len = Process[i].ContentLength - Process[i].BodyReceived; }
+
+                len = pOTA->Write((uint8_t*)&Process[i].RequestString[Process[i].BodyOffset], (uint16_t)len);     //  part of data is accepted if buffers are full
+                Process[i].BodyOffset += len;
+                Process[i].BodyReceived += len;
+                break;
+            }
+
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected)
+            {
+                pOTA->Abort();
+                Process[i].STEP = 200;
+                break;
+            }
+
+            pSendData = pOTA->GetWriteBuffer(DataLen);     //  zero if both buffers are waiting for programming
+            if(pSendData && SUCCESS == pTransport->ListenSocketStream(i, pSendData, DataLen))
+            {
+                Process[i].STEP = 13;
+            }
+            break;
+
+        case 13:    //  FIRMWARE UPDATE: wait for next part of body
+            DataLen = pTransport->SocketRecv(i);
+            if(DataLen == (uint16_t)-1)    //  data lost (HUART buffer overflow)
+            {
+                pOTA->Abort();
+                Process[i].STEP = 14;
+                break;
+            }
+
+            if(DataLen)
+            {
+                if(DataLen > Process[i].ContentLength - Process[i].BodyReceived) { DataLen = (uint16_t)(Process[i].ContentLength - Process[i].BodyReceived); }
+                pOTA->Commit(DataLen);
+                Process[i].BodyReceived += DataLen;
+                Process[i].TimeCounter = SocketConnectionTimeOut;   //  prolong timeout time
+                Process[i].STEP = 12;
+                break;
+            }
+
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected)
+            {
+                pOTA->Abort();
+                Process[i].STEP = 200;
+            }
+            break;
+
+        case 14:    //  FIRMWARE UPDATE: wait for programming and verification of the image, send result
+            if(pOTA->GetState() == OTA_Update::eState::Receiving || pOTA->GetState() == OTA_Update::eState::Verifying) { break; }
+
+            pTransport->SocketRxDiscard(i);   //  data after the body are ignored
+            Process[i].HeaderLen = PrepareOTAResponse(i);
+            Process[i].HeaderOnly = true;
+            Process[i].STEP = 7;
+            break;
+#endif
+
+#ifdef HTTP_SERV_GENERATED_RESPONSES
+        case 20:    //  GENERATED RESPONSE: send header. Body is generated into RequestString by parts, end of body is indicated by closing of the connection
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+            Process[i].TsRendered = Timestamp_Get();
+#endif
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected)
+            {
+                Process[i].STEP = 200;
+                break;
+            }
+
+            if(SUCCESS == pTransport->SocketSend(i, (uint8_t*)HTTP_ServerResponseOKText, (uint16_t)strlen(HTTP_ServerResponseOKText)))
+            {
+#ifdef METRICS_EN
+                CountResponse(HTTP_ServerResponseOKText);
+#endif
+                Process[i].GenLine = 0;
+                Process[i].TimeCounter = SocketConnectionTimeOut;   //  prolong timeout time
+                Process[i].STEP = 21;
+            }
+            break;
+
+        case 21:    //  GENERATED RESPONSE: when previous part is sent, generate next lines and send them
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Connected ||
+                   pTransport->GetDataSendStatus(i) == Transport::eSocketSendDataStatus::SendFail)
+            {
+                Process[i].STEP = 200;
+                break;
+            }
+
+            if(pTransport->GetDataSendStatus(i) == Transport::eSocketSendDataStatus::SendRequested ||
+               pTransport->GetDataSendStatus(i) == Transport::eSocketSendDataStatus::InProgress) { break; }  //  RequestString may be in use by ESP
+
+            len = GenerateResponseLines(i);
+            if(len == 0)    //  response is finished
+            {
+                pTransport->CloseSocket(i);
+                Process[i].STEP = 200;
+                break;
+            }
+
+            if(SUCCESS == pTransport->SocketSend(i, (uint8_t*)Process[i].RequestString, (uint16_t)len))
+            {
+                Process[i].TimeCounter = SocketConnectionTimeOut;   //  prolong timeout time
+            }
+            else
+            {
+                pTransport->CloseSocket(i);
+                Process[i].STEP = 200;
+            }
+            break;
+#endif
+
+        case 100:   //  wait timeout and then close socket if not already closed
+            if(pTransport->GetSocketState(i) == Transport::eSocketState::Closed )
+            {
+                Process[i].TimeCounter = 0;
+                Process[i].STEP = 0;
+            }
+
+            if(Process[i].TimeoutFlag)
+            {
+                if(SUCCESS == pTransport->CloseSocket(i))
+                {
+                    Process[i].STEP = 200;
+                }
+            }
+
+            break;
+
+        case 200:
+            if(pTransport->GetSocketState(i) == Transport::eSocketState::Closed )
+            {
+                Process[i].STEP = 0;
+            }
+            else if(pTransport->GetSocketState(i) == Transport::eSocketState::Connected ||     //  Socket has been connected again after closing, between steps
+                    pTransport->GetSocketState(i) == Transport::eSocketState::Error)
+            {
+                Process[i].STEP = 201;  //  Close socket because HTTP Server was not ready when it opened (should be very exceptional case)
+            }
+            break;
+
+        case 201:   //  Socket timeout, close socket
+            if(pTransport->GetSocketState(i) != Transport::eSocketState::Closing )
+            {
+                if(SUCCESS == pTransport->CloseSocket(i))
+                {
+                    Process[i].STEP = 200;
+                }
+                else
+                {
+                    Process[i].STEP = 0;
+                }
+            }
+            break;
+
+        default:
+            Process[i].STEP = 0;
+            break;
+        }
+
+        if(Process[i].STEP != Step) { Progress = true; }
+#ifdef ESP8266_SOCKET_EVENTS_EN
+        else if(StepWaitsForSocketEvent(Step)) { SocketWaiting |= (1U << i); }
+#endif
+    }
+
+    return Progress;
+}
+
+
+HTTP_Server::ResponseStatusCode HTTP_Server::ParseHTTPRequest(char *ReqStr, size_t len, uint8_t SocketID)
+{
+int pos = 0;
+char c;
+bool PageFound = false;
+int num;
+bool exit = false;
+int HTTPVersion[2] = {0,0};
+char *p;
+enum class cMethod {NotImplemented = 0, Get, Post};
+cMethod Method = cMethod::NotImplemented;
+char *ReqStrStart = ReqStr;
+char *ReqStrEnd = &ReqStr[len-1];
+ResponseStatusCode response;
+unsigned long RangeFirst, RangeLast;
+#ifdef HTTP_SERV_OTA_EN
+unsigned long Value;
+#endif
+#ifdef HTTP_SERV_ROMFS_EN
+bool GzipAccepted = false;
+char *pIfNoneMatch = 0, *pIfNoneMatchEnd = 0;
+#endif
+
+    Process[SocketID].RangeRequested = false;
+    Process[SocketID].Service = eService::None;
+
+#ifdef HTTP_SERV_OTA_EN
+    Process[SocketID].BodyOffset = 0;
+    Process[SocketID].ContentLength = 0;
+    Process[SocketID].ImageCRCFound = false;
+    Process[SocketID].ExpectContinue = false;
+#endif
+
+#ifdef HTTP_SERV_ROMFS_EN
+    Process[SocketID].pFile = 0;
+    Process[SocketID].ETagMatch = false;
+#endif
+
+    switch(ReqStr[0])
+    {
+    case 'G':   // GET method
+        if(0 == strncmp(ReqStr, "GET /", 5))
+        {
+            if(0 == strncmp(ReqStr, "GET /", 5))
+            {
+                Method = cMethod::Get;
+                ReqStr += 5;
+            }
+            /* Here other methods can be implemented */
+            else
+            {
+                return ResponseStatusCode::MethodNotImplemented;
+            }
+            break;
+        }
+        /* Here other methods can be implemented */
+        else
+        {
+            return ResponseStatusCode::MethodNotImplemented;
+        }
+        break;
+
+    case 'P':      //  "POST" or "PUT" methods
+        if(0 == strncmp(ReqStr, "POST /", 6))
+        {
+            Method = cMethod::Post;
+            ReqStr += 6;
+        }
         /* Here other methods can be implemented */
         else
         {
@@ -467,13 +1043,44 @@ ResponseStatusCode response;
         else
         {
             /* search for page name */
-            sscanf(ReqStr, "%*" xstr(HTTP_CLIENT_REQUEST_STRING_SIZE) "[--9a-zA-Z_]%n", &pos);
+            sscanf(ReqStr, "%*[--9a-zA-Z_]%n", &pos);     //  string is terminated within RequestString
 
             if(pos)
             {
                 c = ReqStr[pos];    //  save next symbol for further analysis
                 ReqStr[pos] = 0;    //  terminate string
-                for(int i=0; i<NumOfPages; i++)     //  search in content if page exist on the server
+#ifdef HTTP_SERV_ROMFS_EN
+                Process[SocketID].pFile = ROMFS_Find(ReqStr, pos);    //  files are searched by hash, no need to scan whole content
+                if(Process[SocketID].pFile)
+                {
+                    if(Method != cMethod::Get) { return ResponseStatusCode::MethodNotAllowed; }
+                    PageFound = true;
+                }
+#endif
+#ifdef HTTP_SERV_OTA_EN
+                if(pOTA && PageFound == false && 0 == strcmp(ReqStr, HTTP_SERV_OTA_URI))
+                {
+                    Process[SocketID].Service = (Method == cMethod::Post) ? eService::OTAUpload : eService::OTAStatus;
+                    PageFound = true;
+                }
+#endif
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+                if(PageFound == false && 0 == strcmp(ReqStr, HTTP_SERV_STATS_URI))
+                {
+                    if(Method != cMethod::Get) { return ResponseStatusCode::MethodNotAllowed; }
+                    Process[SocketID].Service = eService::LatencyStats;
+                    PageFound = true;
+                }
+#endif
+#ifdef METRICS_EN
+                if(PageFound == false && 0 == strcmp(ReqStr, HTTP_SERV_METRICS_URI))
+                {
+                    if(Method != cMethod::Get) { return ResponseStatusCode::MethodNotAllowed; }
+                    Process[SocketID].Service = eService::Metrics;
+                    PageFound = true;
+                }
+#endif
+                for(int i=0; i<HTTPServerContentPages && PageFound == false; i++)     //  search in content if page exist on the server
                 {
                     if(0 == strcmp(ReqStr, HTTPServerContent[i].pPageName))
                     {
@@ -563,15 +1170,19 @@ ResponseStatusCode response;
     exit = false;
     while(exit == false)
     {
-        p = strstr(ReqStr, "\r\n");           //  find end of current line
-        if(p != 0 && (p < ReqStrEnd))         //  \r\n found inside received string
+        p = (char*)Scan_FindCRLF(ReqStr, ReqStrEnd - ReqStr);     //  find end of current line inside received string
+        if(p != 0)
         {
             if(0 == strncmp(p, "\r\n\r\n", 4))
             {
                 exit = true;    //  end of header found
+#ifdef HTTP_SERV_OTA_EN
+                Process[SocketID].BodyOffset = (uint16_t)(p + 4 - ReqStrStart);
+#endif
             }
             //  find "Host:" string and set pos shift. Actual name reading is made separately to limit reading to buffer size and detect if name has been cut
-            num = sscanf(ReqStr, " Host: %c%n ", &c, &pos);
+            num = 0;
+            if(0 == strncmp(ReqStr, "Host:", 5)) { num = sscanf(ReqStr, " Host: %c%n ", &c, &pos); }   //  sscanf() is slow, it is called for "Host:" line only
             if(num == 1)
             {
                 num = sscanf(&ReqStr[pos-1], "%" xstr(HTTP_CLIENT_HOST_NAME_SIZE) "s%n ", Process[SocketID].HostName, &pos);
@@ -594,6 +1205,69 @@ ResponseStatusCode response;
                 }
             }
 
+#ifdef HTTP_SERV_ROMFS_EN
+            if(Process[SocketID].pFile && 0 == strncmp(ReqStr, "If-None-Match:", 14))
+            {
+                pIfNoneMatch = ReqStr + 14;     //  compared after all headers, when it is known which copy of the file is sent
+                pIfNoneMatchEnd = p;
+            }
+            if(Process[SocketID].pFile && 0 == strncmp(ReqStr, "Accept-Encoding:", 16))
+            {
+                *p = 0;     //  limit search to current line
+                GzipAccepted = HTTP_GzipAccepted(ReqStr + 16);
+                *p = '\r';
+            }
+#endif
+
+            if(0 == strncmp(ReqStr, "Range:", 6))
+            {
+                *p = 0;     //  limit parsing to current line
+                if(0 == strchr(ReqStr, ','))    //  only single range is supported, otherwise header is ignored and whole content is sent
+                {
+                    if(1 == sscanf(ReqStr + 6, " bytes=-%lu", &RangeLast))     //  last N bytes
+                    {
+                        Process[SocketID].RangeSuffix = true;
+                        Process[SocketID].RangeFirst = 0;
+                        Process[SocketID].RangeLast = RangeLast;
+                        Process[SocketID].RangeRequested = true;
+                    }
+                    else
+                    {
+                        num = sscanf(ReqStr + 6, " bytes=%lu-%lu", &RangeFirst, &RangeLast);
+                        if(num == 1) { RangeLast = 0xFFFFFFFF; }   //  "bytes=N-", up to the end of content
+                        if(num >= 1 && RangeFirst <= RangeLast)    //  invalid range is ignored
+                        {
+                            Process[SocketID].RangeSuffix = false;
+                            Process[SocketID].RangeFirst = RangeFirst;
+                            Process[SocketID].RangeLast = RangeLast;
+                            Process[SocketID].RangeRequested = true;
+                        }
+                    }
+                }
+                *p = '\r';
+            }
+
+#ifdef HTTP_SERV_OTA_EN
+            if(Process[SocketID].Service == eService::OTAUpload)
+            {
+                *p = 0;     //  limit parsing to current line
+                if(1 == sscanf(ReqStr, "Content-Length: %lu", &Value))
+                {
+                    Process[SocketID].ContentLength = Value;
+                }
+                else if(1 == sscanf(ReqStr, "X-Image-CRC32: %lx", &Value))
+                {
+                    Process[SocketID].ImageCRC = Value;
+                    Process[SocketID].ImageCRCFound = true;
+                }
+                else if(0 == strncmp(ReqStr, "Expect:", 7) && strstr(ReqStr + 7, "100-continue"))
+                {
+                    Process[SocketID].ExpectContinue = true;
+                }
+                *p = '\r';
+            }
+#endif
+
             /* ===  Other arguments parsing can be implemented here */
 
             /* =====================================================*/
@@ -607,6 +1281,38 @@ ResponseStatusCode response;
         }
     }
 
+#ifdef HTTP_SERV_ROMFS_EN
+    if(Process[SocketID].pFile)
+    {
+        if((Process[SocketID].pFile->Flags & ROMFS_FLAG_GZIP) && GzipAccepted == false)    //  client can't decode stored file, uncompressed copy is sent if there is one
+        {
+            Process[SocketID].pFile = ROMFS_FindPlain(Process[SocketID].pFile->pPath, strlen(Process[SocketID].pFile->pPath));
+            if(Process[SocketID].pFile == 0) { return ResponseStatusCode::NotAcceptable; }
+        }
+        if(pIfNoneMatch)
+        {
+            *pIfNoneMatchEnd = 0;     //  limit search to the line
+            if(strstr(pIfNoneMatch, Process[SocketID].pFile->pETag)) { Process[SocketID].ETagMatch = true; }
+            *pIfNoneMatchEnd = '\r';
+        }
+    }
+#endif
+
+#ifdef HTTP_SERV_OTA_EN
+    if(Process[SocketID].Service == eService::OTAUpload)   //  body is firmware image, not query string
+    {
+        if(Process[SocketID].BodyOffset == 0 || Process[SocketID].ContentLength == 0 || Process[SocketID].ImageCRCFound == false)
+        {
+            return ResponseStatusCode::BadRequest;
+        }
+        if(Process[SocketID].ContentLength > pOTA->GetMaxImageSize())
+        {
+            return ResponseStatusCode::PayloadTooLarge;
+        }
+        return ResponseStatusCode::OK;
+    }
+#endif
+
     if(Method == cMethod::Post)
     {
         /*====  Parse Query String ====*/
@@ -627,6 +1333,9 @@ float FloatValue;
 #endif
 bool exit = false;
 HTTPVariable* Variable = 0;
+const char *pEnd = ReqStr + len + 1;    //  terminating zero of the request is at ReqStr[len]
+const char *p;
+static const char Delimiters[] = {'&', ' ', '\r', '\n', '=', '\0'};  //  end of name or value (zero: end of received data)
 
     sscanf(ReqStr, " %n", &pos);    //  delete white symbols in front, if any
     ReqStr+=pos;
@@ -634,8 +1343,10 @@ HTTPVariable* Variable = 0;
     while(exit == false)
     {
         pos = 0;
-        sscanf(ReqStr, " %*[^& \r\n=]%n", &pos);
-        if(pos && pos<len)
+        while(ReqStr + pos < pEnd && isspace((unsigned char)ReqStr[pos])) { pos++; }    //  white symbols in front of the name
+        p = Scan_FindAny(ReqStr + pos, pEnd - (ReqStr + pos), Delimiters, sizeof(Delimiters));
+        pos = (p > ReqStr + pos) ? (unsigned int)(p - ReqStr) : 0;    //  name must not be empty
+        if(pos)
         {
             if(ReqStr[pos] == '=')
             {
@@ -644,9 +1355,9 @@ HTTPVariable* Variable = 0;
                 if(Variable)        //  Variable found
                 {
                     ReqStr += pos+1;
-                    pos = 0;
-                    sscanf(ReqStr, "%*[^& \r\n=]%n", &pos);
-                    if(pos && pos<len)
+                    p = Scan_FindAny(ReqStr, (ReqStr < pEnd) ? pEnd - ReqStr : 0, Delimiters, sizeof(Delimiters));
+                    pos = (p > ReqStr) ? (unsigned int)(p - ReqStr) : 0;     //  value must not be empty
+                    if(pos)
                     {
                         c = ReqStr[pos];
                         ReqStr[pos] = 0;   //  terminate string
@@ -715,6 +1426,428 @@ HTTPVariable* Variable = 0;
     return ReqStr;
 }
 
+int HTTP_Server::GetContentParts(uint8_t SocketID)
+{
+#ifdef HTTP_SERV_ROMFS_EN
+    if(Process[SocketID].pFile) { return 1; }
+#endif
+
+    return HTTPServerContent[Process[SocketID].RequestedPageIndex].PageParts;
+}
+
+const char* HTTP_Server::GetContentPart(uint8_t SocketID, int Part, size_t *pLen)
+{
+const HTTP_Page *pPage;
+
+#ifdef HTTP_SERV_ROMFS_EN
+    if(Process[SocketID].pFile)
+    {
+        *pLen = Process[SocketID].pFile->Size;
+        return (const char*)Process[SocketID].pFile->pData;
+    }
+#endif
+
+    pPage = &HTTPServerContent[Process[SocketID].RequestedPageIndex].pPage[Part];
+
+    if(pPage->Size == 0)    //  dynamic part of page, size is not known, need to calculate
+    {
+        *pLen = strlen(pPage->pContent);
+    }
+    else
+    {
+        *pLen = pPage->Size;
+    }
+
+    return pPage->pContent;
+}
+
+uint32_t HTTP_Server::GetContentLength(uint8_t SocketID)
+{
+uint32_t Length = 0;
+size_t len;
+
+#ifdef HTTP_SERV_ROMFS_EN
+    if(Process[SocketID].pFile == 0)
+#endif
+    {
+        if(HTTPServerContent[Process[SocketID].RequestedPageIndex].Type == HTTP_PageType::Static)     //  length of static page is known at compile time
+        {
+            return HTTPServerContent[Process[SocketID].RequestedPageIndex].StaticSize;
+        }
+    }
+
+    for(int i=0; i<GetContentParts(SocketID); i++)
+    {
+        GetContentPart(SocketID, i, &len);
+        Length += len;
+    }
+
+    return Length;
+}
+
+size_t HTTP_Server::PrepareResponseHeader(uint8_t SocketID)
+{
+process *pProcess = &Process[SocketID];
+char *pHeader = pProcess->RequestString;
+const size_t size = RequestStringSize;
+uint32_t Total = GetContentLength(SocketID);
+uint32_t First = 0, Last = 0;
+int len;
+
+    pProcess->SendIndex = 0;
+    pProcess->PartOffset = 0;
+    pProcess->SendOffset = 0;
+    pProcess->SendEnd = Total;
+    pProcess->HeaderOnly = false;
+
+#ifdef HTTP_SERV_ROMFS_EN
+    if(pProcess->pFile && pProcess->ETagMatch)
+    {
+        len = snprintf(pHeader, size, HTTP_ServerResponseFileNotModified, pProcess->pFile->pETag);
+        pProcess->HeaderOnly = true;
+    }
+    else
+#endif
+    if(pProcess->RangeRequested)
+    {
+        if(pProcess->RangeSuffix)
+        {
+            First = (Total > pProcess->RangeLast) ? Total - pProcess->RangeLast : 0;
+            Last = Total - 1;
+        }
+        else
+        {
+            First = pProcess->RangeFirst;
+            Last = (pProcess->RangeLast < Total) ? pProcess->RangeLast : Total - 1;
+        }
+
+        if(Total == 0 || First >= Total || (pProcess->RangeSuffix && pProcess->RangeLast == 0))
+        {
+            len = snprintf(pHeader, size, HTTP_ServerResponseRangeNotSatisfiable, (unsigned long)Total);
+            pProcess->HeaderOnly = true;
+            pProcess->SendEnd = 0;
+        }
+        else
+        {
+            len = snprintf(pHeader, size, HTTP_ServerResponsePartialContent, (unsigned long)First, (unsigned long)Last, (unsigned long)Total, (unsigned long)(Last - First + 1));
+            pProcess->SendOffset = First;
+            pProcess->SendEnd = Last + 1;
+        }
+    }
+#ifdef HTTP_SERV_ROMFS_EN
+    else if(pProcess->pFile)
+    {
+        len = snprintf(pHeader, size, HTTP_ServerResponseOKContentLength, (unsigned long)Total);
+    }
+#endif
+    else    //  whole page is sent without header
+    {
+        return 0;
+    }
+
+    if(len < 0 || (size_t)len >= size) { return PrepareErrorHeader(SocketID); }   //  content must not be sent without status line
+
+    if(pProcess->HeaderOnly == false)
+    {
+#ifdef HTTP_SERV_ROMFS_EN
+        if(pProcess->pFile)
+        {
+            len += snprintf(&pHeader[len], size - len, HTTP_ServerResponseFileInfo, ROMFS_GetMimeTypeString(pProcess->pFile->MimeType), pProcess->pFile->pETag,
+                            (pProcess->pFile->Flags & ROMFS_FLAG_GZIP) ? HTTP_ServerResponseGzipEncoding : "");
+        }
+        else
+#endif
+        {
+            len += snprintf(&pHeader[len], size - len, "%s", HTTP_ServerResponseContentTypeHTML);
+        }
+
+        if((size_t)len >= size) { return PrepareErrorHeader(SocketID); }
+
+        if(pProcess->SendOffset >= pProcess->SendEnd) { pProcess->HeaderOnly = true; }     //  empty file
+    }
+
+    len += snprintf(&pHeader[len], size - len, "%s", HTTP_ServerResponseConnectionClose);
+    if((size_t)len >= size) { return PrepareErrorHeader(SocketID); }
+
+    return (size_t)len;
+}
+
+size_t HTTP_Server::PrepareErrorHeader(uint8_t SocketID)
+{
+process *pProcess = &Process[SocketID];
+
+    debug_print("SRV: Response header doesn't fit request string, socket %u\n", SocketID);
+
+    pProcess->SendOffset = 0;
+    pProcess->SendEnd = 0;
+    pProcess->HeaderOnly = true;
+
+    return (size_t)snprintf(pProcess->RequestString, RequestStringSize, "%s", HTTP_ServerResponseInternalServerError);    //  fits, see HTTP_SERV_RESPONSE_HEADER_MAX
+}
+
+#ifdef HTTP_SERV_GENERATED_RESPONSES
+size_t HTTP_Server::GenerateResponseLines(uint8_t SocketID)
+{
+process *pProcess = &Process[SocketID];
+char *pBuf = pProcess->RequestString;
+const size_t size = RequestStringSize;
+size_t len = 0;
+int n;
+
+    while(len < size)   //  as many whole lines as fit into the buffer, to send less but longer packets
+    {
+        switch(pProcess->Service)
+        {
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+        case eService::LatencyStats:
+            n = RenderLatencyStatsLine(pProcess->GenLine, &pBuf[len], size - len);
+            break;
+#endif
+#ifdef METRICS_EN
+        case eService::Metrics:
+            n = Metric::RenderLine(pProcess->GenLine, &pBuf[len], size - len);
+            break;
+#endif
+        default:
+            n = -1;
+            break;
+        }
+
+        if(n < 0) { break; }    //  no more lines
+
+        if((size_t)n >= size - len)     //  line doesn't fit, it is generated again into the next part
+        {
+            if(len == 0) { pProcess->GenLine++; }   //  line is longer than the buffer, skip it
+            break;
+        }
+
+        len += n;
+        pProcess->GenLine++;
+    }
+
+    return len;
+}
+#endif
+
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+static void AddLatency(OKO_STATS::Log2Histogram &Histogram, uint32_t Start, uint32_t End)
+{
+    if(Start == 0 || End == 0 || (int32_t)(End - Start) < 0) { return; }    //  event didn't happen (e.g. error response is sent without "SEND OK" waiting) or belongs to other connection
+
+    Histogram.Add(Timestamp_ElapsedUs(Start, End));
+}
+
+void HTTP_Server::RecordLatency(uint8_t SocketID)
+{
+const Transport::socket_timestamps *pTs = pTransport->GetSocketTimestamps(SocketID);
+uint32_t Stamp[(int)eLatencyPhase::Total + 1];
+
+    if(pTs == 0) { return; }
+
+    /* phase N is time between stamps N and N+1 */
+    Stamp[0] = pTs->Connected;
+    Stamp[1] = pTs->FirstRx;
+    Stamp[2] = Process[SocketID].TsParsed;
+    Stamp[3] = Process[SocketID].TsRendered;
+    Stamp[4] = pTs->FirstSendOK;
+    Stamp[5] = pTs->LastSendOK;
+    Stamp[6] = pTs->Closed;
+
+    for(int i=0; i < (int)eLatencyPhase::Total; i++)
+    {
+        AddLatency(LatencyPhase[i], Stamp[i], Stamp[i+1]);
+    }
+
+    AddLatency(LatencyPhase[(int)eLatencyPhase::Total], pTs->Connected, pTs->Closed);
+    AddLatency(LatencyPage[Process[SocketID].StatsSlot], pTs->Connected, pTs->Closed);
+}
+
+int HTTP_Server::RenderLatencyStatsLine(int Line, char *pBuf, size_t Size)
+{
+const OKO_STATS::Log2Histogram *pHistogram;
+const char *pName;
+int len;
+
+    if(Line == 0)
+    {
+        return snprintf(pBuf, Size, "# request latency, us: count avg p50 p90 p99 | buckets, bucket k counts values below 2^(k+1)\n");
+    }
+    Line--;
+
+    if(Line < (int)eLatencyPhase::Num)
+    {
+        pHistogram = &LatencyPhase[Line];
+        len = snprintf(pBuf, Size, "phase %s", HTTP_LatencyPhaseName[Line]);
+    }
+    else if(Line < (int)eLatencyPhase::Num + HTTP_SERV_LATENCY_PAGES)
+    {
+        Line -= (int)eLatencyPhase::Num;
+        pHistogram = &LatencyPage[Line];
+        pName = (Line < HTTP_SERV_LATENCY_PAGES - 1 && Line < HTTPServerContentPages) ? HTTPServerContent[Line].pPageName : "other";
+        if(Line < HTTP_SERV_LATENCY_PAGES - 1 && Line >= HTTPServerContentPages) { return 0; }     //  page doesn't exist, empty line
+        len = snprintf(pBuf, Size, "page %s", pName);
+    }
+    else
+    {
+        return -1;
+    }
+
+    if(len < 0 || (size_t)len >= Size) { return len; }
+
+    len += snprintf(&pBuf[len], Size - len, " %lu %lu %lu %lu %lu |", (unsigned long)pHistogram->GetCount(),
+                    (unsigned long)(pHistogram->GetCount() ? pHistogram->GetSum() / pHistogram->GetCount() : 0),
+                    (unsigned long)pHistogram->GetPercentile(50), (unsigned long)pHistogram->GetPercentile(90), (unsigned long)pHistogram->GetPercentile(99));
+
+    for(int i=0; i < HISTOGRAM_BUCKETS && (size_t)len < Size; i++)
+    {
+        len += snprintf(&pBuf[len], Size - len, " %u", pHistogram->GetBucket(i));
+    }
+
+    if((size_t)len < Size) { len += snprintf(&pBuf[len], Size - len, "\n"); }
+
+    return len;
+}
+
+void HTTP_Server::PrintLatencyStats(void)
+{
+char Line[200];
+
+    for(int i=0; RenderLatencyStatsLine(i, Line, sizeof(Line)) >= 0; i++)
+    {
+        debug_print("%s", Line);
+    }
+}
+
+void HTTP_Server::ClearLatencyStats(void)
+{
+    for(int i=0; i < (int)eLatencyPhase::Num; i++) { LatencyPhase[i].Clear(); }
+    for(int i=0; i < HTTP_SERV_LATENCY_PAGES; i++) { LatencyPage[i].Clear(); }
+}
+#endif
+
+#ifdef HTTP_SERV_RATE_LIMIT_EN
+HTTP_Server::ResponseStatusCode HTTP_Server::CheckRateLimit(uint8_t SocketID)
+{
+uint32_t IP = pTransport->GetSocketRemoteIP(SocketID);
+client_bucket *pBucket = 0;
+int Connections = 0;
+
+    if(IP == 0) { return ResponseStatusCode::OK; }     //  client unknown, not limited
+
+    /* number of sockets the client already occupies (request is parsed or response is being sent) */
+    for(uint8_t i=0; i < SocketsNum; i++)
+    {
+        if(i != SocketID && Process[i].STEP > 2 && pTransport->GetSocketRemoteIP(i) == IP) { Connections++; }
+    }
+    if(Connections >= HTTP_SERV_RATE_LIMIT_CONNECTIONS) { return ResponseStatusCode::ServiceUnavailable; }
+
+    RateLimitClock++;
+
+    /* find client's bucket or replace the least recently seen client */
+    for(int i=0; i < HTTP_SERV_RATE_LIMIT_CLIENTS; i++)
+    {
+        if(RateLimitBucket[i].IP == IP)
+        {
+            pBucket = &RateLimitBucket[i];
+            break;
+        }
+        if(pBucket == 0 || RateLimitBucket[i].LastSeen < pBucket->LastSeen) { pBucket = &RateLimitBucket[i]; }    //  free bucket has LastSeen zero
+    }
+
+    if(pBucket->IP != IP)   //  new client
+    {
+        pBucket->IP = IP;
+        pBucket->Tokens = HTTP_SERV_RATE_LIMIT_BURST;
+        pBucket->RefillCounter = 0;
+    }
+    pBucket->LastSeen = RateLimitClock;
+
+    if(pBucket->Tokens == 0)
+    {
+        debug_print("SRV: Rate limit, client %lu.%lu.%lu.%lu\n", (unsigned long)(IP >> 24), (unsigned long)((IP >> 16) & 0xFF), (unsigned long)((IP >> 8) & 0xFF), (unsigned long)(IP & 0xFF));
+        return ResponseStatusCode::TooManyRequests;
+    }
+
+    pBucket->Tokens--;
+
+    return ResponseStatusCode::OK;
+}
+
+void HTTP_Server::RefillRateLimitBuckets(void)
+{
+    for(int i=0; i < HTTP_SERV_RATE_LIMIT_CLIENTS; i++)
+    {
+        if(RateLimitBucket[i].IP && RateLimitBucket[i].Tokens < HTTP_SERV_RATE_LIMIT_BURST)
+        {
+            RateLimitBucket[i].RefillCounter++;
+            if(RateLimitBucket[i].RefillCounter >= HTTP_SERV_RATE_LIMIT_REFILL)
+            {
+                RateLimitBucket[i].RefillCounter = 0;
+                RateLimitBucket[i].Tokens++;
+            }
+        }
+    }
+}
+#endif
+
+#ifdef HTTP_SERV_IDLE_RECLAIM_EN
+int HTTP_Server::GetFreeSockets(void)
+{
+int Free = 0;
+
+    for(uint8_t i=0; i < SocketsNum; i++)
+    {
+        if(Process[i].STEP <= 1) { Free++; }    //  waiting for connection
+    }
+
+    return Free;
+}
+
+int HTTP_Server::GetIdleTimeout(void)
+{
+    return HTTP_SERV_IDLE_TIMEOUT_MIN + ((SocketConnectionTimeOut - HTTP_SERV_IDLE_TIMEOUT_MIN) * GetFreeSockets()) / SocketsNum;
+}
+
+void HTTP_Server::EvictIdleSocket(uint8_t NewSocketID)
+{
+int Victim = -1;
+
+    /* connections with request received or response being sent are not idle (STEP > 2), neither is one with request waiting in the buffer */
+    for(uint8_t i=0; i < SocketsNum; i++)
+    {
+        if(i == NewSocketID || Process[i].STEP != 2 || Process[i].TimeoutFlag) { continue; }
+        if(pTransport->SocketRecv(i) != 0) { continue; }
+
+        if(Victim < 0 || (IdleClock - Process[i].ActiveTick) > (IdleClock - Process[Victim].ActiveTick)) { Victim = i; }
+    }
+
+    if(Victim < 0) { return; }
+
+    debug_print("SRV: Socket %d idle for %lu ticks, closed for new connection\n", Victim, (unsigned long)(IdleClock - Process[Victim].ActiveTick));
+    Process[Victim].TimeCounter = 0;
+    Process[Victim].TimeoutFlag = true;     //  closed by HandleSockets() as on timeout
+}
+#endif
+
+#ifdef HTTP_SERV_OTA_EN
+size_t HTTP_Server::PrepareOTAResponse(uint8_t SocketID)
+{
+char *pResponse = Process[SocketID].RequestString;
+const size_t size = RequestStringSize;
+OTA_Update::eState State = pOTA->GetState();
+int len;
+
+    len = snprintf(pResponse, size, HTTP_ServerResponseOTAStatus,
+                   (Process[SocketID].Service == eService::OTAUpload && State != OTA_Update::eState::Done) ? "500 Internal Server Error" : "200 OK",
+                   OTA_Update::GetStateString(State), (unsigned int)pOTA->GetProgress(), (unsigned long)pOTA->GetReceivedBytes(),
+                   (unsigned long)pOTA->GetImageSize(), OTA_Update::GetErrorString(pOTA->GetError()));
+
+    if(len < 0 || (size_t)len >= size) { return 0; }
+
+    return (size_t)len;
+}
+#endif
+
 /*****************************************************************************************************************************
  *                                  VARIABLES
  *****************************************************************************************************************************/
@@ -815,6 +1948,42 @@ bool HTTPVariable::NewValueReceived(void)
     return flag;
 }
 
+bool HTTPVariable::SetValue(const char *pValue)
+{
+int IntValue;
+#ifdef HTTP_SERV_SUPPORT_FLOATING_POINT_VARS
+float FloatValue;
+#endif
+
+    if(Valid == false || pValue == 0) { return false; }
+
+    switch(Type)
+    {
+    case HTTPVariable::HTTPVarType::Text:
+        if(strlen(pValue) >= TextSize) { return false; }   //  check if there is enough space to hold received string
+        strcpy(pText, pValue);
+        break;
+
+    case HTTPVariable::HTTPVarType::Integer:
+        if(1 != sscanf(pValue, "%d", &IntValue)) { return false; }
+        ValueInteger = IntValue;
+        break;
+
+    case HTTPVariable::HTTPVarType::Float:
+#ifdef HTTP_SERV_SUPPORT_FLOATING_POINT_VARS
+        if(1 != sscanf(pValue, "%f", &FloatValue)) { return false; }
+        ValueFloat = FloatValue;
+        break;
+#else
+        return false;
+#endif
+    }
+
+    NewValue = true;
+    HTTPVariable::HTTPVariableReceivedFlag = true;
+    return true;
+}
+
 char* HTTPVariable::GetText(void)
 {
     if(Valid == false) { return 0; }
@@ -201,8 +201,7 @@ const char HTTP_Settings_Body1[] =
         "<hr>\n"
         "<p style=\"text-align: left;\"><b>WiFi SSID:</b><br /><br />";
 
-// dynamic part of settings.html page
-const char* pHTTP_Settings_Body2 = HTTP_StringForRendering2;
+// dynamic part of settings.html page: HTTP_StringForRendering2
 
 // static part of settings.html page
 const char HTTP_Settings_Body3[] =
@@ -226,8 +225,7 @@ const char HTTP_Settings_Body3[] =
         "</table>\n"
         "</div>";
 
-// dynamic part of settings.html page
-const char* pHTTP_Settings_Body4 = HTTP_StringForRendering;
+// dynamic part of settings.html page: HTTP_StringForRendering
 
 // static part of settings.html page
 const char HTTP_Settings_Body5[] =
@@ -241,25 +239,31 @@ const char HTTP_Settings_Body5[] =
         "</body>\n"
         "</html>";
 
-HTTP_Page IndexPage[] = {{HTTP_Header, sizeof(HTTP_Header)}, {HTTP_Index_Body1, sizeof(HTTP_Index_Body1)}, {HTTP_Index_Body2, 0}, {HTTP_Index_Body3, sizeof(HTTP_Index_Body3)}};
-HTTP_Page SettingsPage[] = {{HTTP_Header, sizeof(HTTP_Header)}, {HTTP_Settings_Body1, sizeof(HTTP_Settings_Body1)}, {pHTTP_Settings_Body2, 0},
-                            {HTTP_Settings_Body3, sizeof(HTTP_Settings_Body3)}, {pHTTP_Settings_Body4, 0}, {HTTP_Settings_Body5, sizeof(HTTP_Settings_Body5)}};
+/* Dynamic parts must be arrays (not pointer variables), so that tables below are constant expressions */
+constexpr HTTP_Page IndexPage[] = {{HTTP_Header, sizeof(HTTP_Header)}, {HTTP_Index_Body1, sizeof(HTTP_Index_Body1)}, {HTTP_Index_Body2, 0}, {HTTP_Index_Body3, sizeof(HTTP_Index_Body3)}};
+constexpr HTTP_Page SettingsPage[] = {{HTTP_Header, sizeof(HTTP_Header)}, {HTTP_Settings_Body1, sizeof(HTTP_Settings_Body1)}, {HTTP_StringForRendering2, 0},
+                                      {HTTP_Settings_Body3, sizeof(HTTP_Settings_Body3)}, {HTTP_StringForRendering, 0}, {HTTP_Settings_Body5, sizeof(HTTP_Settings_Body5)}};
+
+static_assert(HTTP_PagePartsAreValid(IndexPage) && HTTP_PagePartsAreValid(SettingsPage), "page part without content");
 
 /* ====== Array of pages. First page must be home page. Last record in array must be zeros ======= */
-HTTPServerContent_t HTTPServerContent[] = {
-/* |---------------|---------------------------------------------------|--------------------------------------------|------------------------------------*/
-/* |  *pPage       |   PageParts                                       |   *pPageName                               |   HTTP_PageType                    */
-/* |---------------|---------------------------------------------------|--------------------------------------------|------------------------------------*/
-/* | Pointer on    |   sizeof(<ArrayName>) / sizeof(HTTP_Page)         | Pointer or string                          |  Any value, field is filled by     */
-/* |    Array      |                                                   | with page name                             |  application during initialization */
-/* |---------------|---------------------------------------------------|--------------------------------------------|------------------------------------*/
-   {   IndexPage,      sizeof(IndexPage) / sizeof(HTTP_Page),              "index.html",                                HTTP_PageType::Static        },
-   {   SettingsPage,   sizeof(SettingsPage) / sizeof(HTTP_Page),           "settings.html",                             HTTP_PageType::Static        },
-/* |---------------|---------------------------------------------------|--------------------------------------------|------------------------------------*/
+constexpr HTTPServerContent_t HTTPServerContent[] = {
+/* |---------------|-----------------------------------|-------------------|-----------------------------------|----------------------------------------*/
+/* |  *pPage       |   PageParts                       |   *pPageName      |   HTTP_PageType                   |   StaticSize                           */
+/* |---------------|-----------------------------------|-------------------|-----------------------------------|----------------------------------------*/
+/* | Pointer on    |   HTTP_GetPageParts(<ArrayName>)  | Pointer or string |  HTTP_GetPageType(<ArrayName>)    |  HTTP_GetPageStaticSize(<ArrayName>)   */
+/* |    Array      |                                   | with page name    |                                   |                                        */
+/* |---------------|-----------------------------------|-------------------|-----------------------------------|----------------------------------------*/
+   {   IndexPage,      HTTP_GetPageParts(IndexPage),       "index.html",       HTTP_GetPageType(IndexPage),        HTTP_GetPageStaticSize(IndexPage)       },
+   {   SettingsPage,   HTTP_GetPageParts(SettingsPage),    "settings.html",    HTTP_GetPageType(SettingsPage),     HTTP_GetPageStaticSize(SettingsPage)    },
+/* |---------------|-----------------------------------|-------------------|-----------------------------------|----------------------------------------*/
                                                                /* ENDING ELEMENT, DO NOT CHANGE!!! */
-   {   0,              0,                                                  0,                                           HTTP_PageType::Static        }
+   {   0,              0,                                  0,                  HTTP_PageType::Static,              0                                       }
 };
 
+constexpr int HTTPServerContentPages = sizeof(HTTPServerContent) / sizeof(HTTPServerContent[0]) - 1;
+static_assert(HTTP_ContentIsValid(HTTPServerContent), "HTTPServerContent[]: page without content or name, or last element is not zeros");
+
 /*****************************************************************************************************************************
  *                                  VARIABLES
  *****************************************************************************************************************************/
@@ -0,0 +1,93 @@
+/**
+  ******************************************************************************
+  * @file    Histogram.cpp
+  * @author  Ostap Kostyk
+  * @brief   Log2Histogram counts values (e.g. latencies) in power-of-two buckets,
+  *          fixed size, no dynamic memory
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "Histogram.hpp"
+
+using namespace OKO_STATS;
+
+Log2Histogram::Log2Histogram()
+{
+    Clear();
+}
+
+void Log2Histogram::Clear()
+{
+    for(int i=0; i < HISTOGRAM_BUCKETS; i++) { Buckets[i] = 0; }
+    Count = 0;
+    Sum = 0;
+}
+
+void Log2Histogram::Add(uint32_t Value)
+{
+int Bucket = 0;
+
+    if(Value > 1)
+    {
+        Bucket = 31 - __builtin_clz(Value);     //  index of the highest bit set (single CLZ instruction on Cortex-M3)
+        if(Bucket >= HISTOGRAM_BUCKETS) { Bucket = HISTOGRAM_BUCKETS - 1; }
+    }
+
+    if(Buckets[Bucket] < 0xFFFF) { Buckets[Bucket]++; }
+    Count++;
+    Sum += Value;
+}
+
+uint16_t Log2Histogram::GetBucket(int Bucket) const
+{
+    if(Bucket < 0 || Bucket >= HISTOGRAM_BUCKETS) { return 0; }
+
+    return Buckets[Bucket];
+}
+
+uint32_t Log2Histogram::GetPercentile(uint8_t Percent) const
+{
+uint32_t Total = 0;
+uint32_t Rank;
+uint32_t Counted = 0;
+
+    for(int i=0; i < HISTOGRAM_BUCKETS; i++) { Total += Buckets[i]; }  //  not Count, buckets may be saturated
+    if(Total == 0) { return 0; }
+
+    Rank = (Total * Percent + 99) / 100;    //  rank of the value, rounded up
+    if(Rank == 0) { Rank = 1; }
+
+    for(int i=0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        Counted += Buckets[i];
+        if(Counted >= Rank) { return GetBucketUpperBound(i); }
+    }
+
+    return GetBucketUpperBound(HISTOGRAM_BUCKETS - 1);
+}
+
+uint32_t Log2Histogram::GetBucketUpperBound(int Bucket)
+{
+    if(Bucket >= HISTOGRAM_BUCKETS - 1) { return 0xFFFFFFFF; }
+
+    return 2UL << Bucket;
+}
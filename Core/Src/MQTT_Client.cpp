@@ -0,0 +1,661 @@
+/**
+  ******************************************************************************
+  * @file    MQTT_Client.cpp
+  * @author  Ostap Kostyk
+  * @brief   MQTT 3.1.1 client over ESP socket: keep-alive, QoS0/QoS1 publishing
+  *          with batching of small messages, subscriptions and commands which
+  *          set HTTP variables
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "MQTT_Client.hpp"
+
+#ifdef MQTT_CLIENT_EN
+
+#include "HTTP_content.h"
+
+using namespace OKO_MQTT;
+
+/* Control packet types (upper 4 bits of the first byte) */
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        0x20
+#define MQTT_PUBLISH        0x30
+#define MQTT_PUBACK         0x40
+#define MQTT_SUBSCRIBE      0x82    //  with reserved flags
+#define MQTT_SUBACK         0x90
+#define MQTT_PINGREQ        0xC0
+#define MQTT_PINGRESP       0xD0
+
+#define MQTT_PUBLISH_DUP    0x08
+
+MQTT_Client::MQTT_Client(ESP *pESP, uint8_t SocketID, const char *pHost, uint16_t Port, const char *pClientID) : SocketID(SocketID), Port(Port)
+{
+    this->pESP = pESP;
+    this->pHost = pHost;
+    this->pClientID = pClientID;
+}
+
+STATUS MQTT_Client::Publish(const char *pTopic, const uint8_t *pPayload, uint16_t Len, uint8_t QoS, bool Retain)
+{
+uint8_t *p;
+uint32_t Remaining;
+uint16_t PacketLen, Offset, PacketID = 0;
+size_t TopicLen;
+
+    if(pTopic == 0 || QoS > 1 || (pPayload == 0 && Len)) { return ERROR; }
+
+    TopicLen = strlen(pTopic);
+    if(TopicLen == 0 || TopicLen > 0xFFFF) { return ERROR; }
+
+    Remaining = 2 + TopicLen + (QoS ? 2 : 0) + Len;
+    if(Remaining + 5 > 0xFFFF) { return ERROR; }
+    PacketLen = (uint16_t)(HeaderLen(Remaining) + Remaining);
+
+    if(QoS == 0)
+    {
+        if(STEP != 3) { return ERROR; }     //  QoS0 message is not stored while client is not connected
+        if(TxLen + PacketLen > MQTT_TX_BUFFER_SIZE) { return ERROR; }
+        p = &TxBuffer[TxLen];
+    }
+    else
+    {
+        if(InFlightCount >= MQTT_INFLIGHT_MAX) { return ERROR; }
+        Offset = InFlightOffset(InFlightCount);
+        if(Offset + PacketLen > MQTT_INFLIGHT_BUFFER_SIZE) { return ERROR; }
+        p = &InFlightBuffer[Offset];
+
+        PacketID = NextPacketID++;
+        if(NextPacketID == 0) { NextPacketID = 1; }     //  zero is not valid packet identifier
+    }
+
+    p += PutHeader(p, MQTT_PUBLISH | (QoS << 1) | (Retain ? 1 : 0), Remaining);
+    p += PutString(p, pTopic);
+    if(QoS)
+    {
+        *p++ = (uint8_t)(PacketID >> 8);
+        *p++ = (uint8_t)PacketID;
+    }
+    if(Len) { memcpy(p, pPayload, Len); }
+
+    if(QoS == 0)
+    {
+        TxLen += PacketLen;
+        if(BatchPending == false)   //  first message of the batch
+        {
+            BatchPending = true;
+            BatchTimer.Reset();
+        }
+    }
+    else
+    {
+        InFlight[InFlightCount].Len = PacketLen;
+        InFlight[InFlightCount].PacketID = PacketID;
+        InFlight[InFlightCount].Sent = false;
+        InFlight[InFlightCount].Acked = false;
+        InFlightCount++;
+    }
+
+    return SUCCESS;
+}
+
+STATUS MQTT_Client::Subscribe(const char *pTopicFilter, uint8_t QoS)
+{
+    if(pTopicFilter == 0 || *pTopicFilter == 0 || QoS > 1 || SubscriptionsNum >= MQTT_SUBSCRIPTIONS_MAX) { return ERROR; }
+
+    Subscriptions[SubscriptionsNum].pTopicFilter = pTopicFilter;
+    Subscriptions[SubscriptionsNum].QoS = QoS;
+    SubscriptionsNum++;
+
+    if(STEP == 3) { SendSubscribe(); }  //  subscribed at once if connected, otherwise after connection
+
+    return SUCCESS;
+}
+
+STATUS MQTT_Client::BindVariables(const char *pTopicPrefix)
+{
+size_t len;
+
+    if(pTopicPrefix == 0 || VariablesPrefixLen) { return ERROR; }   //  one prefix only
+
+    len = strlen(pTopicPrefix);
+    if(len == 0 || len + 2 > sizeof(VariablesFilter)) { return ERROR; }
+
+    memcpy(VariablesFilter, pTopicPrefix, len);
+    VariablesFilter[len] = '#';
+    VariablesFilter[len + 1] = 0;
+
+    if(SUCCESS != Subscribe(VariablesFilter, 1)) { return ERROR; }
+
+    VariablesPrefixLen = (uint8_t)len;
+    return SUCCESS;
+}
+
+void MQTT_Client::Handle()
+{
+ESP::eSocketState State = pESP->GetSocketState(SocketID);
+
+    switch(STEP)
+    {
+    case 0:     //  not connected
+        if(State != ESP::eSocketState::Closed) { break; }   //  previous connection may still be closing
+
+        if(SUCCESS == pESP->OpenSocketWithID(SocketID, ESP::eSocketType::TCP))
+        {
+            if(SUCCESS == pESP->ConnectSocket(SocketID, (char*)pHost, Port))
+            {
+                StateTimer.Set(MQTT_CONNECT_TIMEOUT);
+                StateTimer.Reset();
+                STEP = 1;
+            }
+            else
+            {
+                pESP->CloseSocket(SocketID);
+            }
+        }
+        break;
+
+    case 1:     //  wait for TCP connection
+        if(State == ESP::eSocketState::Connected)
+        {
+            RxHeader = 0;
+            if(SUCCESS != pESP->ListenSocketStream(SocketID, RxBuffer, sizeof(RxBuffer)) || SendConnect() == false)
+            {
+                Close();
+                break;
+            }
+            STEP = 2;   //  StateTimer keeps running until CONNACK
+            Send();
+            break;
+        }
+
+        if(State == ESP::eSocketState::Closed || State == ESP::eSocketState::Error || StateTimer.Elapsed())
+        {
+            Close();
+        }
+        break;
+
+    case 2:     //  wait for CONNACK
+    case 3:     //  connected
+        if(State != ESP::eSocketState::Connected || Receive() == false)
+        {
+            Close();
+            break;
+        }
+
+        if(STEP == 2 || PingPending)
+        {
+            if(StateTimer.Elapsed())    //  no CONNACK or PINGRESP
+            {
+                debug_print("MQTT: no response from broker\n");
+                Close();
+                break;
+            }
+        }
+        else if(KeepAlive && KeepAliveTimer.Elapsed())
+        {
+            SendPing();
+        }
+
+        Send();
+        break;
+
+    case 4:     //  wait for socket to close and pause before next connection
+        if(State == ESP::eSocketState::Closed && StateTimer.Elapsed())
+        {
+            StateTimer.Stop();
+            STEP = 0;
+        }
+        break;
+
+    default:
+        STEP = 0;
+        break;
+    }
+}
+
+uint16_t MQTT_Client::HeaderLen(uint32_t RemainingLength)
+{
+uint16_t len = 2;
+
+    while(RemainingLength > 127)
+    {
+        RemainingLength >>= 7;
+        len++;
+    }
+
+    return len;
+}
+
+uint16_t MQTT_Client::PutHeader(uint8_t *pBuffer, uint8_t Type, uint32_t RemainingLength)
+{
+uint16_t len = 1;
+
+    pBuffer[0] = Type;
+
+    do  //  variable length encoding, 7 bits per byte, least significant first
+    {
+        pBuffer[len] = RemainingLength & 0x7F;
+        RemainingLength >>= 7;
+        if(RemainingLength) { pBuffer[len] |= 0x80; }
+        len++;
+    }while(RemainingLength);
+
+    return len;
+}
+
+uint16_t MQTT_Client::PutString(uint8_t *pBuffer, const char *pString)
+{
+uint16_t len = (uint16_t)strlen(pString);
+
+    pBuffer[0] = (uint8_t)(len >> 8);
+    pBuffer[1] = (uint8_t)len;
+    memcpy(&pBuffer[2], pString, len);
+
+    return len + 2;
+}
+
+bool MQTT_Client::SendConnect(void)
+{
+static const uint8_t ProtocolName[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};  //  name and level of MQTT 3.1.1
+uint8_t *p = TxBuffer;
+uint32_t Remaining;
+uint8_t Flags = 0x02;   //  clean session, subscriptions are sent after every connection
+
+    Remaining = sizeof(ProtocolName) + 3 + 2 + strlen(pClientID);
+    if(pUser)
+    {
+        Remaining += 2 + strlen(pUser);
+        Flags |= 0x80;
+        if(pPassword)
+        {
+            Remaining += 2 + strlen(pPassword);
+            Flags |= 0x40;
+        }
+    }
+
+    if(HeaderLen(Remaining) + Remaining > MQTT_TX_BUFFER_SIZE) { return false; }
+
+    p += PutHeader(p, MQTT_CONNECT, Remaining);
+    memcpy(p, ProtocolName, sizeof(ProtocolName));
+    p += sizeof(ProtocolName);
+    *p++ = Flags;
+    *p++ = (uint8_t)(KeepAlive >> 8);
+    *p++ = (uint8_t)KeepAlive;
+    p += PutString(p, pClientID);
+    if(pUser)
+    {
+        p += PutString(p, pUser);
+        if(pPassword) { p += PutString(p, pPassword); }
+    }
+
+    TxLen = (uint16_t)(p - TxBuffer);   //  nothing else is in buffer before connection
+    TxSending = 0;
+    TxUrgent = true;
+    BatchPending = false;
+    BatchTimer.Stop();
+    return true;
+}
+
+void MQTT_Client::SendSubscribe(void)
+{
+uint8_t *p;
+uint32_t Remaining = 2;     //  packet identifier
+
+    if(SubscriptionsNum == 0) { return; }
+
+    for(uint8_t i = 0; i < SubscriptionsNum; i++)
+    {
+        Remaining += 2 + strlen(Subscriptions[i].pTopicFilter) + 1;
+    }
+
+    if(TxLen + HeaderLen(Remaining) + Remaining > MQTT_TX_BUFFER_SIZE)
+    {
+        debug_print("MQTT: no space for SUBSCRIBE\n");
+        return;
+    }
+
+    p = &TxBuffer[TxLen];
+    p += PutHeader(p, MQTT_SUBSCRIBE, Remaining);
+    *p++ = (uint8_t)(NextPacketID >> 8);
+    *p++ = (uint8_t)NextPacketID;
+    if(++NextPacketID == 0) { NextPacketID = 1; }
+
+    for(uint8_t i = 0; i < SubscriptionsNum; i++)   //  all filters in one packet
+    {
+        p += PutString(p, Subscriptions[i].pTopicFilter);
+        *p++ = Subscriptions[i].QoS;
+    }
+
+    TxLen = (uint16_t)(p - TxBuffer);
+    TxUrgent = true;
+}
+
+void MQTT_Client::SendPing(void)
+{
+    if(TxLen + 2 > MQTT_TX_BUFFER_SIZE) { return; }     //  buffer is full, something will be sent anyway
+
+    TxBuffer[TxLen++] = MQTT_PINGREQ;
+    TxBuffer[TxLen++] = 0;
+    TxUrgent = true;
+    PingPending = true;
+    StateTimer.Set(MQTT_RESPONSE_TIMEOUT);
+    StateTimer.Reset();
+}
+
+void MQTT_Client::Send(void)
+{
+ESP::eSocketSendDataStatus TxStatus;
+uint8_t i;
+uint16_t Offset;
+
+    if(TxSending || InFlightSending)
+    {
+        TxStatus = pESP->GetDataSendStatus(SocketID);
+        if(TxStatus == ESP::eSocketSendDataStatus::SendSuccess)
+        {
+            SendDone();
+        }
+        else if(TxStatus == ESP::eSocketSendDataStatus::SendFail)
+        {
+            Close();
+            return;
+        }
+        else
+        {
+            return;     //  sending in progress
+        }
+    }
+
+    if(BatchPending && BatchTimer.Elapsed())
+    {
+        BatchPending = false;
+        BatchTimer.Stop();
+    }
+
+    /* control packets and QoS0 messages, small messages wait for batch unless buffer is getting full */
+    if(TxLen && (TxUrgent || BatchPending == false || TxLen >= MQTT_TX_BUFFER_SIZE / 2))
+    {
+        if(SUCCESS == pESP->SocketSend(SocketID, TxBuffer, TxLen))
+        {
+            TxSending = TxLen;
+            TxUrgent = false;
+            BatchPending = false;
+            BatchTimer.Stop();
+        }
+        return;
+    }
+
+    if(STEP != 3) { return; }
+
+    /* QoS1 messages which are not sent yet, all together */
+    for(i = 0; i < InFlightCount; i++)
+    {
+        if(InFlight[i].Sent == false) { break; }
+    }
+    if(i == InFlightCount) { return; }
+
+    Offset = InFlightOffset(i);
+    if(SUCCESS == pESP->SocketSend(SocketID, &InFlightBuffer[Offset], InFlightOffset(InFlightCount) - Offset))
+    {
+        InFlightSendFirst = i;
+        InFlightSending = InFlightCount - i;
+    }
+}
+
+void MQTT_Client::SendDone(void)
+{
+    if(TxSending)
+    {
+        TxLen -= TxSending;
+        if(TxLen) { memmove(TxBuffer, &TxBuffer[TxSending], TxLen); }  //  packets added while sending
+        TxSending = 0;
+    }
+
+    if(InFlightSending)
+    {
+        for(uint8_t i = InFlightSendFirst; i < InFlightSendFirst + InFlightSending; i++)
+        {
+            InFlight[i].Sent = true;
+        }
+        InFlightSending = 0;
+        InFlightCompact();      //  PUBACK may come before "SEND OK"
+    }
+
+    if(KeepAlive)
+    {
+        KeepAliveTimer.Set((unsigned long)KeepAlive * _1sec_);
+        KeepAliveTimer.Reset();
+    }
+}
+
+bool MQTT_Client::Receive(void)
+{
+uint16_t Len;
+uint16_t n;
+const uint8_t *p = RxBuffer;
+
+    Len = pESP->SocketRecv(SocketID);
+    if(Len == 0) { return true; }
+
+    if(Len == (uint16_t)-1) { return false; }   //  data lost (HUART buffer overflow)
+
+    while(Len)
+    {
+        if(RxHeader == 0)   //  first byte of packet
+        {
+            RxHeader = *p++;
+            Len--;
+            if(RxHeader == 0) { return false; }     //  reserved packet type
+            RxLenBytes = 0;
+            RxLenDone = false;
+            RxRemaining = 0;
+            RxPos = 0;
+            continue;
+        }
+
+        if(RxLenDone == false)  //  remaining length, 1 to 4 bytes
+        {
+            RxRemaining |= (uint32_t)(*p & 0x7F) << (7 * RxLenBytes);
+            RxLenDone = ((*p & 0x80) == 0);
+            p++;
+            Len--;
+            if(++RxLenBytes >= 4 && RxLenDone == false) { return false; }
+            if(RxLenDone == false || RxRemaining) { continue; }
+        }
+        else
+        {
+            n = (RxRemaining - RxPos < Len) ? (uint16_t)(RxRemaining - RxPos) : Len;
+            if(RxRemaining <= MQTT_RX_PACKET_SIZE) { memcpy(&Packet[RxPos], p, n); }   //  longer packets are skipped
+            RxPos += n;
+            p += n;
+            Len -= n;
+            if(RxPos < RxRemaining) { continue; }
+        }
+
+        if(RxRemaining <= MQTT_RX_PACKET_SIZE && ParsePacket() == false) { return false; }
+        RxHeader = 0;
+    }
+
+    pESP->ListenSocketStream(SocketID, RxBuffer, sizeof(RxBuffer));     //  next part
+    return true;
+}
+
+bool MQTT_Client::ParsePacket(void)
+{
+uint16_t PacketID;
+
+    switch(RxHeader & 0xF0)
+    {
+    case MQTT_CONNACK:
+        if(STEP != 2 || RxRemaining != 2) { return false; }
+        if(Packet[1] != 0)
+        {
+            debug_print("MQTT: connection refused, code %u\n", Packet[1]);
+            return false;
+        }
+
+        STEP = 3;
+        StateTimer.Stop();
+        PingPending = false;
+        if(KeepAlive)
+        {
+            KeepAliveTimer.Set((unsigned long)KeepAlive * _1sec_);
+            KeepAliveTimer.Reset();
+        }
+        SendSubscribe();    //  stored QoS1 messages are sent by Send()
+        break;
+
+    case MQTT_PUBLISH:
+        if(STEP == 3) { Message(RxHeader & 0x0F); }
+        break;
+
+    case MQTT_PUBACK:
+        if(RxRemaining < 2) { return false; }
+        PacketID = ((uint16_t)Packet[0] << 8) | Packet[1];
+        for(uint8_t i = 0; i < InFlightCount; i++)
+        {
+            if(InFlight[i].PacketID == PacketID) { InFlight[i].Acked = true; }
+        }
+        if(InFlightSending == 0) { InFlightCompact(); }     //  otherwise after sending
+        break;
+
+    case MQTT_SUBACK:
+        for(uint32_t i = 2; i < RxRemaining; i++)
+        {
+            if(Packet[i] == 0x80) { debug_print("MQTT: subscription %u refused\n", (unsigned int)(i - 2)); }
+        }
+        break;
+
+    case MQTT_PINGRESP:
+        PingPending = false;
+        StateTimer.Stop();
+        break;
+
+    default:    //  packets which are not expected by client are ignored
+        break;
+    }
+
+    return true;
+}
+
+void MQTT_Client::Message(uint8_t Flags)
+{
+uint8_t QoS = (Flags >> 1) & 0x03;
+uint16_t TopicLen, PayloadLen, PacketID = 0;
+uint32_t Pos;
+char *pTopic = (char*)Packet;
+char Value[MQTT_VALUE_SIZE];
+HTTPVariable *Variable;
+
+    if(RxRemaining < 2) { return; }
+    TopicLen = ((uint16_t)Packet[0] << 8) | Packet[1];
+    Pos = 2 + TopicLen;
+    if(QoS)
+    {
+        if(Pos + 2 > RxRemaining) { return; }
+        PacketID = ((uint16_t)Packet[Pos] << 8) | Packet[Pos + 1];
+        Pos += 2;
+    }
+    if(Pos > RxRemaining) { return; }
+    PayloadLen = (uint16_t)(RxRemaining - Pos);
+
+    memmove(Packet, &Packet[2], TopicLen);  //  topic is moved over its length to terminate it in place
+    Packet[TopicLen] = 0;
+
+    if(VariablesPrefixLen && TopicLen > VariablesPrefixLen && 0 == strncmp(pTopic, VariablesFilter, VariablesPrefixLen))
+    {
+        Variable = HTTPVariable::FindVariable(&pTopic[VariablesPrefixLen]);
+        if(Variable && PayloadLen < sizeof(Value))
+        {
+            memcpy(Value, &Packet[Pos], PayloadLen);
+            Value[PayloadLen] = 0;
+            if(Variable->SetValue(Value) == false) { debug_print("MQTT: wrong value of %s\n", pTopic); }
+        }
+    }
+
+    if(pCallback) { pCallback(pContext, pTopic, &Packet[Pos], PayloadLen); }
+
+    if(QoS == 1 && TxLen + 4 <= MQTT_TX_BUFFER_SIZE)    //  without space PUBACK is not sent, broker sends message again after reconnection
+    {
+        TxBuffer[TxLen++] = MQTT_PUBACK;
+        TxBuffer[TxLen++] = 2;
+        TxBuffer[TxLen++] = (uint8_t)(PacketID >> 8);
+        TxBuffer[TxLen++] = (uint8_t)PacketID;
+        TxUrgent = true;
+    }
+}
+
+uint16_t MQTT_Client::InFlightOffset(uint8_t Index)
+{
+uint16_t Offset = 0;
+
+    for(uint8_t i = 0; i < Index; i++) { Offset += InFlight[i].Len; }
+
+    return Offset;
+}
+
+void MQTT_Client::InFlightCompact(void)
+{
+uint16_t Src = 0, Dst = 0;
+uint8_t n = 0;
+
+    for(uint8_t i = 0; i < InFlightCount; i++)
+    {
+        if(InFlight[i].Acked == false)
+        {
+            if(Src != Dst) { memmove(&InFlightBuffer[Dst], &InFlightBuffer[Src], InFlight[i].Len); }
+            Dst += InFlight[i].Len;
+            InFlight[n++] = InFlight[i];
+        }
+        Src += InFlight[i].Len;
+    }
+
+    InFlightCount = n;
+}
+
+void MQTT_Client::Close(void)
+{
+    pESP->CloseSocket(SocketID);
+
+    TxLen = 0;                  //  control packets and QoS0 messages are dropped
+    TxSending = 0;
+    TxUrgent = false;
+    BatchPending = false;
+    BatchTimer.Stop();
+    PingPending = false;
+    KeepAliveTimer.Stop();
+
+    InFlightSending = 0;
+    InFlightCompact();
+    for(uint8_t i = 0; i < InFlightCount; i++)  //  QoS1 messages are sent again after reconnection
+    {
+        InFlight[i].Sent = false;
+        InFlightBuffer[InFlightOffset(i)] |= MQTT_PUBLISH_DUP;
+    }
+
+    RxHeader = 0;
+    StateTimer.Set(MQTT_RETRY_TIME);
+    StateTimer.Reset();
+    STEP = 4;
+}
+
+#endif  //  MQTT_CLIENT_EN
@@ -0,0 +1,166 @@
+/**
+  ******************************************************************************
+  * @file    Metrics.cpp
+  * @author  Ostap Kostyk
+  * @brief   Metrics registry: counters, gauges and histograms linked into a list
+  *          at construction (no dynamic memory) and rendered line by line in
+  *          Prometheus text format
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "Metrics.hpp"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef METRICS_EN
+
+using namespace OKO_STATS;
+
+Metric* Metric::pFirst = 0;
+
+static const char* const MetricTypeName[] = {"counter", "gauge", "histogram"};
+
+Metric::Metric(const char *pName, const char *pHelp, eType Type, const char *pLabels)
+    : pName(pName), pHelp(pHelp), pLabels(pLabels), Type(Type), pSource(0), pHistogram(0), Value(0)
+{
+    Link();
+}
+
+Metric::Metric(const char *pName, const char *pHelp, eType Type, const volatile uint32_t *pSource, const char *pLabels)
+    : pName(pName), pHelp(pHelp), pLabels(pLabels), Type(Type), pSource(pSource), pHistogram(0), Value(0)
+{
+    Link();
+}
+
+Metric::Metric(const char *pName, const char *pHelp, Log2Histogram *pHistogram, const char *pLabels)
+    : pName(pName), pHelp(pHelp), pLabels(pLabels), Type(eType::Histogram), pSource(0), pHistogram(pHistogram), Value(0)
+{
+    Link();
+}
+
+void Metric::Link()
+{
+Metric* pMetric;
+
+    Prev = 0;
+    Next = 0;
+
+    pMetric = Metric::pFirst;
+
+    if(pMetric == 0)     //  Creating first instance of the Metric class
+    {
+        Metric::pFirst = this;
+    }
+    else
+    {
+        while(pMetric->Next != 0)
+        {
+            pMetric = pMetric->Next;
+        }
+        pMetric->Next = this;
+        Prev = pMetric;
+    }
+}
+
+void Metric::Add(uint32_t Value)
+{
+    if(pHistogram) { pHistogram->Add(Value); }
+    else           { this->Value += Value; }
+}
+
+void Metric::Set(uint32_t Value)
+{
+    this->Value = Value;
+}
+
+uint32_t Metric::Get() const
+{
+    if(pHistogram) { return pHistogram->GetCount(); }
+    if(pSource)    { return *pSource; }
+
+    return Value;
+}
+
+bool Metric::isFirstOfFamily() const
+{
+    return (Prev == 0 || strcmp(Prev->pName, pName) != 0);
+}
+
+int Metric::GetLines() const
+{
+int Lines = (Type == eType::Histogram) ? HISTOGRAM_BUCKETS + 2 : 1;    //  histogram: buckets (the last one is "+Inf"), sum and count
+
+    if(isFirstOfFamily()) { Lines += 2; }
+
+    return Lines;
+}
+
+int Metric::Render(int Line, char *pBuf, size_t Size) const
+{
+uint32_t Cumulative = 0;
+
+    if(isFirstOfFamily())
+    {
+        if(Line == 0) { return snprintf(pBuf, Size, "# HELP %s %s\n", pName, pHelp); }
+        if(Line == 1) { return snprintf(pBuf, Size, "# TYPE %s %s\n", pName, MetricTypeName[(int)Type]); }
+        Line -= 2;
+    }
+
+    if(Type != eType::Histogram)
+    {
+        return snprintf(pBuf, Size, "%s%s%s%s %lu\n", pName, pLabels ? "{" : "", pLabels ? pLabels : "", pLabels ? "}" : "", (unsigned long)Get());
+    }
+
+    if(Line < HISTOGRAM_BUCKETS - 1)    //  buckets are cumulative in Prometheus, "le" is inclusive upper bound
+    {
+        for(int i=0; i <= Line; i++) { Cumulative += pHistogram->GetBucket(i); }
+
+        return snprintf(pBuf, Size, "%s_bucket{%s%sle=\"%lu\"} %lu\n", pName, pLabels ? pLabels : "", pLabels ? "," : "",
+                        (unsigned long)(Log2Histogram::GetBucketUpperBound(Line) - 1), (unsigned long)Cumulative);
+    }
+
+    if(Line == HISTOGRAM_BUCKETS - 1)
+    {
+        return snprintf(pBuf, Size, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", pName, pLabels ? pLabels : "", pLabels ? "," : "", (unsigned long)pHistogram->GetCount());
+    }
+
+    return snprintf(pBuf, Size, "%s_%s%s%s%s %lu\n", pName, (Line == HISTOGRAM_BUCKETS) ? "sum" : "count", pLabels ? "{" : "", pLabels ? pLabels : "", pLabels ? "}" : "",
+                    (unsigned long)((Line == HISTOGRAM_BUCKETS) ? pHistogram->GetSum() : pHistogram->GetCount()));
+}
+
+int Metric::RenderLine(int Line, char *pBuf, size_t Size)
+{
+const Metric* pMetric = Metric::pFirst;
+int Lines;
+
+    while(pMetric)      //  registry is small, it is cheaper to walk it again than to keep position for every connection
+    {
+        Lines = pMetric->GetLines();
+        if(Line < Lines) { return pMetric->Render(Line, pBuf, Size); }
+        Line -= Lines;
+        pMetric = pMetric->Next;
+    }
+
+    return -1;
+}
+
+#endif  //  METRICS_EN
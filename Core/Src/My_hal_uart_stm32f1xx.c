@@ -171,6 +171,8 @@
 /* Private define ------------------------------------------------------------*/
 /* Private macros ------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+static UART_ErrorCounters UART1_ErrorCounters;
+static UART_ErrorCounters UART2_ErrorCounters;
 /* Private function prototypes -----------------------------------------------*/
 
 /* External variables --------------------------------------------------------*/
@@ -204,17 +206,22 @@ void MY_USART2_IRQHandler(void)
 }
 
 STATUS Init_USART_CB(UART_HandleTypeDef *huart, circular_buffer *cb_Rx, circular_buffer *cb_Tx, size_t cb_size_rx, size_t cb_size_tx, size_t data_size)
+{
+   return Init_USART_CB_Static(huart, cb_Rx, cb_Tx, memmgr_alloc(cb_size_rx * data_size), memmgr_alloc(cb_size_tx * data_size), cb_size_rx, cb_size_tx, data_size);
+}
+
+STATUS Init_USART_CB_Static(UART_HandleTypeDef *huart, circular_buffer *cb_Rx, circular_buffer *cb_Tx, void *buffer_rx, void *buffer_tx, size_t cb_size_rx, size_t cb_size_tx, size_t data_size)
 {
    if((data_size != sizeof(uint8_t)) && (data_size != sizeof(uint16_t)))
    {
       return ERROR;
    }
 
-   if(SUCCESS == cb_init(cb_Rx, cb_size_rx, data_size))
+   if(SUCCESS == cb_init_static(cb_Rx, buffer_rx, cb_size_rx, data_size))
    {
       huart->pRxBuffPtr = (uint8_t *)cb_Rx;
       huart->gState &= ~MY_HAL_UART_STATE_RX_OVERFLOW;
-      if(SUCCESS == cb_init(cb_Tx, cb_size_tx, data_size))
+      if(SUCCESS == cb_init_static(cb_Tx, buffer_tx, cb_size_tx, data_size))
       {
         huart->pTxBuffPtr = (uint8_t *)cb_Tx;
         return SUCCESS;
@@ -255,6 +262,14 @@ int UART_RxDataOverflow(UART_HandleTypeDef *huart)
     return 0;
 }
 
+UART_ErrorCounters* UART_GetErrorCounters(UART_HandleTypeDef *huart)
+{
+    if(huart == &huart1) { return &UART1_ErrorCounters; }
+    if(huart == &huart2) { return &UART2_ErrorCounters; }
+
+    return 0;
+}
+
 static HAL_StatusTypeDef My_UART_Transmit_IT(UART_HandleTypeDef *huart);
 static HAL_StatusTypeDef My_UART_Receive_IT(UART_HandleTypeDef *huart);
 /**
@@ -329,6 +344,7 @@ HAL_StatusTypeDef My_HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, uint8_t *pD
 void My_HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
 {
   uint32_t tmp_flag = 0, tmp_it_source = 0;
+  UART_ErrorCounters *pCounters;
 
   tmp_flag = __HAL_UART_GET_FLAG(huart, UART_FLAG_PE);
   tmp_it_source = __HAL_UART_GET_IT_SOURCE(huart, UART_IT_PE);  
@@ -344,6 +360,8 @@ void My_HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
   if((tmp_flag != RESET) && (tmp_it_source != RESET))
   { 
     huart->ErrorCode |= HAL_UART_ERROR_FE;
+    pCounters = UART_GetErrorCounters(huart);
+    if(pCounters) { pCounters->FrameErrors++; }
   }
   
   tmp_flag = __HAL_UART_GET_FLAG(huart, UART_FLAG_NE);
@@ -351,6 +369,8 @@ void My_HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
   if((tmp_flag != RESET) && (tmp_it_source != RESET))
   { 
     huart->ErrorCode |= HAL_UART_ERROR_NE;
+    pCounters = UART_GetErrorCounters(huart);
+    if(pCounters) { pCounters->NoiseErrors++; }
   }
   
   tmp_flag = __HAL_UART_GET_FLAG(huart, UART_FLAG_ORE);
@@ -358,6 +378,8 @@ void My_HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
   if((tmp_flag != RESET) && (tmp_it_source != RESET))
   { 
     huart->ErrorCode |= HAL_UART_ERROR_ORE;
+    pCounters = UART_GetErrorCounters(huart);
+    if(pCounters) { pCounters->OverrunErrors++; }
   }
   
   tmp_flag = __HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE);
@@ -0,0 +1,333 @@
+/**
+  ******************************************************************************
+  * @file    OTA_Update.cpp
+  * @author  Ostap Kostyk
+  * @brief   Firmware update over the air: writes received image into staging
+  *          area of flash through double-buffered writer and verifies CRC32
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "OTA_Update.hpp"
+#include <string.h>
+
+#ifdef HTTP_SERV_OTA_EN
+
+using namespace OKO_OTA;
+
+/* CRC32 table for 4-bit processing (64 bytes of flash instead of 1K for byte table) */
+static const uint32_t CRC32_Table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+OTA_Update::OTA_Update(uint32_t StagingAddress, uint32_t StagingSize) : StagingAddress(StagingAddress), StagingSize(StagingSize)
+{
+    State = eState::Idle;
+    Error = eError::NoError;
+    ImageSize = 0;
+    ImageCRC = 0;
+    ReceivedBytes = 0;
+    ProgrammedBytes = 0;
+    EraseAddress = 0;
+    EraseEnd = 0;
+    VerifyCRC = 0;
+    LastProgress = 0;
+    BufferLen[0] = BufferLen[1] = 0;
+    BufferFull[0] = BufferFull[1] = false;
+    FillIndex = 0;
+    ProgramIndex = 0;
+    ProgramPos = 0;
+}
+
+STATUS OTA_Update::Begin(uint32_t ImageSize, uint32_t ImageCRC)
+{
+    if(State == eState::Erasing || State == eState::Receiving || State == eState::Verifying) { return ERROR; }   //  update in progress
+
+    if(ImageSize == 0 || ImageSize > StagingSize)
+    {
+        Fail(eError::TooBig);
+        return ERROR;
+    }
+
+    if(SUCCESS != Flash_Init())
+    {
+        Fail(eError::Erase);
+        return ERROR;
+    }
+
+    this->ImageSize = ImageSize;
+    this->ImageCRC = ImageCRC;
+    ReceivedBytes = 0;
+    ProgrammedBytes = 0;
+    EraseAddress = StagingAddress;
+    EraseEnd = StagingAddress + ((ImageSize + FLASH_IF_PAGE_SIZE - 1) / FLASH_IF_PAGE_SIZE) * FLASH_IF_PAGE_SIZE;
+    LastProgress = 0;
+    BufferLen[0] = BufferLen[1] = 0;
+    BufferFull[0] = BufferFull[1] = false;
+    FillIndex = 0;
+    ProgramIndex = 0;
+    ProgramPos = 0;
+    Error = eError::NoError;
+    State = eState::Erasing;
+
+    debug_print("OTA: Begin, size=%lu, CRC32=%08lx\n", (unsigned long)ImageSize, (unsigned long)ImageCRC);
+
+    return SUCCESS;
+}
+
+void OTA_Update::Abort()
+{
+    if(State == eState::Erasing || State == eState::Receiving || State == eState::Verifying)
+    {
+        Fail(eError::Aborted);
+    }
+}
+
+void OTA_Update::Fail(eError Error)
+{
+    this->Error = Error;
+    State = eState::Error;
+    debug_print("OTA: Error: %s\n", GetErrorString(Error));
+}
+
+uint8_t* OTA_Update::GetWriteBuffer(uint16_t &Space)
+{
+uint32_t left;
+
+    Space = 0;
+
+    if(State != eState::Receiving || BufferFull[FillIndex]) { return 0; }
+
+    left = ImageSize - ReceivedBytes;
+    if(left == 0) { return 0; }
+
+    Space = OTA_BUFFER_SIZE - BufferLen[FillIndex];
+    if(Space > left) { Space = (uint16_t)left; }
+
+    return &Buffer[FillIndex][BufferLen[FillIndex]];
+}
+
+void OTA_Update::Commit(uint16_t Len)
+{
+    if(State != eState::Receiving || BufferFull[FillIndex]) { return; }
+
+    if(Len > OTA_BUFFER_SIZE - BufferLen[FillIndex]) { Len = OTA_BUFFER_SIZE - BufferLen[FillIndex]; }
+    if(Len > ImageSize - ReceivedBytes) { Len = (uint16_t)(ImageSize - ReceivedBytes); }
+
+    BufferLen[FillIndex] += Len;
+    ReceivedBytes += Len;
+
+    if(BufferLen[FillIndex] == OTA_BUFFER_SIZE || ReceivedBytes == ImageSize)  //  buffer is ready for programming, continue receiving into the other one
+    {
+        BufferFull[FillIndex] = true;
+        FillIndex ^= 1;
+    }
+}
+
+uint16_t OTA_Update::Write(const uint8_t *pData, uint16_t Len)
+{
+uint8_t *pBuffer;
+uint16_t Space;
+uint16_t Written = 0;
+
+    while(Len)
+    {
+        pBuffer = GetWriteBuffer(Space);
+        if(pBuffer == 0) { break; }     //  both buffers are full
+
+        if(Space > Len) { Space = Len; }
+        memcpy(pBuffer, pData, Space);
+        Commit(Space);
+
+        pData += Space;
+        Len -= Space;
+        Written += Space;
+    }
+
+    return Written;
+}
+
+void OTA_Update::Handle()
+{
+const uint8_t *p;
+uint16_t HalfWord;
+uint32_t i, len;
+uint8_t Progress;
+
+    switch(State)
+    {
+    case eState::Erasing:   //  one page per call, CPU is stalled while erasing
+        p = Flash_GetPointer(EraseAddress);
+        if(p == 0)
+        {
+            Fail(eError::Erase);
+            break;
+        }
+
+        for(i = 0; i < FLASH_IF_PAGE_SIZE; i++)     //  skip pages which are already erased
+        {
+            if(p[i] != 0xFF) { break; }
+        }
+
+        if(i < FLASH_IF_PAGE_SIZE && SUCCESS != Flash_ErasePage(EraseAddress))
+        {
+            Fail(eError::Erase);
+            break;
+        }
+
+        EraseAddress += FLASH_IF_PAGE_SIZE;
+        if(EraseAddress >= EraseEnd)
+        {
+            State = eState::Receiving;
+            debug_print("OTA: Flash erased\n");
+        }
+        break;
+
+    case eState::Receiving:
+        if(BufferFull[ProgramIndex] == false) { break; }
+
+        for(i = 0; i < OTA_PROGRAM_HALFWORDS_PER_CALL && ProgramPos < BufferLen[ProgramIndex]; i++)
+        {
+            HalfWord = Buffer[ProgramIndex][ProgramPos];
+            if(ProgramPos + 1 < BufferLen[ProgramIndex]) { HalfWord |= (uint16_t)Buffer[ProgramIndex][ProgramPos + 1] << 8; }
+            else                                         { HalfWord |= 0xFF00; }     //  odd length of image, pad with erased value
+
+            if(SUCCESS != Flash_ProgramHalfWord(StagingAddress + ProgrammedBytes + ProgramPos, HalfWord))
+            {
+                Fail(eError::Program);
+                return;
+            }
+            ProgramPos += 2;
+        }
+
+        if(ProgramPos >= BufferLen[ProgramIndex])   //  buffer is programmed, release it for receiving
+        {
+            ProgrammedBytes += BufferLen[ProgramIndex];
+            BufferLen[ProgramIndex] = 0;
+            BufferFull[ProgramIndex] = false;
+            ProgramIndex ^= 1;
+            ProgramPos = 0;
+
+            Progress = GetProgress();
+            if(Progress / 10 != LastProgress / 10)
+            {
+                debug_print("OTA: %u%%\n", Progress);
+            }
+            LastProgress = Progress;
+
+            if(ProgrammedBytes >= ImageSize)
+            {
+                VerifyCRC = 0;
+                EraseAddress = StagingAddress;  //  used as verification address
+                State = eState::Verifying;
+            }
+        }
+        break;
+
+    case eState::Verifying:     //  CRC of flash content (not of received data) to detect programming errors as well
+        len = StagingAddress + ImageSize - EraseAddress;
+        if(len > OTA_VERIFY_BYTES_PER_CALL) { len = OTA_VERIFY_BYTES_PER_CALL; }
+
+        p = Flash_GetPointer(EraseAddress);
+        if(p == 0)
+        {
+            Fail(eError::Program);
+            break;
+        }
+
+        VerifyCRC = CRC32(VerifyCRC, p, len);
+        EraseAddress += len;
+
+        if(EraseAddress >= StagingAddress + ImageSize)
+        {
+            if(VerifyCRC == ImageCRC)
+            {
+                State = eState::Done;
+                debug_print("OTA: Done, image is valid\n");
+            }
+            else
+            {
+                debug_print("OTA: CRC32=%08lx, expected %08lx\n", (unsigned long)VerifyCRC, (unsigned long)ImageCRC);
+                Fail(eError::CRCMismatch);
+            }
+        }
+        break;
+
+    case eState::Idle:
+    case eState::Done:
+    case eState::Error:
+    default:
+        break;
+    }
+}
+
+uint8_t OTA_Update::GetProgress() const
+{
+    if(ImageSize == 0) { return 0; }
+
+    return (uint8_t)((ProgrammedBytes * 100UL) / ImageSize);
+}
+
+const char* OTA_Update::GetStateString(eState State)
+{
+    switch(State)
+    {
+    case eState::Idle:      return "idle";
+    case eState::Erasing:   return "erasing";
+    case eState::Receiving: return "receiving";
+    case eState::Verifying: return "verifying";
+    case eState::Done:      return "done";
+    case eState::Error:     return "error";
+    }
+    return "";
+}
+
+const char* OTA_Update::GetErrorString(eError Error)
+{
+    switch(Error)
+    {
+    case eError::NoError:       return "";
+    case eError::Busy:          return "busy";
+    case eError::TooBig:        return "image too big";
+    case eError::Erase:         return "flash erase failed";
+    case eError::Program:       return "flash program failed";
+    case eError::Aborted:       return "aborted";
+    case eError::CRCMismatch:   return "CRC mismatch";
+    }
+    return "";
+}
+
+uint32_t OTA_Update::CRC32(uint32_t Crc, const uint8_t *pData, size_t Len)
+{
+    Crc = ~Crc;
+
+    while(Len--)
+    {
+        Crc = CRC32_Table[(Crc ^ *pData) & 0x0F] ^ (Crc >> 4);
+        Crc = CRC32_Table[(Crc ^ (*pData >> 4)) & 0x0F] ^ (Crc >> 4);
+        pData++;
+    }
+
+    return ~Crc;
+}
+
+#endif  //  HTTP_SERV_OTA_EN
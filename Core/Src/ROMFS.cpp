@@ -0,0 +1,110 @@
+/**
+  ******************************************************************************
+  * @file    ROMFS.cpp
+  * @author  Ostap Kostyk
+  * @brief   Read-only file system image located in flash (static assets for HTTP Server)
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "ROMFS.h"
+#include <string.h>
+
+#ifdef HTTP_SERV_ROMFS_EN
+
+/* Order must match ROMFS_MimeType */
+static const char* const ROMFS_MimeTypeString[] = {
+        "application/octet-stream",
+        "text/html; charset=utf-8",
+        "text/css",
+        "application/javascript",
+        "application/json",
+        "text/plain; charset=utf-8",
+        "image/png",
+        "image/jpeg",
+        "image/gif",
+        "image/svg+xml",
+        "image/x-icon"
+};
+
+uint32_t ROMFS_Hash(const char *pPath, size_t Len)
+{
+uint32_t hash = 2166136261UL;   //  FNV-1a offset basis, must match Tools/mkromfs.py
+
+    while(Len--)
+    {
+        hash ^= (uint8_t)*pPath++;
+        hash *= 16777619UL;     //  FNV-1a prime
+    }
+
+    return hash;
+}
+
+/* Files with any of SkipFlags are skipped (gzip-compressed copy and uncompressed one have the same path) */
+static const ROMFS_File* ROMFS_Lookup(const char *pPath, size_t Len, uint8_t SkipFlags)
+{
+uint32_t hash;
+uint16_t mask;
+uint16_t bucket;
+uint16_t FileNum;
+const ROMFS_File *pFile;
+
+    if(ROMFS.Magic != ROMFS_MAGIC || ROMFS.NumOfFiles == 0) { return 0; }
+
+    hash = ROMFS_Hash(pPath, Len);
+    mask = ROMFS.IndexSize - 1;
+    bucket = (uint16_t)(hash & mask);
+
+    /* index is always bigger than number of files, so there is at least one empty bucket which terminates probing */
+    while((FileNum = ROMFS.pIndex[bucket]) != 0)
+    {
+        pFile = &ROMFS.pFiles[FileNum - 1];
+        if(pFile->PathHash == hash && 0 == strncmp(pFile->pPath, pPath, Len) && pFile->pPath[Len] == 0 && 0 == (pFile->Flags & SkipFlags))
+        {
+            return pFile;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    return 0;
+}
+
+const ROMFS_File* ROMFS_Find(const char *pPath, size_t Len)
+{
+    return ROMFS_Lookup(pPath, Len, 0);
+}
+
+const ROMFS_File* ROMFS_FindPlain(const char *pPath, size_t Len)
+{
+    return ROMFS_Lookup(pPath, Len, ROMFS_FLAG_GZIP);
+}
+
+const char* ROMFS_GetMimeTypeString(ROMFS_MimeType Type)
+{
+    if((size_t)Type >= sizeof(ROMFS_MimeTypeString)/sizeof(ROMFS_MimeTypeString[0]))
+    {
+        return ROMFS_MimeTypeString[0];
+    }
+
+    return ROMFS_MimeTypeString[(size_t)Type];
+}
+
+#endif  //  HTTP_SERV_ROMFS_EN
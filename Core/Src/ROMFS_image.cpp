@@ -0,0 +1,34 @@
+/* This file is generated by Tools/mkromfs.py from HTML/romfs, do not edit */
+
+#include "ROMFS.h"
+
+#ifdef HTTP_SERV_ROMFS_EN
+
+/* favicon.ico, 198 bytes */
+static const uint8_t ROMFS_Data0[] = {
+        0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x10, 0x10, 0x02, 0x00, 0x01, 0x00, 0x01, 0x00, 0xB0, 0x00,
+        0x00, 0x00, 0x16, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x20, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0xAF,
+        0x4C, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18,
+        0x00, 0x00, 0x1F, 0xF8, 0x00, 0x00, 0x1F, 0xF8, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18,
+        0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01,
+        0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01,
+        0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00,
+};
+
+static const ROMFS_File ROMFS_Files[] = {
+    {0x1A629480UL, "favicon.ico", ROMFS_Data0, 198, "\"2d2e5f13\"", ROMFS_MimeType::Icon, 0x00},
+};
+
+static const uint16_t ROMFS_Index[] = {
+    1, 0, 0, 0,
+};
+
+const ROMFS_Image ROMFS = {0x53464D52UL, 1, 4, ROMFS_Files, ROMFS_Index};
+
+#endif  //  HTTP_SERV_ROMFS_EN
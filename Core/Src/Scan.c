@@ -0,0 +1,158 @@
+/**
+  ******************************************************************************
+  * @file    Scan.c
+  * @author  Ostap Kostyk
+  * @brief   Scan implements word-at-a-time (SWAR) search of delimiters in
+  *          received data: one 32-bit word (4 bytes) is checked per step on
+  *          aligned data, byte by byte search is used for unaligned head and tail
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "Scan.h"
+
+#if !defined(SCAN_BYTEWISE) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SCAN_SWAR
+#endif
+
+#ifdef SCAN_SWAR
+typedef uint32_t __attribute__((__may_alias__)) scan_word;     //  word read from char buffer
+
+#define SCAN_ONES   0x01010101UL    //  multiplied by byte gives the byte in every position of the word
+#define SCAN_LOW7   0x7F7F7F7FUL
+
+/* Returns word with bit 7 set in every zero byte of w and all other bits cleared. Exact (no false positives
+ * caused by borrow unlike shorter (w - 0x01010101) & ~w & 0x80808080), so several results can be ORed */
+static inline uint32_t ZeroBytes(uint32_t w)
+{
+    return ~(((w & SCAN_LOW7) + SCAN_LOW7) | w | SCAN_LOW7);
+}
+
+/* Index of the first (lowest address) byte marked by ZeroBytes(), Mask must not be zero */
+static inline size_t FirstByte(uint32_t Mask)
+{
+    return (size_t)__builtin_ctz(Mask) >> 3;     //  RBIT + CLZ on Cortex-M3
+}
+#endif
+
+const char* Scan_FindByte(const char *p, size_t Len, char c)
+{
+#ifdef SCAN_SWAR
+uint32_t Pattern, Mask;
+
+    while(Len && ((uintptr_t)p & 3))    //  unaligned head
+    {
+        if(*p == c) { return p; }
+        p++;
+        Len--;
+    }
+
+    Pattern = (uint8_t)c * SCAN_ONES;
+    while(Len >= 4)
+    {
+        Mask = ZeroBytes(*(const scan_word*)p ^ Pattern);
+        if(Mask) { return p + FirstByte(Mask); }
+        p += 4;
+        Len -= 4;
+    }
+#endif
+
+    while(Len)
+    {
+        if(*p == c) { return p; }
+        p++;
+        Len--;
+    }
+
+    return 0;
+}
+
+const char* Scan_FindAny(const char *p, size_t Len, const char *pSet, size_t SetLen)
+{
+size_t i;
+#ifdef SCAN_SWAR
+uint32_t Pattern[SCAN_SET_MAX];
+uint32_t Word, Mask;
+#endif
+
+    if(SetLen > SCAN_SET_MAX) { SetLen = SCAN_SET_MAX; }
+
+#ifdef SCAN_SWAR
+    while(Len && ((uintptr_t)p & 3))    //  unaligned head
+    {
+        for(i=0; i < SetLen; i++) { if(*p == pSet[i]) { return p; } }
+        p++;
+        Len--;
+    }
+
+    for(i=0; i < SetLen; i++) { Pattern[i] = (uint8_t)pSet[i] * SCAN_ONES; }
+
+    while(Len >= 4)
+    {
+        Word = *(const scan_word*)p;
+        Mask = 0;
+        for(i=0; i < SetLen; i++) { Mask |= ZeroBytes(Word ^ Pattern[i]); }
+        if(Mask) { return p + FirstByte(Mask); }
+        p += 4;
+        Len -= 4;
+    }
+#endif
+
+    while(Len)
+    {
+        for(i=0; i < SetLen; i++) { if(*p == pSet[i]) { return p; } }
+        p++;
+        Len--;
+    }
+
+    return 0;
+}
+
+const char* Scan_FindCRLF(const char *p, size_t Len)
+{
+const char *pEnd = p + Len;
+
+    while(p < pEnd)
+    {
+        p = Scan_FindByte(p, pEnd - p, '\r');
+        if(p == 0 || p + 1 >= pEnd) { return 0; }
+        if(p[1] == '\n') { return p; }
+        p++;
+    }
+
+    return 0;
+}
+
+const char* Scan_FindCRLFCRLF(const char *p, size_t Len)
+{
+const char *pStart = p;
+const char *pEnd = p + Len;
+
+    while(p < pEnd)
+    {
+        p = Scan_FindByte(p, pEnd - p, '\n');   //  second byte of the sequence is searched, then neighbours are checked
+        if(p == 0 || p + 2 >= pEnd) { return 0; }
+        if(p > pStart && p[-1] == '\r' && p[1] == '\r' && p[2] == '\n') { return p - 1; }
+        p++;
+    }
+
+    return 0;
+}
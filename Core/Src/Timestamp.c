@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file    Timestamp.c
+  * @author  Ostap Kostyk
+  * @brief   Timestamp implements high-resolution time stamps based on DWT cycle
+  *          counter of Cortex-M3 core for latency measurements
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "Timestamp.h"
+
+void Timestamp_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;     //  enable trace and debug blocks (DWT)
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t Timestamp_Get(void)
+{
+    return DWT->CYCCNT;
+}
+
+uint32_t Timestamp_ElapsedUs(uint32_t Start, uint32_t End)
+{
+    return (End - Start) / (SystemCoreClock / 1000000UL);     //  unsigned subtraction handles counter wrap-around
+}
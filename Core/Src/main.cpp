@@ -63,6 +63,9 @@ extern "C" {
 #include "Button.h"
 #include "ESP8266.hpp"
 #include "HTTP_Server.hpp"
+#include "HTTP_Client.hpp"
+#include "MQTT_Client.hpp"
+#include "CoAP_Server.hpp"
 
 using namespace mTimer;
 using namespace OKO_ESP8266;
@@ -140,11 +143,57 @@ Button Button1{Button1_GPIO_Port, Button1_Pin, Button::ePressedLevel::Low};
 #define STD_IN_CB_SIZE      200
 #define STD_OUT_CB_SIZE     200
 
+#if !defined(HTTP_CLIENT_EN) && !defined(MQTT_CLIENT_EN) && !defined(COAP_SERVER_EN)
 /* Create ESP instance */
-ESP ESP1{ESP1_HUART_NUM};
+ESP_Instance<> ESP1{ESP1_HUART_NUM};
 
 /* Create HTTP server instance */
-HTTP_Server MyHTTPServer{&ESP1};
+HTTP_ServerInstance<> MyHTTPServer{&ESP1};
+#else
+/* Upper sockets are used by clients and CoAP server, HTTP server accepts connections on the others */
+#ifdef HTTP_CLIENT_EN
+#define ESP1_HTTP_CLIENT_SOCKETS    1
+#else
+#define ESP1_HTTP_CLIENT_SOCKETS    0
+#endif
+#ifdef MQTT_CLIENT_EN
+#define ESP1_MQTT_CLIENT_SOCKETS    1
+#else
+#define ESP1_MQTT_CLIENT_SOCKETS    0
+#endif
+#ifdef COAP_SERVER_EN
+#define ESP1_COAP_SERVER_SOCKETS    1
+#else
+#define ESP1_COAP_SERVER_SOCKETS    0
+#endif
+#define ESP1_CLIENT_SOCKETS     (ESP1_HTTP_CLIENT_SOCKETS + ESP1_MQTT_CLIENT_SOCKETS + ESP1_COAP_SERVER_SOCKETS)
+struct ESP1_Config : ESP_DefaultConfig { static constexpr uint8_t ServerConnections = ESP8266_SOCKETS_MAX - ESP1_CLIENT_SOCKETS; };
+struct MyHTTPServer_Config : HTTP_ServerDefaultConfig { static constexpr uint8_t Sockets = ESP8266_SOCKETS_MAX - ESP1_CLIENT_SOCKETS; };
+
+ESP_Instance<ESP1_Config> ESP1{ESP1_HUART_NUM};
+HTTP_ServerInstance<MyHTTPServer_Config> MyHTTPServer{&ESP1};
+#endif
+
+#ifdef HTTP_CLIENT_EN
+/* Client posts button events to the collector (e.g. PC connected to the access point) */
+OKO_HTTP_CLIENT::HTTP_Client MyHTTPClient{&ESP1, ESP8266_SOCKETS_MAX - 1, "192.168.0.2", 8080};
+#endif
+
+#ifdef MQTT_CLIENT_EN
+/* Client publishes button events to the broker (e.g. Mosquitto on PC connected to the access point),
+ * messages on "esp1/set/<variable>" set HTTP variables like the settings page does */
+OKO_MQTT::MQTT_Client MyMQTTClient{&ESP1, ESP8266_SOCKETS_MAX - ESP1_HTTP_CLIENT_SOCKETS - 1, "192.168.0.2", 1883, "esp1"};
+#endif
+
+#ifdef COAP_SERVER_EN
+/* Pages and variables of HTTP server are also served over CoAP (UDP port 5683), e.g. "coap-client -m get coap://<IP>/.well-known/core" */
+OKO_COAP::CoAP_Server MyCoAPServer{&ESP1, ESP8266_SOCKETS_MAX - ESP1_CLIENT_SOCKETS};
+#endif
+
+#ifdef HTTP_SERV_OTA_EN
+/* Firmware update, image is uploaded by "POST /update" and written to flash staging area */
+OKO_OTA::OTA_Update FirmwareUpdate{};
+#endif
 
 /*************************************************************
  *      TCP/IP communication
@@ -498,6 +547,18 @@ int main(void)
 
 #endif  /* END OF #ifdef EEPROM_EMULATION_EN */
 
+#if defined(ESP8266_TIMESTAMPS_EN) || defined(ESP8266_PROCESS_BUDGET_US) || defined(HTTP_SERV_HANDLE_BUDGET_US)
+  Timestamp_Init();     /*  cycle counter for latency measurements and time budget of ESP1.Process() and MyHTTPServer.Handle() */
+#endif
+
+#ifdef HTTP_SERV_OTA_EN
+  MyHTTPServer.AttachOTA(&FirmwareUpdate);
+#endif
+
+#ifdef MQTT_CLIENT_EN
+  MyMQTTClient.BindVariables("esp1/set/");  /*  e.g. "esp1/set/BlueLEDMode" with payload "Blink" */
+#endif
+
   /* Start WiFi module */
   ESP1.ModuleToggle(ESP::eModuleToggle::Enable);
 
@@ -531,6 +592,25 @@ int main(void)
 	        Button1.ClearReleasedEvent();
 	        /*  turn LED4 On for a time of which button kept pressed last time (to test Button, LED and Timer classes) */
 	        LED4.BlinkNtimes(Button1.GetPressedTime(), _100ms_, 1);
+#ifdef HTTP_SERV_LATENCY_STATS_EN
+	        MyHTTPServer.PrintLatencyStats();   /*  request latency histograms to debug output */
+#endif
+#ifdef HTTP_CLIENT_EN
+	        do
+	        {
+	          char Event[48];
+	          int len = snprintf(Event, sizeof(Event), "{\"button\":1,\"pressed_ms\":%lu}", (unsigned long)Button1.GetPressedTime());
+	          MyHTTPClient.Request(OKO_HTTP_CLIENT::HTTP_Client::eMethod::Post, "/events", "application/json", (const uint8_t*)Event, (uint16_t)len);  /*  event is dropped if queue is full */
+	        }while(0);
+#endif
+#ifdef MQTT_CLIENT_EN
+	        do
+	        {
+	          char Event[16];
+	          snprintf(Event, sizeof(Event), "%lu", (unsigned long)Button1.GetPressedTime());
+	          MyMQTTClient.Publish("esp1/button", Event, 1);    /*  QoS1: stored until broker confirms it */
+	        }while(0);
+#endif
 	    }
 
 	/****************************************************
@@ -592,6 +672,15 @@ int main(void)
 
 	          /*  run HTTP server */
 	          MyHTTPServer.Handle();
+#ifdef HTTP_CLIENT_EN
+	          MyHTTPClient.Handle();    /*  connects when there are events to post */
+#endif
+#ifdef MQTT_CLIENT_EN
+	          MyMQTTClient.Handle();    /*  keeps connection to the broker */
+#endif
+#ifdef COAP_SERVER_EN
+	          MyCoAPServer.Handle();    /*  binds UDP socket and answers requests */
+#endif
 	          break;
 
 	      default:
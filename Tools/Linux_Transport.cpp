@@ -0,0 +1,589 @@
+/**
+  ******************************************************************************
+  * @file    Linux_Transport.cpp
+  * @author  Ostap Kostyk
+  * @brief   Transport over non-blocking POSIX sockets and epoll, so HTTP_Server
+  *          and HTTP content run as a host process (see host_server.cpp)
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include "Linux_Transport.hpp"
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+using namespace OKO_TRANSPORT;
+
+#define LISTEN_TAG      0xFFFFFFFFU     //  epoll data of listening socket, sockets have their index
+
+static_assert((LINUX_TRANSPORT_EVENT_QUEUE_LEN & (LINUX_TRANSPORT_EVENT_QUEUE_LEN - 1)) == 0 && LINUX_TRANSPORT_EVENT_QUEUE_LEN <= 128, "event queue length must be power of 2 up to 128");
+
+Linux_Transport::Linux_Transport(uint8_t Sockets) : SocketsNum(Sockets < LINUX_TRANSPORT_SOCKETS_MAX ? Sockets : LINUX_TRANSPORT_SOCKETS_MAX)
+{
+    for(uint8_t i = 0; i < LINUX_TRANSPORT_SOCKETS_MAX; i++)
+    {
+        memset(&Socket[i], 0, sizeof(socket));
+        Socket[i].fd = -1;
+        Socket[i].State = eSocketState::Closed;
+        Socket[i].RxLock = true;
+        Socket[i].TxState = eSocketSendDataStatus::Idle;
+    }
+}
+
+Linux_Transport::~Linux_Transport()
+{
+    for(uint8_t i = 0; i < SocketsNum; i++)
+    {
+        if(Socket[i].fd >= 0) { close(Socket[i].fd); }
+    }
+    if(ListenFd >= 0) { close(ListenFd); }
+    if(EpollFd >= 0) { close(EpollFd); }
+}
+
+STATUS Linux_Transport::StartServer(uint16_t Port)
+{
+struct sockaddr_in Address;
+int On = 1;
+
+    if(EpollFd < 0)
+    {
+        EpollFd = epoll_create1(0);
+        if(EpollFd < 0) { return ERROR; }
+    }
+
+    if(ListenFd >= 0) { return ERROR; }     //  already started
+
+    ListenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(ListenFd < 0) { return ERROR; }
+
+    setsockopt(ListenFd, SOL_SOCKET, SO_REUSEADDR, &On, sizeof(On));
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_ANY);
+    Address.sin_port = htons(Port);
+
+    if(bind(ListenFd, (struct sockaddr*)&Address, sizeof(Address)) < 0 || listen(ListenFd, LINUX_TRANSPORT_BACKLOG) < 0)
+    {
+        close(ListenFd);
+        ListenFd = -1;
+        return ERROR;
+    }
+
+    ListenRegistered = false;   //  registered by UpdateEpoll() when there is free socket
+    return SUCCESS;
+}
+
+void Linux_Transport::Process(int TimeoutMs)
+{
+struct epoll_event Events[LINUX_TRANSPORT_EPOLL_EVENTS];
+bool Progress = false;
+int n;
+
+    if(EpollFd < 0) { return; }
+
+    /* most of data are sent at once, without waiting for EPOLLOUT */
+    for(uint8_t i = 0; i < SocketsNum; i++)
+    {
+        if(Socket[i].TxState == eSocketSendDataStatus::SendRequested) { Progress |= Send(i); }
+    }
+
+    UpdateEpoll();
+
+    n = epoll_wait(EpollFd, Events, LINUX_TRANSPORT_EPOLL_EVENTS, Progress ? 0 : TimeoutMs);
+
+    for(int k = 0; k < n; k++)
+    {
+        if(Events[k].data.u32 == LISTEN_TAG)
+        {
+            Accept();
+            continue;
+        }
+
+        uint8_t i = (uint8_t)Events[k].data.u32;
+        if(i >= SocketsNum || Socket[i].fd < 0) { continue; }   //  closed by previous event
+
+        if(Socket[i].State == eSocketState::Connecting)
+        {
+            FinishConnect(i);
+            continue;
+        }
+
+        if(Events[k].events & EPOLLOUT)
+        {
+            Send(i);
+        }
+        if(Socket[i].fd >= 0 && (Events[k].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)))
+        {
+            Receive(i);     //  also detects closing by remote side
+        }
+    }
+}
+
+void Linux_Transport::UpdateEpoll(void)
+{
+struct epoll_event Event;
+uint32_t Mask;
+bool FreeSocket = false;
+
+    for(uint8_t i = 0; i < SocketsNum; i++)
+    {
+        if(Socket[i].fd < 0)
+        {
+            if(Socket[i].RxLock == false) { FreeSocket = true; }
+            continue;
+        }
+
+        /* level-triggered: socket is watched only for what it waits for, so unexpected data don't wake up Process() again and again */
+        Mask = 0;
+        if(Socket[i].RxLock == false || Socket[i].RxDiscard) { Mask |= EPOLLIN | EPOLLRDHUP; }
+        if(Socket[i].TxState == eSocketSendDataStatus::InProgress || Socket[i].State == eSocketState::Connecting) { Mask |= EPOLLOUT; }
+
+        if(Mask != Socket[i].EpollMask)
+        {
+            Event.events = Mask;
+            Event.data.u32 = i;
+            epoll_ctl(EpollFd, EPOLL_CTL_MOD, Socket[i].fd, &Event);
+            Socket[i].EpollMask = Mask;
+        }
+    }
+
+    /* connections are left in the kernel backlog while all sockets are busy */
+    if(ListenFd >= 0 && FreeSocket != ListenRegistered)
+    {
+        Event.events = EPOLLIN;
+        Event.data.u32 = LISTEN_TAG;
+        epoll_ctl(EpollFd, FreeSocket ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, ListenFd, &Event);
+        ListenRegistered = FreeSocket;
+    }
+}
+
+void Linux_Transport::Accept(void)
+{
+struct sockaddr_in Address;
+socklen_t AddressLen;
+socket *pS;
+int fd;
+
+    for(uint8_t i = 0; i < SocketsNum; i++)
+    {
+        pS = &Socket[i];
+        if(pS->fd >= 0 || pS->RxLock) { continue; }     //  socket is busy or application has not seen it closed yet
+
+        AddressLen = sizeof(Address);
+        fd = accept4(ListenFd, (struct sockaddr*)&Address, &AddressLen, SOCK_NONBLOCK);
+        if(fd < 0) { return; }  //  EAGAIN: no more connections
+
+        if(SUCCESS != Attach(i, fd, Address, eSocketState::Connected)) { return; }
+#ifdef ESP8266_SOCKET_EVENTS_EN
+        PushSocketEvent(eSocketEvent::Connected, i, 0);
+#endif
+    }
+}
+
+STATUS Linux_Transport::Attach(uint8_t SocketID, int fd, const struct sockaddr_in &Address, eSocketState State)
+{
+socket *pS = &Socket[SocketID];
+struct epoll_event Event;
+int On = 1;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &On, sizeof(On));     //  response is sent by parts, don't wait for ACK of previous one
+
+    Event.events = 0;   //  events are set by UpdateEpoll()
+    Event.data.u32 = SocketID;
+    if(epoll_ctl(EpollFd, EPOLL_CTL_ADD, fd, &Event) < 0)
+    {
+        close(fd);
+        return ERROR;
+    }
+
+    pS->fd = fd;
+    pS->EpollMask = 0;
+    pS->State = State;
+    pS->RemoteIP = ntohl(Address.sin_addr.s_addr);
+    pS->RemotePort = ntohs(Address.sin_port);
+    pS->RxDataLen = 0;      //  buffer may be provided before connection, as ESP allows
+    pS->RxPaused = false;
+    pS->RxDiscard = false;
+    pS->DataCutFlag = false;
+    pS->DataTx = 0;
+    pS->TxDataLen = 0;
+    pS->TxSent = 0;
+    pS->TxState = eSocketSendDataStatus::Idle;
+    pS->CloseAfterSending = false;
+
+    return SUCCESS;
+}
+
+void Linux_Transport::FinishConnect(uint8_t SocketID)
+{
+socket *pS = &Socket[SocketID];
+socklen_t Len = sizeof(int);
+int Error = 0;
+
+    if(getsockopt(pS->fd, SOL_SOCKET, SO_ERROR, &Error, &Len) < 0 || Error != 0)
+    {
+        Release(SocketID);  //  connection failed (refused, unreachable), socket is Closed
+        return;
+    }
+
+    pS->State = eSocketState::Connected;
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    PushSocketEvent(eSocketEvent::Connected, SocketID, 0);
+#endif
+}
+
+bool Linux_Transport::Receive(uint8_t SocketID)
+{
+socket *pS = &Socket[SocketID];
+ssize_t len;
+int Available = 0;
+
+    if(pS->RxDiscard)
+    {
+        Drop(SocketID);
+        return true;
+    }
+
+    if(pS->RxLock)  //  only closing is detected
+    {
+        len = recv(pS->fd, &Available, 1, MSG_PEEK);
+        if(len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) { Release(SocketID); return true; }
+        return false;
+    }
+
+    len = recv(pS->fd, pS->DataRx, pS->RxBuffSize, 0);
+    if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) { return false; }
+    if(len <= 0)    //  closed by remote side or error
+    {
+        Release(SocketID);
+        return true;
+    }
+
+    pS->RxDataLen = (uint16_t)len;
+    pS->DataCutFlag = false;
+    pS->RxLock = true;
+
+    if(len == pS->RxBuffSize && ioctl(pS->fd, FIONREAD, &Available) == 0 && Available > 0)     //  message doesn't fit the buffer
+    {
+        if(pS->RxStream)
+        {
+            pS->RxPaused = true;    //  rest is received into the next buffer
+        }
+        else
+        {
+            pS->DataCutFlag = true;
+            Drop(SocketID);
+        }
+    }
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    if(pS->fd >= 0) { PushSocketEvent(eSocketEvent::Data, SocketID, pS->RxDataLen); }
+#endif
+
+    return true;
+}
+
+void Linux_Transport::Drop(uint8_t SocketID)
+{
+uint8_t Trash[512];
+ssize_t len;
+
+    do
+    {
+        len = recv(Socket[SocketID].fd, Trash, sizeof(Trash), 0);
+    } while(len > 0);
+
+    if(len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) { Release(SocketID); }
+}
+
+bool Linux_Transport::Send(uint8_t SocketID)
+{
+socket *pS = &Socket[SocketID];
+ssize_t len;
+
+    len = send(pS->fd, pS->DataTx + pS->TxSent, pS->TxDataLen - pS->TxSent, MSG_NOSIGNAL);
+    if(len < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            pS->TxState = eSocketSendDataStatus::InProgress;    //  wait for EPOLLOUT
+            return false;
+        }
+
+        pS->TxState = eSocketSendDataStatus::SendFail;
+#ifdef ESP8266_SOCKET_EVENTS_EN
+        PushSocketEvent(eSocketEvent::SendFail, SocketID, 0);
+#endif
+        Release(SocketID);
+        return true;
+    }
+
+    pS->TxSent += (uint16_t)len;
+    if(pS->TxSent < pS->TxDataLen)
+    {
+        pS->TxState = eSocketSendDataStatus::InProgress;
+        return true;
+    }
+
+    pS->TxState = eSocketSendDataStatus::SendSuccess;
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    PushSocketEvent(eSocketEvent::SendDone, SocketID, 0);
+#endif
+    if(pS->CloseAfterSending)
+    {
+        shutdown(pS->fd, SHUT_WR);  //  data already sent are delivered before FIN
+        Release(SocketID);
+    }
+
+    return true;
+}
+
+void Linux_Transport::Release(uint8_t SocketID)
+{
+socket *pS = &Socket[SocketID];
+
+    if(pS->fd < 0) { return; }
+
+    close(pS->fd);  //  removes fd from epoll as well
+    pS->fd = -1;
+    pS->EpollMask = 0;
+    pS->State = eSocketState::Closed;
+    pS->RxLock = true;
+    pS->RxPaused = false;
+    pS->RxDiscard = false;
+    if(pS->TxState == eSocketSendDataStatus::SendRequested || pS->TxState == eSocketSendDataStatus::InProgress) { pS->TxState = eSocketSendDataStatus::SendFail; }
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    PushSocketEvent(eSocketEvent::Closed, SocketID, 0);
+#endif
+}
+
+STATUS Linux_Transport::ListenSocket(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize)
+{
+    if((SocketID >= SocketsNum) || (0 == RxBuffer)) { return ERROR; }
+
+    if(Socket[SocketID].RxPaused && Socket[SocketID].fd >= 0) { Drop(SocketID); }     //  rest of paused message is ignored
+
+    Socket[SocketID].DataRx = RxBuffer;
+    Socket[SocketID].RxBuffSize = BufferSize;
+    Socket[SocketID].RxStream = false;
+    Socket[SocketID].RxPaused = false;
+    Socket[SocketID].RxDiscard = false;
+    Socket[SocketID].RxLock = false;
+
+    return SUCCESS;
+}
+
+STATUS Linux_Transport::ListenSocketStream(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize)
+{
+    if((SocketID >= SocketsNum) || (0 == RxBuffer) || (0 == BufferSize)) { return ERROR; }
+
+    Socket[SocketID].DataRx = RxBuffer;
+    Socket[SocketID].RxBuffSize = BufferSize;
+    Socket[SocketID].RxDataLen = 0;
+    Socket[SocketID].DataCutFlag = false;
+    Socket[SocketID].RxStream = true;
+    Socket[SocketID].RxPaused = false;  //  continues into the new buffer
+    Socket[SocketID].RxDiscard = false;
+    Socket[SocketID].RxLock = false;
+
+    return SUCCESS;
+}
+
+uint16_t Linux_Transport::SocketRecv(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum || Socket[SocketID].RxLock == false || Socket[SocketID].DataRx == 0) { return 0; }
+
+    if(Socket[SocketID].DataCutFlag) { return -1; }
+
+    return Socket[SocketID].RxDataLen;
+}
+
+bool Linux_Transport::SocketRxPaused(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return false; }
+
+    return Socket[SocketID].RxPaused && Socket[SocketID].RxLock;
+}
+
+void Linux_Transport::SocketRxDiscard(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return; }
+
+    Socket[SocketID].RxStream = false;
+    Socket[SocketID].RxPaused = false;
+    Socket[SocketID].RxLock = true;
+    Socket[SocketID].DataRx = 0;
+    Socket[SocketID].RxDiscard = (Socket[SocketID].fd >= 0);
+}
+
+uint32_t Linux_Transport::GetSocketRemoteIP(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return 0; }
+
+    return Socket[SocketID].RemoteIP;
+}
+
+uint16_t Linux_Transport::GetSocketRemotePort(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return 0; }
+
+    return Socket[SocketID].RemotePort;
+}
+
+STATUS Linux_Transport::SocketSend(uint8_t SocketID, uint8_t* Data, uint16_t DataLen)
+{
+socket *pS;
+
+    if(SocketID >= SocketsNum) { return ERROR; }
+
+    pS = &Socket[SocketID];
+    pS->CloseAfterSending = false;
+
+    if(pS->State != eSocketState::Connected || pS->TxState == eSocketSendDataStatus::SendRequested || pS->TxState == eSocketSendDataStatus::InProgress)
+    {
+        return ERROR;
+    }
+
+    pS->DataTx = Data;
+    pS->TxDataLen = DataLen;
+    pS->TxSent = 0;
+    pS->TxState = eSocketSendDataStatus::SendRequested;     //  sent by Process()
+
+    return SUCCESS;
+}
+
+STATUS Linux_Transport::SocketSendClose(uint8_t SocketID, uint8_t* Data, uint16_t DataLen)
+{
+    if(SUCCESS == SocketSend(SocketID, Data, DataLen))
+    {
+        Socket[SocketID].CloseAfterSending = true;
+        return SUCCESS;
+    }
+
+    return ERROR;
+}
+
+STATUS Linux_Transport::CloseSocket(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return ERROR; }
+
+    Release(SocketID);
+    Socket[SocketID].TxState = eSocketSendDataStatus::Idle;
+    Socket[SocketID].DataRx = 0;
+    Socket[SocketID].DataTx = 0;
+
+    return SUCCESS;
+}
+
+STATUS Linux_Transport::OpenConnection(uint8_t SocketID, const char *pHost, uint16_t Port)
+{
+struct addrinfo Hints, *pResult;
+struct sockaddr_in Address;
+int fd;
+
+    if(SocketID >= SocketsNum || pHost == 0 || Port == 0 || Socket[SocketID].fd >= 0) { return ERROR; }
+
+    if(EpollFd < 0)     //  client only, server is not started
+    {
+        EpollFd = epoll_create1(0);
+        if(EpollFd < 0) { return ERROR; }
+    }
+
+    memset(&Hints, 0, sizeof(Hints));
+    Hints.ai_family = AF_INET;
+    Hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(pHost, 0, &Hints, &pResult) != 0) { return ERROR; }
+
+    memcpy(&Address, pResult->ai_addr, sizeof(Address));
+    Address.sin_port = htons(Port);
+    freeaddrinfo(pResult);
+
+    fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(fd < 0) { return ERROR; }
+
+    if(connect(fd, (struct sockaddr*)&Address, sizeof(Address)) < 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return ERROR;
+    }
+
+    return Attach(SocketID, fd, Address, eSocketState::Connecting);   //  result comes with EPOLLOUT, also if connected at once
+}
+
+Transport::eSocketState Linux_Transport::GetSocketState(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return eSocketState::Error; }
+
+    return Socket[SocketID].State;
+}
+
+Transport::eSocketSendDataStatus Linux_Transport::GetDataSendStatus(uint8_t SocketID)
+{
+    if(SocketID >= SocketsNum) { return eSocketSendDataStatus::SendFail; }
+
+    return Socket[SocketID].TxState;
+}
+
+#ifdef ESP8266_SOCKET_EVENTS_EN
+void Linux_Transport::PushSocketEvent(eSocketEvent Type, uint8_t SocketID, uint16_t Len)
+{
+socket_event *pEvent;
+
+    if((uint8_t)(EventWrite - EventRead) >= LINUX_TRANSPORT_EVENT_QUEUE_LEN)
+    {
+        EventsLost = true;
+        return;
+    }
+
+    pEvent = &EventQueue[EventWrite % LINUX_TRANSPORT_EVENT_QUEUE_LEN];
+    pEvent->Type = Type;
+    pEvent->SocketID = SocketID;
+    pEvent->Len = Len;
+    EventWrite++;
+}
+
+bool Linux_Transport::GetSocketEvent(socket_event &Event)
+{
+    if(EventsLost)
+    {
+        EventsLost = false;
+        EventRead = EventWrite;
+        Event.Type = eSocketEvent::Overflow;
+        Event.SocketID = LINUX_TRANSPORT_SOCKETS_MAX;
+        Event.Len = 0;
+        return true;
+    }
+
+    if(EventRead == EventWrite) { return false; }
+
+    Event = EventQueue[EventRead % LINUX_TRANSPORT_EVENT_QUEUE_LEN];
+    EventRead++;
+
+    return true;
+}
+#endif
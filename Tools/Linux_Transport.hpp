@@ -0,0 +1,142 @@
+/**
+  ******************************************************************************
+  * @file    Linux_Transport.hpp
+  * @author  Ostap Kostyk
+  * @brief   Transport over non-blocking POSIX sockets and epoll, so HTTP_Server
+  *          and HTTP content run as a host process (see host_server.cpp)
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+/* Linux_Transport behaves as ESP8266 module in server mode: it listens on the port, accepts connections into free sockets
+ * and receives data only into buffers provided by ListenSocket()/ListenSocketStream(). Everything happens in Process(),
+ * which waits for socket activity up to given time. Data which are not expected by application stay in kernel buffers.
+ * Connection is accepted into closed socket which got receive buffer after it was closed, so application always sees
+ * the socket closed before it is used by the next connection (ESP8266 module takes some time to reuse the link id).
+ * Outgoing connections (OpenConnection(), e.g. of HTTP_Client) are made by non-blocking connect(), host name is resolved by
+ * getaddrinfo() which blocks (IP address is taken at once). Socket used for them must not be given a buffer while it is closed,
+ * otherwise incoming connection may be accepted into it */
+
+#ifndef LINUX_TRANSPORT_HPP_
+#define LINUX_TRANSPORT_HPP_
+
+#include <netinet/in.h>
+#include "Transport.hpp"
+
+#ifdef ESP8266_TIMESTAMPS_EN
+#error "ESP8266_TIMESTAMPS_EN is not supported by Linux_Transport (time stamps use cycle counter of the target)"
+#endif
+
+#define LINUX_TRANSPORT_SOCKETS_MAX     8       //  number of sockets (connections served at a time)
+#define LINUX_TRANSPORT_BACKLOG         128     //  connections waiting for free socket in the kernel
+#define LINUX_TRANSPORT_EPOLL_EVENTS    16      //  events taken by one epoll_wait()
+#define LINUX_TRANSPORT_EVENT_QUEUE_LEN 64      //  socket events (ESP8266_SOCKET_EVENTS_EN), power of 2 up to 128
+
+namespace OKO_TRANSPORT
+{
+
+class Linux_Transport : public Transport
+{
+public:
+    /* Constructor. Sockets: number of sockets up to LINUX_TRANSPORT_SOCKETS_MAX */
+    Linux_Transport(uint8_t Sockets = LINUX_TRANSPORT_SOCKETS_MAX);
+    ~Linux_Transport();
+
+    Linux_Transport(const Linux_Transport&) = delete;
+    Linux_Transport& operator=(const Linux_Transport&) = delete;
+
+    /* Starts listening on TCP port Port of all interfaces. Returns ERROR if epoll or socket can't be created (see errno) */
+    STATUS StartServer(uint16_t Port);
+
+    /* Main Handler - must be called regularly (e.g. in main loop): accepts connections, receives and sends data.
+     * Waits for socket activity up to TimeoutMs milliseconds, does not wait if it made progress already */
+    void Process(int TimeoutMs);
+
+    STATUS ListenSocket(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize) override;
+    STATUS ListenSocketStream(uint8_t SocketID, uint8_t * RxBuffer, uint16_t BufferSize) override;
+    uint16_t SocketRecv(uint8_t SocketID) override;
+    bool SocketRxPaused(uint8_t SocketID) override;
+    void SocketRxDiscard(uint8_t SocketID) override;
+    uint32_t GetSocketRemoteIP(uint8_t SocketID) override;
+    uint16_t GetSocketRemotePort(uint8_t SocketID) override;
+    STATUS SocketSend(uint8_t SocketID, uint8_t* Data, uint16_t DataLen) override;
+    STATUS SocketSendClose(uint8_t SocketID, uint8_t* Data, uint16_t DataLen) override;
+    STATUS CloseSocket(uint8_t SocketID) override;
+    STATUS OpenConnection(uint8_t SocketID, const char *pHost, uint16_t Port) override;
+    eSocketState GetSocketState(uint8_t SocketID) override;
+    eSocketSendDataStatus GetDataSendStatus(uint8_t SocketID) override;
+    void SetSocketTxClass(uint8_t, eTxClass) override {}    //  sockets are scheduled by the kernel
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    bool GetSocketEvent(socket_event &Event) override;
+#endif
+
+private:
+    struct socket
+    {
+        int fd;                     //  -1 if socket is closed
+        uint32_t EpollMask;         //  events registered for fd
+        eSocketState State;
+        uint32_t RemoteIP;
+        uint16_t RemotePort;
+
+        uint8_t *DataRx;
+        uint16_t RxBuffSize;
+        uint16_t RxDataLen;
+        bool RxLock;                //  buffer is not provided or data are received, nothing is read from fd
+        bool RxStream;
+        bool RxPaused;              //  stream buffer is full, rest of data is in the kernel
+        bool RxDiscard;             //  incoming data are read and ignored
+        bool DataCutFlag;
+
+        const uint8_t *DataTx;
+        uint16_t TxDataLen;
+        uint16_t TxSent;
+        eSocketSendDataStatus TxState;
+        bool CloseAfterSending;
+    };
+
+    void Accept(void);
+    STATUS Attach(uint8_t SocketID, int fd, const struct sockaddr_in &Address, eSocketState State);    //  socket takes connection fd
+    void FinishConnect(uint8_t SocketID);   //  result of outgoing connection
+    bool Receive(uint8_t SocketID);     //  returns true if there was progress
+    bool Send(uint8_t SocketID);
+    void Drop(uint8_t SocketID);        //  reads and ignores data available in the kernel
+    void Release(uint8_t SocketID);     //  closes fd, socket becomes Closed
+    void UpdateEpoll(void);             //  registers events needed by state of every socket
+#ifdef ESP8266_SOCKET_EVENTS_EN
+    void PushSocketEvent(eSocketEvent Type, uint8_t SocketID, uint16_t Len);
+
+    socket_event EventQueue[LINUX_TRANSPORT_EVENT_QUEUE_LEN];
+    uint8_t EventWrite = 0;             //  free-running indexes, number of events is EventWrite - EventRead
+    uint8_t EventRead = 0;
+    bool EventsLost = false;
+#endif
+
+    const uint8_t SocketsNum;
+    socket Socket[LINUX_TRANSPORT_SOCKETS_MAX];
+    int EpollFd = -1;
+    int ListenFd = -1;
+    bool ListenRegistered = false;
+};
+
+}   //  END of namespace OKO_TRANSPORT
+
+#endif /* LINUX_TRANSPORT_HPP_ */
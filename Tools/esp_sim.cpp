@@ -0,0 +1,812 @@
+/**
+  ******************************************************************************
+  * @file    esp_sim.cpp
+  * @author  Ostap Kostyk
+  * @brief   ESP class (ESP8266.cpp) running on the host against simulated ESP8266
+  *          module behind ESP8266_Interface. Module answers AT commands as AT
+  *          firmware does, one Process() call and one timer tick are 1 ms. Runs
+  *          scenarios (server start, requests, bursts of messages, several closes
+  *          at once, long messages, module restart and the optional modes) and
+  *          prints number of passes/ms each of them takes. Build and run on the
+  *          host from Tools directory:
+  *            g++ -g -include stdlib.h -DSTM32F103xB -DUSE_HAL_DRIVER -DUSE_CUSTOM_MEMMGR
+  *              -I../Core/Inc -I../Drivers/STM32F1xx_HAL_Driver/Inc -I../Drivers/CMSIS/Include
+  *              -I../Drivers/CMSIS/Device/ST/STM32F1xx/Include
+  *              esp_sim.cpp ../Core/Src/ESP8266.cpp ../Core/Src/AT_Lexer.cpp
+  *              ../Core/Src/Timer.cpp -x c ../Core/Src/memmgr.c -o esp_sim && ./esp_sim
+  *          Options of ESP class (e.g. -DESP8266_SENDBUF_EN -DESP8266_PASSIVE_RX_EN)
+  *          are added as for target. Environment variables: V=1 prints the traffic,
+  *          NOSENDBUF=1 and NOPASSIVE=1 simulate firmware without AT+CIPSENDBUF and
+  *          AT+CIPRECVMODE. Exit code is number of failed checks
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include "ESP8266.hpp"
+
+using namespace OKO_ESP8266;
+
+#define SIM_LINKS               5       //  link IDs of AT firmware
+#define SIM_STEPS_MAX           20000   //  limit of every wait, ms
+#define SIM_BUFFERED_SEND_MS    20      //  "SEND OK" of AT+CIPSENDBUF comes after network latency
+
+/* Output of the module which comes later */
+struct SimDelayed
+{
+    int Ms;
+    std::string Text;
+};
+
+/* Simulated module */
+static std::string ModuleOut;                   //  module -> MCU, read by ESP_GetChar()/ESP_GetData()
+static std::string CommandLine;                 //  MCU -> module, command being received
+static std::vector<std::string> Commands;       //  all commands received
+static bool Echo = true;
+static bool Verbose;
+static int DataLeft = -1;                       //  bytes of AT+CIPSEND(BUF) data still expected
+static int DataLink;
+static bool DataBuffered;                       //  data of AT+CIPSENDBUF
+static std::string Sent[SIM_LINKS];             //  data sent over links
+static std::string AfterSendOK;                 //  comes in the same chunk with next "SEND OK"
+static bool SendBufSupported;
+static int Segment[SIM_LINKS];                  //  segment IDs of AT+CIPSENDBUF
+static bool Passive;                            //  AT+CIPRECVMODE=1
+static std::string Pending[SIM_LINKS];          //  data held by module in passive mode
+static bool Transparent;                        //  AT+CIPSEND without parameters
+static std::string TransparentSent;
+static bool LinkUp[SIM_LINKS];                  //  reported by AT+CIPSTATUS
+static int ServerTimeout = -1;                  //  AT+CIPSTO
+static bool OverflowOnce;
+static size_t TxSpace = 1000;
+static UART_ErrorCounters ErrorCounters;
+static std::deque<SimDelayed> Delayed;
+
+static int Failures;
+
+static ESP_Instance<> ESP1{1};
+
+static void Check(bool Condition, const char *pWhat)
+{
+    if(!Condition)
+    {
+        printf("FAIL: %s\n", pWhat);
+        Failures++;
+    }
+}
+
+static void PrintCommands(size_t From)
+{
+    for(size_t k = From; k < Commands.size(); k++) { printf(" %s;", Commands[k].c_str()); }
+    printf("\n");
+}
+
+/* Module output, link states are tracked from "<id>,CONNECT" and "<id>,CLOSED" */
+static void ModuleSend(const std::string &Text)
+{
+    ModuleOut += Text;
+    if(Verbose) { printf("<<%s", Text.c_str()); }
+
+    for(size_t k = 0; k + 8 < Text.size(); k++)
+    {
+        if(Text[k] < '0' || Text[k] >= '0' + SIM_LINKS || Text[k+1] != ',') { continue; }
+        if(0 == Text.compare(k+2, 7, "CONNECT")) { LinkUp[Text[k]-'0'] = true; }
+        if(0 == Text.compare(k+2, 6, "CLOSED"))  { LinkUp[Text[k]-'0'] = false; }
+    }
+}
+
+#if defined(ESP8266_PASSIVE_RX_EN) || defined(ESP8266_RX_RING_EN)
+/* Data received by module from the network */
+static void ModuleDeliver(int Link, const std::string &Data)
+{
+    if(Passive)
+    {
+        Pending[Link] += Data;
+        ModuleSend("+IPD," + std::to_string(Link) + "," + std::to_string(Data.size()) + "\r\n");
+    }
+    else
+    {
+        ModuleSend("+IPD," + std::to_string(Link) + "," + std::to_string(Data.size()) + ":" + Data);
+    }
+}
+#endif
+
+static bool StartsWith(const std::string &Text, const char *pPrefix)
+{
+    return 0 == Text.compare(0, strlen(pPrefix), pPrefix);
+}
+
+static void ModuleCommand(const std::string &Cmd)
+{
+int Link = 0, Len = 0;
+std::string Text;
+
+    Commands.push_back(Cmd);
+    if(Verbose) { printf(">>%s\n", Cmd.c_str()); }
+    if(Echo) { ModuleSend(Cmd + "\r\r\n"); }
+
+    if(Cmd == "AT+RST")
+    {
+        ModuleSend("\r\nOK\r\n ets Jan  8 2013,rst cause:2, boot mode:(3,6)\r\n\xff\xfe garbage\r\n\r\nready\r\n");
+        Echo = true;
+    }
+    else if(Cmd == "ATE0")
+    {
+        Echo = false;
+        ModuleSend("\r\nOK\r\n");
+    }
+    else if(Cmd == "AT+CWSAP_CUR?")
+    {
+        ModuleSend("+CWSAP_CUR:\"ESP_TEST\",\"12345678\",6,3,4,0\r\n\r\nOK\r\n");
+    }
+    else if(StartsWith(Cmd, "AT+CWLAP"))
+    {
+        if(Cmd.find("ESP_TEST\"") != std::string::npos)
+        {
+            ModuleSend("+CWLAP:(3,\"Neighbour network with a really long name\",-71,\"aa:bb:cc:dd:ee:ff\",6,-12,0)\r\n");
+        }
+        ModuleSend("\r\nOK\r\n");
+    }
+    else if(Cmd == "AT+CIFSR")
+    {
+        ModuleSend("+CIFSR:APIP,\"192.168.4.1\"\r\n+CIFSR:APMAC,\"1a:fe:34:a0:0b:cd\"\r\n\r\nOK\r\n");
+    }
+    else if(Cmd == "AT+CIPSENDBUF=?")
+    {
+        ModuleSend(SendBufSupported ? "+CIPSENDBUF:<link ID>,<length>\r\n\r\nOK\r\n" : "\r\nERROR\r\n");
+    }
+    else if(StartsWith(Cmd, "AT+CIPSENDBUF=") && SendBufSupported)
+    {
+        sscanf(Cmd.c_str(), "AT+CIPSENDBUF=%d,%d", &Link, &Len);
+        DataLink = Link;
+        DataLeft = Len;
+        DataBuffered = true;
+        Segment[Link]++;
+        ModuleSend(std::to_string(Segment[Link]) + "," + std::to_string(Segment[Link]-1) + "\r\n\r\nOK\r\n> ");
+    }
+    else if(Cmd == "AT+CIPRECVMODE=1")
+    {
+        Passive = (getenv("NOPASSIVE") == 0);
+        ModuleSend(Passive ? "\r\nOK\r\n" : "\r\nERROR\r\n");
+    }
+    else if(StartsWith(Cmd, "AT+CIPRECVDATA="))
+    {
+        sscanf(Cmd.c_str(), "AT+CIPRECVDATA=%d,%d", &Link, &Len);
+        Text = Pending[Link].substr(0, Len);
+        Pending[Link].erase(0, Text.size());
+        ModuleSend("+CIPRECVDATA," + std::to_string(Text.size()) + ":" + Text + "\r\nOK\r\n");
+    }
+    else if(Cmd == "AT+CIPRECVLEN?")
+    {
+        Text = "+CIPRECVLEN:";
+        for(Link = 0; Link < SIM_LINKS; Link++)
+        {
+            Text += std::to_string(Pending[Link].size()) + (Link < SIM_LINKS-1 ? "," : "");
+        }
+        ModuleSend(Text + "\r\n\r\nOK\r\n");
+    }
+    else if(Cmd == "AT+CIPSTATUS")
+    {
+        Text = "STATUS:3\r\n";
+        for(Link = 0; Link < SIM_LINKS; Link++)
+        {
+            if(!LinkUp[Link]) { continue; }
+            Text += "+CIPSTATUS:" + std::to_string(Link) + ",\"TCP\",\"192.168.4.2\"," + std::to_string(50000+Link) + ",80,1\r\n";
+        }
+        ModuleSend(Text + "\r\nOK\r\n");
+    }
+    else if(StartsWith(Cmd, "AT+CIPSTO="))
+    {
+        ServerTimeout = atoi(Cmd.c_str() + 10);
+        ModuleSend("\r\nOK\r\n");
+    }
+    else if(Cmd == "AT+CIPSEND")
+    {
+        Transparent = true;
+        ModuleSend("\r\nOK\r\n\r\n>");
+    }
+    else if(StartsWith(Cmd, "AT+CIPSTART=") && isdigit((unsigned char)Cmd[12]))
+    {
+        ModuleSend(std::to_string(atoi(Cmd.c_str() + 12)) + ",CONNECT\r\n\r\nOK\r\n");
+    }
+    else if(StartsWith(Cmd, "AT+CIPSTART=\""))
+    {
+        ModuleSend("CONNECT\r\n\r\nOK\r\n");
+    }
+    else if(StartsWith(Cmd, "AT+CIPSEND="))
+    {
+        sscanf(Cmd.c_str(), "AT+CIPSEND=%d,%d", &Link, &Len);
+        DataLink = Link;
+        DataLeft = Len;
+        ModuleSend("\r\nOK\r\n> ");
+    }
+    else if(Cmd == "AT+CIPCLOSE")
+    {
+        ModuleSend("CLOSED\r\n\r\nOK\r\n");
+    }
+    else if(Cmd == "AT+CIPCLOSE=5")
+    {
+        ModuleSend("0,CLOSED\r\n\r\nOK\r\n");
+    }
+    else if(StartsWith(Cmd, "AT+CIPCLOSE="))
+    {
+        ModuleSend(std::to_string(atoi(Cmd.c_str() + 12)) + ",CLOSED\r\n\r\nOK\r\n");
+    }
+    else
+    {
+        ModuleSend("\r\nOK\r\n");
+    }
+}
+
+/* Byte written by ESP class to the module */
+static void ModuleReceive(char Sym)
+{
+    if(DataLeft > 0)
+    {
+        Sent[DataLink] += Sym;
+        if(--DataLeft) { return; }
+
+        ModuleSend("\r\nRecv " + std::to_string(Sent[DataLink].size()) + " bytes\r\n");
+        if(DataBuffered)
+        {
+            Delayed.push_back({SIM_BUFFERED_SEND_MS, std::to_string(DataLink) + "," + std::to_string(Segment[DataLink]) + ",SEND OK\r\n" + AfterSendOK});
+            DataBuffered = false;
+        }
+        else
+        {
+            ModuleSend("\r\nSEND OK\r\n" + AfterSendOK);
+        }
+        AfterSendOK.clear();
+        DataLeft = -1;
+        return;
+    }
+
+    CommandLine += Sym;
+    if(CommandLine.size() >= 2 && 0 == CommandLine.compare(CommandLine.size()-2, 2, "\r\n"))
+    {
+        CommandLine.resize(CommandLine.size()-2);
+        ModuleCommand(CommandLine);
+        CommandLine.clear();
+    }
+}
+
+/* ESP8266_Interface of the simulated module */
+STATUS ESP_HuartInit(uint8_t, uint8_t *, size_t, uint8_t *, size_t)   { return SUCCESS; }
+void ESP_Enable(uint8_t)                        {}
+void ESP_Disable(uint8_t)                       {}
+void ESP_ActivateResetPin(uint8_t)              {}
+void ESP_ReleaseResetPin(uint8_t)               {}
+void ESP_SetBaudRate(uint8_t, uint32_t)         {}
+size_t ESP_NumOfDataReceived(uint8_t)           { return ModuleOut.size(); }
+size_t ESP_TransmitBufferSpaceLeft(uint8_t)     { return TxSpace; }
+const UART_ErrorCounters* ESP_HuartErrorCounters(uint8_t) { return &ErrorCounters; }
+
+STATUS ESP_HuartSend(uint8_t, char* pData, size_t Size)
+{
+    if(Transparent)
+    {
+        if(std::string(pData, Size) == "+++") { Transparent = false; }
+        else { TransparentSent.append(pData, Size); }
+        return SUCCESS;
+    }
+
+    for(size_t i = 0; i < Size; i++) { ModuleReceive(pData[i]); }
+
+    return SUCCESS;
+}
+
+STATUS ESP_GetChar(uint8_t, uint8_t* sym)
+{
+    if(ModuleOut.empty()) { return ERROR; }
+
+    *sym = (uint8_t)ModuleOut[0];
+    ModuleOut.erase(0, 1);
+
+    return SUCCESS;
+}
+
+size_t ESP_GetData(uint8_t, uint8_t* pData, size_t Size)
+{
+    if(Size > ModuleOut.size()) { Size = ModuleOut.size(); }
+    memcpy(pData, ModuleOut.data(), Size);
+    ModuleOut.erase(0, Size);
+
+    return Size;
+}
+
+size_t ESP_SkipData(uint8_t, size_t Size)
+{
+    if(Size > ModuleOut.size()) { Size = ModuleOut.size(); }
+    ModuleOut.erase(0, Size);
+
+    return Size;
+}
+
+STATUS ESP_HuartRxOverflow(uint8_t)
+{
+bool Overflow = OverflowOnce;
+
+    OverflowOnce = false;
+
+    return Overflow ? ERROR : SUCCESS;
+}
+
+#if defined(ESP8266_TIMESTAMPS_EN) || defined(ESP8266_PROCESS_BUDGET_US)
+/* DWT cycle counter of 72 MHz core, every call takes 10 us */
+extern "C" uint32_t Timestamp_Get(void) { static uint32_t Cycles; return Cycles += 720; }
+extern "C" uint32_t Timestamp_ElapsedUs(uint32_t Start, uint32_t End) { return (End - Start) / 72; }
+#endif
+
+/* One millisecond: Process() call, SysTick and output of the module which is due */
+static void Step(int Ms = 1)
+{
+    for(int i = 0; i < Ms; i++)
+    {
+        ESP1.Process();
+        mTimer::Timer::Tick();
+
+        for(auto &Out : Delayed) { Out.Ms--; }
+        while(!Delayed.empty() && Delayed.front().Ms <= 0)
+        {
+            ModuleSend(Delayed.front().Text);
+            Delayed.pop_front();
+        }
+    }
+}
+
+/* Returns ms till the server is up */
+static int StartServer(void)
+{
+static char SSID[] = "ESP_TEST", Password[] = "12345678";
+int Ms;
+ESP::eServerState State;
+
+    for(Ms = 0; Ms < SIM_STEPS_MAX; Ms++)
+    {
+        Step();
+        if(!ESP1.isModuleReady()) { continue; }
+
+        if(ESP1.GetCurrentModuleMode() == ESP::eModuleMode::Undefined)
+        {
+            ESP1.SwitchToAccessPointMode(SSID, Password, 6, ESP::eECNType::WPA2_PSK);
+        }
+        else if(ESP1.GetCurrentModuleMode() == ESP::eModuleMode::AccessPoint && ESP1.LocalAccessPointState() == ESP::eAccessPointState::Started)
+        {
+            State = ESP1.GetServerState();
+            if(State == ESP::eServerState::Connected) { break; }
+            if(State == ESP::eServerState::Disconnected || State == ESP::eServerState::Undefined) { ESP1.StartServer(80); }
+        }
+    }
+    Check(Ms < SIM_STEPS_MAX, "server start");
+
+    return Ms;
+}
+
+static void ScenarioRequest(void)
+{
+static uint8_t Buf[64];
+static uint8_t Response[] = "HTTP/1.1 200 OK\r\n\r\nhello";
+
+    ESP1.ListenSocket(0, Buf, sizeof(Buf));
+    ModuleSend("0,CONNECT\r\n\r\n+IPD,0,18:GET / HTTP/1.1\r\n\r\n");
+    Step(20);
+    Check(ESP1.SocketRecv(0) == 18 && 0 == memcmp(Buf, "GET / HTTP/1.1\r\n\r\n", 18), "request received");
+
+    ESP1.SocketSendClose(0, Response, sizeof(Response)-1);
+    Step(200);
+    Check(Sent[0] == (char*)Response, "response sent");
+    Check(ESP1.GetSocketState(0) == ESP::eSocketState::Closed, "socket closed after response");
+    printf("request/response: %zu commands, last %s\n", Commands.size(), Commands.back().c_str());
+
+    // long unknown line must not break parsing
+    ESP1.ListenSocket(1, Buf, sizeof(Buf));
+    ModuleSend(std::string(500, 'x') + "\r\n1,CONNECT\r\n+IPD,1,4:ping");
+    Step(20);
+    Check(ESP1.GetSocketState(1) == ESP::eSocketState::Connected && ESP1.SocketRecv(1) == 4, "long unknown line");
+}
+
+/* "SEND OK", "CLOSED" of other socket and +IPD come in one chunk */
+static void ScenarioBurst(void)
+{
+static uint8_t Buf[64];
+static uint8_t Data[] = "data2";
+
+    ModuleSend("2,CONNECT\r\n");
+    Step(20);
+    ESP1.ListenSocket(2, Buf, sizeof(Buf));
+    AfterSendOK = "1,CLOSED\r\n\r\n+IPD,2,3:abc";
+    ESP1.SocketSend(2, Data, 5);
+    Step(50);
+    Check(ESP1.GetSocketState(1) == ESP::eSocketState::Closed, "burst: socket 1 closed");
+    Check(ESP1.GetSocketState(2) == ESP::eSocketState::Connected && ESP1.SocketRecv(2) == 3, "burst: socket 2 received");
+    Check(ESP1.GetDataSendStatus(2) == ESP::eSocketSendDataStatus::SendSuccess && Sent[2] == "data2", "burst: socket 2 sent");
+}
+
+/* Three closes and change of Access Point IP are requested at once */
+static void ScenarioCloses(void)
+{
+size_t From;
+int Passes;
+
+    ModuleSend("3,CONNECT\r\n4,CONNECT\r\n");
+    Step(5);
+    From = Commands.size();
+    ESP1.CloseSocket(2);
+    ESP1.CloseSocket(3);
+    ESP1.CloseSocket(4);
+    ESP1.SetAccessPointIP(0xC0A80501, 0xC0A80501, 0xFFFFFF00);
+
+    for(Passes = 1; Passes < SIM_STEPS_MAX; Passes++)
+    {
+        Step();
+        if(ESP1.GetSocketState(2) == ESP::eSocketState::Closed && ESP1.GetSocketState(3) == ESP::eSocketState::Closed &&
+           ESP1.GetSocketState(4) == ESP::eSocketState::Closed && !ESP1.SetAccessPointIP(0xC0A80501, 0xC0A80501, 0xFFFFFF00)) { break; }
+    }
+    Check(Passes < SIM_STEPS_MAX, "closes and IP change");
+    printf("closes+ip: %d passes, commands:", Passes);
+    PrintCommands(From);
+}
+
+/* 5000 bytes on two sockets at once */
+static void ScenarioBig(void)
+{
+static uint8_t Big3[5000], Big4[5000];
+int Ms;
+
+    for(int i = 0; i < 5000; i++) { Big3[i] = 'a' + i % 26; Big4[i] = 'A' + i % 26; }
+    Sent[3].clear();
+    Sent[4].clear();
+    TxSpace = 4096;
+    ModuleSend("3,CONNECT\r\n4,CONNECT\r\n");
+    Step(5);
+    ESP1.SocketSend(3, Big3, sizeof(Big3));
+    ESP1.SocketSend(4, Big4, sizeof(Big4));
+
+    for(Ms = 1; Ms < SIM_STEPS_MAX; Ms++)
+    {
+        Step();
+        if(ESP1.GetDataSendStatus(3) == ESP::eSocketSendDataStatus::SendSuccess &&
+           ESP1.GetDataSendStatus(4) == ESP::eSocketSendDataStatus::SendSuccess) { break; }
+    }
+    Check(Sent[3] == std::string((char*)Big3, sizeof(Big3)) && Sent[4] == std::string((char*)Big4, sizeof(Big4)), "big messages");
+    printf("big: %d ms\n", Ms);
+    TxSpace = 1000;
+}
+
+/* Stream receiving paused by full buffer, other messages come behind the paused one */
+static void ScenarioStreamPause(void)
+{
+static uint8_t Buf[16], Next[64], Other[64];
+
+    ModuleSend("1,CONNECT\r\n2,CONNECT\r\n");
+    Step(5);
+    ESP1.ListenSocketStream(1, Buf, sizeof(Buf));
+    ESP1.ListenSocket(2, Other, sizeof(Other));
+    ModuleSend("+IPD,1,40:" + std::string(40, 'p'));
+    Step(5);
+    Check(ESP1.SocketRxPaused(1) && ESP1.SocketRecv(1) == sizeof(Buf), "stream: paused with full buffer");
+    ESP1.ListenSocketStream(1, Next, sizeof(Next));
+    Step(5);
+    Check(ESP1.SocketRecv(1) == 40 - sizeof(Buf), "stream: rest of message in the next buffer");
+
+    // application does not provide next buffer while HUART buffer fills up
+    ESP1.ListenSocketStream(1, Buf, sizeof(Buf));
+    ModuleSend("+IPD,1,300:" + std::string(300, 'p') + "\r\n+IPD,2,4:ping\r\n3,CLOSED\r\n");
+    Step(20);
+    Check(ESP1.SocketRecv(2) == 4 && ESP1.GetSocketState(3) == ESP::eSocketState::Closed, "stream: messages behind paused one are parsed");
+    ESP1.ListenSocketStream(1, Next, sizeof(Next));
+    Check(ESP1.SocketRecv(1) == (uint16_t)-1, "stream: dropped rest is reported");
+    ESP1.ListenSocket(1, Next, sizeof(Next));
+    ModuleSend("+IPD,1,4:pong");
+    Step(5);
+    Check(ESP1.SocketRecv(1) == 4, "stream: socket receives after drop");
+}
+
+#ifdef ESP8266_PASSTHROUGH_EN
+static void ScenarioPassthrough(void)
+{
+static uint8_t Buf[64], RxBuf[700];
+std::string In, Out, Got;
+size_t From, Pos = 0, Len;
+int Ms;
+
+    ModuleSend("0,CONNECT\r\n");
+    Step(5);
+    From = Commands.size();
+    ESP1.PassthroughStart(0xC0A80402, 5000, ESP::eSocketType::TCP);
+    for(Ms = 1; Ms < SIM_STEPS_MAX && ESP1.GetPassthroughState() != ESP::ePassthroughState::Active; Ms++) { Step(); }
+    Check(Ms < SIM_STEPS_MAX, "passthrough start");
+    printf("passthrough active after %d ms, commands:", Ms);
+    PrintCommands(From);
+
+    // data looking like AT messages go through as is
+    for(int i = 0; i < 100000; i++) { In += (char)(i * 7 + i / 251); }
+    In.replace(100, 12, "\r\n+IPD,0,3:");
+    In.replace(5000, 3, "\r\n>");
+    Out = In;
+    TxSpace = 512;
+    ModuleSend(In.substr(0, 30000));
+    for(Ms = 0; Ms < SIM_STEPS_MAX && (Pos < Out.size() || Got.size() < In.size()); Ms++)
+    {
+        Pos += ESP1.PassthroughSend((const uint8_t*)Out.data() + Pos, Out.size() - Pos);
+        while((Len = ESP1.PassthroughRecv(RxBuf, sizeof(RxBuf))) != 0) { Got.append((char*)RxBuf, Len); }
+        if(Ms == 10) { ModuleSend(In.substr(30000)); }
+        Step();
+    }
+    Check(TransparentSent == Out && Got == In, "passthrough data");
+    printf("passthrough data: %d ms\n", Ms);
+    TxSpace = 1000;
+
+    From = Commands.size();
+    ESP1.PassthroughStop();
+    for(Ms = 1; Ms < SIM_STEPS_MAX; Ms++)
+    {
+        Step();
+        if(ESP1.GetPassthroughState() == ESP::ePassthroughState::Idle && ESP1.GetServerState() == ESP::eServerState::Connected) { break; }
+    }
+    Check(Ms < SIM_STEPS_MAX && !Transparent, "passthrough stop");
+    printf("passthrough stopped after %d ms, commands:", Ms);
+    PrintCommands(From);
+
+    ESP1.ListenSocket(1, Buf, sizeof(Buf));
+    ModuleSend("1,CONNECT\r\n+IPD,1,4:ping");
+    Step(20);
+    Check(ESP1.GetSocketState(1) == ESP::eSocketState::Connected && ESP1.SocketRecv(1) == 4, "server after passthrough");
+}
+#endif
+
+#ifdef ESP8266_PASSIVE_RX_EN
+static void ScenarioPassive(void)
+{
+static uint8_t Buf[64];
+std::string Request, Got;
+size_t From;
+uint16_t Len;
+int Ms;
+
+    for(int i = 0; i < 700; i++) { Request += (char)('a' + i % 26); }
+    From = Commands.size();
+    ModuleSend("1,CONNECT\r\n");
+    Step(5);
+    ESP1.ListenSocket(1, Buf, sizeof(Buf));
+    ModuleDeliver(1, Request.substr(0, 300));
+    ModuleDeliver(1, Request.substr(300, 250));
+    Step(3);
+    ModuleDeliver(1, Request.substr(550));
+    for(Ms = 1; Ms < SIM_STEPS_MAX && Got.size() < Request.size(); Ms++)
+    {
+        Step();
+        Len = ESP1.SocketRecv(1);
+        if(Len == (uint16_t)-1) { break; }
+        if(Len)
+        {
+            Got.append((char*)Buf, Len);
+            ESP1.ListenSocket(1, Buf, sizeof(Buf));
+        }
+    }
+    Check(!Passive || Got == Request, "passive receive");      //  without passive mode messages longer than the buffer are cut
+    printf("passive receive (%s): %d ms, %zu commands\n", Passive ? "on" : "off", Ms, Commands.size() - From);
+
+    // data waiting without notification are found by AT+CIPRECVLEN? after UART flush
+    Pending[1] = "lost";
+    ESP1.ListenSocket(1, Buf, sizeof(Buf));
+    ModuleSend("\xff\xff garbage");
+    OverflowOnce = true;
+    for(Ms = 1; Ms < SIM_STEPS_MAX; Ms++)
+    {
+        Step();
+        Len = ESP1.SocketRecv(1);
+        if(Len && Len != (uint16_t)-1) { break; }
+    }
+    Check(!Passive || 0 == memcmp(Buf, "lost", 4), "passive data after UART flush");
+    printf("passive after UART flush: %d ms\n", Ms);
+}
+#endif
+
+#ifdef ESP8266_RX_RING_EN
+static void ScenarioRing(void)
+{
+static uint8_t Ring[100], Buf[37], Peek[8];
+std::string Request, Got;
+uint16_t Len, PeekLen;
+bool PeekOK = true;
+int Ms;
+
+    for(int i = 0; i < 700; i++) { Request += (char)('A' + i % 26); }
+    ModuleSend("1,CONNECT\r\n");
+    Step(5);
+
+    // message which does not fit is dropped at "+IPD", next ones are received
+    ESP1.ListenSocketRing(1, Ring, sizeof(Ring), ESP::eRxFullPolicy::Pause);
+    Passive = false;        //  module pushes data as firmware without AT+CIPRECVMODE
+    ModuleSend("\r\n+IPD,1,60:" + Request.substr(0, 60) + "\r\n+IPD,1,60:" + Request.substr(0, 60) + "\r\n+IPD,1,30:" + Request.substr(0, 30) + "\r\n2,CONNECT\r\n");
+    Step(20);
+    Check(ESP1.SocketRxAvailable(1) == 90 && ESP1.GetSocketRxDropped(1) == 60 && ESP1.GetSocketState(2) == ESP::eSocketState::Connected, "ring, pause policy without passive receive");
+    ESP1.CloseSocket(2);
+    Step(20);
+#ifdef ESP8266_PASSIVE_RX_EN
+    Passive = (getenv("NOPASSIVE") == 0);
+#endif
+
+    // application reads slower than data come, with passive receive they wait in the module
+    ESP1.ListenSocketRing(1, Ring, sizeof(Ring), ESP::eRxFullPolicy::Pause);
+    ModuleDeliver(1, Request.substr(0, 300));
+    ModuleDeliver(1, Request.substr(300, 250));
+    ModuleDeliver(1, Request.substr(550));
+    for(Ms = 1; Ms < SIM_STEPS_MAX && Got.size() + ESP1.GetSocketRxDropped(1) < Request.size(); Ms++)
+    {
+        Step();
+        PeekLen = ESP1.SocketPeek(1, Peek, sizeof(Peek));
+        Len = ESP1.SocketRead(1, Buf, sizeof(Buf));
+        if(PeekLen && memcmp(Peek, Buf, PeekLen < Len ? PeekLen : Len)) { PeekOK = false; }
+        Got.append((char*)Buf, Len);
+    }
+    Check(PeekOK, "ring, peek");
+    if(Passive) { Check(Got == Request && 0 == ESP1.GetSocketRxDropped(1), "ring, pause policy"); }
+    printf("ring pause: %d ms\n", Ms);
+
+    ESP1.ListenSocketRing(1, Ring, 50, ESP::eRxFullPolicy::Drop);
+    ModuleSend("+IPD,1,80:" + Request.substr(0, 80) + "\r\n+IPD,1,3:xyz");
+    Step(20);
+    Check(ESP1.SocketRxAvailable(1) == 50 && ESP1.GetSocketRxDropped(1) == 33 && ESP1.GetSocketState(1) == ESP::eSocketState::Connected, "ring, drop policy");
+    ESP1.SocketRead(1, 0, 10);
+    ModuleSend("+IPD,1,3:xyz");
+    Step(20);
+    Len = ESP1.SocketRead(1, Buf, sizeof(Buf));
+    Check(Len == sizeof(Buf) && 0 == memcmp(Buf, "KLMNO", 5) && ESP1.SocketRxAvailable(1) == 6, "ring, skip");
+
+    ESP1.ListenSocketRing(1, Ring, 50, ESP::eRxFullPolicy::Close);
+    ModuleSend("+IPD,1,80:" + Request.substr(0, 80));
+    Step(20);
+    Check(ESP1.SocketRxAvailable(1) == 50 && ESP1.GetSocketState(1) == ESP::eSocketState::Closed, "ring, close policy");
+}
+#endif
+
+/* Small response on socket 3 is interleaved with 20 KB response on socket 0 */
+static void ScenarioScheduler(void)
+{
+static uint8_t Big[20000], Small[300];
+int Ms, SmallMs = -1;
+
+    memset(Big, 'B', sizeof(Big));
+    memset(Small, 's', sizeof(Small));
+    ModuleSend("0,CONNECT\r\n3,CONNECT\r\n");
+    Step(20);
+    Sent[0].clear();
+    Sent[3].clear();
+    ESP1.SetSocketTxClass(0, ESP::eTxClass::Bulk);
+    ESP1.SetSocketTxClass(3, ESP::eTxClass::Control);
+    ESP1.SocketSend(0, Big, sizeof(Big));
+    Step(3);
+    ESP1.SocketSend(3, Small, sizeof(Small));
+
+    for(Ms = 0; Ms < SIM_STEPS_MAX && Sent[0].size() < sizeof(Big); Ms++)
+    {
+        Step();
+        if(SmallMs < 0 && Sent[3].size() == sizeof(Small)) { SmallMs = Ms; }
+    }
+    Check(Sent[0].size() == sizeof(Big) && Sent[3].size() == sizeof(Small), "interleaved responses");
+    printf("scheduler: small response after %d ms, big one after %d ms\n", SmallMs, Ms);
+    Step(100);
+}
+
+/* Lost "<id>,CLOSED" and "<id>,CONNECT" are found by AT+CIPSTATUS */
+static void ScenarioSync(void)
+{
+static uint8_t Buf[64];
+size_t From;
+int Ms;
+
+    Check(ServerTimeout == ESP8266_SERVER_TIMEOUT, "server timeout set");
+    ESP1.ListenSocket(3, Buf, sizeof(Buf));
+    ModuleSend("3,CONNECT\r\n");
+    Step(20);
+    ESP1.CloseSocket(4);
+    Step(50);
+    LinkUp[3] = false;      //  closed by module without report
+    LinkUp[4] = true;       //  accepted without report
+    ESP1.ListenSocket(4, Buf, sizeof(Buf));
+    From = Commands.size();
+    ESP1.SyncSocketStates();
+    Step(50);
+    Check(ESP1.GetSocketState(3) == ESP::eSocketState::Closed && ESP1.GetSocketState(4) == ESP::eSocketState::Connected, "socket states synchronized");
+    printf("sync, commands:");
+    PrintCommands(From);
+
+    From = Commands.size();
+    for(Ms = 0; Ms < SIM_STEPS_MAX && Commands.size() == From; Ms++) { Step(); }
+    Check(Commands.size() > From && Commands[From] == "AT+CIPSTATUS", "periodic synchronization");
+    printf("periodic sync after %d ms\n", Ms);
+    ESP1.CloseSocket(4);
+    Step(50);
+}
+
+/* Module restarts by itself */
+/* Outgoing connection, module works with multiple connections, so link ID comes first */
+static void ScenarioConnect(void)
+{
+static char Host[] = "192.168.4.2";
+size_t From = Commands.size();
+
+    Check(SUCCESS == ESP1.OpenConnection(4, Host, 8080), "connect: requested");
+    Step(50);
+    Check(ESP1.GetSocketState(4) == ESP::eSocketState::Connected, "connect: socket connected");
+    Check(std::find(Commands.begin() + From, Commands.end(), "AT+CIPSTART=4,\"TCP\",\"192.168.4.2\",8080") != Commands.end(), "connect: link ID");
+    ESP1.CloseSocket(4);
+    Step(50);
+}
+
+static void ScenarioRestart(void)
+{
+size_t From = Commands.size();
+int Ms;
+
+    ModuleSend("\r\n ets Jan  8 2013,rst cause:4, boot mode:(3,6)\r\n\r\nwdt reset\r\nready\r\n");
+    Echo = true;
+    Step(20);
+    Check(ESP1.GetSocketState(2) == ESP::eSocketState::Closed, "sockets closed after restart");
+    Ms = StartServer();
+    printf("server up again after %d ms, %zu commands\n", Ms, Commands.size() - From);
+}
+
+int main(void)
+{
+int Ms;
+
+    Verbose = (getenv("V") != 0);
+    SendBufSupported = (getenv("NOSENDBUF") == 0);
+
+    ESP1.ModuleToggle(ESP::eModuleToggle::Enable);
+    Ms = StartServer();
+    printf("server up after %d ms, commands:", Ms);
+    PrintCommands(0);
+    Step(500);
+
+    ScenarioRequest();
+    ScenarioBurst();
+    ScenarioCloses();
+    ScenarioBig();
+    ScenarioStreamPause();
+#ifdef ESP8266_PASSTHROUGH_EN
+    ScenarioPassthrough();
+#endif
+#ifdef ESP8266_PASSIVE_RX_EN
+    ScenarioPassive();
+#endif
+#ifdef ESP8266_RX_RING_EN
+    ScenarioRing();
+#endif
+    ScenarioScheduler();
+    ScenarioSync();
+    ScenarioConnect();
+    ScenarioRestart();
+
+    printf(Failures ? "%d check(s) failed\n" : "all checks passed\n", Failures);
+
+    return Failures;
+}
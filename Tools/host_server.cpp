@@ -0,0 +1,129 @@
+/**
+  ******************************************************************************
+  * @file    host_server.cpp
+  * @author  Ostap Kostyk
+  * @brief   HTTP_Server with the content of the device (HTTP_content.cpp) running
+  *          as Linux process over Linux_Transport, e.g. for load tests with wrk/ab
+  *          and profiling with perf without UART limits. Build and run on the host
+  *          from Tools directory:
+  *            g++ -O2 -g -include stdlib.h -DSTM32F103xB -DUSE_HAL_DRIVER -I. -I../Core/Inc
+  *              -I../Drivers/STM32F1xx_HAL_Driver/Inc -I../Drivers/CMSIS/Include
+  *              -I../Drivers/CMSIS/Device/ST/STM32F1xx/Include
+  *              host_server.cpp Linux_Transport.cpp ../Core/Src/HTTP_Server.cpp
+  *              ../Core/Src/HTTP_content.cpp ../Core/Src/ROMFS.cpp
+  *              ../Core/Src/ROMFS_image.cpp ../Core/Src/Timer.cpp ../Core/Src/Scan.c
+  *              -o host_server && ./host_server 8080
+  *          HAL headers are needed for types only, malloc() of the C library is used
+  *          instead of memmgr. Options of the server (e.g. -DESP8266_SOCKET_EVENTS_EN
+  *          -DHTTP_SERV_ROMFS_EN) are added as for target
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Linux_Transport.hpp"
+#include "HTTP_Server.hpp"
+#include "main.h"
+
+using namespace OKO_TRANSPORT;
+using namespace OKO_HTTP_SERVER;
+
+#define HOST_SERVER_PORT    8080    //  default port, other one can be given as argument
+
+/* Server uses all sockets of the transport */
+struct HostServerConfig : HTTP_ServerDefaultConfig { static constexpr uint8_t Sockets = LINUX_TRANSPORT_SOCKETS_MAX; };
+
+static Linux_Transport HostTransport{};
+static HTTP_ServerInstance<HostServerConfig> HostServer{&HostTransport};
+
+static char BlueLEDMode = '0';      //  state shown by index.html, device keeps it in LED module
+
+/* Same as HTTP_RenderPage() of the device, values are taken from HTTP variables instead of LEDs and EEPROM */
+bool HTTP_RenderPage(int PageIndex, char *, bool **pProcessSemaphore)
+{
+char *pText;
+
+    *pProcessSemaphore = 0;
+
+    switch(PageIndex)
+    {
+    case 0:     //  index.html
+        if(HTTP_VAR_BlueLEDMode.NewValueReceived())
+        {
+            pText = HTTP_VAR_BlueLEDMode.GetText();
+            if(0 == strcmp(pText, "ON"))            { BlueLEDMode = '1'; }
+            else if(0 == strcmp(pText, "BLINK"))    { BlueLEDMode = '2'; }
+            else if(0 == strcmp(pText, "OFF"))      { BlueLEDMode = '0'; }
+        }
+        HTTP_Index_Body2[0] = BlueLEDMode;
+        return true;
+
+    case 1:     //  settings.html
+        snprintf(pHTTP_StringForRendering, HTML_RENDER_STR_SIZE-1, "<p id=\"BLEDOnAct\", visibility: hidden>%d</p>\n<p id=\"BLEDOffAct\", visibility: hidden>%d</p>",
+                 HTTP_VAR_BlueLEDBlinkTimeOn.GetValueInteger(), HTTP_VAR_BlueLEDBlinkTimeOff.GetValueInteger());
+        snprintf(pHTTP_StringForRendering2, HTML_RENDER_STR_SIZE2-1, "Actual: \"%s\"<br />", HTTP_VAR_WiFiSSID.GetText());
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+static uint64_t Milliseconds(void)
+{
+struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char *argv[])
+{
+int Port = HOST_SERVER_PORT;
+uint64_t TickTime;
+
+    if(argc > 1) { Port = atoi(argv[1]); }
+
+    if(SUCCESS != HostTransport.StartServer((uint16_t)Port))
+    {
+        perror("StartServer");
+        return 1;
+    }
+    printf("HTTP server listens on port %d\n", Port);
+
+    TickTime = Milliseconds();
+
+    for(;;)
+    {
+        HostTransport.Process(1);   //  timers of the server count milliseconds
+        HostServer.Handle();
+
+        while(Milliseconds() > TickTime)    //  SysTick of the device
+        {
+            mTimer::Timer::Tick();
+            TickTime++;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,366 @@
+/**
+  ******************************************************************************
+  * @file    http_client_test.cpp
+  * @author  Ostap Kostyk
+  * @brief   HTTP_Client running on the host over Linux_Transport against
+  *          stand-in server on localhost, which checks received requests and
+  *          answers with scripted responses: Content-Length body, chunked body
+  *          split into small TCP segments, pipelined requests answered at once,
+  *          body until close with reconnection, keep-alive connection closed
+  *          by server while idle and refused connection.
+  *          One loop pass is one timer tick (1 ms), so timeouts take no real time.
+  *          Build and run on the host from Tools directory:
+  *            g++ -g -include stdlib.h -DSTM32F103xB -DUSE_HAL_DRIVER -DHTTP_CLIENT_EN
+  *              -I. -I../Core/Inc -I../Drivers/STM32F1xx_HAL_Driver/Inc
+  *              -I../Drivers/CMSIS/Include -I../Drivers/CMSIS/Device/ST/STM32F1xx/Include
+  *              http_client_test.cpp Linux_Transport.cpp ../Core/Src/HTTP_Client.cpp
+  *              ../Core/Src/Timer.cpp ../Core/Src/Scan.c -o http_client_test
+  *              && ./http_client_test
+  *          Exit code is number of failed checks
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include "Linux_Transport.hpp"
+#include "HTTP_Client.hpp"
+
+using namespace OKO_TRANSPORT;
+using namespace OKO_HTTP_CLIENT;
+
+#define TEST_HOST           "127.0.0.1"
+#define TEST_WAIT_MAX       30000   //  limit of every wait, ms
+#define TEST_TAGS           16
+
+/* Stand-in server: one connection at a time, requests are split by header end and Content-Length */
+struct StandIn
+{
+    int ListenFd = -1;
+    int fd = -1;
+    uint16_t Port = 0;
+    int Connections = 0;
+    int Reads = 0;                          //  recv() calls which returned data
+    std::string Rx;
+    std::vector<std::string> Requests;      //  complete requests in order of arrival
+    std::deque<std::string> TxSegments;     //  sent one per loop pass
+};
+
+/* Response as seen by callback */
+struct Response
+{
+    int Status = 0;
+    std::string Body;
+    int Parts = 0;                          //  callback calls with data
+    bool Done = false;
+};
+
+static Linux_Transport ClientTransport{2};
+static StandIn Server;
+static Response Responses[TEST_TAGS];
+static std::vector<int> Completed;          //  tags in order of completion
+static int Failures;
+
+static void Check(bool Condition, const char *Name)
+{
+    printf("  %-48s %s\n", Name, Condition ? "ok" : "FAILED");
+    if(!Condition) { Failures++; }
+}
+
+static void ClientCallback(void *, uint8_t Tag, int Status, const uint8_t *pData, uint16_t Len, bool Last)
+{
+Response *pR = &Responses[Tag % TEST_TAGS];
+
+    pR->Status = Status;
+    if(Len)
+    {
+        pR->Body.append((const char*)pData, Len);
+        pR->Parts++;
+    }
+    if(Last)
+    {
+        pR->Done = true;
+        Completed.push_back(Tag);
+    }
+}
+
+static bool ServerStart(StandIn &S)
+{
+struct sockaddr_in Address;
+socklen_t AddressLen = sizeof(Address);
+
+    S.ListenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(S.ListenFd < 0) { return false; }
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = 0;   //  any free port
+
+    if(bind(S.ListenFd, (struct sockaddr*)&Address, sizeof(Address)) < 0 || listen(S.ListenFd, 4) < 0) { return false; }
+    if(getsockname(S.ListenFd, (struct sockaddr*)&Address, &AddressLen) < 0) { return false; }
+
+    S.Port = ntohs(Address.sin_port);
+    return true;
+}
+
+static void ServerCloseConnection(StandIn &S)
+{
+    if(S.fd >= 0) { close(S.fd); }
+    S.fd = -1;
+    S.Rx.clear();
+}
+
+/* Splits received data into requests */
+static void ServerParse(StandIn &S)
+{
+size_t End, Length;
+const char *pLength;
+
+    for(;;)
+    {
+        End = S.Rx.find("\r\n\r\n");
+        if(End == std::string::npos) { return; }
+        End += 4;
+
+        Length = 0;
+        pLength = strstr(S.Rx.c_str(), "Content-Length: ");
+        if(pLength && (size_t)(pLength - S.Rx.c_str()) < End) { Length = strtoul(pLength + 16, 0, 10); }
+
+        if(S.Rx.size() < End + Length) { return; }
+
+        S.Requests.push_back(S.Rx.substr(0, End + Length));
+        S.Rx.erase(0, End + Length);
+    }
+}
+
+static void ServerPoll(StandIn &S)
+{
+char Buffer[1024];
+ssize_t len;
+int fd;
+int On = 1;
+
+    if(S.ListenFd >= 0 && (fd = accept4(S.ListenFd, 0, 0, SOCK_NONBLOCK)) >= 0)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &On, sizeof(On));    //  segments are not delayed by Nagle, loop passes are much shorter than 1 ms
+        ServerCloseConnection(S);   //  client opens new connection after closing previous one
+        S.fd = fd;
+        S.Connections++;
+    }
+
+    if(S.fd < 0) { return; }
+
+    len = recv(S.fd, Buffer, sizeof(Buffer), 0);
+    if(len > 0)
+    {
+        S.Rx.append(Buffer, len);
+        S.Reads++;
+        ServerParse(S);
+    }
+    else if(len == 0)
+    {
+        ServerCloseConnection(S);   //  closed by client
+        return;
+    }
+
+    if(!S.TxSegments.empty())
+    {
+        send(S.fd, S.TxSegments.front().data(), S.TxSegments.front().size(), MSG_NOSIGNAL);
+        S.TxSegments.pop_front();
+    }
+}
+
+/* Queues response, Segment is size of TCP segments it is sent by (0: at once) */
+static void ServerRespond(StandIn &S, const std::string &Text, size_t Segment = 0)
+{
+    if(Segment == 0) { Segment = Text.size(); }
+
+    for(size_t i = 0; i < Text.size(); i += Segment)
+    {
+        S.TxSegments.push_back(Text.substr(i, Segment));
+    }
+}
+
+/* Loop of the device: transport, client, timer tick. Returns true if Condition became true within WaitMax ms */
+template <typename F>
+static bool Run(HTTP_Client &Client, F Condition, int WaitMax = TEST_WAIT_MAX)
+{
+    for(int ms = 0; ms < WaitMax; ms++)
+    {
+        ClientTransport.Process(0);
+        Client.Handle();
+        ServerPoll(Server);
+        mTimer::Timer::Tick();
+
+        if(Condition()) { return true; }
+    }
+
+    return false;
+}
+
+static bool HasHeader(const std::string &Request, const std::string &Header)
+{
+    return Request.find("\r\n" + Header + "\r\n") != std::string::npos;
+}
+
+static void TestContentLength(HTTP_Client &Client)
+{
+char Host[32];
+
+    printf("Content-Length\n");
+
+    Client.Request(HTTP_Client::eMethod::Get, "/length", 0, 0, 0, 1);
+    Check(Run(Client, []{ return Server.Requests.size() == 1; }), "request is received");
+    Check(Server.Requests[0].compare(0, 24, "GET /length HTTP/1.1\r\nHo") == 0, "request line");
+    snprintf(Host, sizeof(Host), "Host: %s:%u", TEST_HOST, Server.Port);
+    Check(HasHeader(Server.Requests[0], Host), "host header with port");
+
+    ServerRespond(Server, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 11\r\n\r\nhello world");
+    Check(Run(Client, []{ return Responses[1].Done; }), "response is complete");
+    Check(Responses[1].Status == 200 && Responses[1].Body == "hello world", "status and body");
+    Check(Client.isConnected() && Client.GetQueued() == 0, "connection is kept alive");
+}
+
+static void TestChunked(HTTP_Client &Client)
+{
+static const uint8_t Body[] = "{\"led\":1}";
+
+    printf("Chunked body split into segments\n");
+
+    Client.Request(HTTP_Client::eMethod::Post, "/chunked", "application/json", Body, sizeof(Body) - 1, 2);
+    Check(Run(Client, []{ return Server.Requests.size() == 2; }), "request is received");
+    Check(HasHeader(Server.Requests[1], "Content-Type: application/json") && HasHeader(Server.Requests[1], "Content-Length: 9"), "content headers");
+    Check(Server.Requests[1].compare(Server.Requests[1].size() - 9, 9, (const char*)Body) == 0, "request body");
+
+    ServerRespond(Server, "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n"
+                          "5;ext=1\r\nhello\r\n7\r\n world!\r\n0\r\nX-Trailer: 1\r\n\r\n", 3);
+    Check(Run(Client, []{ return Responses[2].Done; }), "response is complete");
+    Check(Responses[2].Status == 201 && Responses[2].Body == "hello world!", "status and body");
+    Check(Server.Connections == 1, "same connection is used");
+}
+
+static void TestPipelined(HTTP_Client &Client)
+{
+std::string Big(1000, 'x');
+int Reads = Server.Reads;
+
+    printf("Pipelined requests\n");
+
+    Client.Request(HTTP_Client::eMethod::Get, "/big", 0, 0, 0, 3);
+    Client.Request(HTTP_Client::eMethod::Get, "/chunks", 0, 0, 0, 4);
+    Client.Request(HTTP_Client::eMethod::Get, "/cached", 0, 0, 0, 5);
+    Check(Run(Client, []{ return Server.Requests.size() == 5; }), "requests are sent before responses");
+    Check(Server.Reads == Reads + 1, "requests are sent together");
+
+    ServerRespond(Server, "HTTP/1.1 200 OK\r\nContent-Length: 1000\r\n\r\n" + Big +
+                          "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"
+                          "HTTP/1.1 304 Not Modified\r\nETag: \"1\"\r\n\r\n");
+    Check(Run(Client, []{ return Responses[5].Done; }), "responses are complete");
+    Check(Completed.size() >= 5 && Completed[2] == 3 && Completed[3] == 4 && Completed[4] == 5, "responses are in order of requests");
+    Check(Responses[3].Body == Big && Responses[3].Parts > 1, "long body is received by parts");
+    Check(Responses[4].Body == "abc" && Responses[5].Status == 304 && Responses[5].Body.empty(), "chunked and empty bodies");
+}
+
+static void TestUntilClose(HTTP_Client &Client)
+{
+    printf("Body until close, reconnection\n");
+
+    Client.Request(HTTP_Client::eMethod::Get, "/close", 0, 0, 0, 6);
+    Check(Run(Client, []{ return Server.Requests.size() == 6; }), "request is received");
+
+    ServerRespond(Server, "HTTP/1.0 200 OK\r\n\r\nuntil close");
+    Run(Client, []{ return Server.TxSegments.empty(); });
+    ServerCloseConnection(Server);
+    Check(Run(Client, []{ return Responses[6].Done; }), "response is complete");
+    Check(Responses[6].Status == 200 && Responses[6].Body == "until close", "status and body");
+
+    Client.Request(HTTP_Client::eMethod::Delete, "/item", 0, 0, 0, 7);
+    Check(Run(Client, []{ return Server.Requests.size() == 7; }), "next request is received");
+    Check(Server.Connections == 2 && Server.Requests[6].compare(0, 13, "DELETE /item ") == 0, "client connected again");
+
+    ServerRespond(Server, "HTTP/1.1 204 No Content\r\n\r\n");
+    Check(Run(Client, []{ return Responses[7].Done; }) && Responses[7].Status == 204, "response is complete");
+}
+
+static void TestIdleClose(HTTP_Client &Client)
+{
+    printf("Keep-alive connection closed by server while idle\n");
+
+    ServerCloseConnection(Server);
+    Check(Run(Client, [&Client]{ return !Client.isConnected(); }), "close is seen by client");
+
+    Client.Request(HTTP_Client::eMethod::Get, "/again", 0, 0, 0, 9);
+    Check(Run(Client, []{ return Server.Requests.size() == 8; }, 1000), "next request is sent without retry pause");
+    Check(Server.Connections == 3, "client connected again");
+
+    ServerRespond(Server, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+    Check(Run(Client, []{ return Responses[9].Done; }) && Responses[9].Body == "ok", "response is complete");
+}
+
+static void TestRefused(HTTP_Client &Client)
+{
+    printf("Refused connection\n");
+
+    Client.Request(HTTP_Client::eMethod::Get, "/", 0, 0, 0, 8);
+    Check(Run(Client, []{ return Responses[8].Done; }), "request fails");
+    Check(Responses[8].Status == HTTP_CLIENT_STATUS_FAILED && Client.GetQueued() == 0, "status is failed");
+}
+
+int main()
+{
+StandIn Refusing;
+
+    if(!ServerStart(Server) || !ServerStart(Refusing))
+    {
+        perror("stand-in server");
+        return 1;
+    }
+    close(Refusing.ListenFd);   //  nobody listens on the port
+
+    HTTP_Client Client{&ClientTransport, 0, TEST_HOST, Server.Port};
+    HTTP_Client RefusedClient{&ClientTransport, 1, TEST_HOST, Refusing.Port};
+
+    Client.SetCallback(ClientCallback, 0);
+    RefusedClient.SetCallback(ClientCallback, 0);
+
+    TestContentLength(Client);
+    TestChunked(Client);
+    TestPipelined(Client);
+    TestUntilClose(Client);
+    TestIdleClose(Client);
+    TestRefused(RefusedClient);
+
+    if(Failures) { printf("%d check(s) failed\n", Failures); }
+    else         { printf("all checks passed\n"); }
+
+    return Failures;
+}
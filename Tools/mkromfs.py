@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# @file    mkromfs.py
+# @author  Ostap Kostyk
+# @brief   Generates ROMFS image (C++ source with constant data placed in flash) from a directory
+#
+# Copyright (C) 2018  Ostap Kostyk
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version provided that the redistributions
+# of source code must retain the above copyright notice.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Usage: mkromfs.py [--gzip [--plain]] <input directory> <output .cpp file>
+#
+# Every file of the input directory (recursively) becomes a ROMFS file with path relative to the directory.
+# With --gzip text files are stored gzip-compressed if that makes them smaller (served with "Content-Encoding: gzip").
+# With --plain an uncompressed copy of every compressed file is stored as well, for clients which do not accept gzip
+# (without it such clients get "406 Not Acceptable").
+# Output is rewritten only if its content changed, so the pre-build step does not trigger rebuild every time.
+
+import gzip
+import os
+import sys
+
+ROMFS_MAGIC = 0x53464D52
+MAX_FILE_SIZE = 0xFFFF      # ESP::SocketSend() length is 16 bit
+
+# name, must match ROMFS_MimeType in Core/Inc/ROMFS.h
+MIME_TYPES = ["Binary", "Html", "Css", "Js", "Json", "Text", "Png", "Jpeg", "Gif", "Svg", "Icon"]
+
+EXTENSIONS = {
+    ".html": "Html", ".htm": "Html",
+    ".css": "Css",
+    ".js": "Js",
+    ".json": "Json",
+    ".txt": "Text",
+    ".png": "Png",
+    ".jpg": "Jpeg", ".jpeg": "Jpeg",
+    ".gif": "Gif",
+    ".svg": "Svg",
+    ".ico": "Icon",
+}
+
+COMPRESSIBLE = {"Html", "Css", "Js", "Json", "Text", "Svg"}     # text types, images are compressed already
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def c_bytes(data, indent="        "):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append(indent + ", ".join("0x%02X" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def collect(root, use_gzip, keep_plain):
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for name in sorted(filenames):
+            full = os.path.join(dirpath, name)
+            path = os.path.relpath(full, root).replace(os.sep, "/")
+            with open(full, "rb") as f:
+                data = f.read()
+            mime = EXTENSIONS.get(os.path.splitext(name)[1].lower(), "Binary")
+            variants = [(data, 0)]
+            if use_gzip and mime in COMPRESSIBLE:
+                packed = gzip.compress(data, compresslevel=9, mtime=0)
+                if len(packed) < len(data):
+                    variants = [(packed, 0x01), (data, 0)] if keep_plain else [(packed, 0x01)]   # gzip copy is found first
+            for data, flags in variants:
+                if len(data) > MAX_FILE_SIZE:
+                    sys.exit("mkromfs: %s is too big (%u bytes, max %u)" % (path, len(data), MAX_FILE_SIZE))
+                files.append({"path": path, "data": data, "mime": mime, "flags": flags,
+                              "hash": fnv1a(path.encode("ascii")), "etag": "%08x" % fnv1a(data)})
+    return files
+
+
+def build_index(files):
+    size = 4
+    while size < 2 * len(files):    # load factor <= 0.5, at least one empty bucket terminates probing
+        size *= 2
+    index = [0] * size
+    for num, f in enumerate(files):
+        bucket = f["hash"] & (size - 1)
+        while index[bucket]:
+            bucket = (bucket + 1) & (size - 1)
+        index[bucket] = num + 1
+    return index
+
+
+def generate(files, index):
+    out = []
+    out.append("/* This file is generated by Tools/mkromfs.py from HTML/romfs, do not edit */\n")
+    out.append('#include "ROMFS.h"\n')
+    out.append("#ifdef HTTP_SERV_ROMFS_EN\n")
+    for num, f in enumerate(files):
+        out.append("/* %s, %u bytes%s */" % (f["path"], len(f["data"]), ", gzip" if f["flags"] & 1 else ""))
+        out.append("static const uint8_t ROMFS_Data%u[] = {\n%s\n};\n" % (num, c_bytes(f["data"])))
+    out.append("static const ROMFS_File ROMFS_Files[] = {")
+    for num, f in enumerate(files):
+        out.append('    {0x%08XUL, "%s", ROMFS_Data%u, %u, "\\"%s\\"", ROMFS_MimeType::%s, 0x%02X},'
+                   % (f["hash"], f["path"], num, len(f["data"]), f["etag"], f["mime"], f["flags"]))
+    if not files:
+        out.append("    {0, \"\", 0, 0, \"\", ROMFS_MimeType::Binary, 0},")
+    out.append("};\n")
+    out.append("static const uint16_t ROMFS_Index[] = {")
+    for i in range(0, len(index), 16):
+        out.append("    " + ", ".join(str(n) for n in index[i:i + 16]) + ",")
+    out.append("};\n")
+    out.append("const ROMFS_Image ROMFS = {0x%08XUL, %u, %u, ROMFS_Files, ROMFS_Index};\n"
+               % (ROMFS_MAGIC, len(files), len(index)))
+    out.append("#endif  //  HTTP_SERV_ROMFS_EN\n")
+    return "\n".join(out)
+
+
+def main(argv):
+    use_gzip = "--gzip" in argv
+    keep_plain = "--plain" in argv
+    args = [a for a in argv if a not in ("--gzip", "--plain")]
+    if len(args) != 2:
+        sys.exit("usage: mkromfs.py [--gzip [--plain]] <input directory> <output .cpp file>")
+
+    files = collect(args[0], use_gzip, keep_plain)
+    text = generate(files, build_index(files))
+
+    if os.path.exists(args[1]):
+        with open(args[1], "r") as f:
+            if f.read() == text:
+                return
+    with open(args[1], "w", newline="\r\n") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
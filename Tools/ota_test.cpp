@@ -0,0 +1,229 @@
+/**
+  ******************************************************************************
+  * @file    ota_test.cpp
+  * @author  Ostap Kostyk
+  * @brief   OTA_Update running on the host with flash emulated in RAM
+  *          (FLASH_EMULATOR in Flash_Interface.c). Streams images in chunks of
+  *          random size through both receive buffers (Write() and GetWriteBuffer()/
+  *          Commit()) interleaved with Handle() calls, checks flash content, CRC32
+  *          accept and reject paths and that erased pages of staging area are not
+  *          erased again. Build and run on the host from Tools directory:
+  *            g++ -g -include stdlib.h -DSTM32F103xB -DUSE_HAL_DRIVER -DFLASH_EMULATOR
+  *              -DHTTP_SERV_OTA_EN -I../Core/Inc -I../Drivers/STM32F1xx_HAL_Driver/Inc
+  *              -I../Drivers/CMSIS/Include -I../Drivers/CMSIS/Device/ST/STM32F1xx/Include
+  *              -Wl,--wrap=Flash_ErasePage ota_test.cpp ../Core/Src/OTA_Update.cpp
+  *              -x c ../Core/Src/Flash_Interface.c -o ota_test && ./ota_test
+  *          Flash_ErasePage() is wrapped by the linker to count erased pages.
+  *          Exit code is number of failed checks
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include "OTA_Update.hpp"
+
+using namespace OKO_OTA;
+
+#define TEST_HANDLE_CALLS_MAX   1000000     //  limit of every update
+#define TEST_CHUNK_MAX          700         //  longer than OTA_BUFFER_SIZE, so one chunk fills both buffers
+
+static int Failures;
+static int ErasedPages;
+
+extern "C" STATUS __real_Flash_ErasePage(uint32_t Address);
+
+extern "C" STATUS __wrap_Flash_ErasePage(uint32_t Address)
+{
+    ErasedPages++;
+    return __real_Flash_ErasePage(Address);
+}
+
+static void Check(bool Condition, const char *Name)
+{
+    printf("  %-48s %s\n", Name, Condition ? "ok" : "FAILED");
+    if(!Condition) { Failures++; }
+}
+
+/* Pseudo-random image, page Blank (if not negative) is left erased (0xFF) */
+static std::vector<uint8_t> MakeImage(uint32_t Size, int Blank, uint32_t Seed)
+{
+std::vector<uint8_t> Image(Size);
+uint32_t i;
+
+    for(i = 0; i < Size; i++)
+    {
+        Seed = Seed * 1103515245U + 12345U;
+        Image[i] = (uint8_t)(Seed >> 16);
+        if(Blank >= 0 && i / FLASH_IF_PAGE_SIZE == (uint32_t)Blank) { Image[i] = 0xFF; }
+    }
+
+    return Image;
+}
+
+/* Runs update of Image with expected Crc to the end, data come in chunks of random size.
+ * Returns true if both buffers were full at least once (receiver had to wait for programming) */
+static bool Stream(OTA_Update &Ota, const std::vector<uint8_t> &Image, uint32_t Crc)
+{
+uint32_t Pos = 0, Chunk, Calls;
+uint16_t Space, Len;
+uint8_t *pBuffer;
+bool Waited = false;
+bool Direct = false;
+
+    if(SUCCESS != Ota.Begin(Image.size(), Crc)) { return false; }
+
+    for(Calls = 0; Calls < TEST_HANDLE_CALLS_MAX; Calls++)
+    {
+        if(Ota.GetState() != OTA_Update::eState::Erasing && Ota.GetState() != OTA_Update::eState::Receiving
+           && Ota.GetState() != OTA_Update::eState::Verifying) { break; }
+
+        if(Ota.isReadyForData() && Pos < Image.size() && rand() % 3 == 0)  //  data come less often than Handle() is called
+        {
+            Chunk = 1 + rand() % TEST_CHUNK_MAX;
+            if(Chunk > Image.size() - Pos) { Chunk = Image.size() - Pos; }
+
+            if(Direct)      //  receiver writes directly into the buffer
+            {
+                pBuffer = Ota.GetWriteBuffer(Space);
+                Len = (Chunk < Space) ? (uint16_t)Chunk : Space;
+                if(pBuffer && Len)
+                {
+                    memcpy(pBuffer, &Image[Pos], Len);
+                    Ota.Commit(Len);
+                }
+            }
+            else
+            {
+                Len = Ota.Write(&Image[Pos], (uint16_t)Chunk);
+            }
+
+            if(Len < Chunk) { Waited = true; }  //  rest of chunk waits for free buffer
+            Pos += Len;
+            Direct = !Direct;
+        }
+
+        Ota.Handle();
+    }
+
+    return Waited;
+}
+
+static bool FlashEquals(const std::vector<uint8_t> &Image)
+{
+    return memcmp(Flash_GetPointer(OTA_STAGING_ADDRESS), Image.data(), Image.size()) == 0;
+}
+
+static void TestAccept()
+{
+std::vector<uint8_t> Image = MakeImage(5 * FLASH_IF_PAGE_SIZE - 333, -1, 1);    //  odd size, last half-word is padded
+OTA_Update Ota;
+bool Waited;
+
+    printf("Image is accepted\n");
+
+    ErasedPages = 0;
+    Waited = Stream(Ota, Image, OTA_Update::CRC32(0, Image.data(), Image.size()));
+
+    Check(Ota.GetState() == OTA_Update::eState::Done && Ota.isImageReady(), "state is done");
+    Check(Ota.GetError() == OTA_Update::eError::NoError, "no error");
+    Check(Ota.GetReceivedBytes() == Image.size() && Ota.GetProgress() == 100, "all bytes received and programmed");
+    Check(FlashEquals(Image), "flash content equals image");
+    Check(Flash_GetPointer(OTA_STAGING_ADDRESS)[Image.size()] == 0xFF, "padding byte is erased value");
+    Check(Waited, "receiver waited for both buffers");
+    Check(ErasedPages == 0, "erased staging area is not erased again");
+}
+
+static void TestReject()
+{
+std::vector<uint8_t> Image = MakeImage(5 * FLASH_IF_PAGE_SIZE, -1, 2);
+OTA_Update Ota;
+
+    printf("Image with wrong CRC32 is rejected\n");
+
+    ErasedPages = 0;
+    Stream(Ota, Image, OTA_Update::CRC32(0, Image.data(), Image.size()) ^ 1);
+
+    Check(Ota.GetState() == OTA_Update::eState::Error && !Ota.isImageReady(), "state is error");
+    Check(Ota.GetError() == OTA_Update::eError::CRCMismatch, "error is CRC mismatch");
+    Check(FlashEquals(Image), "flash content equals image");
+    Check(ErasedPages == 5, "pages of previous image are erased");
+}
+
+static void TestBlankPage()
+{
+std::vector<uint8_t> Image = MakeImage(5 * FLASH_IF_PAGE_SIZE, 2, 3);          //  third page is erased value only
+std::vector<uint8_t> Next = MakeImage(5 * FLASH_IF_PAGE_SIZE, -1, 4);
+OTA_Update Ota;
+
+    printf("Blank pages are skipped\n");
+
+    ErasedPages = 0;
+    Stream(Ota, Image, OTA_Update::CRC32(0, Image.data(), Image.size()));
+    Check(Ota.isImageReady() && FlashEquals(Image), "image with blank page is accepted");
+    Check(ErasedPages == 5, "pages of previous image are erased");
+
+    ErasedPages = 0;
+    Stream(Ota, Next, OTA_Update::CRC32(0, Next.data(), Next.size()));
+    Check(Ota.isImageReady() && FlashEquals(Next), "next image is accepted");
+    Check(ErasedPages == 4, "blank page is not erased");
+}
+
+static void TestLimits()
+{
+OTA_Update Ota;
+uint8_t Data[4] = {0};
+
+    printf("Limits\n");
+
+    Check(SUCCESS != Ota.Begin(OTA_STAGING_SIZE + 1, 0) && Ota.GetError() == OTA_Update::eError::TooBig, "too big image is refused");
+    Check(SUCCESS != Ota.Begin(0, 0), "empty image is refused");
+    Check(Ota.Write(Data, sizeof(Data)) == 0, "data are refused when idle");
+
+    Check(SUCCESS == Ota.Begin(sizeof(Data), 0), "update is started");
+    Check(SUCCESS != Ota.Begin(sizeof(Data), 0), "second start is refused");
+    Ota.Abort();
+    Check(Ota.GetError() == OTA_Update::eError::Aborted, "update is aborted");
+}
+
+int main()
+{
+uint32_t Address;
+
+    srand(1);
+
+    for(Address = OTA_STAGING_ADDRESS; Address < OTA_STAGING_ADDRESS + OTA_STAGING_SIZE; Address += FLASH_IF_PAGE_SIZE)
+    {
+        __real_Flash_ErasePage(Address);    //  emulated flash is zeroed at start, device comes with erased flash
+    }
+
+    TestAccept();
+    TestReject();
+    TestBlankPage();
+    TestLimits();
+
+    if(Failures) { printf("%d check(s) failed\n", Failures); }
+    else         { printf("all checks passed\n"); }
+
+    return Failures;
+}
@@ -0,0 +1,275 @@
+/**
+  ******************************************************************************
+  * @file    scan_bench.c
+  * @author  Ostap Kostyk
+  * @brief   Host benchmark of delimiter scanning: sscanf()/strstr() based parsing
+  *          of HTTP requests (as it was) versus Scan.h functions on a corpus of
+  *          requests sent by real browsers.
+  *          Build and run on the host from Tools directory:
+  *            gcc -O2 -I../Core/Inc scan_bench.c ../Core/Src/Scan.c -o scan_bench && ./scan_bench
+  *          Add -DSCAN_BYTEWISE to compare with byte by byte search.
+  *          Note: glibc strstr()/strchr() on the host are vectorized, newlib on
+  *          the target compares byte by byte, so the target gains more
+  *
+  ******************************************************************************
+  * Copyright (C) 2018  Ostap Kostyk
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version provided that the redistributions
+  * of source code must retain the above copyright notice.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  ******************************************************************************
+  * Author contact information: Ostap Kostyk, email: ostap.kostyk@gmail.com
+  ******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "Scan.h"
+
+#define ITERATIONS  20000
+
+/* Requests captured from browsers opening the page of the server (addresses and cookies shortened) */
+static const char *Corpus[] = {
+    /* Chrome, form submitted with GET */
+    "GET /?LED1=1&LED2=0&Relay=1 HTTP/1.1\r\n"
+    "Host: 192.168.0.1\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+    "Referer: http://192.168.0.1/\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: en-US,en;q=0.9,uk;q=0.8\r\n"
+    "\r\n",
+
+    /* Firefox */
+    "GET /favicon.ico HTTP/1.1\r\n"
+    "Host: 192.168.0.1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Ubuntu; Linux x86_64; rv:121.0) Gecko/20100101 Firefox/121.0\r\n"
+    "Accept: image/avif,image/webp,*/*\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://192.168.0.1/\r\n"
+    "If-None-Match: \"4f1c2a9e\"\r\n"
+    "\r\n",
+
+    /* Safari */
+    "GET / HTTP/1.1\r\n"
+    "Host: 192.168.0.1\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "User-Agent: Mozilla/5.0 (iPhone; CPU iPhone OS 17_2 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.2 Mobile/15E148 Safari/604.1\r\n"
+    "Accept-Language: en-GB,en;q=0.9\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n",
+
+    /* Edge, form submitted with POST */
+    "POST / HTTP/1.1\r\n"
+    "Host: 192.168.0.1\r\n"
+    "Connection: keep-alive\r\n"
+    "Content-Length: 34\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Origin: http://192.168.0.1\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36 Edg/120.0.0.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,image/apng,*/*;q=0.8\r\n"
+    "Referer: http://192.168.0.1/\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "\r\n"
+    "LED1=0&LED2=1&Relay=0&Name=kitchen",
+
+    /* curl */
+    "GET /metrics HTTP/1.1\r\n"
+    "Host: 192.168.0.1\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "\r\n",
+};
+
+#define CORPUS_SIZE (sizeof(Corpus) / sizeof(Corpus[0]))
+
+static volatile size_t Sink;    //  keeps results alive, so the compiler does not remove the work
+
+static double Now(void)
+{
+struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Header lines and "Host:" as done by ParseHTTPRequest() before */
+static size_t HeaderOld(const char *Req)
+{
+const char *p = Req;
+const char *pEnd;
+char Host[64];
+size_t n = 0;
+
+    pEnd = strstr(Req, "\r\n\r\n");
+    if(pEnd == 0) { return 0; }
+
+    while((p = strstr(p, "\r\n")) != 0 && p < pEnd)
+    {
+        p += 2;
+        if(sscanf(p, " Host: %63s", Host) == 1) { n += strlen(Host); }
+        n++;
+    }
+
+    return n;
+}
+
+/* Same with Scan.h, "Host:" is compared before sscanf() as ParseHTTPRequest() does now */
+static size_t HeaderNew(const char *Req, size_t Len)
+{
+const char *p = Req;
+const char *pEnd;
+const char *pLine;
+char Host[64];
+size_t n = 0;
+
+    pEnd = Scan_FindCRLFCRLF(Req, Len);
+    if(pEnd == 0) { return 0; }
+
+    while((pLine = Scan_FindCRLF(p, pEnd + 2 - p)) != 0 && pLine < pEnd)
+    {
+        p = pLine + 2;
+        if(strncmp(p, "Host:", 5) == 0 && sscanf(p, " Host: %63s", Host) == 1) { n += strlen(Host); }
+        n++;
+    }
+
+    return n;
+}
+
+/* Query string tokenizing as done by ParseQueryString() before */
+static size_t QueryOld(const char *Req)
+{
+const char *p;
+int pos;
+size_t n = 0;
+
+    p = strchr(Req, '?');
+    if(p == 0)
+    {
+        p = strstr(Req, "\r\n\r\n");
+        if(p == 0) { return 0; }
+        p += 3;
+    }
+    p++;
+
+    while(*p && *p != ' ')
+    {
+        pos = 0;
+        sscanf(p, "%*[^& \r\n=]%n", &pos);
+        if(pos == 0) { break; }
+        p += pos;
+        n += pos;
+        if(*p == '=') { p++; }
+        pos = 0;
+        sscanf(p, "%*[^& \r\n=]%n", &pos);
+        p += pos;
+        n += pos;
+        if(*p != '&') { break; }
+        p++;
+    }
+
+    return n;
+}
+
+static size_t QueryNew(const char *Req, size_t Len)
+{
+static const char Delimiters[] = {'&', ' ', '\r', '\n', '=', '\0'};
+const char *pEnd = Req + Len + 1;   //  terminating zero is a delimiter too
+const char *p, *q;
+size_t n = 0;
+
+    p = Scan_FindByte(Req, Len, '?');
+    if(p == 0)
+    {
+        p = Scan_FindCRLFCRLF(Req, Len);
+        if(p == 0) { return 0; }
+        p += 3;
+    }
+    p++;
+
+    while(*p && *p != ' ')
+    {
+        q = Scan_FindAny(p, pEnd - p, Delimiters, sizeof(Delimiters));
+        if(q == 0 || q == p) { break; }
+        n += q - p;
+        p = q;
+        if(*p == '=') { p++; }
+        q = Scan_FindAny(p, pEnd - p, Delimiters, sizeof(Delimiters));
+        if(q == 0) { break; }
+        n += q - p;
+        p = q;
+        if(*p != '&') { break; }
+        p++;
+    }
+
+    return n;
+}
+
+int main(void)
+{
+size_t Len[CORPUS_SIZE];
+size_t i, k, Bytes = 0;
+double t0, tHeaderOld, tHeaderNew, tQueryOld, tQueryNew;
+
+    for(i = 0; i < CORPUS_SIZE; i++)
+    {
+        Len[i] = strlen(Corpus[i]);
+        Bytes += Len[i];
+
+        if(HeaderOld(Corpus[i]) != HeaderNew(Corpus[i], Len[i]) || QueryOld(Corpus[i]) != QueryNew(Corpus[i], Len[i]))
+        {
+            printf("Results differ for request %u\n", (unsigned)i);
+            return 1;
+        }
+    }
+
+    t0 = Now();
+    for(k = 0; k < ITERATIONS; k++) { for(i = 0; i < CORPUS_SIZE; i++) { Sink += HeaderOld(Corpus[i]); } }
+    tHeaderOld = Now() - t0;
+
+    t0 = Now();
+    for(k = 0; k < ITERATIONS; k++) { for(i = 0; i < CORPUS_SIZE; i++) { Sink += HeaderNew(Corpus[i], Len[i]); } }
+    tHeaderNew = Now() - t0;
+
+    t0 = Now();
+    for(k = 0; k < ITERATIONS; k++) { for(i = 0; i < CORPUS_SIZE; i++) { Sink += QueryOld(Corpus[i]); } }
+    tQueryOld = Now() - t0;
+
+    t0 = Now();
+    for(k = 0; k < ITERATIONS; k++) { for(i = 0; i < CORPUS_SIZE; i++) { Sink += QueryNew(Corpus[i], Len[i]); } }
+    tQueryNew = Now() - t0;
+
+#ifdef SCAN_BYTEWISE
+    printf("Scan.h: byte by byte\n");
+#else
+    printf("Scan.h: word at a time\n");
+#endif
+    printf("%u requests, %u bytes, %u iterations\n", (unsigned)CORPUS_SIZE, (unsigned)Bytes, ITERATIONS);
+    printf("header lines:  old %8.1f ns/request, new %8.1f ns/request, x%.1f\n",
+           tHeaderOld / (ITERATIONS * CORPUS_SIZE), tHeaderNew / (ITERATIONS * CORPUS_SIZE), tHeaderOld / tHeaderNew);
+    printf("query string:  old %8.1f ns/request, new %8.1f ns/request, x%.1f\n",
+           tQueryOld / (ITERATIONS * CORPUS_SIZE), tQueryNew / (ITERATIONS * CORPUS_SIZE), tQueryOld / tQueryNew);
+
+    return 0;
+}